@@ -0,0 +1,193 @@
+// Measures connection pool checkout contention.
+//
+// Every thread repeatedly checks a connection out and returns it without running a query, so
+// the numbers are the pool's own overhead. The pool is compared with MutexPool, a copy of the
+// checkout it replaced, and with itself at a single shard, where every thread scans the same
+// slots. Needs a PostgreSQL server; the host and port of the test database can be overridden
+// with the first two arguments.
+
+#include <relx/connection/postgresql_connection.hpp>
+#include <relx/connection/postgresql_connection_pool.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t pool_size = 32;
+constexpr int checkouts_per_thread = 20'000;
+
+relx::connection::PostgreSQLConnectionParams connection_params(int argc, char** argv) {
+  relx::connection::PostgreSQLConnectionParams params{.host = "localhost",
+                                                      .port = 5434,
+                                                      .dbname = "relx_test",
+                                                      .user = "postgres",
+                                                      .password = "postgres"};
+  if (argc > 1) {
+    params.host = argv[1];
+  }
+  if (argc > 2) {
+    params.port = static_cast<uint16_t>(std::stoi(argv[2]));
+  }
+  return params;
+}
+
+// The checkout of the pool before it was sharded: one mutex and condition variable guard a
+// queue of idle connections. Every checkout takes the mutex for the idle sweep and again to pop
+// a connection; every return takes it to push the connection back and notifies a waiter.
+class MutexPool {
+public:
+  bool initialize(const relx::connection::PostgreSQLConnectionParams& params) {
+    for (size_t i = 0; i < pool_size; ++i) {
+      auto connection = std::make_shared<relx::connection::PostgreSQLConnection>(params);
+      if (auto connected = connection->connect(); !connected) {
+        std::fprintf(stderr, "%s\n", connected.error().message.c_str());
+        return false;
+      }
+      idle_.push(Entry{.connection = std::move(connection),
+                       .last_used = std::chrono::steady_clock::now()});
+    }
+    total_ = pool_size;
+    return true;
+  }
+
+  std::shared_ptr<relx::connection::PostgreSQLConnection> get() {
+    sweep_idle();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!available_.wait_for(lock, std::chrono::seconds(5), [&] { return !idle_.empty(); })) {
+      return nullptr;
+    }
+    auto connection = std::move(idle_.front().connection);
+    idle_.pop();
+    ++active_;
+    return connection;
+  }
+
+  void put(std::shared_ptr<relx::connection::PostgreSQLConnection> connection) {
+    const bool valid = connection->is_connected() && !connection->in_transaction();
+
+    const std::lock_guard<std::mutex> lock(mutex_);
+    --active_;
+    if (valid) {
+      idle_.push(Entry{.connection = std::move(connection),
+                       .last_used = std::chrono::steady_clock::now()});
+    } else {
+      --total_;
+    }
+    available_.notify_one();
+  }
+
+private:
+  struct Entry {
+    std::shared_ptr<relx::connection::PostgreSQLConnection> connection;
+    std::chrono::steady_clock::time_point last_used;
+  };
+
+  // The old sweep closed idle connections above the initial size under the mutex. The
+  // benchmark pool never grows, so all that is left of it is taking the lock
+  void sweep_idle() { const std::lock_guard<std::mutex> lock(mutex_); }
+
+  std::mutex mutex_;
+  std::condition_variable available_;
+  std::queue<Entry> idle_;
+  size_t total_ = 0;
+  size_t active_ = 0;
+};
+
+// Starts the threads together and returns the mean time of one checkout_once() call in
+// nanoseconds, or a negative value if any call failed
+template <typename CheckoutOnce>
+double measure(int threads, CheckoutOnce checkout_once) {
+  std::atomic<bool> start{false};
+  std::atomic<int> failures{0};
+  std::vector<std::thread> workers;
+  workers.reserve(threads);
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&] {
+      while (!start.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      for (int i = 0; i < checkouts_per_thread; ++i) {
+        if (!checkout_once()) {
+          failures.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    });
+  }
+
+  const auto begin = std::chrono::steady_clock::now();
+  start.store(true, std::memory_order_release);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - begin;
+
+  if (failures > 0) {
+    return -1;
+  }
+  return static_cast<double>(
+             std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+         (static_cast<double>(threads) * checkouts_per_thread);
+}
+
+double run_mutex_pool(const relx::connection::PostgreSQLConnectionParams& params, int threads) {
+  MutexPool pool;
+  if (!pool.initialize(params)) {
+    return -1;
+  }
+  return measure(threads, [&] {
+    auto connection = pool.get();
+    if (!connection) {
+      return false;
+    }
+    pool.put(std::move(connection));
+    return true;
+  });
+}
+
+double run_pool(const relx::connection::PostgreSQLConnectionParams& params, size_t shard_count,
+                int threads) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = params;
+  config.initial_size = pool_size;
+  config.max_size = pool_size;
+  config.validate_connections = false;
+  config.shard_count = shard_count;
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  if (auto init = pool->initialize(); !init) {
+    std::fprintf(stderr, "%s\n", init.error().message.c_str());
+    return -1;
+  }
+  return measure(threads, [&] { return pool->get_connection().has_value(); });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const auto params = connection_params(argc, argv);
+
+  std::printf("%8s %20s %20s %20s\n", "threads", "mutex pool (ns/op)", "1 shard (ns/op)",
+              "sharded (ns/op)");
+  for (int threads = 1; threads <= 128; threads *= 2) {
+    const double mutex = run_mutex_pool(params, threads);
+    const double single = run_pool(params, 1, threads);
+    const double sharded = run_pool(params, 0, threads);
+    if (mutex < 0 || single < 0 || sharded < 0) {
+      return 1;
+    }
+    std::printf("%8d %20.1f %20.1f %20.1f\n", threads, mutex, single, sharded);
+  }
+  return 0;
+}
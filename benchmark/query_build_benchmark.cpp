@@ -0,0 +1,102 @@
+// Measures the cost of building a query and rendering its SQL and parameters.
+//
+// Queries with a static shape render their SQL once per thread and afterwards only pay for
+// collecting bind parameters; the "params only" rows show that lower bound. The IN-list row has
+// a runtime-variable shape and is rendered on every call, for comparison. The writer row is what
+// the connections do: one pass producing $n placeholders and parameters into reused buffers.
+
+#include <relx/query.hpp>
+#include <relx/schema.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Users {
+  static constexpr auto table_name = "users";
+  relx::schema::column<Users, "id", int> id;
+  relx::schema::column<Users, "name", std::string> name;
+  relx::schema::column<Users, "email", std::string> email;
+  relx::schema::column<Users, "age", int> age;
+};
+
+constexpr int iterations = 1'000'000;
+
+// Accumulates output sizes so the optimiser cannot drop the measured work
+size_t sink = 0;
+
+template <typename Fn>
+void run(const char* name, Fn&& fn) {
+  // Warm up, which also populates the per-thread SQL cache
+  for (int i = 0; i < 1000; ++i) {
+    fn(i);
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    fn(i);
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  const double ns_per_op =
+      static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+      iterations;
+  std::printf("%-48s %10.1f ns/op\n", name, ns_per_op);
+}
+
+auto select_by_age(const Users& u, int i) {
+  using namespace relx::query;
+  return select(u.id, u.name, u.email)
+      .from(u)
+      .where(u.age > i && u.name != "admin")
+      .order_by(desc(u.id))
+      .limit(10);
+}
+
+}  // namespace
+
+int main() {
+  using namespace relx::query;
+  Users u;
+
+  run("select: params only", [&](int i) { sink += select_by_age(u, i).bind_params().size(); });
+
+  run("select: to_sql + params (static shape)", [&](int i) {
+    auto query = select_by_age(u, i);
+    sink += query.to_sql().size() + query.bind_params().size();
+  });
+
+  run("select: render to reused writer ($n)", [&](int i) {
+    SqlWriterLease writer(PlaceholderStyle::Numbered);
+    render_to(*writer, select_by_age(u, i));
+    sink += writer->sql().size() + writer->params().size();
+  });
+
+  run("select: to_sql + params (IN list, rendered)", [&](int i) {
+    auto query = select(u.id, u.name, u.email)
+                     .from(u)
+                     .where(in(column_ref(u.id), std::vector<std::string>{std::to_string(i)}));
+    sink += query.to_sql().size() + query.bind_params().size();
+  });
+
+  run("insert: to_sql + params (static shape)", [&](int i) {
+    auto query = insert_into(u).columns(u.id, u.name, u.email, u.age).values(i, "n", "e", 42);
+    sink += query.to_sql().size() + query.bind_params().size();
+  });
+
+  run("update: to_sql + params (static shape)", [&](int i) {
+    auto query = update(u).set(u.age, val(i)).where(column_ref(u.id) == val(i));
+    sink += query.to_sql().size() + query.bind_params().size();
+  });
+
+  run("delete: to_sql + params (static shape)", [&](int i) {
+    auto query = delete_from(u).where(column_ref(u.id) == val(i));
+    sink += query.to_sql().size() + query.bind_params().size();
+  });
+
+  return sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,107 @@
+// Measures small-query latency over loopback TCP and over a Unix-domain socket.
+//
+// One async connection per transport runs SELECT 1 back to back, so each sample is a full round
+// trip through the async wrapper. Needs a PostgreSQL server reachable both ways; by default the
+// test database of docker-compose.yml, whose socket directory is shared as /tmp/relx_postgres.
+// The TCP host and port and the socket directory can be overridden with the first three
+// arguments.
+
+#include <relx/connection/postgresql_async_connection.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+
+namespace {
+
+namespace asio = boost::asio;
+
+constexpr int warmup_queries = 1'000;
+constexpr int measured_queries = 20'000;
+
+struct Latency {
+  double mean_us = -1;
+  double p50_us = -1;
+  double p99_us = -1;
+};
+
+relx::connection::PostgreSQLConnectionParams base_params() {
+  return {.dbname = "relx_test", .user = "postgres", .password = "postgres"};
+}
+
+// Returns negative latencies if the connection or a query fails
+Latency run(const relx::connection::PostgreSQLConnectionParams& params) {
+  asio::io_context io_context;
+  relx::connection::PostgreSQLAsyncConnection conn(io_context, params);
+  Latency latency;
+
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        if (auto connected = co_await conn.connect(); !connected) {
+          std::fprintf(stderr, "%s\n", connected.error().message.c_str());
+          co_return;
+        }
+
+        std::vector<double> samples;
+        samples.reserve(measured_queries);
+        for (int i = 0; i < warmup_queries + measured_queries; ++i) {
+          const auto begin = std::chrono::steady_clock::now();
+          auto result = co_await conn.execute_raw("SELECT 1");
+          const auto elapsed = std::chrono::steady_clock::now() - begin;
+          if (!result) {
+            std::fprintf(stderr, "%s\n", result.error().message.c_str());
+            co_return;
+          }
+          if (i >= warmup_queries) {
+            samples.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+          }
+        }
+        co_await conn.disconnect();
+
+        double total = 0;
+        for (const double sample : samples) {
+          total += sample;
+        }
+        std::sort(samples.begin(), samples.end());
+        latency.mean_us = total / static_cast<double>(samples.size());
+        latency.p50_us = samples[samples.size() / 2];
+        latency.p99_us = samples[samples.size() * 99 / 100];
+      },
+      asio::detached);
+  io_context.run();
+  return latency;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  auto tcp = base_params();
+  tcp.host = argc > 1 ? argv[1] : "127.0.0.1";
+  tcp.port = argc > 2 ? static_cast<uint16_t>(std::stoi(argv[2])) : 5434;
+
+  // libpq treats a host starting with a slash as the directory of a Unix-domain socket; the
+  // port names the socket file, .s.PGSQL.<port>
+  auto uds = base_params();
+  uds.host = argc > 3 ? argv[3] : "/tmp/relx_postgres";
+  uds.port = 5432;
+
+  std::printf("%-10s %12s %12s %12s\n", "transport", "mean (us)", "p50 (us)", "p99 (us)");
+  for (const auto& [name, params] : {std::pair{"tcp", tcp}, std::pair{"unix", uds}}) {
+    const Latency latency = run(params);
+    if (latency.mean_us < 0) {
+      return 1;
+    }
+    std::printf("%-10s %12.1f %12.1f %12.1f\n", name, latency.mean_us, latency.p50_us,
+                latency.p99_us);
+  }
+  return 0;
+}
@@ -2,8 +2,11 @@
 
 #include "connection/connection.hpp"
 #include "connection/postgresql_async_connection.hpp"
+#include "connection/postgresql_async_connection_pool.hpp"
 #include "connection/postgresql_connection.hpp"
 #include "connection/postgresql_connection_pool.hpp"
+#include "connection/postgresql_pipeline.hpp"
+#include "connection/query_options.hpp"
 #include "connection/transaction_guard.hpp"
 #include "utils/error_handling.hpp"
 /**
@@ -97,6 +100,8 @@ using connection::PostgreSQLConnection;
 using connection::PostgreSQLConnectionParams;
 using connection::PostgreSQLConnectionPool;
 using connection::PostgreSQLConnectionPoolConfig;
+using connection::PostgreSQLPipeline;
+using connection::StatementCacheStats;
 using connection::TransactionGuard;
 
 // Error types
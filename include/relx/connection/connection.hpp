@@ -1,11 +1,14 @@
 #pragma once
 
 #include "../query/core.hpp"
+#include "../query/param.hpp"
+#include "../query/sql_writer.hpp"
 #include "../results/result.hpp"
 #include "meta.hpp"
 
 #include <expected>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <string_view>
@@ -98,6 +101,110 @@ struct PostgreSQLConnectionParams {
   }
 };
 
+/// @brief Map every row of a result set to a user-defined type using Boost.PFR
+/// @tparam T The user-defined type to map rows to
+/// @tparam Query The query expression that produced the result, named in errors
+/// @param result_set The rows to map
+/// @param query The query expression that produced the result
+/// @return The mapped objects, or an error if a row does not fit T
+template <typename T, query::SqlExpr Query>
+ConnectionResult<std::vector<T>> map_rows(const result::ResultSet& result_set,
+                                          const Query& query) {
+  std::vector<T> objects;
+  objects.reserve(result_set.size());
+
+  // Check if we have at least one row to determine column count
+  if (result_set.empty()) {
+    return objects;  // Return empty vector
+  }
+
+  // Make sure the number of columns matches the number of fields in the struct
+  if (result_set.column_count() != boost::pfr::tuple_size_v<std::remove_cvref_t<T>>) {
+    std::stringstream ss;
+    for (const auto& param : query.bind_params()) {
+      ss << param << ", ";
+    }
+    return std::unexpected(ConnectionError{
+        .message = "Column count does not match struct field count, " +
+                   std::to_string(result_set.column_count()) +
+                   " != " + std::to_string(boost::pfr::tuple_size_v<std::remove_cvref_t<T>>) +
+                   " for struct " + typeid(T).name() + " and query " + query.to_sql() +
+                   " with params " + ss.str(),
+        .error_code = -1});
+  }
+
+  // Process each row
+  for (size_t row_idx = 0; row_idx < result_set.size(); ++row_idx) {
+    const auto& row = result_set.at(row_idx);
+    T obj{};
+    auto structure_tie = boost::pfr::structure_tie(obj);
+
+    try {
+      // Create a vector of values from the row
+      std::vector<std::string> values;
+      for (size_t i = 0; i < result_set.column_count(); ++i) {
+        auto cell_result = row.get_cell(i);
+        if (!cell_result) {
+          return std::unexpected(ConnectionError{
+              .message = "Failed to get cell value: " + cell_result.error().message,
+              .error_code = -1});
+        }
+        values.push_back((*cell_result)->raw_value());
+      }
+
+      relx::connection::map_row_to_tuple(structure_tie, values);
+      objects.push_back(std::move(obj));
+    } catch (const std::exception& e) {
+      return std::unexpected(ConnectionError{
+          .message = std::string("Failed to convert result to struct: ") + e.what(),
+          .error_code = -1});
+    }
+  }
+
+  return objects;
+}
+
+/// @brief Map the result sets of a batch of queries, the i-th to a vector of the i-th type
+/// @tparam Ts The user-defined types to map rows to, one per query
+/// @tparam Queries The query expression types
+/// @param result_sets One result set per query, in order
+/// @param queries The query expressions that produced the results
+/// @return A tuple with one vector of mapped objects per query, or the first mapping error
+template <typename... Ts, query::SqlExpr... Queries>
+ConnectionResult<std::tuple<std::vector<Ts>...>> map_result_sets(
+    const std::vector<result::ResultSet>& result_sets, const Queries&... queries) {
+  static_assert(sizeof...(Ts) == sizeof...(Queries), "One result type is needed per query");
+  if (result_sets.size() != sizeof...(Queries)) {
+    return std::unexpected(ConnectionError{
+        .message = "Expected " + std::to_string(sizeof...(Queries)) + " result sets, got " +
+                   std::to_string(result_sets.size()),
+        .error_code = -1});
+  }
+
+  std::optional<ConnectionError> error;
+  size_t index = 0;
+  auto map_next = [&]<typename T>(const auto& query) {
+    std::vector<T> objects;
+    if (!error) {
+      auto mapped = map_rows<T>(result_sets[index], query);
+      if (mapped) {
+        objects = std::move(*mapped);
+      } else {
+        error = std::move(mapped.error());
+      }
+    }
+    ++index;
+    return objects;
+  };
+
+  // A braced initializer evaluates its elements in order, so index follows the queries
+  std::tuple<std::vector<Ts>...> mapped{map_next.template operator()<Ts>(queries)...};
+  if (error) {
+    return std::unexpected(std::move(*error));
+  }
+  return mapped;
+}
+
 /// @brief Abstract base class for database connections
 class Connection {
 public:
@@ -126,9 +233,13 @@ public:
   template <query::SqlExpr Query>
   [[nodiscard]]
   ConnectionResult<result::ResultSet> execute(const Query& query) {
-    std::string sql = query.to_sql();
-    std::vector<std::string> params = query.bind_params();
-    return execute_raw(sql, params);
+    static_assert(!query::ParameterizedQuery<Query>,
+                  "Queries with relx::param placeholders must be executed through prepare()");
+    // Render text and parameters in one pass into this thread's reusable buffers
+    query::SqlWriterLease writer(placeholder_style());
+    writer->set_typed_params(uses_typed_params());
+    query::render_to(*writer, query);
+    return execute_query_sql(writer->sql(), writer->params(), writer->param_types());
   }
 
   /// @brief Execute a query and map results to a user-defined type using Boost.PFR
@@ -213,61 +324,7 @@ public:
     if (!result) {
       return std::unexpected(result.error());
     }
-
-    const auto& result_set = *result;
-    std::vector<T> objects;
-    objects.reserve(result_set.size());
-
-    // Check if we have at least one row to determine column count
-    if (result_set.empty()) {
-      return objects;  // Return empty vector
-    }
-
-    // Make sure the number of columns matches the number of fields in the struct
-    // TODO
-    if (result_set.column_count() != boost::pfr::tuple_size_v<std::remove_cvref_t<T>>) {
-      std::stringstream ss;
-      for (const auto& param : query.bind_params()) {
-        ss << param << ", ";
-      }
-      return std::unexpected(ConnectionError{
-          .message = "Column count does not match struct field count, " +
-                     std::to_string(result_set.column_count()) +
-                     " != " + std::to_string(boost::pfr::tuple_size_v<std::remove_cvref_t<T>>) +
-                     " for struct " + typeid(T).name() + " and query " + query.to_sql() +
-                     " with params " + ss.str(),
-          .error_code = -1});
-    }
-
-    // Process each row
-    for (size_t row_idx = 0; row_idx < result_set.size(); ++row_idx) {
-      const auto& row = result_set.at(row_idx);
-      T obj{};
-      auto structure_tie = boost::pfr::structure_tie(obj);
-
-      try {
-        // Create a vector of values from the row
-        std::vector<std::string> values;
-        for (size_t i = 0; i < result_set.column_count(); ++i) {
-          auto cell_result = row.get_cell(i);
-          if (!cell_result) {
-            return std::unexpected(ConnectionError{.message = "Failed to get cell value: " +
-                                                              cell_result.error().message,
-                                                   .error_code = -1});
-          }
-          values.push_back((*cell_result)->raw_value());
-        }
-
-        relx::connection::map_row_to_tuple(structure_tie, values);
-        objects.push_back(std::move(obj));
-      } catch (const std::exception& e) {
-        return std::unexpected(ConnectionError{
-            .message = std::string("Failed to convert result to struct: ") + e.what(),
-            .error_code = -1});
-      }
-    }
-
-    return objects;
+    return map_rows<T>(*result, query);
   }
 
   /// @brief Check if the connection is open
@@ -295,6 +352,31 @@ public:
   /// @return True if a transaction is active, false otherwise
   virtual bool in_transaction() const = 0;
 
+protected:
+  /// @brief Placeholder style used when rendering query expressions for this connection
+  /// @return Question marks by default; connections that accept numbered placeholders natively
+  /// override this so rendered SQL does not have to be converted before sending
+  virtual query::PlaceholderStyle placeholder_style() const {
+    return query::PlaceholderStyle::Question;
+  }
+
+  /// @brief Check if query expressions are rendered with typed, binary-encoded parameters
+  /// @return False by default; connections that pass parameter types to the server override this
+  virtual bool uses_typed_params() const { return false; }
+
+  /// @brief Execute SQL rendered from a query expression
+  /// @details Rendered queries always hold exactly one statement, so implementations may route
+  /// them differently from execute_raw(), e.g. through a prepared-statement cache.
+  /// @param sql The rendered SQL query string
+  /// @param params Vector of parameter values
+  /// @param types Parameter types and formats, empty unless uses_typed_params() returns true
+  /// @return Result containing the query results or an error
+  virtual ConnectionResult<result::ResultSet> execute_query_sql(
+      const std::string& sql, const std::vector<std::string>& params,
+      [[maybe_unused]] const query::ParamTypes& types) {
+    return execute_raw(sql, params);
+  }
+
 private:
 };
 
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace relx::connection {
+
+/// @brief Counts of the queries sent on a connection
+struct QueryStats {
+  uint64_t queries = 0;   ///< Statements executed, including the ones that failed
+  uint64_t errors = 0;    ///< Statements that failed, in the server or on the connection
+  uint64_t timeouts = 0;  ///< Statements cancelled by statement_timeout or a cancel request
+
+  QueryStats& operator+=(const QueryStats& other) {
+    queries += other.queries;
+    errors += other.errors;
+    timeouts += other.timeouts;
+    return *this;
+  }
+
+  /// @brief Counts since an earlier reading of the same connection
+  QueryStats operator-(const QueryStats& earlier) const {
+    return QueryStats{.queries = queries - earlier.queries,
+                      .errors = errors - earlier.errors,
+                      .timeouts = timeouts - earlier.timeouts};
+  }
+};
+
+namespace detail {
+
+/// @brief Number of stripes each metric is split into
+inline constexpr size_t metric_stripes = 8;
+
+/// @brief Stripe the calling thread records into; threads are spread over the stripes in turn
+inline size_t metric_stripe() {
+  static std::atomic<size_t> next_stripe{0};
+  thread_local const size_t stripe =
+      next_stripe.fetch_add(1, std::memory_order_relaxed) % metric_stripes;
+  return stripe;
+}
+
+}  // namespace detail
+
+/// @brief Counter that threads increment without contending on one cache line
+/// @details Each thread adds to its own stripe with a relaxed increment; reading sums the
+/// stripes, so a value read while others record may miss their latest increments.
+class StripedCounter {
+public:
+  /// @brief Add to the counter
+  void add(uint64_t value = 1) {
+    cells_[detail::metric_stripe()].value.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  /// @brief Get the current total
+  uint64_t load() const {
+    uint64_t total = 0;
+    for (const auto& cell : cells_) {
+      total += cell.value.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+private:
+  struct alignas(64) Cell {
+    std::atomic<uint64_t> value{0};
+  };
+  std::array<Cell, detail::metric_stripes> cells_;
+};
+
+/// @brief Counts of a LatencyHistogram at one point in time
+struct HistogramSnapshot {
+  std::vector<uint64_t> counts;  ///< Per bucket, see LatencyHistogram::bucket_upper_bound()
+  uint64_t count = 0;
+  std::chrono::microseconds sum{0};
+  std::chrono::microseconds max{0};  ///< Largest value recorded since the histogram was created
+
+  /// @brief Get a percentile of the recorded values
+  /// @param percent The percentile, between 0 and 100
+  /// @return The upper bound of the bucket holding the percentile, capped at max, or 0 if
+  /// nothing was recorded
+  std::chrono::microseconds percentile(double percent) const;
+
+  /// @brief Get the mean of the recorded values, or 0 if nothing was recorded
+  std::chrono::microseconds mean() const {
+    return count == 0 ? std::chrono::microseconds(0)
+                      : std::chrono::microseconds(sum.count() / static_cast<int64_t>(count));
+  }
+
+  /// @brief Get the values recorded since an earlier snapshot of the same histogram
+  /// @details max cannot be taken apart and stays the overall maximum.
+  HistogramSnapshot since(const HistogramSnapshot& earlier) const;
+};
+
+/// @brief Histogram of durations with HDR-style log-linear buckets, safe to record into from
+/// any thread
+/// @details Values are kept in microseconds. Values below 8 have a bucket each; every power of
+/// two above is split into 8 buckets, so a value is reported at most 12.5% too high, up to
+/// about 12 days. Recording only touches the calling thread's stripe, with relaxed atomics.
+class LatencyHistogram {
+public:
+  static constexpr unsigned sub_bucket_bits = 3;
+  static constexpr size_t sub_buckets = size_t{1} << sub_bucket_bits;
+  static constexpr unsigned max_bits = 40;  ///< Values from 2^max_bits us on share the top bucket
+  static constexpr size_t bucket_count = sub_buckets + (max_bits - sub_bucket_bits) * sub_buckets;
+
+  /// @brief Get the bucket holding a value in microseconds
+  static constexpr size_t bucket_index(uint64_t micros) {
+    micros = std::min(micros, (uint64_t{1} << max_bits) - 1);
+    if (micros < sub_buckets) {
+      return static_cast<size_t>(micros);
+    }
+    const unsigned shift = static_cast<unsigned>(std::bit_width(micros)) - 1 - sub_bucket_bits;
+    return sub_buckets + shift * sub_buckets + static_cast<size_t>(micros >> shift) - sub_buckets;
+  }
+
+  /// @brief Get the largest value in microseconds that falls into a bucket
+  static constexpr uint64_t bucket_upper_bound(size_t index) {
+    if (index < sub_buckets) {
+      return index;
+    }
+    const size_t shift = (index - sub_buckets) / sub_buckets;
+    const uint64_t lower = (sub_buckets + (index - sub_buckets) % sub_buckets) << shift;
+    return lower + (uint64_t{1} << shift) - 1;
+  }
+
+  /// @brief Record a duration
+  template <typename Rep, typename Period>
+  void record(std::chrono::duration<Rep, Period> value) {
+    const auto micros = std::max<int64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(value).count(), 0);
+    auto& stripe = stripes_[detail::metric_stripe()];
+    stripe.counts[bucket_index(static_cast<uint64_t>(micros))].fetch_add(
+        1, std::memory_order_relaxed);
+    stripe.sum.fetch_add(static_cast<uint64_t>(micros), std::memory_order_relaxed);
+    auto max = stripe.max.load(std::memory_order_relaxed);
+    while (static_cast<uint64_t>(micros) > max &&
+           !stripe.max.compare_exchange_weak(max, static_cast<uint64_t>(micros),
+                                             std::memory_order_relaxed)) {
+    }
+  }
+
+  /// @brief Get the counts recorded so far
+  HistogramSnapshot snapshot() const {
+    HistogramSnapshot snapshot;
+    snapshot.counts.assign(bucket_count, 0);
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    for (const auto& stripe : stripes_) {
+      for (size_t i = 0; i < bucket_count; ++i) {
+        const auto count = stripe.counts[i].load(std::memory_order_relaxed);
+        snapshot.counts[i] += count;
+        snapshot.count += count;
+      }
+      sum += stripe.sum.load(std::memory_order_relaxed);
+      max = std::max(max, stripe.max.load(std::memory_order_relaxed));
+    }
+    snapshot.sum = std::chrono::microseconds(static_cast<int64_t>(sum));
+    snapshot.max = std::chrono::microseconds(static_cast<int64_t>(max));
+    return snapshot;
+  }
+
+private:
+  struct alignas(64) Stripe {
+    std::array<std::atomic<uint64_t>, bucket_count> counts{};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+  };
+  std::array<Stripe, detail::metric_stripes> stripes_{};
+};
+
+inline std::chrono::microseconds HistogramSnapshot::percentile(double percent) const {
+  if (count == 0) {
+    return std::chrono::microseconds(0);
+  }
+  // The rank of the percentile value, counting from 1
+  const auto rank = std::clamp<uint64_t>(
+      static_cast<uint64_t>(std::ceil(std::clamp(percent, 0.0, 100.0) / 100.0 *
+                                      static_cast<double>(count))),
+      1, count);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < counts.size(); ++i) {
+    seen += counts[i];
+    if (seen >= rank) {
+      const auto bound = static_cast<int64_t>(LatencyHistogram::bucket_upper_bound(i));
+      return std::min(std::chrono::microseconds(bound), max);
+    }
+  }
+  return max;
+}
+
+inline HistogramSnapshot HistogramSnapshot::since(const HistogramSnapshot& earlier) const {
+  HistogramSnapshot difference = *this;
+  for (size_t i = 0; i < earlier.counts.size() && i < difference.counts.size(); ++i) {
+    difference.counts[i] -= earlier.counts[i];
+  }
+  difference.count -= earlier.count;
+  difference.sum -= earlier.sum;
+  return difference;
+}
+
+/// @brief Query counts of one connection of a pool
+struct PooledConnectionMetrics {
+  size_t slot = 0;      ///< Position of the connection in the pool
+  QueryStats queries;   ///< As of the last time the connection was returned
+};
+
+/// @brief Metrics of a connection pool at one point in time
+struct PoolMetrics {
+  std::chrono::steady_clock::time_point time;  ///< When the snapshot was taken
+
+  size_t active_connections = 0;  ///< Checked out
+  size_t idle_connections = 0;
+  size_t total_connections = 0;  ///< Open, or being opened
+
+  uint64_t checkouts = 0;          ///< Connections handed out
+  uint64_t checkout_timeouts = 0;  ///< Checkouts that gave up waiting for a connection
+  uint64_t connections_opened = 0;
+  uint64_t connections_closed = 0;  ///< Broken, expired, failed validation or scaled down
+  uint64_t connect_failures = 0;
+  uint64_t validation_failures = 0;  ///< Connections found broken when checked by the pool
+
+  /// @brief Queries on the pool's connections, counted when each connection is returned
+  QueryStats queries;
+
+  /// @brief Time from asking for a connection to getting it, or to giving up
+  HistogramSnapshot checkout_wait;
+
+  /// @brief Time to open a connection and apply the session setup
+  HistogramSnapshot connect_latency;
+
+  /// @brief Each open connection; only filled by PostgreSQLConnectionPool
+  std::vector<PooledConnectionMetrics> connections;
+};
+
+/// @brief Callback that receives a pool's metrics periodically
+struct PoolMetricsSink {
+  /// @brief Called with a snapshot at most once per interval; empty for none
+  /// @details Runs on a thread that is using the pool, or on the maintenance thread, so it
+  /// should hand the snapshot off rather than block.
+  std::function<void(const PoolMetrics&)> callback;
+
+  /// @brief Time between calls (ms)
+  std::chrono::milliseconds interval{10000};
+};
+
+/// @brief Counters and histograms a pool records into, and the schedule of its sink
+class PoolMetricsRecorder {
+public:
+  /// @brief Constructor
+  /// @param sink Callback to report to, if any
+  explicit PoolMetricsRecorder(PoolMetricsSink sink = {}) : sink_(std::move(sink)) {}
+
+  StripedCounter checkouts;
+  StripedCounter checkout_timeouts;
+  StripedCounter connections_opened;
+  StripedCounter connections_closed;
+  StripedCounter connect_failures;
+  StripedCounter validation_failures;
+  StripedCounter queries;
+  StripedCounter query_errors;
+  StripedCounter query_timeouts;
+  LatencyHistogram checkout_wait;
+  LatencyHistogram connect_latency;
+
+  /// @brief Add the queries a connection ran while it was checked out
+  void add_queries(const QueryStats& stats) {
+    if (stats.queries != 0) {
+      queries.add(stats.queries);
+    }
+    if (stats.errors != 0) {
+      query_errors.add(stats.errors);
+    }
+    if (stats.timeouts != 0) {
+      query_timeouts.add(stats.timeouts);
+    }
+  }
+
+  /// @brief Take a snapshot of the counters and histograms
+  /// @details The connection counts and per-connection entries are left for the pool to fill.
+  PoolMetrics snapshot() const {
+    return PoolMetrics{.time = std::chrono::steady_clock::now(),
+                       .checkouts = checkouts.load(),
+                       .checkout_timeouts = checkout_timeouts.load(),
+                       .connections_opened = connections_opened.load(),
+                       .connections_closed = connections_closed.load(),
+                       .connect_failures = connect_failures.load(),
+                       .validation_failures = validation_failures.load(),
+                       .queries = QueryStats{.queries = queries.load(),
+                                             .errors = query_errors.load(),
+                                             .timeouts = query_timeouts.load()},
+                       .checkout_wait = checkout_wait.snapshot(),
+                       .connect_latency = connect_latency.snapshot()};
+  }
+
+  /// @brief Check whether the sink is due, in at most one thread per interval
+  /// @return True if the caller should report now
+  bool report_due() {
+    if (!sink_.callback) {
+      return false;
+    }
+    const auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    auto due = next_report_.load(std::memory_order_relaxed);
+    const auto interval =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(sink_.interval).count();
+    return now >= due && next_report_.compare_exchange_strong(due, now + interval);
+  }
+
+  /// @brief Pass a snapshot to the sink
+  void report(const PoolMetrics& metrics) const { sink_.callback(metrics); }
+
+private:
+  PoolMetricsSink sink_;
+  std::atomic<std::chrono::steady_clock::rep> next_report_{0};
+};
+
+}  // namespace relx::connection
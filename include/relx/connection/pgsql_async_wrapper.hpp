@@ -4,25 +4,38 @@
 
 #pragma once
 
+#include "query_options.hpp"
+#include "sql_utils.hpp"
+
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <expected>
 #include <format>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <boost/asio.hpp>
 #include <boost/asio/awaitable.hpp>
+#include <boost/asio/bind_cancellation_slot.hpp>
+#include <boost/asio/cancellation_signal.hpp>
 #include <boost/asio/co_spawn.hpp>
 #include <boost/asio/detached.hpp>
 #include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/asio/this_coro.hpp>
 #include <boost/asio/use_awaitable.hpp>
 #include <libpq-fe.h>
@@ -142,11 +155,14 @@ private:
   Connection& conn_;
   std::string name_;
   std::string query_;
+  std::vector<Oid> param_types_;  // empty to let the server infer every parameter type
   bool prepared_ = false;
 
 public:
-  PreparedStatement(Connection& conn, std::string name, std::string query)
-      : conn_(conn), name_(std::move(name)), query_(std::move(query)) {}
+  PreparedStatement(Connection& conn, std::string name, std::string query,
+                    std::vector<Oid> param_types = {})
+      : conn_(conn), name_(std::move(name)), query_(std::move(query)),
+        param_types_(std::move(param_types)) {}
 
   ~PreparedStatement() = default;
 
@@ -157,7 +173,7 @@ public:
   // Move constructible/assignable
   PreparedStatement(PreparedStatement&& other) noexcept
       : conn_(other.conn_), name_(std::move(other.name_)), query_(std::move(other.query_)),
-        prepared_(other.prepared_) {
+        param_types_(std::move(other.param_types_)), prepared_(other.prepared_) {
     other.prepared_ = false;
   }
 
@@ -165,6 +181,7 @@ public:
     if (this != &other) {
       name_ = std::move(other.name_);
       query_ = std::move(other.query_);
+      param_types_ = std::move(other.param_types_);
       prepared_ = other.prepared_;
       other.prepared_ = false;
     }
@@ -173,28 +190,227 @@ public:
 
   const std::string& name() const { return name_; }
   const std::string& query() const { return query_; }
+  const std::vector<Oid>& param_types() const { return param_types_; }
   bool is_prepared() const { return prepared_; }
 
   // The implementation of prepare and execute will be defined in separate cpp file
   boost::asio::awaitable<PgResult<void>> prepare();
-  boost::asio::awaitable<PgResult<Result>> execute(const std::vector<std::string>& params);
+  // types must match the parameter types the statement was prepared with
+  boost::asio::awaitable<PgResult<Result>> execute(const std::vector<std::string>& params,
+                                                   const relx::query::ParamTypes& types = {},
+                                                   const connection::QueryOptions& options = {});
   boost::asio::awaitable<PgResult<void>> deallocate();
 
   friend class Connection;
 };
 
+// ----------------------------------------------------------------------
+// Sends the cancel requests of every Connection in the process from one thread, in the order
+// they were made. PQcancel connects to the server and waits for its answer, so it must not run
+// on a strand. A single thread bounds how many run at once and delivers each request before
+// the next one; it is joined at exit.
+// ----------------------------------------------------------------------
+class CancelWorker {
+public:
+  // Requests beyond this many waiting are refused rather than queued
+  static constexpr size_t max_queued = 64;
+
+  static CancelWorker& instance() {
+    static CancelWorker worker;
+    return worker;
+  }
+
+  CancelWorker(const CancelWorker&) = delete;
+  CancelWorker& operator=(const CancelWorker&) = delete;
+
+  ~CancelWorker() {
+    {
+      const std::lock_guard lock(mutex_);
+      stopping_ = true;
+    }
+    available_.notify_one();
+    thread_.join();
+    for (auto& job : jobs_) {
+      PQfreeCancel(job.cancel);
+    }
+  }
+
+  // Queue a request, taking ownership of cancel. sent is called on the worker thread once the
+  // server has answered. Returns false, and frees cancel, if the queue is full
+  bool submit(PGcancel* cancel, std::function<void()> sent) {
+    {
+      const std::lock_guard lock(mutex_);
+      if (jobs_.size() < max_queued) {
+        jobs_.push_back(Job{.cancel = cancel, .sent = std::move(sent)});
+        available_.notify_one();
+        return true;
+      }
+    }
+    PQfreeCancel(cancel);
+    return false;
+  }
+
+private:
+  struct Job {
+    PGcancel* cancel;
+    std::function<void()> sent;
+  };
+
+  CancelWorker() : thread_([this] { run(); }) {}
+
+  void run() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+      available_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      auto job = std::move(jobs_.front());
+      jobs_.pop_front();
+      lock.unlock();
+
+      std::array<char, 256> error_buffer{};
+      PQcancel(job.cancel, error_buffer.data(), static_cast<int>(error_buffer.size()));
+      PQfreeCancel(job.cancel);
+      job.sent();
+      lock.lock();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable available_;
+  std::deque<Job> jobs_;
+  bool stopping_ = false;
+  std::thread thread_;  // last, so it starts once the rest is constructed
+};
+
 // ----------------------------------------------------------------------
 // The connection class - main interface for PostgreSQL operations
+//
+// Queries are pipelined: any number of coroutines may call query() or execute prepared
+// statements concurrently. Each query is sent immediately, followed by its own sync point, and
+// its results are dispatched back to the awaiting coroutine in FIFO order. A failing query
+// therefore never affects the others in flight.
+// Transactions are per connection, so coroutines sharing a connection must not interleave
+// statements of different transactions.
+//
+// Cancellation: a query stops waiting at the deadline in its QueryOptions, when its cancel
+// token is triggered, or when the awaiting coroutine is cancelled through its cancellation
+// slot, e.g. by awaiting it || a timer. The call then fails with query_cancelled_error and the
+// query's results are discarded when they arrive. The server is sent a cancel request once
+// the abandoned query is the only one in flight, since a cancel request stops whatever
+// statement the server is running and would otherwise hit another coroutine's query.
+//
+// Thread safety: every connection is bound to a strand of its io_context, and the socket and
+// all internal timers live on it. The awaitable operations run their body on the strand, so
+// they may be awaited from coroutines on any thread of a multi-threaded io_context. An
+// operation awaited from a coroutine spawned on strand() runs inline; any other caller pays one
+// hop onto the strand. The synchronous members (close, defer, in_transaction, native_handle,
+// socket, ...) are not synchronised and must be called from code running on strand(), or while
+// no operation is in flight.
 // ----------------------------------------------------------------------
 class Connection {
+public:
+  using Strand = boost::asio::strand<boost::asio::io_context::executor_type>;
+
+  // The descriptor returned by PQsocket: a TCP socket over IPv4 or IPv6, or a Unix-domain
+  // socket when the host is a directory such as /var/run/postgresql. Waiting on it is all the
+  // wrapper needs, so it is watched as a plain descriptor whatever its address family
+  using Socket = boost::asio::posix::stream_descriptor;
+
+  // A statement to send: SQL with $n placeholders, its parameters, and their type OIDs and
+  // formats (empty for untyped text parameters)
+  struct Statement {
+    std::string sql;
+    std::vector<std::string> params;
+    relx::query::ParamTypes types;
+  };
+
 private:
+  /// A query that has been sent and is waiting for its results
+  struct PendingQuery {
+    explicit PendingQuery(const Strand& strand)
+        : signal(strand, std::chrono::steady_clock::time_point::max()) {}
+
+    boost::asio::steady_timer signal;  // cancelled to wake the awaiting coroutine
+    boost::asio::cancellation_signal interrupt;  // aborts the waits of the awaiting coroutine
+    std::optional<boost::asio::steady_timer> deadline;  // stops the query when it expires
+    Result result;
+    std::optional<PgError> error;
+    std::vector<Result> results;  // every result of a batch, when keep_all is set
+    size_t skip_results = 0;  // results of deferred statements sent ahead of this query
+    bool keep_all = false;    // a batch of statements, which keeps one result per statement
+    bool done = false;
+    bool stopped = false;      // the awaiting coroutine gave up on the query
+    bool timed_out = false;    // stopped by its deadline rather than a cancellation
+    bool cancel_sent = false;  // the server was asked to cancel it
+
+    // Make the awaiting coroutine give up on the query
+    void stop() {
+      if (!done && !stopped) {
+        stopped = true;
+        interrupt.emit(boost::asio::cancellation_type::terminal);
+      }
+    }
+  };
+
+  struct CancelRequest;
+
+  /// What the CancelWorker holds to report back. It never owns the
+  /// request, so the timer in it is only ever destroyed on the connection's side.
+  struct CancelLink {
+    std::mutex mutex;
+    std::optional<Strand> strand;  // reset by close(); nothing is posted afterwards
+    std::weak_ptr<CancelRequest> request;
+  };
+
+  /// A cancel request being sent from another thread, which the next query waits for
+  struct CancelRequest {
+    explicit CancelRequest(const Strand& strand)
+        : signal(strand, std::chrono::steady_clock::time_point::max()),
+          link(std::make_shared<CancelLink>()) {
+      link->strand = strand;
+    }
+
+    boost::asio::steady_timer signal;  // cancelled to wake the waiting queries
+    bool delivered = false;  // the request reached the server, or no longer matters
+    std::shared_ptr<CancelLink> link;
+
+    // Wake the waiting queries; on the strand
+    void complete() {
+      delivered = true;
+      signal.cancel();
+    }
+
+    // Report from the CancelWorker that the request is out
+    static void report(const std::shared_ptr<CancelLink>& link) {
+      const std::lock_guard lock(link->mutex);
+      if (link->strand) {
+        boost::asio::post(*link->strand, [weak = link->request] {
+          if (auto request = weak.lock()) {
+            request->complete();
+          }
+        });
+      }
+    }
+  };
+
   boost::asio::io_context& io_;
+  Strand strand_;  // serialises every operation on this connection
   PGconn* conn_ = nullptr;
-  std::unique_ptr<boost::asio::ip::tcp::socket> socket_;
+  std::unique_ptr<Socket> socket_;
   std::unordered_map<std::string, std::shared_ptr<PreparedStatement>> statements_;
   bool in_transaction_ = false;
-
-  PgResult<void> create_socket() {
+  std::string deferred_begin_;  // BEGIN not sent yet, empty once sent
+  std::vector<Statement> deferred_;  // statements held back until the next query is sent
+  std::vector<std::string> released_;  // statements deallocated ahead of the next query
+  std::deque<std::shared_ptr<PendingQuery>> pending_;
+  bool reading_ = false;  // true while one of the awaiting coroutines is reading results
+  std::shared_ptr<CancelRequest> cancel_request_;  // the last cancel request, until it arrived
+
+  // Watch the descriptor libpq is using now. libpq may replace it while connecting, e.g. when it
+  // falls back from one address of the host to the next, so connect() calls this before each wait
+  PgResult<void> watch_socket() {
     if (conn_ == nullptr) {
       return std::unexpected(
           PgError{.message = "Cannot create socket: no connection", .error_code = -1});
@@ -205,10 +421,19 @@ private:
       return std::unexpected(PgError{.message = "Invalid socket", .error_code = -1});
     }
 
-    socket_ = std::make_unique<boost::asio::ip::tcp::socket>(io_, boost::asio::ip::tcp::v4(), sock);
+    release_socket();
+    socket_ = std::make_unique<Socket>(strand_, sock);
     return PgResult<void>{};
   }
 
+  // Stop watching the descriptor without closing it, which is left to libpq
+  void release_socket() {
+    if (socket_) {
+      socket_->release();
+      socket_.reset();
+    }
+  }
+
   // Asynchronous flush of outgoing data to the PostgreSQL server
   boost::asio::awaitable<PgResult<void>> flush_outgoing_data() {
     while (true) {
@@ -225,9 +450,13 @@ private:
         co_return std::unexpected(socket_result.error());
       }
       
+      // Not cancellable: a query has to be sent in full, or the pipeline breaks
       boost::system::error_code ec;
-      co_await (*socket_result)->async_wait(boost::asio::ip::tcp::socket::wait_write,
-                                            boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+      co_await (*socket_result)->async_wait(
+          Socket::wait_write,
+          boost::asio::bind_cancellation_slot(
+              boost::asio::cancellation_slot(),
+              boost::asio::redirect_error(boost::asio::use_awaitable, ec)));
 
       if (ec) {
         co_return std::unexpected(PgError{.message = ec.message(), .error_code = ec.value()});
@@ -236,25 +465,304 @@ private:
     co_return PgResult<void>{};
   }
 
-  // Helper method to wait for and get a query result
-  boost::asio::awaitable<PgResult<Result>> get_query_result() {
-    while (true) {
-      // Check if we can consume input without blocking
+  // Send a query through the pipeline and wait for its result
+  // send_fn queues the query on the PGconn (PQsendQueryParams, PQsendPrepared, ...). When it
+  // queues several statements, pass batch_results to receive all of their results instead
+  template <typename SendFn>
+  boost::asio::awaitable<PgResult<Result>> submit(SendFn send_fn,
+                                                  const connection::QueryOptions& options = {},
+                                                  std::vector<Result>* batch_results = nullptr) {
+    if (!is_open()) {
+      co_return std::unexpected(PgError{.message = "Connection is not open", .error_code = -1});
+    }
+
+    const auto expiry = options.expiry();
+    if (options.cancel_token != nullptr && options.cancel_token->is_cancelled()) {
+      co_return std::unexpected(stopped_error(false));
+    }
+    if (std::chrono::steady_clock::now() >= expiry) {
+      co_return std::unexpected(stopped_error(true));
+    }
+
+    auto cancel_result = co_await wait_for_cancel_request(expiry, options.cancel_token);
+    if (!cancel_result) {
+      co_return std::unexpected(cancel_result.error());
+    }
+
+    if (PQpipelineStatus(conn_) == PQ_PIPELINE_OFF && PQenterPipelineMode(conn_) != 1) {
+      co_return std::unexpected(PgError::from_conn(conn_));
+    }
+
+    if (!send_released()) {
+      auto error = PgError::from_conn(conn_);
+      leave_pipeline_if_idle();
+      co_return std::unexpected(error);
+    }
+
+    // A deferred BEGIN and deferred statements go out ahead of the query, in the same segment
+    const auto deferred = take_deferred();
+    bool sent = true;
+    for (const auto& statement : deferred) {
+      sent = sent && send_params(conn_, statement.sql, statement.params, statement.types);
+    }
+
+    if (!sent || !send_fn(conn_) || PQpipelineSync(conn_) != 1) {
+      auto error = PgError::from_conn(conn_);
+      leave_pipeline_if_idle();
+      co_return std::unexpected(error);
+    }
+
+    auto pending = std::make_shared<PendingQuery>(strand_);
+    pending->skip_results = deferred.size();
+    pending->keep_all = batch_results != nullptr;
+    pending_.push_back(pending);
+    watch_limits(pending, expiry, options.cancel_token);
+
+    // Once sent, the query is seen through to its sync point, so a cancellation of the
+    // awaiting coroutine stops its wait instead of throwing out of the middle of it
+    const bool throw_if_cancelled = co_await boost::asio::this_coro::throw_if_cancelled();
+    co_await boost::asio::this_coro::throw_if_cancelled(false);
+
+    auto flush_result = co_await flush_outgoing_data();
+    if (!flush_result) {
+      fail_pending(flush_result.error());
+    }
+
+    auto result = co_await wait_for_result(pending);
+    if (options.cancel_token != nullptr) {
+      options.cancel_token->detach();
+    }
+    co_await boost::asio::this_coro::throw_if_cancelled(throw_if_cancelled);
+    if (result && batch_results != nullptr) {
+      *batch_results = std::move(pending->results);
+    }
+    co_return result;
+  }
+
+  // Wait until the server has received the last cancel request. Arriving after this query was
+  // sent, it would stop this query instead of the one it was meant for
+  boost::asio::awaitable<PgResult<void>> wait_for_cancel_request(
+      std::chrono::steady_clock::time_point expiry, connection::CancelToken* cancel_token) {
+    while (cancel_request_ && !cancel_request_->delivered) {
+      auto request = cancel_request_;
+      if (cancel_token != nullptr && cancel_token->is_cancelled()) {
+        co_return std::unexpected(stopped_error(false));
+      }
+      if (std::chrono::steady_clock::now() >= expiry) {
+        co_return std::unexpected(stopped_error(true));
+      }
+
+      // Woken by the CancelWorker once the request is out, or by this query's own limits
+      boost::asio::steady_timer deadline(strand_, expiry);
+      deadline.async_wait([request](const boost::system::error_code& ec) {
+        if (!ec) {
+          request->signal.cancel();
+        }
+      });
+      if (cancel_token != nullptr) {
+        cancel_token->attach([strand = strand_, request] {
+          boost::asio::dispatch(strand, [request] { request->signal.cancel(); });
+        });
+      }
+      boost::system::error_code ec;
+      co_await request->signal.async_wait(
+          boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+      deadline.cancel();
+      if (cancel_token != nullptr) {
+        cancel_token->detach();
+      }
+
+      auto cancellation = co_await boost::asio::this_coro::cancellation_state;
+      if (cancellation.cancelled() != boost::asio::cancellation_type::none) {
+        co_return std::unexpected(stopped_error(false));
+      }
+    }
+    cancel_request_.reset();
+    if (!is_open()) {
+      co_return std::unexpected(PgError{.message = "Connection is not open", .error_code = -1});
+    }
+    co_return PgResult<void>{};
+  }
+
+  // Stop the query at its deadline, or when its cancel token is triggered from any thread
+  void watch_limits(const std::shared_ptr<PendingQuery>& pending,
+                    std::chrono::steady_clock::time_point expiry,
+                    connection::CancelToken* cancel_token) {
+    if (expiry != std::chrono::steady_clock::time_point::max()) {
+      pending->deadline.emplace(strand_, expiry);
+      pending->deadline->async_wait(
+          [weak = std::weak_ptr(pending)](const boost::system::error_code& ec) {
+            if (auto expired = weak.lock(); expired && !ec) {
+              expired->timed_out = !expired->done && !expired->stopped;
+              expired->stop();
+            }
+          });
+    }
+    if (cancel_token != nullptr) {
+      cancel_token->attach(stop_on_strand(pending));
+    }
+  }
+
+  // A function that stops the query from any thread
+  std::function<void()> stop_on_strand(const std::shared_ptr<PendingQuery>& pending) const {
+    return [strand = strand_, weak = std::weak_ptr(pending)] {
+      boost::asio::dispatch(strand, [weak] {
+        if (auto stopped = weak.lock()) {
+          stopped->stop();
+        }
+      });
+    };
+  }
+
+  static PgError stopped_error(bool timed_out) {
+    return PgError{.message = timed_out ? "Query timed out" : "Query cancelled",
+                   .error_code = connection::query_cancelled_error};
+  }
+
+  // Queue a parameterized query on the PGconn. Without types every parameter is text and
+  // its type is inferred by the server.
+  static bool send_params(PGconn* conn, const std::string& query_text,
+                          const std::vector<std::string>& params,
+                          const relx::query::ParamTypes& types = {}) {
+    const auto pg_params = relx::connection::sql_utils::make_pg_params(params, types);
+    return PQsendQueryParams(conn, query_text.c_str(), pg_params.count(), pg_params.types,
+                             pg_params.value_data(), pg_params.length_data(), pg_params.formats,
+                             0  // result format - text format
+                             ) == 1;
+  }
+
+  // Send the DEALLOCATE of every released statement in a segment of its own. Nobody waits for
+  // its results, which are discarded as they arrive, and a failure cannot abort another query.
+  bool send_released() {
+    if (released_.empty()) {
+      return true;
+    }
+
+    const auto names = std::exchange(released_, {});
+    for (const auto& name : names) {
+      if (!send_params(conn_, "DEALLOCATE " + name, {})) {
+        return false;
+      }
+    }
+    if (PQpipelineSync(conn_) != 1) {
+      return false;
+    }
+
+    auto discarded = std::make_shared<PendingQuery>(strand_);
+    discarded->stopped = true;
+    discarded->cancel_sent = true;  // not worth a cancel request
+    pending_.push_back(std::move(discarded));
+    return true;
+  }
+
+  // Remove the deferred BEGIN and statements so they can be sent, BEGIN first
+  std::vector<Statement> take_deferred() {
+    std::vector<Statement> statements;
+    if (!deferred_begin_.empty()) {
+      statements.push_back(Statement{.sql = std::move(deferred_begin_), .params = {}});
+      deferred_begin_.clear();
+    }
+    for (auto& statement : deferred_) {
+      statements.push_back(std::move(statement));
+    }
+    deferred_.clear();
+    return statements;
+  }
+
+  // Wait until the given query completes. Whichever waiting coroutine finds nobody reading
+  // becomes the reader and dispatches results for every query in the pipeline.
+  boost::asio::awaitable<PgResult<Result>> wait_for_result(std::shared_ptr<PendingQuery> pending) {
+    // Cancelling the awaiting coroutine stops the query
+    auto cancellation = co_await boost::asio::this_coro::cancellation_state;
+    if (cancellation.cancelled() != boost::asio::cancellation_type::none) {
+      pending->stop();
+    } else if (cancellation.slot().is_connected()) {
+      cancellation.slot().assign(
+          [stop = stop_on_strand(pending)](boost::asio::cancellation_type) { stop(); });
+    }
+
+    while (!pending->done && !pending->stopped) {
+      if (reading_) {
+        boost::system::error_code ec;
+        co_await pending->signal.async_wait(boost::asio::bind_cancellation_slot(
+            pending->interrupt.slot(),
+            boost::asio::redirect_error(boost::asio::use_awaitable, ec)));
+        continue;
+      }
+
+      reading_ = true;
+      auto read_result = co_await read_results_until(*pending);
+      reading_ = false;
+
+      if (!read_result) {
+        fail_pending(read_result.error());
+      }
+      hand_off_reading();
+    }
+
+    if (cancellation.slot().is_connected()) {
+      cancellation.slot().clear();
+    }
+
+    if (!pending->done) {
+      // The query is still in the pipeline; its results are discarded as they arrive
+      cancel_abandoned_query();
+      co_return std::unexpected(stopped_error(pending->timed_out));
+    }
+
+    if (pending->error) {
+      co_return std::unexpected(*pending->error);
+    }
+
+    leave_pipeline_if_idle();
+    co_return std::move(pending->result);
+  }
+
+  // Hand the reader role to the oldest query whose coroutine is still waiting
+  void hand_off_reading() {
+    for (const auto& pending : pending_) {
+      if (!pending->stopped) {
+        pending->signal.cancel();
+        return;
+      }
+    }
+  }
+
+  // Ask the server to cancel an abandoned query once it is the only one in flight
+  void cancel_abandoned_query() {
+    if (pending_.size() != 1 || !pending_.front()->stopped || pending_.front()->cancel_sent) {
+      return;
+    }
+    pending_.front()->cancel_sent = true;
+    request_cancel();
+  }
+
+  // Read and dispatch pipeline results until the target query has completed, or its awaiting
+  // coroutine gave up on it
+  boost::asio::awaitable<PgResult<void>> read_results_until(PendingQuery& target) {
+    int consecutive_nulls = 0;
+
+    while (!target.done && !target.stopped) {
       if (PQconsumeInput(conn_) == 0) {
         co_return std::unexpected(PgError::from_conn(conn_));
       }
 
-      // Check if we can get a result without blocking
-      if (!PQisBusy(conn_)) {
+      while (!target.done && !PQisBusy(conn_)) {
         PGresult* res = PQgetResult(conn_);
-        Result result_obj(res);
-
-        // Flush all remaining results (normally there should be none for a single query)
-        while ((res = PQgetResult(conn_)) != nullptr) {
-          PQclear(res);
+        if (res == nullptr) {
+          // A null result ends each query; two in a row means the pipeline is out of sync
+          if (++consecutive_nulls > 1) {
+            co_return std::unexpected(
+                PgError{.message = "Pipeline ended before all results arrived", .error_code = -1});
+          }
+          continue;
         }
+        consecutive_nulls = 0;
+        dispatch_result(res);
+      }
 
-        co_return result_obj;
+      if (target.done) {
+        break;
       }
 
       // Still busy, wait for the socket to be readable
@@ -262,19 +770,85 @@ private:
       if (!socket_result) {
         co_return std::unexpected(socket_result.error());
       }
-      
-      boost::system::error_code ec;
-      co_await (*socket_result)->async_wait(boost::asio::ip::tcp::socket::wait_read,
-                                            boost::asio::redirect_error(boost::asio::use_awaitable, ec));
 
+      boost::system::error_code ec;
+      co_await (*socket_result)->async_wait(
+          Socket::wait_read,
+          boost::asio::bind_cancellation_slot(
+              target.interrupt.slot(),
+              boost::asio::redirect_error(boost::asio::use_awaitable, ec)));
+
+      if (target.stopped) {
+        break;  // The pipeline is intact; another waiting coroutine takes over reading
+      }
       if (ec) {
         co_return std::unexpected(PgError{.message = ec.message(), .error_code = ec.value()});
       }
     }
+
+    co_return PgResult<void>{};
+  }
+
+  // Hand a result to the query at the front of the pipeline
+  void dispatch_result(PGresult* res) {
+    Result result(res);
+    if (pending_.empty()) {
+      return;  // Nothing is waiting for it, discard
+    }
+
+    auto& front = pending_.front();
+    if (result.status() == PGRES_PIPELINE_SYNC) {
+      // The sync point marks the end of this query
+      auto completed = std::move(front);
+      pending_.pop_front();
+      completed->done = true;
+      completed->deadline.reset();
+      completed->signal.cancel();
+      cancel_abandoned_query();
+      return;
+    }
+
+    if (front->skip_results > 0) {
+      // Result of a deferred statement; only a failure is reported, to the query it rode with
+      --front->skip_results;
+      if (!result && !front->error) {
+        front->error = PgError::from_result(result.get());
+      }
+      return;
+    }
+
+    if (front->keep_all) {
+      front->results.push_back(std::move(result));
+      return;
+    }
+
+    // Keep the first result of each query, extra results are discarded
+    if (!front->result.get()) {
+      front->result = std::move(result);
+    }
+  }
+
+  // Complete every in-flight query with an error
+  void fail_pending(const PgError& error) {
+    auto failed = std::move(pending_);
+    pending_.clear();
+    for (auto& pending : failed) {
+      pending->error = error;
+      pending->done = true;
+      pending->deadline.reset();
+      pending->signal.cancel();
+    }
+  }
+
+  // Leave pipeline mode once nothing is in flight, so direct libpq users (streaming) work
+  void leave_pipeline_if_idle() {
+    if (pending_.empty() && conn_ != nullptr && PQpipelineStatus(conn_) != PQ_PIPELINE_OFF) {
+      PQexitPipelineMode(conn_);
+    }
   }
 
 public:
-  Connection(boost::asio::io_context& io) : io_(io) {}
+  Connection(boost::asio::io_context& io) : io_(io), strand_(boost::asio::make_strand(io)) {}
 
   ~Connection() { close(); }
 
@@ -284,8 +858,11 @@ public:
 
   // Move constructible/assignable
   Connection(Connection&& other) noexcept
-      : io_(other.io_), conn_(other.conn_), socket_(std::move(other.socket_)),
-        statements_(std::move(other.statements_)), in_transaction_(other.in_transaction_) {
+      : io_(other.io_), strand_(other.strand_), conn_(other.conn_),
+        socket_(std::move(other.socket_)), statements_(std::move(other.statements_)),
+        in_transaction_(other.in_transaction_), deferred_begin_(std::move(other.deferred_begin_)),
+        deferred_(std::move(other.deferred_)), released_(std::move(other.released_)),
+        pending_(std::move(other.pending_)), cancel_request_(std::move(other.cancel_request_)) {
     other.conn_ = nullptr;
     other.in_transaction_ = false;
   }
@@ -293,10 +870,16 @@ public:
   Connection& operator=(Connection&& other) noexcept {
     if (this != &other) {
       close();
+      strand_ = other.strand_;
       conn_ = other.conn_;
       socket_ = std::move(other.socket_);
       statements_ = std::move(other.statements_);
       in_transaction_ = other.in_transaction_;
+      deferred_begin_ = std::move(other.deferred_begin_);
+      deferred_ = std::move(other.deferred_);
+      released_ = std::move(other.released_);
+      pending_ = std::move(other.pending_);
+      cancel_request_ = std::move(other.cancel_request_);
       other.conn_ = nullptr;
       other.in_transaction_ = false;
     }
@@ -304,13 +887,23 @@ public:
   }
 
   void close() {
+    fail_pending(PgError{.message = "Connection closed", .error_code = -1});
     statements_.clear();
-
-    if (socket_) {
-      socket_->close();
-      socket_.reset();
+    deferred_begin_.clear();
+    deferred_.clear();
+    released_.clear();
+    if (cancel_request_) {
+      // A request for the old session cannot reach a new one, so nobody waits for it
+      {
+        const std::lock_guard lock(cancel_request_->link->mutex);
+        cancel_request_->link->strand.reset();
+      }
+      cancel_request_->complete();
+      cancel_request_.reset();
     }
 
+    release_socket();
+
     if (conn_) {
       PQfinish(conn_);
       conn_ = nullptr;
@@ -319,13 +912,55 @@ public:
     in_transaction_ = false;
   }
 
+  // The strand every operation on this connection runs on
+  const Strand& strand() const { return strand_; }
+
+  // Whether a coroutine with the given executor runs on this connection's strand, e.g.
+  // running_on_strand(co_await boost::asio::this_coro::executor)
+  bool running_on_strand(const boost::asio::any_io_executor& executor) const {
+    const auto* strand = executor.target<Strand>();
+    return strand != nullptr && *strand == strand_;
+  }
+
   bool is_open() const { return conn_ != nullptr && PQstatus(conn_) == CONNECTION_OK; }
 
   bool in_transaction() const { return in_transaction_; }
 
   PGconn* native_handle() { return conn_; }
 
-  PgResult<boost::asio::ip::tcp::socket*> socket() {
+  // Ask the server to cancel the statement it is running for this connection, e.g. a stream
+  // that was abandoned early. Returns at once: the request is sent by the CancelWorker with
+  // its own copy of the cancel key, so neither the strand nor a closed connection holds it up.
+  // The next query is only sent once the request has been delivered, so it cannot be cancelled
+  // in place of this statement. A request arriving after the statement finished is ignored.
+  // Returns false if no request could be queued
+  bool request_cancel() {
+    PGcancel* cancel = conn_ != nullptr ? PQgetCancel(conn_) : nullptr;
+    if (cancel == nullptr) {
+      return false;
+    }
+    auto request = std::make_shared<CancelRequest>(strand_);
+    request->link->request = request;
+    if (!CancelWorker::instance().submit(
+            cancel, [link = request->link] { CancelRequest::report(link); })) {
+      return false;
+    }
+
+    // The worker sends requests in order, so waiting for this one covers the earlier ones
+    if (cancel_request_) {
+      cancel_request_->signal.cancel();  // its waiters move on to wait for this request
+    }
+    cancel_request_ = std::move(request);
+    return true;
+  }
+
+  // Number of queries sent but not yet completed
+  size_t pending_queries() const { return pending_.size(); }
+
+  // Number of statements held back until the next query, including an unsent BEGIN
+  size_t deferred_count() const { return deferred_.size() + (deferred_begin_.empty() ? 0 : 1); }
+
+  PgResult<Socket*> socket() {
     if (!socket_) {
       return std::unexpected(PgError{.message = "Socket not initialized", .error_code = -1});
     }
@@ -334,6 +969,11 @@ public:
 
   // Asynchronous connection using boost::asio::awaitable
   boost::asio::awaitable<PgResult<void>> connect(const std::string& conninfo) {
+    if (!running_on_strand(co_await boost::asio::this_coro::executor)) {
+      co_return co_await boost::asio::co_spawn(strand_, connect(conninfo),
+                                               boost::asio::use_awaitable);
+    }
+
     if (conn_ != nullptr) {
       close();
     }
@@ -358,13 +998,6 @@ public:
       co_return std::unexpected(error);
     }
 
-    // Create the socket
-    auto socket_result = create_socket();
-    if (!socket_result) {
-      close();
-      co_return std::unexpected(socket_result.error());
-    }
-
     // Connection polling loop
     while (true) {
       const PostgresPollingStatusType poll_status = PQconnectPoll(conn_);
@@ -380,39 +1013,22 @@ public:
         break;
       }
 
-      // Need to poll
-      if (poll_status == PGRES_POLLING_READING) {
-        // Wait until socket is readable
-        auto socket_result = socket();
-        if (!socket_result) {
-          close();
-          co_return std::unexpected(socket_result.error());
-        }
-        
-        boost::system::error_code ec;
-        co_await (*socket_result)->async_wait(boost::asio::ip::tcp::socket::wait_read,
-                                              boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+      // Need to poll, on whichever socket libpq is using at this step
+      auto socket_result = watch_socket();
+      if (!socket_result) {
+        close();
+        co_return std::unexpected(socket_result.error());
+      }
 
-        if (ec) {
-          close();
-          co_return std::unexpected(PgError{.message = ec.message(), .error_code = ec.value()});
-        }
-      } else if (poll_status == PGRES_POLLING_WRITING) {
-        // Wait until socket is writable
-        auto socket_result = socket();
-        if (!socket_result) {
-          close();
-          co_return std::unexpected(socket_result.error());
-        }
-        
-        boost::system::error_code ec;
-        co_await (*socket_result)->async_wait(boost::asio::ip::tcp::socket::wait_write,
-                                              boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+      const auto wait_type =
+          poll_status == PGRES_POLLING_READING ? Socket::wait_read : Socket::wait_write;
+      boost::system::error_code ec;
+      co_await socket_->async_wait(wait_type,
+                                   boost::asio::redirect_error(boost::asio::use_awaitable, ec));
 
-        if (ec) {
-          close();
-          co_return std::unexpected(PgError{.message = ec.message(), .error_code = ec.value()});
-        }
+      if (ec) {
+        close();
+        co_return std::unexpected(PgError{.message = ec.message(), .error_code = ec.value()});
       }
     }
 
@@ -426,47 +1042,113 @@ public:
   }
 
   // Asynchronous parameterized query execution using boost::asio::awaitable
+  // types holds the parameter type OIDs and formats, or is empty for untyped text parameters;
+  // options limit how long the query may run
   boost::asio::awaitable<PgResult<Result>> query(const std::string& query_text,
-                                                 const std::vector<std::string>& params = {}) {
+                                                 const std::vector<std::string>& params = {},
+                                                 const relx::query::ParamTypes& types = {},
+                                                 const connection::QueryOptions& options = {}) {
+    if (!running_on_strand(co_await boost::asio::this_coro::executor)) {
+      co_return co_await boost::asio::co_spawn(strand_,
+                                               query(query_text, params, types, options),
+                                               boost::asio::use_awaitable);
+    }
+
     if (!is_open()) {
       co_return std::unexpected(PgError{.message = "Connection is not open", .error_code = -1});
     }
 
-    // Convert parameters
-    std::vector<const char*> values;
-    values.reserve(params.size());
-    for (const auto& param : params) {
-      values.push_back(param.c_str());
+    // Send the parameterized query and wait for its turn in the pipeline
+    co_return co_await submit(
+        [&](PGconn* conn) { return send_params(conn, query_text, params, types); }, options);
+  }
+
+  // Send several statements in one pipeline segment and wait for all of their results, one
+  // per statement in order. The statements share a sync point, so outside an explicit
+  // transaction they run in one implicit transaction; a failing statement makes the server skip
+  // the ones after it, whose results have status PGRES_PIPELINE_ABORTED.
+  boost::asio::awaitable<PgResult<std::vector<Result>>> query_batch(
+      std::vector<Statement> statements, const connection::QueryOptions& options = {}) {
+    if (!running_on_strand(co_await boost::asio::this_coro::executor)) {
+      co_return co_await boost::asio::co_spawn(
+          strand_, query_batch(std::move(statements), options), boost::asio::use_awaitable);
     }
 
-    // Send the parameterized query
-    if (!PQsendQueryParams(conn_, query_text.c_str(), static_cast<int>(values.size()),
-                           // TODO allow user to customize fields with nullptr values
-                           nullptr,  // param types - inferred
-                           values.size() == 0 ? nullptr : values.data(),
-                           nullptr,  // param lengths - null-terminated strings
-                           nullptr,  // param formats - text format
-                           0         // result format - text format
-                           )) {
-      co_return std::unexpected(PgError::from_conn(conn_));
+    if (!is_open()) {
+      co_return std::unexpected(PgError{.message = "Connection is not open", .error_code = -1});
+    }
+    if (statements.empty()) {
+      co_return std::vector<Result>{};
     }
 
-    // Flush the outgoing data
-    auto flush_result = co_await flush_outgoing_data();
-    if (!flush_result) {
-      co_return std::unexpected(flush_result.error());
+    std::vector<Result> results;
+    auto submitted = co_await submit(
+        [&](PGconn* conn) {
+          return std::ranges::all_of(statements, [conn](const Statement& statement) {
+            return send_params(conn, statement.sql, statement.params, statement.types);
+          });
+        },
+        options, &results);
+    if (!submitted) {
+      co_return std::unexpected(submitted.error());
+    }
+
+    // A statement string holding several commands yields several results
+    if (results.size() != statements.size()) {
+      co_return std::unexpected(PgError{
+          .message = "Batch of " + std::to_string(statements.size()) + " statements returned " +
+                     std::to_string(results.size()) + " results",
+          .error_code = -1});
+    }
+    co_return results;
+  }
+
+  // Hold a statement back until the next query so both share one round trip.
+  // Only allowed inside a transaction; the result is discarded and a failure is reported by
+  // the query (or COMMIT) it is sent with.
+  PgResult<void> defer(std::string query_text, std::vector<std::string> params = {},
+                       relx::query::ParamTypes types = {}) {
+    if (!in_transaction_) {
+      return std::unexpected(PgError{.message = "Not in a transaction", .error_code = -1});
+    }
+    deferred_.push_back(Statement{
+        .sql = std::move(query_text), .params = std::move(params), .types = std::move(types)});
+    return PgResult<void>{};
+  }
+
+  // Send the deferred BEGIN and deferred statements now and wait for every query still in
+  // flight, including abandoned ones, e.g. before using native_handle()
+  boost::asio::awaitable<PgResult<void>> flush_deferred() {
+    if (!running_on_strand(co_await boost::asio::this_coro::executor)) {
+      co_return co_await boost::asio::co_spawn(strand_, flush_deferred(),
+                                               boost::asio::use_awaitable);
     }
 
-    // Get and return the result
-    co_return co_await get_query_result();
+    if (deferred_begin_.empty() && deferred_.empty() && pending_.empty()) {
+      co_return PgResult<void>{};
+    }
+
+    auto res_result = co_await submit([](PGconn*) { return true; });
+    if (!res_result) {
+      co_return std::unexpected(res_result.error());
+    }
+    co_return PgResult<void>{};
   }
 
   // Transaction support
   // ------------------
+  //
+  // BEGIN is deferred: it is sent in the same pipeline segment as the first query of the
+  // transaction, and a transaction that never runs a query costs no round trip at all.
 
   // Begin transaction with specified isolation level
   boost::asio::awaitable<PgResult<void>> begin_transaction(
       IsolationLevel isolation = IsolationLevel::ReadCommitted) {
+    if (!running_on_strand(co_await boost::asio::this_coro::executor)) {
+      co_return co_await boost::asio::co_spawn(strand_, begin_transaction(isolation),
+                                               boost::asio::use_awaitable);
+    }
+
     if (in_transaction_) {
       co_return std::unexpected(PgError{.message = "Already in a transaction", .error_code = -1});
     }
@@ -487,28 +1169,29 @@ public:
       break;
     }
 
-    const std::string begin_cmd = "BEGIN ISOLATION LEVEL " + isolation_str;
-    auto res_result = co_await query(begin_cmd);
-
-    if (!res_result) {
-      co_return std::unexpected(res_result.error());
-    }
-
-    if (!*res_result) {
-      co_return std::unexpected(PgError{.message = res_result->error_message(),
-                                        .error_code = static_cast<int>(res_result->status())});
-    }
-
+    deferred_begin_ = "BEGIN ISOLATION LEVEL " + isolation_str;
     in_transaction_ = true;
     co_return PgResult<void>{};
   }
 
   // Commit the current transaction
   boost::asio::awaitable<PgResult<void>> commit() {
+    if (!running_on_strand(co_await boost::asio::this_coro::executor)) {
+      co_return co_await boost::asio::co_spawn(strand_, commit(), boost::asio::use_awaitable);
+    }
+
     if (!in_transaction_) {
       co_return std::unexpected(PgError{.message = "Not in a transaction", .error_code = -1});
     }
 
+    if (!deferred_begin_.empty() && deferred_.empty()) {
+      // Nothing was ever sent, so there is nothing to commit on the server
+      deferred_begin_.clear();
+      in_transaction_ = false;
+      co_return PgResult<void>{};
+    }
+
+    // Deferred statements go out together with the COMMIT
     auto res_result = co_await query("COMMIT");
 
     if (!res_result) {
@@ -526,10 +1209,22 @@ public:
 
   // Rollback the current transaction
   boost::asio::awaitable<PgResult<void>> rollback() {
+    if (!running_on_strand(co_await boost::asio::this_coro::executor)) {
+      co_return co_await boost::asio::co_spawn(strand_, rollback(), boost::asio::use_awaitable);
+    }
+
     if (!in_transaction_) {
       co_return std::unexpected(PgError{.message = "Not in a transaction", .error_code = -1});
     }
 
+    deferred_.clear();
+    if (!deferred_begin_.empty()) {
+      // The server never saw the transaction
+      deferred_begin_.clear();
+      in_transaction_ = false;
+      co_return PgResult<void>{};
+    }
+
     auto res_result = co_await query("ROLLBACK");
 
     if (!res_result) {
@@ -548,9 +1243,16 @@ public:
   // Prepared statement support
   // -------------------------
 
-  // Create a prepared statement
+  // Create a prepared statement, optionally with explicit parameter types
   boost::asio::awaitable<PgResult<std::shared_ptr<PreparedStatement>>> prepare_statement(
-      const std::string& name, const std::string& query_text) {
+      const std::string& name, const std::string& query_text,
+      std::vector<Oid> param_types = {}) {
+    if (!running_on_strand(co_await boost::asio::this_coro::executor)) {
+      co_return co_await boost::asio::co_spawn(
+          strand_, prepare_statement(name, query_text, std::move(param_types)),
+          boost::asio::use_awaitable);
+    }
+
     if (!is_open()) {
       co_return std::unexpected(PgError{.message = "Connection is not open", .error_code = -1});
     }
@@ -558,7 +1260,7 @@ public:
     auto it = statements_.find(name);
     if (it != statements_.end()) {
       // Statement with this name already exists
-      if (it->second->query() != query_text) {
+      if (it->second->query() != query_text || it->second->param_types() != param_types) {
         // Deallocate the old statement since the query is different
         auto deallocate_result = co_await it->second->deallocate();
         if (!deallocate_result) {
@@ -572,7 +1274,8 @@ public:
     }
 
     // Create a new prepared statement
-    auto stmt = std::make_shared<PreparedStatement>(*this, name, query_text);
+    auto stmt =
+        std::make_shared<PreparedStatement>(*this, name, query_text, std::move(param_types));
     statements_[name] = stmt;
 
     // Prepare it
@@ -597,17 +1300,29 @@ public:
 
   // Execute a prepared statement by name
   boost::asio::awaitable<PgResult<Result>> execute_prepared(
-      const std::string& name, const std::vector<std::string>& params = {}) {
+      const std::string& name, const std::vector<std::string>& params = {},
+      const relx::query::ParamTypes& types = {}, const connection::QueryOptions& options = {}) {
+    if (!running_on_strand(co_await boost::asio::this_coro::executor)) {
+      co_return co_await boost::asio::co_spawn(strand_,
+                                               execute_prepared(name, params, types, options),
+                                               boost::asio::use_awaitable);
+    }
+
     auto stmt_result = get_prepared_statement(name);
     if (!stmt_result) {
       co_return std::unexpected(stmt_result.error());
     }
 
-    co_return co_await (*stmt_result)->execute(params);
+    co_return co_await (*stmt_result)->execute(params, types, options);
   }
 
   // Deallocate a prepared statement by name
   boost::asio::awaitable<PgResult<void>> deallocate_prepared(const std::string& name) {
+    if (!running_on_strand(co_await boost::asio::this_coro::executor)) {
+      co_return co_await boost::asio::co_spawn(strand_, deallocate_prepared(name),
+                                               boost::asio::use_awaitable);
+    }
+
     auto stmt_result = get_prepared_statement(name);
     if (!stmt_result) {
       co_return std::unexpected(stmt_result.error());
@@ -622,8 +1337,21 @@ public:
     co_return PgResult<void>{};
   }
 
+  // Forget a prepared statement and deallocate it on the server ahead of the next query, in
+  // the same round trip and without waiting for the result. Must be called on strand().
+  void release_prepared(const std::string& name) {
+    if (statements_.erase(name) > 0) {
+      released_.push_back(name);
+    }
+  }
+
   // Deallocate all prepared statements
   boost::asio::awaitable<PgResult<void>> deallocate_all_prepared() {
+    if (!running_on_strand(co_await boost::asio::this_coro::executor)) {
+      co_return co_await boost::asio::co_spawn(strand_, deallocate_all_prepared(),
+                                               boost::asio::use_awaitable);
+    }
+
     std::vector<std::string> names;
     names.reserve(statements_.size());
 
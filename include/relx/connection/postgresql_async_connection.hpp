@@ -4,15 +4,25 @@
 #include "../results/result.hpp"
 #include "connection.hpp"
 #include "meta.hpp"
+#include "metrics.hpp"
+#include "prepared_query.hpp"
+#include "query_options.hpp"
+#include "session_setup.hpp"
+#include "statement_cache.hpp"
 
 #include <expected>
 #include <future>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <regex>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <boost/asio.hpp>
@@ -23,7 +33,28 @@
 
 namespace relx::connection {
 
+template <typename... Params>
+class AsyncPreparedQuery;
+
 /// @brief Asynchronous PostgreSQL implementation of the Connection interface
+/// @details execute() and execute_raw() may be awaited concurrently by many coroutines. The
+/// queries are pipelined on the wire and each result is delivered to the coroutine that issued
+/// it, so one connection can serve many in-flight requests. Streaming queries need exclusive
+/// use of the connection.
+///
+/// Every connection is bound to a strand of its io_context, so one io_context may be run on
+/// several threads. The awaitable operations run on the strand and are safe to await from any
+/// thread; awaited from a coroutine spawned on strand() they run without a hop. The synchronous
+/// members (defer(), in_transaction(), query_stats(), enable_statement_cache(), ...) are not
+/// synchronised and must be called from a coroutine running on strand(), or while no operation
+/// is in flight.
+///
+/// execute_raw(), execute(), execute_many(), execute_multi(), execute_multi_as() and
+/// AsyncPreparedQuery can be given a timeout, deadline or cancel token through QueryOptions.
+/// Every query is also stopped when the awaiting coroutine is cancelled through its
+/// cancellation slot, e.g. by co_await (conn.execute(query) || timer.async_wait(use_awaitable)).
+/// A stopped query fails with query_cancelled_error and the connection stays usable; see
+/// pgsql_async_wrapper for how the server is asked to cancel it.
 class PostgreSQLAsyncConnection {
 public:
   /// @brief Constructor with connection parameters and io_context
@@ -73,28 +104,37 @@ public:
   /// @brief Execute a raw SQL query with parameters asynchronously
   /// @param sql The SQL query string
   /// @param params Vector of parameter values
+  /// @param options Timeout, deadline or cancel token limiting the call
   /// @return Awaitable that resolves with the query results
   boost::asio::awaitable<ConnectionResult<result::ResultSet>> execute_raw(
-      std::string sql, std::vector<std::string> params = {});
+      std::string sql, std::vector<std::string> params = {}, QueryOptions options = {});
 
   /// @brief Execute a query expression asynchronously
   /// @param query The query expression to execute
+  /// @param options Timeout, deadline or cancel token limiting the call
   /// @return Awaitable that resolves with the query results
   template <query::SqlExpr Query>
-  boost::asio::awaitable<ConnectionResult<result::ResultSet>> execute(Query query) {
-    std::string sql = query.to_sql();
-    std::vector<std::string> params = query.bind_params();
-    return execute_raw(sql, params);
+  boost::asio::awaitable<ConnectionResult<result::ResultSet>> execute(Query query,
+                                                                      QueryOptions options = {}) {
+    static_assert(!query::ParameterizedQuery<Query>,
+                  "Queries with relx::param placeholders must be executed through prepare()");
+    // The coroutine keeps its own copies, so the writer is released before anything suspends
+    query::SqlWriterLease writer(query::PlaceholderStyle::Numbered);
+    writer->set_typed_params(true);
+    query::render_to(*writer, query);
+    return execute_query_sql(writer->sql(), writer->params(), writer->param_types(),
+                             options.started());
   }
 
   /// @brief Execute a query and map results to a user-defined type asynchronously
   /// @tparam T The user-defined type to map results to
   /// @tparam Query The query expression type
   /// @param query The query expression to execute
+  /// @param options Timeout, deadline or cancel token limiting the call
   /// @return Awaitable that resolves with the mapped data
   template <typename T, query::SqlExpr Query>
-  boost::asio::awaitable<ConnectionResult<T>> execute(Query query) {
-    auto result_set_output = co_await execute(query);
+  boost::asio::awaitable<ConnectionResult<T>> execute(Query query, QueryOptions options = {}) {
+    auto result_set_output = co_await execute(query, options);
     if (!result_set_output) {
       co_return std::unexpected(result_set_output.error());
     }
@@ -158,84 +198,194 @@ public:
   /// @tparam T The user-defined type to map results to
   /// @tparam Query The query expression type
   /// @param query The query expression to execute
+  /// @param options Timeout, deadline or cancel token limiting the call
   /// @return Awaitable that resolves with a vector of mapped data
   template <typename T, query::SqlExpr Query>
-  boost::asio::awaitable<ConnectionResult<std::vector<T>>> execute_many(const Query& query) {
-    auto result_set_output = co_await execute(query);
+  boost::asio::awaitable<ConnectionResult<std::vector<T>>> execute_many(
+      const Query& query, QueryOptions options = {}) {
+    auto result_set_output = co_await execute(query, options);
     if (!result_set_output) {
       co_return std::unexpected(result_set_output.error());
     }
 
     const auto& result_set = *result_set_output;
+    co_return co_await offload(result_set.size(), [&] { return map_rows<T>(result_set, query); });
+  }
 
-    std::vector<T> objects;
-    objects.reserve(result_set.size());
-
-    // Check if we have at least one row to determine column count
-    if (result_set.empty()) {
-      co_return objects;  // Return empty vector
-    }
+  /// @brief Execute several query expressions in one round trip
+  /// @details The queries are sent together in one pipeline segment and their results are read
+  /// back in order, so e.g. five small aggregates for one page cost one round trip instead of
+  /// five. They share one sync point: outside a transaction they run in one implicit
+  /// transaction, and if one fails the server skips the rest and the call fails with the error
+  /// of the failing query, with its index in the message. Each query must render to a single
+  /// SQL statement.
+  /// @tparam Queries The query expression types
+  /// @param queries The query expressions to execute
+  /// @return Awaitable that resolves with one ResultSet per query, in order
+  template <query::SqlExpr... Queries>
+  boost::asio::awaitable<ConnectionResult<std::vector<result::ResultSet>>> execute_multi(
+      const Queries&... queries) {
+    // The statements are rendered into the vector before anything suspends
+    return execute_statements({render_statement(queries)...});
+  }
 
-    // Make sure the number of columns matches the number of fields in the struct
-    if (result_set.column_count() != boost::pfr::tuple_size_v<std::remove_cvref_t<T>>) {
-      std::stringstream ss;
-      for (const auto& param : query.bind_params()) {
-        ss << param << ", ";
-      }
-      co_return std::unexpected(ConnectionError{
-          .message = "Column count does not match struct field count, " +
-                     std::to_string(result_set.column_count()) +
-                     " != " + std::to_string(boost::pfr::tuple_size_v<std::remove_cvref_t<T>>) +
-                     " for struct " + typeid(T).name() + " and query " + query.to_sql() +
-                     " with params " + ss.str(),
-          .error_code = -1});
-    }
+  /// @brief Execute several query expressions in one round trip, within limits
+  /// @details Like execute_multi(), with the options covering the whole segment
+  /// @param options Timeout, deadline or cancel token limiting the call
+  /// @param queries The query expressions to execute
+  /// @return Awaitable that resolves with one ResultSet per query, in order
+  template <query::SqlExpr... Queries>
+  boost::asio::awaitable<ConnectionResult<std::vector<result::ResultSet>>> execute_multi(
+      const QueryOptions& options, const Queries&... queries) {
+    return execute_statements({render_statement(queries)...}, options.started());
+  }
 
-    // Process each row
-    for (size_t row_idx = 0; row_idx < result_set.size(); ++row_idx) {
-      const auto& row = result_set.at(row_idx);
-      T obj{};
-      auto structure_tie = boost::pfr::structure_tie(obj);
-
-      try {
-        // Create a vector of values from the row
-        std::vector<std::string> values;
-        for (size_t i = 0; i < result_set.column_count(); ++i) {
-          auto cell_result = row.get_cell(i);
-          if (!cell_result) {
-            co_return std::unexpected(ConnectionError{.message = "Failed to get cell value: " +
-                                                                 cell_result.error().message,
-                                                      .error_code = -1});
-          }
-          values.push_back((*cell_result)->raw_value());
-        }
+  /// @brief Execute several query expressions in one round trip and map their rows
+  /// @details Runs the queries like execute_multi() and maps the rows of the i-th query to the
+  /// i-th type, e.g. execute_multi_as<Order, Customer>(orders_query, customers_query)
+  /// @tparam Ts The user-defined types to map the results to, one per query
+  /// @tparam Queries The query expression types
+  /// @param queries The query expressions to execute
+  /// @return Awaitable that resolves with a tuple of one vector of mapped objects per query
+  template <typename... Ts, query::SqlExpr... Queries>
+  boost::asio::awaitable<ConnectionResult<std::tuple<std::vector<Ts>...>>> execute_multi_as(
+      const Queries&... queries) {
+    return execute_multi_as<Ts...>(QueryOptions{}, queries...);
+  }
 
-        relx::connection::map_row_to_tuple(structure_tie, values);
-        objects.push_back(std::move(obj));
-      } catch (const std::exception& e) {
-        co_return std::unexpected(ConnectionError{
-            .message = std::string("Failed to convert result to struct: ") + e.what(),
-            .error_code = -1});
-      }
+  /// @brief Execute several query expressions in one round trip, within limits, and map them
+  /// @details Like execute_multi_as(), with the options covering the whole segment
+  /// @param options Timeout, deadline or cancel token limiting the call
+  /// @param queries The query expressions to execute
+  /// @return Awaitable that resolves with a tuple of one vector of mapped objects per query
+  template <typename... Ts, query::SqlExpr... Queries>
+  boost::asio::awaitable<ConnectionResult<std::tuple<std::vector<Ts>...>>> execute_multi_as(
+      QueryOptions options, const Queries&... queries) {
+    static_assert(sizeof...(Ts) == sizeof...(Queries), "One result type is needed per query");
+    auto result_sets = co_await execute_multi(options, queries...);
+    if (!result_sets) {
+      co_return std::unexpected(result_sets.error());
     }
 
-    co_return objects;
+    size_t rows = 0;
+    for (const auto& result_set : *result_sets) {
+      rows += result_set.size();
+    }
+    co_return co_await offload(
+        rows, [&] { return map_result_sets<Ts...>(*result_sets, queries...); });
   }
 
   /// @brief Begin a new transaction asynchronously
+  /// @details BEGIN is deferred and sent together with the first statement of the transaction,
+  /// so this resolves without a round trip.
   /// @param isolation_level The isolation level for the transaction
   /// @return Awaitable that resolves when transaction begins
   boost::asio::awaitable<ConnectionResult<void>> begin_transaction(
       IsolationLevel isolation_level = IsolationLevel::ReadCommitted);
 
   /// @brief Commit the current transaction asynchronously
+  /// @details Statements queued with defer() are sent with the COMMIT in one flush
   /// @return Awaitable that resolves when transaction is committed
   boost::asio::awaitable<ConnectionResult<void>> commit_transaction();
 
   /// @brief Rollback the current transaction asynchronously
+  /// @details Deferred statements that have not been sent yet are discarded
   /// @return Awaitable that resolves when transaction is rolled back
   boost::asio::awaitable<ConnectionResult<void>> rollback_transaction();
 
+  /// @brief Queue a query to run inside the current transaction without awaiting it
+  /// @details The query is sent with the next statement executed on this connection, or with
+  /// the COMMIT. Its result is discarded; if it fails, that statement or the commit reports
+  /// the error and the transaction must be rolled back.
+  /// @tparam Query The query expression type
+  /// @param query The query expression to queue
+  /// @return Result indicating success or failure
+  template <query::SqlExpr Query>
+  ConnectionResult<void> defer(const Query& query) {
+    static_assert(!query::ParameterizedQuery<Query>,
+                  "Queries with relx::param placeholders must be executed through prepare()");
+    query::SqlWriterLease writer(query::PlaceholderStyle::Numbered);
+    writer->set_typed_params(true);
+    query::render_to(*writer, query);
+    return defer_raw(writer->take_sql(), writer->take_params(), writer->take_param_types());
+  }
+
+  /// @brief Queue a raw SQL statement to run inside the current transaction
+  /// @param sql A single SQL statement with ? placeholders
+  /// @param params Vector of parameter values
+  /// @param types Parameter type OIDs and formats; empty if all parameters are untyped text
+  /// @return Result indicating success or failure
+  ConnectionResult<void> defer_raw(std::string sql, std::vector<std::string> params = {},
+                                   query::ParamTypes types = {});
+
+  /// @brief Prepare a query containing relx::param placeholders for repeated execution
+  /// @details The asynchronous counterpart of PostgreSQLConnection::prepare(). Executions of
+  /// the returned AsyncPreparedQuery may be awaited concurrently; each one encodes its own
+  /// copy of the parameter values.
+  /// @note The prepared query must not outlive this connection
+  /// @tparam Query The query expression type
+  /// @param query The query expression to prepare
+  /// @return Awaitable that resolves with the prepared query
+  template <query::ParameterizedQuery Query>
+  boost::asio::awaitable<ConnectionResult<prepared_query_for_t<AsyncPreparedQuery, Query>>>
+  prepare(const Query& query) {
+    using Prepared = prepared_query_for_t<AsyncPreparedQuery, Query>;
+
+    // Render before anything suspends, so the query may be a temporary
+    query::SqlWriterLease writer(query::PlaceholderStyle::Numbered);
+    writer->set_typed_params(true);
+    query::render_to(*writer, query);
+    return prepare_rendered<Prepared>(writer->sql(), writer->param_types(),
+                                      Prepared::Values::from_writer(*writer));
+  }
+
+  /// @brief Enable the automatic prepared-statement cache for query expressions
+  /// @details Once enabled, execute(query) prepares each distinct rendered SQL string on first
+  /// use and executes the prepared statement afterwards. The least recently used statement is
+  /// deallocated when the cache is full. Raw SQL passed to execute_raw() is never cached.
+  /// @param capacity Maximum number of statements kept prepared on this connection
+  void enable_statement_cache(size_t capacity = 256);
+
+  /// @brief Disable the prepared-statement cache and deallocate its statements
+  /// @return Awaitable that resolves once the statements are deallocated
+  boost::asio::awaitable<ConnectionResult<void>> disable_statement_cache();
+
+  /// @brief Check if the prepared-statement cache is enabled
+  /// @return True if execute(query) goes through the cache
+  bool statement_cache_enabled() const { return statement_cache_.has_value(); }
+
+  /// @brief Get the prepared-statement cache counters
+  /// @return Hit, miss, eviction and re-prepare counts, all zero if the cache is disabled
+  StatementCacheStats statement_cache_stats() const {
+    return statement_cache_ ? statement_cache_->stats() : StatementCacheStats{};
+  }
+
+  /// @brief Get the counts of the queries run on this connection
+  /// @return Statements executed, failed and cancelled since the connection was created
+  QueryStats query_stats() const { return query_stats_; }
+
+  /// @brief Apply session settings and prepare statements in a single round trip
+  /// @details Everything is sent before any reply is awaited, so the statements share one
+  /// pipelined flight. Settings this connection already set to the same value are skipped. The
+  /// statements are prepared into the statement cache, which is enabled if needed.
+  /// @param setup The settings and statements
+  /// @return Awaitable that resolves once every statement has completed
+  boost::asio::awaitable<ConnectionResult<void>> apply_session_setup(SessionSetup setup);
+
+  /// @brief Change a session setting, unless this connection already set it to the same value
+  /// @param name The setting, e.g. "statement_timeout"
+  /// @param value The new value
+  /// @return Awaitable that resolves once the setting is in effect
+  boost::asio::awaitable<ConnectionResult<void>> set_session(std::string name, std::string value);
+
+  /// @brief Get the value this connection set for a session setting
+  /// @return The value, or std::nullopt if it was not set through this connection or may have
+  /// been undone since, e.g. because it was set inside a transaction
+  std::optional<std::string> session_setting(const std::string& name) const;
+
+  /// @brief Forget the tracked session settings, e.g. after running RESET ALL
+  void clear_session_settings() { session_settings_.clear(); }
+
   /// @brief Get the underlying async connection wrapper
   /// @return Reference to the async wrapper connection
   pgsql_async_wrapper::Connection& get_async_conn() { return *async_conn_; }
@@ -243,6 +393,24 @@ public:
   /// Get the IO context associated with this connection
   boost::asio::io_context& get_io_context() const { return io_context_; }
 
+  /// @brief Get the strand every operation on this connection runs on
+  /// @details Spawn coroutines that use the connection on it to save a hop per operation
+  const pgsql_async_wrapper::Connection::Strand& strand() const { return async_conn_->strand(); }
+
+  /// @brief Convert large results on another executor instead of the connection's strand
+  /// @details Turning a result into a ResultSet, and into objects in execute_many(), takes time
+  /// in proportion to its size and holds up every coroutine on the io_context thread it runs
+  /// on. With a conversion executor, e.g. that of a boost::asio::thread_pool, results of at
+  /// least min_rows rows are converted there and the awaiting coroutine then resumes on its own
+  /// executor. Call while no operation is in flight.
+  /// @param executor Executor for the conversion, or std::nullopt to convert inline again
+  /// @param min_rows Smaller results are converted inline, which is cheaper than two hops
+  void set_conversion_executor(std::optional<boost::asio::any_io_executor> executor,
+                               size_t min_rows = 1000) {
+    conversion_executor_ = std::move(executor);
+    offload_min_rows_ = min_rows;
+  }
+
   /// @brief Reset connection state after streaming operations
   /// @return Awaitable that resolves when the connection is ready for new commands
   boost::asio::awaitable<ConnectionResult<void>> reset_connection_state();
@@ -254,20 +422,198 @@ public:
   bool reset_connection_state_sync();
 
 private:
+  template <typename... Params>
+  friend class AsyncPreparedQuery;
+
   boost::asio::io_context& io_context_;
   std::string connection_string_;
   std::unique_ptr<pgsql_async_wrapper::Connection> async_conn_;
   bool is_connected_ = false;
   bool in_transaction_ = false;
+  std::optional<StatementCache> statement_cache_;
+  std::vector<std::string> stale_statements_;  ///< Statements of destroyed prepared queries
+  size_t prepared_query_count_ = 0;            ///< Used to name statements of prepare()
+  /// Guards stale_statements_, which prepared queries destroyed on any thread append to
+  std::mutex stale_mutex_;
+  /// Session settings this connection set outside a transaction, which are still in effect
+  std::unordered_map<std::string, std::string> session_settings_;
+  QueryStats query_stats_;
+  /// Executor large results are converted on, see set_conversion_executor()
+  std::optional<boost::asio::any_io_executor> conversion_executor_;
+  size_t offload_min_rows_ = 0;
+
+  /// @brief Whether a coroutine with the given executor must hop onto strand() first
+  bool off_strand(const boost::asio::any_io_executor& executor) const {
+    return async_conn_ && !async_conn_->running_on_strand(executor);
+  }
+
+  /// @brief Run one statement of apply_session_setup(), preparing it if statement_name is set
+  /// @return The error, or std::nullopt on success
+  boost::asio::awaitable<std::optional<ConnectionError>> run_setup_statement(
+      std::string statement_name, std::string sql, std::vector<std::string> params,
+      query::ParamTypes types);
+
+  /// @brief Prepare a rendered query and wrap it in a prepared query object
+  template <typename Prepared>
+  boost::asio::awaitable<ConnectionResult<Prepared>> prepare_rendered(
+      std::string sql, query::ParamTypes types,
+      ConnectionResult<typename Prepared::Values> params) {
+    if (!params) {
+      co_return std::unexpected(params.error());
+    }
+
+    auto name = co_await prepare_query_sql(std::move(sql), std::move(types));
+    if (!name) {
+      co_return std::unexpected(name.error());
+    }
+    co_return Prepared(*this, std::move(*name), std::move(*params));
+  }
+
+  /// @brief Prepare a rendered query under a new statement name
+  /// @return Awaitable that resolves with the statement name
+  boost::asio::awaitable<ConnectionResult<std::string>> prepare_query_sql(
+      std::string sql, query::ParamTypes types);
+
+  /// @brief Execute a statement created by prepare()
+  boost::asio::awaitable<ConnectionResult<result::ResultSet>> execute_prepared_query(
+      std::string name, std::vector<std::string> params, query::ParamTypes types,
+      QueryOptions options = {});
+
+  /// @brief Deallocate the statement of a destroyed AsyncPreparedQuery with the next prepare()
+  void release_prepared_query(std::string name) {
+    const std::lock_guard lock(stale_mutex_);
+    stale_statements_.push_back(std::move(name));
+  }
+
+  /// @brief Execute SQL rendered from a query expression, through the cache when enabled
+  /// @details Parameters are typed, so numbers, booleans and timestamps travel in binary
+  boost::asio::awaitable<ConnectionResult<result::ResultSet>> execute_query_sql(
+      std::string sql, std::vector<std::string> params, query::ParamTypes types,
+      QueryOptions options = {});
+
+  /// @brief Render a query expression for execute_multi(), with typed parameters
+  template <query::SqlExpr Query>
+  static pgsql_async_wrapper::Connection::Statement render_statement(const Query& query) {
+    static_assert(!query::ParameterizedQuery<Query>,
+                  "Queries with relx::param placeholders must be executed through prepare()");
+    query::SqlWriterLease writer(query::PlaceholderStyle::Numbered);
+    writer->set_typed_params(true);
+    query::render_to(*writer, query);
+    return {.sql = writer->take_sql(),
+            .params = writer->take_params(),
+            .types = writer->take_param_types()};
+  }
+
+  /// @brief Send rendered statements in one pipeline segment and convert their results
+  boost::asio::awaitable<ConnectionResult<std::vector<result::ResultSet>>> execute_statements(
+      std::vector<pgsql_async_wrapper::Connection::Statement> statements,
+      QueryOptions options = {});
+
+  /// @brief Count a query in query_stats_, including a timeout or cancellation
+  void count_query(const pgsql_async_wrapper::PgResult<pgsql_async_wrapper::Result>& pg_result);
 
   /// @brief Helper method to convert pgsql_async_wrapper::result to relx::result::ResultSet
   static ConnectionResult<result::ResultSet> convert_result(
       const pgsql_async_wrapper::Result& pg_result);
 
+  /// @brief convert_result(), on the conversion executor if the result is large enough
+  boost::asio::awaitable<ConnectionResult<result::ResultSet>> convert_offloaded(
+      pgsql_async_wrapper::Result pg_result);
+
+  /// @brief Run CPU-bound work on a result of the given size
+  /// @details Runs the function on the conversion executor when one is set and the result has
+  /// at least offload_min_rows_ rows, inline otherwise. The awaiting coroutine resumes on its
+  /// own executor either way.
+  template <typename Function>
+  boost::asio::awaitable<std::invoke_result_t<Function&>> offload(size_t rows,
+                                                                   Function function) {
+    if (!conversion_executor_ || rows < offload_min_rows_) {
+      co_return function();
+    }
+    co_return co_await boost::asio::co_spawn(
+        *conversion_executor_,
+        [function = std::move(function)]() mutable
+        -> boost::asio::awaitable<std::invoke_result_t<Function&>> { co_return function(); },
+        boost::asio::use_awaitable);
+  }
+
+
   /// @brief Convert SQL with ? placeholders to PostgreSQL's $n format
   /// @param sql SQL query with ? placeholders
   /// @return Converted SQL with $1, $2, etc. placeholders
   static std::string convert_placeholders(const std::string& sql);
 };
 
+/// @brief A query prepared with PostgreSQLAsyncConnection::prepare()
+/// @details Calling the object returns an awaitable executing the statement with new argument
+/// values. The statement is deallocated on the server with the connection's next prepare()
+/// once the object is destroyed.
+/// @tparam Params The Param value types, in placeholder order
+template <typename... Params>
+class AsyncPreparedQuery {
+public:
+  using Values = PreparedParams<Params...>;
+
+  static constexpr size_t param_count = sizeof...(Params);
+
+  AsyncPreparedQuery(PostgreSQLAsyncConnection& connection, std::string name, Values params)
+      : connection_(&connection), name_(std::move(name)), params_(std::move(params)) {}
+
+  ~AsyncPreparedQuery() {
+    if (connection_) {
+      connection_->release_prepared_query(std::move(name_));
+    }
+  }
+
+  AsyncPreparedQuery(const AsyncPreparedQuery&) = delete;
+  AsyncPreparedQuery& operator=(const AsyncPreparedQuery&) = delete;
+
+  AsyncPreparedQuery(AsyncPreparedQuery&& other) noexcept
+      : connection_(std::exchange(other.connection_, nullptr)),
+        name_(std::move(other.name_)),
+        params_(std::move(other.params_)) {}
+
+  AsyncPreparedQuery& operator=(AsyncPreparedQuery&& other) noexcept {
+    if (this != &other) {
+      if (connection_) {
+        connection_->release_prepared_query(std::move(name_));
+      }
+      connection_ = std::exchange(other.connection_, nullptr);
+      name_ = std::move(other.name_);
+      params_ = std::move(other.params_);
+    }
+    return *this;
+  }
+
+  /// @brief Execute the prepared query asynchronously
+  /// @param args One value per Param, in placeholder order
+  /// @return Awaitable that resolves with the query results
+  boost::asio::awaitable<ConnectionResult<result::ResultSet>> operator()(const Params&... args) {
+    // Executions may overlap, so each one binds into its own copy of the values
+    Values bound = params_;
+    bound.bind(args...);
+    return connection_->execute_prepared_query(name_, bound.take_values(), bound.types());
+  }
+
+  /// @brief Execute the prepared query asynchronously, within limits
+  /// @param options Timeout, deadline or cancel token limiting the call
+  /// @param args One value per Param, in placeholder order
+  /// @return Awaitable that resolves with the query results
+  boost::asio::awaitable<ConnectionResult<result::ResultSet>> operator()(
+      const QueryOptions& options, const Params&... args) {
+    Values bound = params_;
+    bound.bind(args...);
+    return connection_->execute_prepared_query(name_, bound.take_values(), bound.types(),
+                                               options.started());
+  }
+
+  /// @brief Get the name of the statement on the server
+  const std::string& name() const { return name_; }
+
+private:
+  PostgreSQLAsyncConnection* connection_;
+  std::string name_;
+  Values params_;
+};
+
 }  // namespace relx::connection
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "postgresql_async_connection.hpp"
+#include "postgresql_connection_pool.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+
+namespace relx::connection {
+
+/// @brief Configuration for the asynchronous PostgreSQL connection pool
+struct PostgreSQLAsyncConnectionPoolConfig {
+  /// @brief Connection parameters for PostgreSQL
+  PostgreSQLConnectionParams connection_params;
+
+  /// @brief Number of connections opened by initialize()
+  size_t initial_size = 5;
+
+  /// @brief Maximum number of connections allowed
+  size_t max_size = 10;
+
+  /// @brief Maximum time acquire() waits for a connection before timing out (ms)
+  std::chrono::milliseconds connection_timeout{5000};
+
+  /// @brief Session settings and statements applied to every new connection
+  /// @details Sent in one pipelined round trip right after connecting, before the connection
+  /// is handed out
+  SessionSetup session_setup;
+
+  /// @brief Callback that receives metrics() periodically, from coroutines calling acquire()
+  PoolMetricsSink metrics_sink;
+};
+
+/// @brief Connection pool for PostgreSQLAsyncConnection that is awaited instead of blocking
+/// @details acquire() completes immediately when a connection is idle. Otherwise the coroutine
+/// joins a FIFO queue and is suspended, without blocking its thread, until a connection is
+/// returned or opened for it, or until its timeout expires. New connections are opened in the
+/// background while fewer than max_size exist. Returned connections are rolled back first if
+/// they are still inside a transaction. The pool may be used from coroutines running on several
+/// threads of the io_context.
+class PostgreSQLAsyncConnectionPool
+    : public std::enable_shared_from_this<PostgreSQLAsyncConnectionPool> {
+private:
+  /// @brief A coroutine waiting in acquire()
+  struct Waiter {
+    explicit Waiter(boost::asio::strand<boost::asio::io_context::executor_type> strand)
+        : timer(std::move(strand)) {}
+
+    /// Only touched on the pool's strand; cancelled to wake the waiter early
+    boost::asio::steady_timer timer;
+    /// The following are guarded by the pool mutex
+    std::shared_ptr<PostgreSQLAsyncConnection> connection;
+    std::optional<ConnectionPoolError> error;
+  };
+
+  /// @brief Constructor with io_context and pool configuration
+  /// @param io_context The IO context the connections run on
+  /// @param config Configuration for the connection pool
+  PostgreSQLAsyncConnectionPool(boost::asio::io_context& io_context,
+                                PostgreSQLAsyncConnectionPoolConfig config);
+
+public:
+  class PooledConnection;
+
+  /// @brief Create a new connection pool
+  /// @note Pooled connections and background tasks keep track of the pool through a shared_ptr,
+  ///       so the pool can only be created with create().
+  /// @param io_context The IO context the connections run on
+  /// @param config Configuration for the pool
+  /// @return Shared pointer to the new pool
+  static std::shared_ptr<PostgreSQLAsyncConnectionPool> create(
+      boost::asio::io_context& io_context, PostgreSQLAsyncConnectionPoolConfig config) {
+    // Use new directly instead of make_shared to access the private constructor
+    return std::shared_ptr<PostgreSQLAsyncConnectionPool>(
+        new PostgreSQLAsyncConnectionPool(io_context, std::move(config)));
+  }
+
+  ~PostgreSQLAsyncConnectionPool() = default;
+
+  PostgreSQLAsyncConnectionPool(const PostgreSQLAsyncConnectionPool&) = delete;
+  PostgreSQLAsyncConnectionPool& operator=(const PostgreSQLAsyncConnectionPool&) = delete;
+  PostgreSQLAsyncConnectionPool(PostgreSQLAsyncConnectionPool&&) = delete;
+  PostgreSQLAsyncConnectionPool& operator=(PostgreSQLAsyncConnectionPool&&) = delete;
+
+  /// @brief Open the initial connections
+  /// @return Awaitable that resolves once initial_size connections are idle, or with an error
+  [[nodiscard]] boost::asio::awaitable<ConnectionPoolResult<void>> initialize();
+
+  /// @brief Acquire a connection, waiting up to the configured connection_timeout
+  /// @return Awaitable that resolves with a connection that returns itself to the pool
+  [[nodiscard]] boost::asio::awaitable<ConnectionPoolResult<PooledConnection>> acquire();
+
+  /// @brief Acquire a connection, waiting up to the given timeout
+  /// @param timeout Maximum time to wait for a connection
+  /// @return Awaitable that resolves with a connection that returns itself to the pool
+  [[nodiscard]] boost::asio::awaitable<ConnectionPoolResult<PooledConnection>> acquire(
+      std::chrono::milliseconds timeout);
+
+  /// @brief Get a snapshot of the pool's counters and latency histograms
+  /// @details Query counts of a connection are taken when it is returned to the pool.
+  PoolMetrics metrics() const;
+
+  /// @brief Get the number of connections currently acquired
+  size_t active_connections() const;
+
+  /// @brief Get the number of idle connections
+  size_t idle_connections() const;
+
+  /// @brief Get the number of coroutines waiting in acquire()
+  size_t waiting() const;
+
+  /// @brief A connection acquired from the pool, returned to it when destroyed
+  class PooledConnection {
+  private:
+    std::shared_ptr<PostgreSQLAsyncConnection> connection_;
+    std::weak_ptr<PostgreSQLAsyncConnectionPool> pool_;
+    QueryStats acquired_stats_;  ///< Query counts of the connection when it was acquired
+
+  public:
+    /// @brief Constructor takes a connection and its parent pool
+    /// @param connection The database connection
+    /// @param pool The connection pool that owns this connection
+    PooledConnection(std::shared_ptr<PostgreSQLAsyncConnection> connection,
+                     const std::shared_ptr<PostgreSQLAsyncConnectionPool>& pool)
+        : connection_(std::move(connection)), pool_(pool),
+          acquired_stats_(connection_->query_stats()) {}
+
+    /// @brief Destructor returns the connection to the pool if it still exists
+    ~PooledConnection() {
+      if (connection_) {
+        if (auto pool = pool_.lock()) {
+          pool->metrics_.add_queries(connection_->query_stats() - acquired_stats_);
+          pool->return_connection(std::move(connection_));
+        }
+      }
+    }
+
+    PooledConnection(const PooledConnection&) = delete;
+    PooledConnection& operator=(const PooledConnection&) = delete;
+
+    PooledConnection(PooledConnection&&) = default;
+    PooledConnection& operator=(PooledConnection&&) = default;
+
+    /// @brief Forward -> operator to the underlying connection
+    PostgreSQLAsyncConnection* operator->() { return connection_.get(); }
+
+    /// @brief Forward const -> operator to the underlying connection
+    const PostgreSQLAsyncConnection* operator->() const { return connection_.get(); }
+
+    /// @brief Get the underlying connection
+    PostgreSQLAsyncConnection& operator*() { return *connection_; }
+
+    /// @brief Allow checking if connection is valid
+    explicit operator bool() const { return connection_ != nullptr; }
+  };
+
+private:
+  boost::asio::io_context& io_context_;
+  PostgreSQLAsyncConnectionPoolConfig config_;
+  /// Serialises all operations on waiter timers
+  boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+
+  mutable std::mutex pool_mutex_;
+  std::vector<std::shared_ptr<PostgreSQLAsyncConnection>> idle_;
+  std::deque<std::shared_ptr<Waiter>> waiters_;
+  size_t total_connections_ = 0;  ///< Open connections plus those being opened
+  size_t active_connections_ = 0;
+
+  PoolMetricsRecorder metrics_;
+
+  /// @brief Wait until a waiter is woken or times out; runs on the strand
+  static boost::asio::awaitable<void> wait_on_strand(
+      std::shared_ptr<PostgreSQLAsyncConnectionPool> self, std::shared_ptr<Waiter> waiter);
+
+  /// @brief Open one connection in the background and hand it to a waiter or the idle list
+  /// @note total_connections_ must already account for the connection
+  static boost::asio::awaitable<void> open_connection(
+      std::shared_ptr<PostgreSQLAsyncConnectionPool> self);
+
+  /// @brief Return a connection, rolling it back in the background if needed
+  void return_connection(std::shared_ptr<PostgreSQLAsyncConnection> connection);
+
+  /// @brief Roll back a returned connection that is still inside a transaction
+  static boost::asio::awaitable<void> roll_back_and_return(
+      std::shared_ptr<PostgreSQLAsyncConnectionPool> self,
+      std::shared_ptr<PostgreSQLAsyncConnection> connection);
+
+  /// @brief Give a usable connection to the longest waiting coroutine, or make it idle
+  void release(std::shared_ptr<PostgreSQLAsyncConnection> connection);
+
+  /// @brief Forget a connection that could not be opened or is broken
+  /// @param error Passed to the longest waiting coroutine, if the pool cannot open another
+  void discard(std::optional<ConnectionPoolError> error);
+
+  /// @brief Wake a waiter whose connection or error has been set
+  void wake(const std::shared_ptr<Waiter>& waiter);
+
+  /// @brief Create a connection object that is not connected yet
+  std::shared_ptr<PostgreSQLAsyncConnection> make_connection() const;
+
+  /// @brief Connect a new connection and apply the session setup, counting it in the metrics
+  static boost::asio::awaitable<ConnectionResult<void>> connect(
+      std::shared_ptr<PostgreSQLAsyncConnectionPool> self,
+      std::shared_ptr<PostgreSQLAsyncConnection> connection);
+};
+
+}  // namespace relx::connection
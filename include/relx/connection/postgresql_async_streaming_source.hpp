@@ -117,6 +117,10 @@ private:
   /// @return Binary string representation
   std::string convert_pg_bytea_to_binary(const std::string& hex_value) const;
 
+  /// @brief Ask the server to cancel an unfinished query instead of draining every row
+  /// @param pg_conn The connection running the query
+  void cancel_remaining_rows(struct pg_conn* pg_conn);
+
   /// @brief Helper method to clean up any active query
   void cleanup();
 };
@@ -303,8 +307,8 @@ public:
           // Async function returning bool - check for early termination
           bool result = co_await func(*it);
           if (result) {
-            // Early termination - need to manually reset connection state
-            co_await auto_reset_connection_state();
+            // Early termination - cancel the rest of the query and reset connection state
+            co_await cleanup();
             co_return;
           }
         } else {
@@ -316,8 +320,8 @@ public:
         if constexpr (std::is_same_v<ReturnType, bool>) {
           // Sync function returning bool - check for early termination
           if (func(*it)) {
-            // Early termination - need to manually reset connection state
-            co_await auto_reset_connection_state();
+            // Early termination - cancel the rest of the query and reset connection state
+            co_await cleanup();
             co_return;
           }
         } else {
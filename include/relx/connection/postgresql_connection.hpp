@@ -1,22 +1,38 @@
 #pragma once
 
 #include "connection.hpp"
+#include "metrics.hpp"
+#include "prepared_query.hpp"
+#include "query_options.hpp"
+#include "session_setup.hpp"
+#include "statement_cache.hpp"
 
+#include <functional>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 // Forward declarations to avoid including libpq headers in our public API
 struct pg_conn;
 using PGconn = pg_conn;
 struct pg_result;
 using PGresult = pg_result;
+struct pg_cancel;
+using PGcancel = pg_cancel;
 
-// Forward declare statement class
+// Forward declare statement and pipeline classes
 namespace relx::connection {
 class PostgreSQLStatement;
+class PostgreSQLPipeline;
+template <typename... Params>
+class PreparedQuery;
 }  // namespace relx::connection
 
 namespace relx::connection {
@@ -24,6 +40,13 @@ namespace relx::connection {
 /// @brief PostgreSQL implementation of the Connection interface
 class PostgreSQLConnection : public Connection {
 public:
+  /// @brief Progress of a connection opened with start_connect()
+  enum class ConnectState : uint8_t {
+    WaitRead,   ///< Wait until socket() is readable, then call continue_connect()
+    WaitWrite,  ///< Wait until socket() is writable, then call continue_connect()
+    Connected,  ///< The connection is ready to use
+  };
+
   /// @brief Constructor with connection parameters
   /// @param connection_string PostgreSQL connection string (e.g. "host=localhost port=5432
   /// dbname=mydb user=postgres password=password")
@@ -48,6 +71,20 @@ public:
   /// @return Result indicating success or failure
   ConnectionResult<void> connect() override;
 
+  /// @brief Start connecting without waiting for the server
+  /// @details Lets one thread open many connections at once: wait on socket() as the returned
+  /// state asks, then call continue_connect() until it returns Connected.
+  /// @return The next state, or an error if the connection could not be started
+  ConnectionResult<ConnectState> start_connect();
+
+  /// @brief Continue a connection started with start_connect() once its socket is ready
+  /// @return The next state, or an error if connecting failed
+  ConnectionResult<ConnectState> continue_connect();
+
+  /// @brief Get the socket of the connection, or -1 if there is none
+  /// @note The socket can change while connecting, so read it again after each step
+  int socket() const;
+
   /// @brief Disconnect from the PostgreSQL database
   /// @return Result indicating success or failure
   ConnectionResult<void> disconnect() override;
@@ -59,6 +96,79 @@ public:
   ConnectionResult<result::ResultSet> execute_raw(
       const std::string& sql, const std::vector<std::string>& params = {}) override;
 
+  /// @brief Execute a raw SQL query within a timeout, deadline or cancel token
+  /// @details When a limit is reached the server is sent a cancel request and the call fails
+  /// with query_cancelled_error. The connection stays usable, unless the server does not
+  /// answer the cancel request either, in which case it is closed.
+  /// @param sql The SQL query string
+  /// @param params Vector of parameter values
+  /// @param options The limits of the call
+  /// @return Result containing the query results or an error
+  ConnectionResult<result::ResultSet> execute_raw(const std::string& sql,
+                                                  const std::vector<std::string>& params,
+                                                  const QueryOptions& options);
+
+  using Connection::execute;
+
+  /// @brief Execute a query expression within a timeout, deadline or cancel token
+  /// @details Limits the statements the call sends the same way as execute_raw() with
+  /// options, including deferred statements sent in the same pipeline.
+  /// @tparam Query The query expression type
+  /// @param query The query expression to execute
+  /// @param options The limits of the call
+  /// @return Result containing the query results or an error
+  template <query::SqlExpr Query>
+  [[nodiscard]]
+  ConnectionResult<result::ResultSet> execute(const Query& query, const QueryOptions& options) {
+    const LimitScope scope(*this, options);
+    return scope.finish(Connection::execute(query));
+  }
+
+  /// @brief Execute several query expressions in one round trip
+  /// @details The queries are sent together through a PostgreSQLPipeline, so e.g. five small
+  /// aggregates for one page cost one round trip instead of five. They share one sync point:
+  /// outside a transaction they run in one implicit transaction, and if one fails the server
+  /// skips the rest and the call returns the error of the failing query, with its index in the
+  /// message. Each query must render to a single SQL statement.
+  /// @tparam Queries The query expression types
+  /// @param queries The query expressions to execute
+  /// @return One ResultSet per query, in order, or the first error
+  template <query::SqlExpr... Queries>
+  ConnectionResult<std::vector<result::ResultSet>> execute_multi(const Queries&... queries) {
+    return execute_statements({render_statement(queries)...});
+  }
+
+  /// @brief Execute several query expressions in one round trip within a timeout, deadline or
+  /// cancel token
+  /// @details As execute_multi() without options; a limit that is reached cancels the whole
+  /// batch, which fails with query_cancelled_error.
+  /// @tparam Queries The query expression types
+  /// @param options The limits of the call
+  /// @param queries The query expressions to execute
+  /// @return One ResultSet per query, in order, or the first error
+  template <query::SqlExpr... Queries>
+  ConnectionResult<std::vector<result::ResultSet>> execute_multi(const QueryOptions& options,
+                                                                 const Queries&... queries) {
+    const LimitScope scope(*this, options);
+    return scope.finish(execute_statements({render_statement(queries)...}));
+  }
+
+  /// @brief Execute several query expressions in one round trip and map their rows
+  /// @details Runs the queries like execute_multi() and maps the rows of the i-th query to the
+  /// i-th type, e.g. execute_multi_as<Order, Customer>(orders_query, customers_query)
+  /// @tparam Ts The user-defined types to map the results to, one per query
+  /// @tparam Queries The query expression types
+  /// @param queries The query expressions to execute
+  /// @return A tuple with one vector of mapped objects per query, or the first error
+  template <typename... Ts, query::SqlExpr... Queries>
+  ConnectionResult<std::tuple<std::vector<Ts>...>> execute_multi_as(const Queries&... queries) {
+    auto result_sets = execute_multi(queries...);
+    if (!result_sets) {
+      return std::unexpected(result_sets.error());
+    }
+    return map_result_sets<Ts...>(*result_sets, queries...);
+  }
+
   /// @brief Execute a raw SQL query with binary parameters
   /// @param sql The SQL query string
   /// @param params Vector of parameter values
@@ -118,19 +228,68 @@ public:
   bool is_connected() const override;
 
   /// @brief Begin a new transaction with specified isolation level
+  /// @details BEGIN is not sent right away. It goes out together with the first statement
+  /// executed in the transaction, so starting a transaction costs no extra round trip. A
+  /// transaction that never executes anything is committed or rolled back without contacting
+  /// the server at all.
   /// @param isolation_level The isolation level for the transaction
   /// @return Result indicating success or failure
   ConnectionResult<void> begin_transaction(
       IsolationLevel isolation_level = IsolationLevel::ReadCommitted) override;
 
   /// @brief Commit the current transaction
+  /// @details Statements queued with defer() are sent in the same pipeline as the COMMIT, so a
+  /// transaction made only of deferred statements costs a single round trip in total.
   /// @return Result indicating success or failure
   ConnectionResult<void> commit_transaction() override;
 
+  /// @brief Commit the current transaction within a timeout, deadline or cancel token
+  /// @details The deferred statements and the COMMIT are limited as a whole, the same way as
+  /// execute_raw() with options. A limit that is reached leaves the transaction to be rolled
+  /// back, or closes the connection if the server does not answer the cancel request.
+  /// @param options The limits of the call
+  /// @return Result indicating success or failure
+  ConnectionResult<void> commit_transaction(const QueryOptions& options);
+
   /// @brief Rollback the current transaction
+  /// @details Deferred statements that have not been sent yet are discarded
   /// @return Result indicating success or failure
   ConnectionResult<void> rollback_transaction() override;
 
+  /// @brief Queue a query to run inside the current transaction without waiting for it
+  /// @details The query is sent with the next statement executed on this connection, or with
+  /// the COMMIT. Its result is discarded; if it fails, that statement or the commit reports
+  /// the error and the transaction must be rolled back.
+  /// @tparam Query The query expression type
+  /// @param query The query expression to queue
+  /// @return Result indicating success or failure
+  template <query::SqlExpr Query>
+  ConnectionResult<void> defer(const Query& query) {
+    static_assert(!query::ParameterizedQuery<Query>,
+                  "Queries with relx::param placeholders must be executed through prepare()");
+    query::SqlWriterLease writer(query::PlaceholderStyle::Numbered);
+    writer->set_typed_params(true);
+    query::render_to(*writer, query);
+    return defer_raw(writer->take_sql(), writer->take_params(), writer->take_param_types());
+  }
+
+  /// @brief Queue a raw SQL statement to run inside the current transaction
+  /// @param sql A single SQL statement with ? placeholders
+  /// @param params Vector of parameter values
+  /// @param types Parameter type OIDs and formats; empty if all parameters are untyped text
+  /// @return Result indicating success or failure
+  ConnectionResult<void> defer_raw(std::string sql, std::vector<std::string> params = {},
+                                   query::ParamTypes types = {});
+
+  /// @brief Send a deferred BEGIN and any deferred statements now
+  /// @details Call this before using get_pg_conn() directly inside a transaction
+  /// @return Result indicating success or failure
+  ConnectionResult<void> flush_deferred();
+
+  /// @brief Get the number of deferred statements that have not been sent yet
+  /// @return The number of statements queued with defer(), plus one for an unsent BEGIN
+  size_t deferred_count() const { return deferred_.size() + (deferred_begin_.empty() ? 0 : 1); }
+
   /// @brief Check if a transaction is currently active
   /// @return True if a transaction is active, false otherwise
   bool in_transaction() const override;
@@ -143,6 +302,105 @@ public:
   std::unique_ptr<PostgreSQLStatement> prepare_statement(const std::string& name,
                                                          const std::string& sql, int param_count);
 
+  /// @brief Prepare a query containing relx::param placeholders for repeated execution
+  /// @details The query is rendered and prepared on the server once. The returned
+  /// PreparedQuery is called with one argument per Param, in the order the placeholders
+  /// appear in the SQL; the argument types are checked at compile time and the values are
+  /// written straight into the parameter buffers, without rendering the query again.
+  /// Values given with val() in the query stay fixed for every execution.
+  /// @note The prepared query must not outlive this connection
+  /// @tparam Query The query expression type
+  /// @param query The query expression to prepare
+  /// @return The prepared query or an error
+  template <query::ParameterizedQuery Query>
+  ConnectionResult<prepared_query_for_t<PreparedQuery, Query>> prepare(const Query& query) {
+    using Prepared = prepared_query_for_t<PreparedQuery, Query>;
+
+    query::SqlWriterLease writer(query::PlaceholderStyle::Numbered);
+    writer->set_typed_params(true);
+    query::render_to(*writer, query);
+
+    auto params = Prepared::Values::from_writer(*writer);
+    if (!params) {
+      return std::unexpected(params.error());
+    }
+
+    auto name = prepare_query_sql(writer->sql(), writer->param_types());
+    if (!name) {
+      return std::unexpected(name.error());
+    }
+    return Prepared(*this, std::move(*name), std::move(*params));
+  }
+
+  /// @brief Create a pipeline for sending several statements in one round trip
+  /// @note Include postgresql_pipeline.hpp to use the returned object
+  /// @return A new, empty pipeline bound to this connection
+  PostgreSQLPipeline pipeline();
+
+  /// @brief Execute a prepared statement once per parameter row using pipeline mode
+  /// @details All executions are sent in a single batch and share one implicit transaction:
+  /// if any row fails, none of them take effect. See PostgreSQLPipeline for details.
+  /// @param statement The prepared statement to execute
+  /// @param param_rows One vector of parameter values per execution
+  /// @return One ResultSet per parameter row, or the first error
+  ConnectionResult<std::vector<result::ResultSet>> execute_batch(
+      const PostgreSQLStatement& statement,
+      const std::vector<std::vector<std::string>>& param_rows);
+
+  /// @brief Enable the automatic prepared-statement cache for query expressions
+  /// @details Once enabled, execute(query) prepares each distinct rendered SQL string on first
+  /// use and runs it with PQexecPrepared afterwards, so the server parses and plans it only
+  /// once. The least recently used statement is deallocated when the cache is full. Raw SQL
+  /// passed to execute_raw() is never cached.
+  /// @param capacity Maximum number of statements kept prepared on this connection
+  void enable_statement_cache(size_t capacity = 256);
+
+  /// @brief Disable the prepared-statement cache and deallocate its statements
+  void disable_statement_cache();
+
+  /// @brief Check if the prepared-statement cache is enabled
+  /// @return True if execute(query) goes through the cache
+  bool statement_cache_enabled() const { return statement_cache_.has_value(); }
+
+  /// @brief Apply session settings and prepare statements in a single round trip
+  /// @details Settings this connection already set to the same value are skipped. The
+  /// statements are prepared into the statement cache, which is enabled if needed, so their
+  /// first execution is a cache hit.
+  /// @param setup The settings and statements
+  /// @return Result indicating success or failure
+  ConnectionResult<void> apply_session_setup(const SessionSetup& setup);
+
+  /// @brief Change a session setting, unless this connection already set it to the same value
+  /// @param name The setting, e.g. "statement_timeout"
+  /// @param value The new value
+  /// @return Result indicating success or failure
+  ConnectionResult<void> set_session(const std::string& name, const std::string& value);
+
+  /// @brief Get the value this connection set for a session setting
+  /// @return The value, or std::nullopt if it was not set through this connection or may have
+  /// been undone since, e.g. because it was set inside a transaction
+  std::optional<std::string> session_setting(const std::string& name) const;
+
+  /// @brief Forget the tracked session settings, e.g. after running RESET ALL
+  void clear_session_settings() { session_settings_.clear(); }
+
+  /// @brief Get the prepared-statement cache counters
+  /// @return Hit, miss, eviction and re-prepare counts, all zero if the cache is disabled
+  StatementCacheStats statement_cache_stats() const {
+    return statement_cache_ ? statement_cache_->stats() : StatementCacheStats{};
+  }
+
+  /// @brief Get the counts of the queries run on this connection
+  /// @return Statements executed, failed and cancelled since the connection was created
+  QueryStats query_stats() const { return query_stats_; }
+
+  /// @brief Ask the server to cancel the statement this connection is running
+  /// @details Waits until the server has received the request over a separate connection; the
+  /// statement then fails with SQLSTATE 57014. A request that arrives after the statement has
+  /// finished is ignored by the server.
+  /// @return True if the request was delivered
+  bool request_cancel();
+
   /// @brief Get direct access to the PostgreSQL connection
   /// @return The PGconn pointer
   PGconn* get_pg_conn() { return pg_conn_; }
@@ -153,10 +411,162 @@ public:
   static std::string convert_placeholders(const std::string& sql);
 
 private:
+  friend class PostgreSQLPipeline;
+  template <typename... Params>
+  friend class PreparedQuery;
+
+  /// @brief Applies the limits of one call to the statements it executes
+  class LimitScope {
+  public:
+    LimitScope(PostgreSQLConnection& connection, const QueryOptions& options);
+    ~LimitScope();
+
+    LimitScope(const LimitScope&) = delete;
+    LimitScope& operator=(const LimitScope&) = delete;
+
+    /// @brief Replace the error of a call stopped by its limits with query_cancelled_error
+    template <typename T>
+    ConnectionResult<T> finish(ConnectionResult<T> result) const {
+      if (result || !connection_.limit_reached_) {
+        return result;
+      }
+      return std::unexpected(limit_error());
+    }
+
+  private:
+    PostgreSQLConnection& connection_;
+    std::optional<QueryOptions> previous_;
+
+    /// @brief The error of a call stopped by its timeout, deadline or cancel token
+    ConnectionError limit_error() const;
+  };
+
+  /// @brief Progress of one wait for results within the limits of the call in progress
+  struct LimitedWait {
+    std::chrono::steady_clock::time_point deadline;
+    bool cancel_sent = false;
+  };
+
+  /// @brief A statement waiting to be sent with the next round trip, or part of a batch
+  struct DeferredStatement {
+    std::string sql;
+    std::vector<std::string> params;
+    query::ParamTypes types;
+  };
+
   std::string connection_string_;
   PGconn* pg_conn_ = nullptr;
   bool is_connected_ = false;
   bool in_transaction_ = false;
+  std::string deferred_begin_;  ///< BEGIN statement not sent yet, empty once sent
+  std::vector<DeferredStatement> deferred_;
+
+  std::optional<StatementCache> statement_cache_;
+  std::vector<std::string> stale_statements_;  ///< Cached statements still to be deallocated
+  size_t prepared_query_count_ = 0;            ///< Used to name statements of prepare()
+  /// Session settings this connection set outside a transaction, which are still in effect
+  std::unordered_map<std::string, std::string> session_settings_;
+  QueryStats query_stats_;
+  std::optional<QueryOptions> limits_;  ///< Limits of the call in progress, with a deadline
+  bool limit_reached_ = false;          ///< A statement of that call was stopped by them
+  PGcancel* cancel_ = nullptr;          ///< Cancel handle, created on first use
+
+  /// @brief Render query expressions with $n placeholders, which need no conversion
+  query::PlaceholderStyle placeholder_style() const override {
+    return query::PlaceholderStyle::Numbered;
+  }
+
+  /// @brief Send numbers, booleans and timestamps in binary with explicit type OIDs
+  bool uses_typed_params() const override { return true; }
+
+  /// @brief Route rendered queries through the statement cache when it is enabled
+  ConnectionResult<result::ResultSet> execute_query_sql(
+      const std::string& sql, const std::vector<std::string>& params,
+      const query::ParamTypes& types) override;
+
+  /// @brief Execute SQL with optionally typed parameters, without the statement cache
+  ConnectionResult<result::ResultSet> execute_params(const std::string& sql,
+                                                     const std::vector<std::string>& params,
+                                                     const query::ParamTypes& types);
+
+  /// @brief Execute a rendered query through the statement cache
+  ConnectionResult<result::ResultSet> execute_cached(const std::string& sql,
+                                                     const std::vector<std::string>& params,
+                                                     const query::ParamTypes& types);
+
+  /// @brief Prepare a rendered query under a new statement name
+  /// @return The statement name or an error
+  ConnectionResult<std::string> prepare_query_sql(const std::string& sql,
+                                                  const query::ParamTypes& types);
+
+  /// @brief Execute a statement created by prepare()
+  ConnectionResult<result::ResultSet> execute_prepared_query(
+      const std::string& name, const std::vector<std::string>& params,
+      const query::ParamTypes& types);
+
+  /// @brief Deallocate the statement of a destroyed PreparedQuery with the next prepare
+  void release_prepared_query(std::string name) { stale_statements_.push_back(std::move(name)); }
+
+  /// @brief Run a simple query, within the limits of the call in progress if there are any
+  PGresult* exec_simple(const char* sql);
+
+  /// @brief Wait for the result of a statement started by send, within the current limits
+  /// @details Sends a cancel request at the deadline or when the cancel token is triggered,
+  /// and closes the connection if the server does not answer it in time.
+  /// @param send Sends the statement with one of the PQsend functions
+  /// @return The last result of the statement, or nullptr if it failed to complete
+  PGresult* exec_limited(const std::function<bool()>& send);
+
+  /// @brief Check the current limits before sending a statement
+  /// @return True if they are already reached, which is recorded in limit_reached_
+  bool limits_expired();
+
+  /// @brief Start waiting for results within the current limits
+  /// @details Until end_limited_wait(), triggering the cancel token sends a cancel request.
+  LimitedWait begin_limited_wait();
+
+  /// @brief Wait until the socket is readable or a limit is reached
+  /// @details Sends a cancel request when a limit is reached, and closes the connection if the
+  /// server has not answered it within a grace period.
+  /// @param wait The wait started by begin_limited_wait()
+  /// @return False if the connection was closed
+  bool wait_for_input(LimitedWait& wait);
+
+  /// @brief Finish a wait started by begin_limited_wait() that did not close the connection
+  void end_limited_wait();
+
+  /// @brief Deallocate cached statements that were evicted or invalidated, in one round trip
+  void deallocate_stale_statements();
+
+  /// @brief Remove the statements waiting to be deallocated so a pipeline can send them
+  /// @return The statement names, or nothing while the transaction is aborted
+  std::vector<std::string> take_stale_statements();
+
+  /// @brief Prepare a statement; stale statements are deallocated in the same round trip
+  /// @return Result indicating success or failure
+  ConnectionResult<void> prepare_sql(const std::string& name, const std::string& sql,
+                                     const query::ParamTypes& types);
+
+  /// @brief Remove the deferred BEGIN and statements so they can be sent
+  /// @return The statements to send ahead of anything else, BEGIN first
+  std::vector<DeferredStatement> take_deferred_statements();
+
+  /// @brief Render a query expression for execute_multi(), with typed parameters
+  template <query::SqlExpr Query>
+  static DeferredStatement render_statement(const Query& query) {
+    static_assert(!query::ParameterizedQuery<Query>,
+                  "Queries with relx::param placeholders must be executed through prepare()");
+    query::SqlWriterLease writer(query::PlaceholderStyle::Numbered);
+    writer->set_typed_params(true);
+    query::render_to(*writer, query);
+    return DeferredStatement{.sql = writer->take_sql(),
+                             .params = writer->take_params(),
+                             .types = writer->take_param_types()};
+  }
+
+  /// @brief Send rendered statements in one pipeline and collect their results
+  ConnectionResult<std::vector<result::ResultSet>> execute_statements(
+      std::vector<DeferredStatement> statements);
 
   /// @brief Helper method to handle PGresult and convert to ConnectionResult
   /// @param result PGresult pointer to process
@@ -165,4 +575,62 @@ private:
   ConnectionResult<PGresult*> handle_pg_result(PGresult* result, int expected_status = -1);
 };
 
-}  // namespace relx::connection
\ No newline at end of file
+/// @brief A query prepared with PostgreSQLConnection::prepare()
+/// @details Calling the object executes the statement with new argument values. The statement
+/// is deallocated on the server with the connection's next prepared statement once the object
+/// is destroyed.
+/// @tparam Params The Param value types, in placeholder order
+template <typename... Params>
+class PreparedQuery {
+public:
+  using Values = PreparedParams<Params...>;
+
+  static constexpr size_t param_count = sizeof...(Params);
+
+  PreparedQuery(PostgreSQLConnection& connection, std::string name, Values params)
+      : connection_(&connection), name_(std::move(name)), params_(std::move(params)) {}
+
+  ~PreparedQuery() {
+    if (connection_) {
+      connection_->release_prepared_query(std::move(name_));
+    }
+  }
+
+  PreparedQuery(const PreparedQuery&) = delete;
+  PreparedQuery& operator=(const PreparedQuery&) = delete;
+
+  PreparedQuery(PreparedQuery&& other) noexcept
+      : connection_(std::exchange(other.connection_, nullptr)),
+        name_(std::move(other.name_)),
+        params_(std::move(other.params_)) {}
+
+  PreparedQuery& operator=(PreparedQuery&& other) noexcept {
+    if (this != &other) {
+      if (connection_) {
+        connection_->release_prepared_query(std::move(name_));
+      }
+      connection_ = std::exchange(other.connection_, nullptr);
+      name_ = std::move(other.name_);
+      params_ = std::move(other.params_);
+    }
+    return *this;
+  }
+
+  /// @brief Execute the prepared query
+  /// @param args One value per Param, in placeholder order
+  /// @return Result containing the query results or an error
+  ConnectionResult<result::ResultSet> operator()(const Params&... args) {
+    params_.bind(args...);
+    return connection_->execute_prepared_query(name_, params_.values(), params_.types());
+  }
+
+  /// @brief Get the name of the statement on the server
+  const std::string& name() const { return name_; }
+
+private:
+  PostgreSQLConnection* connection_;
+  std::string name_;
+  Values params_;
+};
+
+}  // namespace relx::connection
@@ -1,21 +1,125 @@
 #pragma once
 
+#include "metrics.hpp"
 #include "postgresql_connection.hpp"
 
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <format>
 #include <memory>
 #include <mutex>
 #include <optional>
-#include <queue>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
 namespace relx::connection {
 
+/// @brief How an idle connection is checked before the pool hands it out
+enum class ConnectionValidation : uint8_t {
+  /// Run SELECT 1 on every checkout; a full round trip each time
+  Always,
+  /// Check the status and socket on every checkout, and run SELECT 1 only if the connection has
+  /// not been known to work for longer than validation_idle_threshold
+  WhenIdle,
+  /// Only check the status and socket; a connection broken in a way that cannot be seen locally
+  /// is found when it is first used
+  Status,
+};
+
+/// @brief Which idle connection a checkout takes
+enum class IdleOrder : uint8_t {
+  /// The first idle connection found in the thread's shard; the cheapest scan
+  FirstFound,
+  /// The most recently returned idle connection in the thread's shard, so connections that
+  /// are not needed stay idle long enough to be closed after max_idle_time
+  Lifo,
+};
+
+/// @brief A class of callers with its own share of the pool, e.g. "api" or "batch"
+struct PriorityClass {
+  /// @brief Name passed to get_connection()
+  std::string name;
+
+  /// @brief Connections only this class may use; other classes never take them
+  size_t reserved = 0;
+
+  /// @brief Share of freed capacity this class gets while several classes are waiting
+  unsigned weight = 1;
+};
+
+/// @brief Limit on the connections checked out at once that adapts to observed latency
+/// @details Works like TCP Vegas. The shortest recent checkout is taken as the latency without
+/// queueing. When checkouts take longer, the excess is attributed to work queued in the
+/// database: the limit shrinks while more than beta checkouts are estimated to be queued, and
+/// grows while fewer than alpha are. The database is then kept near its throughput knee instead
+/// of being pushed to max_size concurrent queries.
+struct AdaptiveConcurrencyConfig {
+  /// @brief Whether the limit is applied
+  bool enabled = false;
+
+  /// @brief Lowest limit, and the limit at start if initial_limit is 0
+  size_t min_limit = 1;
+
+  /// @brief Limit at start, 0 for max_size
+  size_t initial_limit = 0;
+
+  /// @brief Grow the limit while fewer checkouts than this are estimated to be queued
+  double alpha = 3.0;
+
+  /// @brief Shrink the limit while more checkouts than this are estimated to be queued
+  double beta = 6.0;
+
+  /// @brief Number of checkouts after which the latency without queueing is measured afresh
+  uint32_t probe_interval = 1000;
+};
+
+/// @brief Policy that resizes the pool from observed checkout waits and utilisation
+/// @details The pool opens connections only up to a target size, between min_size and
+/// max_size. Every evaluation_interval the target grows by step if the p99 checkout wait of the
+/// interval exceeded target_wait. It shrinks by step once the peak number of connections in use
+/// has stayed below utilisation_threshold of the target for shrink_window; idle connections
+/// above the new target are closed.
+struct AutoscalingConfig {
+  /// @brief Whether the pool resizes itself
+  bool enabled = false;
+
+  /// @brief Lowest target size; max_size is the highest
+  size_t min_size = 1;
+
+  /// @brief p99 checkout wait above which the pool grows
+  std::chrono::milliseconds target_wait{5};
+
+  /// @brief Fraction of the target in use below which the pool may shrink
+  double utilisation_threshold = 0.5;
+
+  /// @brief Time between evaluations (ms)
+  std::chrono::milliseconds evaluation_interval{1000};
+
+  /// @brief How long utilisation must stay low before the pool shrinks (ms)
+  std::chrono::milliseconds shrink_window{30000};
+
+  /// @brief Connections added or removed per decision
+  size_t step = 1;
+
+  /// @brief Number of recent decisions kept for scaling_decisions()
+  size_t decision_history = 64;
+};
+
+/// @brief One resize made by the autoscaling policy
+struct ScalingDecision {
+  std::chrono::steady_clock::time_point time;
+  size_t from = 0;  ///< Target size before the decision
+  size_t to = 0;    ///< Target size after the decision
+  std::chrono::microseconds p99_wait{0};  ///< Upper bound of the p99 checkout wait
+  double utilisation = 0.0;  ///< Peak connections in use as a fraction of the old target
+};
+
 /// @brief Configuration for PostgreSQL connection pool
 struct PostgreSQLConnectionPoolConfig {
   /// @brief Connection parameters for PostgreSQL
@@ -33,8 +137,72 @@ struct PostgreSQLConnectionPoolConfig {
   /// @brief Whether to validate connections before returning them
   bool validate_connections = true;
 
+  /// @brief How connections are validated when validate_connections is set
+  /// @details With maintenance_thread, a checkout only checks the status and socket, as with
+  /// Status; the maintenance thread runs SELECT 1 on connections idle for longer than
+  /// validation_idle_threshold.
+  ConnectionValidation validation = ConnectionValidation::WhenIdle;
+
+  /// @brief Time after which WhenIdle validation, and validate_idle_connections(), do a round
+  /// trip (ms)
+  std::chrono::milliseconds validation_idle_threshold{1000};
+
   /// @brief Maximum idle time before a connection is closed (ms)
   std::chrono::milliseconds max_idle_time{60000};
+
+  /// @brief Number of idle shards, 0 for one per hardware thread
+  /// @details Each thread checks out from its own shard first and only scans the others when
+  /// that shard has no idle connection. The count is capped at max_size.
+  size_t shard_count = 0;
+
+  /// @brief Which idle connection a checkout takes
+  IdleOrder idle_order = IdleOrder::FirstFound;
+
+  /// @brief Whether a thread first tries to get back the connection it used last
+  /// @details Keeps a thread on the same backend, whose plan and statement caches are warm.
+  bool thread_affinity = false;
+
+  /// @brief Run housekeeping on a background thread instead of on caller threads
+  /// @details The thread closes expired idle connections, validates idle connections, keeps
+  /// min_idle connections open, opens connections for threads waiting in get_connection(),
+  /// and rolls back and resets returned connections. Checkout and return then never wait on
+  /// the network: a checkout that finds no idle connection, or only a broken one, waits for
+  /// the thread to open one instead of connecting.
+  bool maintenance_thread = false;
+
+  /// @brief Time between maintenance runs when nothing needs attention (ms)
+  std::chrono::milliseconds maintenance_interval{1000};
+
+  /// @brief Number of idle connections the maintenance thread keeps open, within max_size
+  size_t min_idle = 0;
+
+  /// @brief SQL run on every returned connection to reset its session, empty for none
+  /// @details For example "RESET ALL". Avoid "DISCARD ALL", which also drops the prepared
+  /// statements the connection has cached.
+  std::string reset_query;
+
+  /// @brief Session settings and statements applied to every new connection
+  /// @details Sent in one pipelined round trip right after connecting, so the first checkout
+  /// already finds its prepared statements warm. The settings are applied again after
+  /// reset_query runs.
+  SessionSetup session_setup;
+
+  /// @brief Priority classes for get_connection(priority_class)
+  /// @details Each class keeps its reserved connections for itself, and all classes share the
+  /// rest. When connections are freed while several classes wait, they are handed out in
+  /// proportion to the class weights. get_connection() without a class uses a default class
+  /// with no reservation and weight 1. The reservations must not add up to more than max_size.
+  std::vector<PriorityClass> priority_classes;
+
+  /// @brief Adaptive limit on the connections checked out at once
+  AdaptiveConcurrencyConfig adaptive_concurrency;
+
+  /// @brief Resize the pool between autoscaling.min_size and max_size from observed load
+  AutoscalingConfig autoscaling;
+
+  /// @brief Callback that receives metrics() periodically, from the maintenance thread if there
+  /// is one and otherwise from threads calling get_connection()
+  PoolMetricsSink metrics_sink;
 };
 
 /// @brief Error type for connection pool operations
@@ -43,6 +211,9 @@ struct ConnectionPoolError {
   int error_code = 0;
 };
 
+/// @brief error_code of the ConnectionPoolError returned when no connection became free in time
+inline constexpr int pool_timeout_error = static_cast<int>(PostgreSQLErrorCode::ConnectionTimeout);
+
 /**
  * @brief Format a ConnectionPoolError for exception messages
  */
@@ -58,12 +229,54 @@ using ConnectionPoolResult = std::expected<T, ConnectionPoolError>;
 class PostgreSQLConnectionPool;
 
 /// @brief PostgreSQL connection pool that manages a collection of PostgreSQL connections
+/// @details Connections live in a fixed array of slots, one per allowed connection, split into
+/// shards. Checking out claims an idle slot with a single compare-and-swap, starting in the
+/// calling thread's shard and stealing from the other shards when it is empty; returning a
+/// connection releases its slot the same way. The mutex is only taken by threads that have to
+/// wait because every connection is in use. With maintenance_thread set, connecting, resetting,
+/// validating and expiring connections all move to a background thread.
 class PostgreSQLConnectionPool : public std::enable_shared_from_this<PostgreSQLConnectionPool> {
 private:
-  /// @brief Internal structure for tracking idle connections in the pool
-  struct PoolEntry {
+  /// @brief Admission of one checkout, held until the connection is returned
+  struct Ticket {
+    size_t lane = 0;
+    bool reserved = false;  ///< Counted against the lane's reservation instead of shared capacity
+    std::chrono::steady_clock::rep admitted = 0;  ///< When the connection was handed out
+  };
+
+  /// @brief A priority class and its waiting threads
+  struct Lane {
+    std::string name;
+    size_t reserved = 0;
+    unsigned weight = 1;
+    std::atomic<size_t> reserved_used{0};
+    /// The following are guarded by pool_mutex_
+    std::condition_variable available;
+    size_t waiters = 0;
+    int64_t current_weight = 0;  ///< Smooth weighted round robin state
+  };
+
+  /// @brief State of a connection slot
+  enum class SlotState : uint8_t {
+    Empty,    ///< No connection; may be claimed to create one
+    Idle,     ///< Connected and available
+    InUse,    ///< Checked out, or being created or closed by the thread that claimed it
+    Resetting,  ///< Returned and waiting for the maintenance thread to reset it
+  };
+
+  /// @brief A place for one connection, padded so neighbouring slots do not share a cache line
+  struct alignas(64) Slot {
+    std::atomic<SlotState> state{SlotState::Empty};
+    /// Time the connection was last returned, in steady_clock ticks
+    std::atomic<std::chrono::steady_clock::rep> last_used{0};
+    /// Time the connection was last known to work: returned after use, or validated
+    std::atomic<std::chrono::steady_clock::rep> last_checked{0};
+    /// Only accessed by the thread that moved the state away from Idle or Empty
     std::shared_ptr<PostgreSQLConnection> connection;
-    std::chrono::steady_clock::time_point last_used;
+    /// Query counts of the connection as of its last return, zero while the slot is empty
+    std::atomic<uint64_t> queries{0};
+    std::atomic<uint64_t> query_errors{0};
+    std::atomic<uint64_t> query_timeouts{0};
   };
 
   /// @brief Constructor with pool configuration
@@ -96,13 +309,42 @@ public:
   PostgreSQLConnectionPool& operator=(PostgreSQLConnectionPool&&) = delete;
 
   /// @brief Initialize the connection pool
-  /// @return Result indicating success or failure
+  /// @details The initial connections are opened concurrently from the calling thread, each
+  /// with a non-blocking connect, and every connection can be checked out by other threads as
+  /// soon as it is ready. Connecting stops after connection_timeout.
+  /// @return Result indicating success, or the first connection error
   [[nodiscard]] ConnectionPoolResult<void> initialize();
 
+  /// @brief Get how long each connection opened by the last initialize() took to connect
+  /// @return One entry per successful connection, in the order they became ready
+  std::vector<std::chrono::microseconds> connect_latencies() const;
+
   /// @brief Get a connection from the pool with automatic return when out of scope
   /// @return Result containing a PooledConnection or an error
   [[nodiscard]] ConnectionPoolResult<PooledConnection> get_connection();
 
+  /// @brief Get a connection for a configured priority class
+  /// @param priority_class Name of one of the configured priority_classes
+  /// @return Result containing a PooledConnection or an error
+  [[nodiscard]] ConnectionPoolResult<PooledConnection> get_connection(
+      std::string_view priority_class);
+
+  /// @brief Get the current limit on connections checked out at once
+  /// @return The adaptive limit, or max_size if adaptive_concurrency is disabled
+  size_t concurrency_limit() const;
+
+  /// @brief Get the number of connections the pool currently opens at most
+  /// @return The autoscaling target, or max_size if autoscaling is disabled
+  size_t target_size() const;
+
+  /// @brief Get the most recent autoscaling decisions, oldest first
+  std::vector<ScalingDecision> scaling_decisions() const;
+
+  /// @brief Get a snapshot of the pool's counters and latency histograms
+  /// @details Recording is lock-free and per thread, so this is cheap to call periodically.
+  /// Query counts of a connection are taken when it is returned to the pool.
+  PoolMetrics metrics() const;
+
   /// @brief Get the current number of active connections
   /// @return The number of active connections
   size_t active_connections() const;
@@ -111,6 +353,12 @@ public:
   /// @return The number of idle connections
   size_t idle_connections() const;
 
+  /// @brief Validate idle connections that have not been used for validation_idle_threshold
+  /// @details Meant to be called periodically from a background task, so checkouts can use
+  /// the cheaper Status validation. Connections in use are skipped.
+  /// @return The number of broken connections that were closed
+  size_t validate_idle_connections();
+
   /// @brief Execute a function with a connection from the pool
   /// @tparam Func Type of the function to execute
   /// @param func Function to execute with a connection
@@ -140,26 +388,56 @@ public:
     }
   }
 
+  /// @brief Execute an idempotent function, retrying once if the connection turns out to be broken
+  /// @details A connection that broke while idle is often only noticed by the first query sent
+  /// on it. If func fails and its connection is no longer connected, the broken connection is
+  /// dropped and func is called again with another one. Only use this for work that is safe to
+  /// run twice, such as reads outside a transaction.
+  /// @tparam Func Function taking a PooledConnection& and returning a std::expected
+  /// @param func Function to execute with a connection
+  /// @return Result of the last call to func, or the error acquiring a connection
+  template <typename Func>
+  [[nodiscard]] auto with_idempotent_connection(Func&& func)
+      -> ConnectionPoolResult<std::invoke_result_t<Func, PooledConnection&>> {
+    for (int attempt = 0;; ++attempt) {
+      auto conn_result = get_connection();
+      if (!conn_result) {
+        return std::unexpected(conn_result.error());
+      }
+
+      auto result = func(*conn_result);
+      if (result || attempt > 0 || (*conn_result)->is_connected()) {
+        return result;
+      }
+      // The broken connection is discarded when conn_result goes out of scope
+    }
+  }
+
   /// @brief A wrapper for a connection that automatically returns it to the pool
   class PooledConnection {
   private:
     std::shared_ptr<PostgreSQLConnection> connection_;
     std::weak_ptr<PostgreSQLConnectionPool> pool_;
+    size_t slot_ = 0;
+    std::optional<Ticket> ticket_;
 
   public:
     /// @brief Constructor takes a connection and its parent pool
     /// @param connection The database connection
     /// @param pool The connection pool that owns this connection
+    /// @param slot The pool slot the connection is returned to
+    /// @param ticket The admission released when the connection is returned, if any
     PooledConnection(std::shared_ptr<PostgreSQLConnection> connection,
-                     const std::shared_ptr<PostgreSQLConnectionPool>& pool)
-        : connection_(std::move(connection)), pool_(pool) {}
+                     const std::shared_ptr<PostgreSQLConnectionPool>& pool, size_t slot,
+                     std::optional<Ticket> ticket = std::nullopt)
+        : connection_(std::move(connection)), pool_(pool), slot_(slot), ticket_(ticket) {}
 
     /// @brief Destructor automatically returns connection to pool if available
     ~PooledConnection() {
       if (connection_) {
         // Check if pool still exists
         if (auto pool = pool_.lock()) {
-          pool->return_connection(std::move(connection_));
+          pool->return_connection(slot_, std::move(connection_), ticket_);
         }
         // If pool no longer exists, connection will simply be destroyed
       }
@@ -188,17 +466,134 @@ private:
   std::atomic<size_t> active_connections_{0};
   std::atomic<size_t> total_connections_{0};
 
+  std::unique_ptr<Slot[]> slots_;
+  size_t shard_count_ = 1;
+  /// Distinguishes this pool in the per-thread record of the last slot used
+  uint64_t pool_id_ = 0;
+
+  /// Earliest time, in steady_clock ticks, at which idle connections are checked again
+  std::atomic<std::chrono::steady_clock::rep> next_cleanup_{0};
+
+  // Slow path for threads that found every slot in use
   mutable std::mutex pool_mutex_;
   std::condition_variable conn_available_;
-  std::queue<PoolEntry> idle_connections_;
+  std::atomic<size_t> waiters_{0};
+  std::vector<std::chrono::microseconds> connect_latencies_;  ///< Guarded by pool_mutex_
+
+  // Admission control, only used with priority classes or an adaptive concurrency limit
+  bool admission_enabled_ = false;
+  std::unique_ptr<Lane[]> lanes_;  ///< The default class first, then the configured ones
+  size_t lane_count_ = 0;
+  size_t total_reserved_ = 0;
+  std::atomic<size_t> shared_used_{0};
+  std::atomic<size_t> admission_waiters_{0};
+  std::atomic<size_t> limit_{0};
+  // Adaptive limit state, only updated by the thread holding limit_mutex_
+  std::mutex limit_mutex_;
+  std::chrono::steady_clock::rep no_load_latency_ = 0;
+  uint32_t samples_since_probe_ = 0;
+
+  PoolMetricsRecorder metrics_;
+
+  // Autoscaling, only used with config_.autoscaling.enabled
+  std::atomic<size_t> target_size_{0};
+  std::atomic<size_t> peak_active_{0};
+  std::atomic<std::chrono::steady_clock::rep> next_evaluation_{0};
+  std::mutex evaluation_mutex_;
+  std::chrono::steady_clock::rep low_since_ = 0;  ///< Guarded by evaluation_mutex_
+  HistogramSnapshot last_waits_;                  ///< Guarded by evaluation_mutex_
+  std::deque<ScalingDecision> decisions_;         ///< Guarded by pool_mutex_
+
+  // Background maintenance, only used with config_.maintenance_thread
+  std::thread maintenance_thread_;
+  std::mutex maintenance_mutex_;
+  std::condition_variable maintenance_cv_;
+  bool maintenance_pending_ = false;  ///< Guarded by maintenance_mutex_
+  std::atomic<bool> stopping_{false};
+
+  /// @brief A checked-out connection and its slot
+  struct Checkout {
+    size_t slot;
+    std::shared_ptr<PostgreSQLConnection> connection;
+    /// True if the connection was opened for this checkout and needs no validation
+    bool created = false;
+    std::optional<Ticket> ticket;
+  };
 
   /// @brief Get a raw connection from the pool
-  /// @return Result containing a connection pointer or an error
-  [[nodiscard]] ConnectionPoolResult<std::shared_ptr<PostgreSQLConnection>> get_raw_connection();
+  /// @param lane The priority class to admit the checkout under
+  /// @return Result containing the checked-out connection or an error
+  [[nodiscard]] ConnectionPoolResult<Checkout> get_raw_connection(size_t lane = 0);
+
+  /// @brief Wrap a checkout in a PooledConnection
+  ConnectionPoolResult<PooledConnection> make_pooled(ConnectionPoolResult<Checkout> checkout);
+
+  /// @brief Admit a checkout of a priority class, waiting until the deadline
+  /// @return The ticket, or std::nullopt if the deadline passed first
+  std::optional<Ticket> admit(size_t lane, std::chrono::steady_clock::time_point deadline);
+
+  /// @brief Take a reserved or shared place for a priority class without waiting
+  std::optional<Ticket> try_admit(size_t lane);
+
+  /// @brief Give back the place of a returned or failed checkout
+  void release_ticket(const Ticket& ticket);
+
+  /// @brief Wake a thread of the next priority class in weighted order that can be admitted
+  /// @note Requires pool_mutex_ to be held
+  void notify_admission_locked();
+
+  /// @brief Adjust the adaptive limit after a checkout that lasted the given time
+  void update_limit(std::chrono::steady_clock::rep latency);
+
+  /// @brief Record how long a checkout waited, for the metrics and for autoscaling
+  /// @param wait Time the checkout waited for its connection, or until it gave up
+  void record_checkout(std::chrono::steady_clock::duration wait);
+
+  /// @brief Pass metrics() to the sink if it is due, in at most one thread
+  void report_metrics();
+
+  /// @brief Add the queries a returned connection ran to the pool's counts
+  void count_queries(size_t slot, const PostgreSQLConnection& connection);
+
+  /// @brief Resize the pool if an evaluation is due, in at most one thread
+  void evaluate_autoscaling();
+
+  /// @brief Claim an idle connection, or an empty slot to connect, without blocking
+  /// @details Never touches the network, so it may be called under pool_mutex_. A claimed
+  /// empty slot comes back with created set and no connection; see connect_claimed().
+  /// @return The claimed slot, or std::nullopt if every slot is in use
+  [[nodiscard]] std::optional<Checkout> try_checkout();
+
+  /// @brief Open the connection of an empty slot claimed by try_checkout()
+  /// @details Releases the slot if the connection cannot be opened. Must not be called under
+  /// pool_mutex_, since connecting takes a network round trip.
+  /// @param checkout The checkout holding the claimed slot
+  /// @return Success, or the error of the failed connect
+  [[nodiscard]] ConnectionPoolResult<void> connect_claimed(Checkout& checkout);
+
+  /// @brief Claim the first slot in the given state, scanning the calling thread's shard first
+  /// @return The slot index, or std::nullopt if none was found
+  std::optional<size_t> claim_slot(SlotState from);
+
+  /// @brief Claim the most recently returned idle slot of a shard
+  /// @return The slot index, or std::nullopt if the shard has no idle slot
+  std::optional<size_t> claim_most_recent(size_t shard);
 
   /// @brief Return a connection to the pool
+  /// @param slot The slot the connection was checked out from
   /// @param connection The connection to return
-  void return_connection(std::shared_ptr<PostgreSQLConnection> connection);
+  /// @param ticket The admission of the checkout, if any
+  void return_connection(size_t slot, std::shared_ptr<PostgreSQLConnection> connection,
+                         const std::optional<Ticket>& ticket = std::nullopt);
+
+  /// @brief Mark a claimed slot as empty again after its connection was dropped
+  void release_slot(size_t slot);
+
+  /// @brief Close the connection of a claimed slot and mark the slot as empty
+  void close_slot(size_t slot);
+
+  /// @brief Wake one thread waiting for a connection, if there is any
+  void notify_waiter();
 
   /// @brief Create a new connection
   /// @return Result containing a connection pointer or an error
@@ -209,8 +604,27 @@ private:
   /// @return True if the connection is valid, false otherwise
   static bool validate_connection(const std::shared_ptr<PostgreSQLConnection>& connection);
 
-  /// @brief Clean up idle connections that have been idle for too long
+  /// @brief Check a checked-out connection according to the configured validation policy
+  bool validate_checkout(const Checkout& checkout) const;
+
+  /// @brief Close connections that have been idle for too long, at most once a second
   void cleanup_idle_connections();
+
+  /// @brief Roll back and reset a returned connection
+  /// @return True if the connection can be reused
+  bool reset_connection(PostgreSQLConnection& connection) const;
+
+  /// @brief Ask the maintenance thread to run now
+  void wake_maintenance();
+
+  /// @brief Body of the maintenance thread
+  void run_maintenance();
+
+  /// @brief Reset the connections returned since the last run
+  void reset_returned_connections();
+
+  /// @brief Open connections for waiting threads and to keep min_idle connections idle
+  void open_connections();
 };
 
 }  // namespace relx::connection
\ No newline at end of file
@@ -21,6 +21,7 @@ enum class PostgreSQLErrorCode {
   QueryFailed = 3000,
   InvalidParameters = 3001,
   EmptyResult = 3002,
+  QueryCancelled = 3003,  // stopped by its timeout, deadline or cancel token
 
   // SQLSTATE errors
   DuplicateKey = 23505,              // unique_violation
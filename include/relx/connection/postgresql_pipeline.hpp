@@ -0,0 +1,148 @@
+#pragma once
+
+#include "postgresql_connection.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace relx::connection {
+
+/// @brief A batch of statements sent to PostgreSQL using libpq pipeline mode
+/// @details Statements added to the pipeline are buffered locally and sent together when
+/// sync() is called, followed by a single synchronization point. The whole batch therefore
+/// costs one network round trip instead of one per statement.
+///
+/// Abort semantics: statements between two sync points run in one implicit transaction
+/// (unless the batch itself contains explicit BEGIN/COMMIT). If a statement fails, the server
+/// skips every following statement up to the sync point and rolls back the implicit
+/// transaction. sync() then returns the error of the first failing statement, with its index
+/// in the message, and no partial results.
+///
+/// If the connection has a deferred BEGIN or deferred statements (see
+/// PostgreSQLConnection::begin_transaction), they are sent at the front of the same batch and
+/// the pipeline runs inside that explicit transaction instead.
+///
+/// Prepared statements the connection has released since its last round trip (evicted from the
+/// statement cache, or of destroyed prepared queries) are deallocated in a segment of their own
+/// ahead of the batch. Their results are discarded, so they cost no extra round trip and a
+/// failed DEALLOCATE does not abort the batch.
+///
+/// sync() honours the limits of the connection call it runs in, e.g. execute_raw() with
+/// QueryOptions sending deferred statements: reading the results stops at the deadline or when
+/// the cancel token is triggered, the same way as for a single statement.
+///
+/// @note Statements without parameters are sent through the extended query protocol, so each
+/// entry must contain exactly one SQL statement.
+class PostgreSQLPipeline {
+public:
+  /// @brief Constructor
+  /// @param connection The connection the pipeline will be sent on
+  explicit PostgreSQLPipeline(PostgreSQLConnection& connection);
+
+  /// @brief Queue a query expression
+  /// @tparam Query The query expression type
+  /// @param query The query expression to queue
+  /// @return Reference to this pipeline for chaining
+  template <query::SqlExpr Query>
+  PostgreSQLPipeline& add(const Query& query) {
+    static_assert(!query::ParameterizedQuery<Query>,
+                  "Queries with relx::param placeholders must be executed through prepare()");
+    query::SqlWriterLease writer(query::PlaceholderStyle::Numbered);
+    writer->set_typed_params(true);
+    query::render_to(*writer, query);
+    return add_raw(writer->take_sql(), writer->take_params(), writer->take_param_types());
+  }
+
+  /// @brief Queue a raw SQL statement
+  /// @param sql The SQL statement with ? or $n placeholders
+  /// @param params Vector of parameter values
+  /// @param types Parameter type OIDs and formats; empty if all parameters are untyped text
+  /// @return Reference to this pipeline for chaining
+  PostgreSQLPipeline& add_raw(std::string sql, std::vector<std::string> params = {},
+                              query::ParamTypes types = {});
+
+  /// @brief Queue the execution of a statement prepared on the same connection
+  /// @param statement_name The name of the prepared statement
+  /// @param params Vector of parameter values
+  /// @param types Parameter type OIDs and formats; empty if all parameters are untyped text
+  /// @return Reference to this pipeline for chaining
+  PostgreSQLPipeline& add_prepared(std::string statement_name, std::vector<std::string> params,
+                                   query::ParamTypes types = {});
+
+  /// @brief Queue preparing a statement, which later entries in the same batch may execute
+  /// @param statement_name The name to prepare the statement under
+  /// @param sql The SQL text with $n placeholders
+  /// @param types Parameter type OIDs; empty to let the server infer every type
+  /// @return Reference to this pipeline for chaining
+  PostgreSQLPipeline& add_prepare(std::string statement_name, std::string sql,
+                                  query::ParamTypes types = {});
+
+  /// @brief Send all queued statements and wait for their results
+  /// @details The queue is cleared afterwards, whether or not the batch succeeded, so the
+  /// pipeline object can be reused.
+  /// @return One ResultSet per queued statement, in order, or the first error
+  ConnectionResult<std::vector<result::ResultSet>> sync();
+
+  /// @brief Get the number of queued statements
+  /// @return The number of statements waiting for sync()
+  size_t size() const { return entries_.size(); }
+
+  /// @brief Check if any statements are queued
+  /// @return True if nothing has been queued since the last sync()
+  bool empty() const { return entries_.empty(); }
+
+  /// @brief Discard all queued statements without sending them
+  void clear() { entries_.clear(); }
+
+private:
+  /// @brief What a queued entry does
+  enum class EntryKind : uint8_t {
+    Query,    ///< Execute SQL text
+    Execute,  ///< Execute a prepared statement
+    Prepare,  ///< Prepare a statement
+  };
+
+  /// @brief A single queued statement
+  struct PipelineEntry {
+    std::string sql;  ///< SQL text, or the statement name for Execute entries
+    std::vector<std::string> params;
+    query::ParamTypes types;
+    EntryKind kind = EntryKind::Query;
+    std::string statement_name;  ///< Name to prepare under, for Prepare entries
+  };
+
+  PostgreSQLConnection& connection_;
+  std::vector<PipelineEntry> entries_;
+  std::vector<std::string> released_;  ///< Statements deallocated ahead of the batch
+  /// Wait within the limits of the connection call in progress, if it has any
+  std::optional<PostgreSQLConnection::LimitedWait> wait_;
+  bool gave_up_ = false;  ///< The limits closed the connection during the last sync()
+
+  /// @brief Move the connection's deferred BEGIN and statements to the front of the queue
+  /// @return The number of entries that were prepended
+  size_t prepend_deferred_statements();
+
+  /// @brief Skip the results of the DEALLOCATE segment sent ahead of the batch
+  /// @return Result indicating whether the segment ended with its sync point
+  ConnectionResult<void> discard_released_results();
+
+  /// @brief Send every queued statement followed by a sync point
+  /// @return Result indicating success or failure
+  ConnectionResult<void> send_entries();
+
+  /// @brief Read one ResultSet per queued statement and the trailing sync result
+  /// @param deferred_count Number of leading entries whose results are dropped
+  /// @return The collected results or the first error
+  ConnectionResult<std::vector<result::ResultSet>> read_results(size_t deferred_count);
+
+  /// @brief Get the next result, waiting no longer than the limits of the call in progress
+  /// @return The result, or nullptr at the end of a statement or once gave_up_ is set
+  PGresult* next_result();
+
+  /// @brief The error of a batch stopped by its limits
+  static ConnectionError limit_error();
+};
+
+}  // namespace relx::connection
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "../query/select.hpp"
+#include "postgresql_connection_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace relx::connection {
+
+/// @brief Configuration for a pool that routes between a primary and its replicas
+struct PostgreSQLRoutingPoolConfig {
+  /// @brief Pool configuration for the primary
+  /// @details Each replica gets a pool with the same settings and its own connection_params.
+  PostgreSQLConnectionPoolConfig primary;
+
+  /// @brief Connection parameters for each replica
+  std::vector<PostgreSQLConnectionParams> replicas;
+
+  /// @brief Replicas lagging further behind the primary do not serve reads, std::nullopt for
+  /// no limit
+  std::optional<std::chrono::milliseconds> max_replication_lag;
+
+  /// @brief How often replica health, latency and replication lag are checked (ms)
+  std::chrono::milliseconds health_check_interval{1000};
+
+  /// @brief Weight of the newest sample in each replica's moving average latency, in (0, 1]
+  double latency_weight = 0.2;
+
+  /// @brief Serve reads from the primary when no replica is usable, instead of failing
+  bool fallback_to_primary = true;
+};
+
+/// @brief Health and load of one replica, as seen by the routing pool
+struct ReplicaStatus {
+  PostgreSQLConnectionParams params;
+  bool healthy = false;                     ///< Reachable and within max_replication_lag
+  std::chrono::microseconds latency{0};     ///< Moving average of query round trips
+  size_t in_flight = 0;                     ///< Connections currently checked out
+  std::chrono::milliseconds replication_lag{0};  ///< As of the last health check
+};
+
+/// @brief Connection pool that sends writes to a primary and reads to its replicas
+/// @details Every server gets its own PostgreSQLConnectionPool. A read goes to the healthy
+/// replica with the lowest moving-average latency multiplied by its connections in flight, so a
+/// slow or busy replica gets proportionally less traffic. Every health_check_interval, a
+/// background thread started by initialize() measures the latency and replication lag of all
+/// replicas, so no request waits on a health check.
+/// Replica connections set default_transaction_read_only, so a write routed there by mistake
+/// fails instead of silently landing on a server that does not replicate it back.
+class PostgreSQLRoutingPool : public std::enable_shared_from_this<PostgreSQLRoutingPool> {
+private:
+  /// @brief Pool and statistics of one replica, shared with the connections checked out of it
+  struct Replica {
+    PostgreSQLConnectionParams params;
+    std::shared_ptr<PostgreSQLConnectionPool> pool;
+    double latency_weight = 0.2;
+    std::atomic<bool> healthy{false};
+    std::atomic<int64_t> latency_ns{0};  ///< 0 until the first sample
+    std::atomic<size_t> in_flight{0};
+    std::atomic<int64_t> lag_ms{0};
+
+    /// @brief Fold a round trip time into the moving average
+    void record_latency(std::chrono::nanoseconds sample);
+  };
+
+  /// @brief Constructor with routing configuration
+  /// @param config Configuration for the primary and replica pools
+  explicit PostgreSQLRoutingPool(PostgreSQLRoutingPoolConfig config);
+
+public:
+  class RoutedConnection;
+
+  /// @brief Create a new routing pool
+  /// @param config Configuration for the primary and replica pools
+  /// @return Shared pointer to the new pool
+  static std::shared_ptr<PostgreSQLRoutingPool> create(PostgreSQLRoutingPoolConfig config) {
+    // Use new directly instead of make_shared to access the private constructor
+    return std::shared_ptr<PostgreSQLRoutingPool>(new PostgreSQLRoutingPool(std::move(config)));
+  }
+
+  /// @brief Destructor stops the health check thread
+  ~PostgreSQLRoutingPool();
+
+  PostgreSQLRoutingPool(const PostgreSQLRoutingPool&) = delete;
+  PostgreSQLRoutingPool& operator=(const PostgreSQLRoutingPool&) = delete;
+  PostgreSQLRoutingPool(PostgreSQLRoutingPool&&) = delete;
+  PostgreSQLRoutingPool& operator=(PostgreSQLRoutingPool&&) = delete;
+
+  /// @brief Initialize the primary and replica pools, check the replicas once and start the
+  /// health check thread
+  /// @details A replica that cannot be reached only stops serving reads until a later health
+  /// check succeeds.
+  /// @return Result indicating success, or the error initializing the primary
+  [[nodiscard]] ConnectionPoolResult<void> initialize();
+
+  /// @brief Get a connection to the primary, for writes and transactions
+  /// @return Result containing a PooledConnection or an error
+  [[nodiscard]] ConnectionPoolResult<PostgreSQLConnectionPool::PooledConnection> get_primary();
+
+  /// @brief Get a connection for read-only work from the least loaded healthy replica
+  /// @details Falls back to the primary if no replica is usable and fallback_to_primary is set.
+  /// @return Result containing a RoutedConnection or an error
+  [[nodiscard]] ConnectionPoolResult<RoutedConnection> get_replica();
+
+  /// @brief Execute a query, sending SELECT queries to a replica and all others to the primary
+  /// @details The round trip of each replica query feeds the replica's moving average latency.
+  /// Use get_primary() for transactions and for reads that must see the caller's own writes.
+  /// @tparam Query The query expression type
+  /// @param query The query to execute
+  /// @return Result containing the result set or an error
+  template <query::SqlExpr Query>
+  [[nodiscard]] ConnectionResult<result::ResultSet> execute(const Query& query) {
+    if constexpr (query::is_select_query_v<Query>) {
+      auto conn = get_replica();
+      if (!conn) {
+        return std::unexpected(ConnectionError{.message = conn.error().message,
+                                               .error_code = conn.error().error_code});
+      }
+      const auto start = std::chrono::steady_clock::now();
+      auto result = (*conn)->execute(query);
+      conn->observe(std::chrono::steady_clock::now() - start, result.has_value());
+      return result;
+    } else {
+      auto conn = get_primary();
+      if (!conn) {
+        return std::unexpected(ConnectionError{.message = conn.error().message,
+                                               .error_code = conn.error().error_code});
+      }
+      return (*conn)->execute(query);
+    }
+  }
+
+  /// @brief Measure the latency and replication lag of every replica now
+  /// @details Replicas whose connections are all in use keep their previous status.
+  /// @return The number of healthy replicas
+  size_t check_replicas();
+
+  /// @brief Get the health and load of every replica, in configuration order
+  std::vector<ReplicaStatus> replica_status() const;
+
+  /// @brief Get the pool of the primary
+  const std::shared_ptr<PostgreSQLConnectionPool>& primary_pool() const { return primary_; }
+
+  /// @brief A connection checked out for reads, from a replica or the primary as a fallback
+  class RoutedConnection {
+  private:
+    PostgreSQLConnectionPool::PooledConnection connection_;
+    std::shared_ptr<Replica> replica_;  ///< Null when served by the primary
+
+    friend class PostgreSQLRoutingPool;
+
+    /// @brief Record the round trip of a query sent on this connection
+    /// @param elapsed Time the query took
+    /// @param succeeded Whether it succeeded; a failure that broke the connection marks the
+    /// replica unhealthy until the next health check
+    void observe(std::chrono::nanoseconds elapsed, bool succeeded);
+
+  public:
+    /// @brief Constructor takes a pooled connection and the replica it belongs to
+    /// @param connection The pooled connection
+    /// @param replica The replica, already counting the connection as in flight, or null
+    RoutedConnection(PostgreSQLConnectionPool::PooledConnection connection,
+                     std::shared_ptr<Replica> replica)
+        : connection_(std::move(connection)), replica_(std::move(replica)) {}
+
+    /// @brief Destructor stops counting the connection as in flight and returns it to its pool
+    ~RoutedConnection() {
+      if (replica_) {
+        replica_->in_flight.fetch_sub(1, std::memory_order_relaxed);
+      }
+    }
+
+    RoutedConnection(const RoutedConnection&) = delete;
+    RoutedConnection& operator=(const RoutedConnection&) = delete;
+
+    RoutedConnection(RoutedConnection&&) = default;
+    RoutedConnection& operator=(RoutedConnection&&) = delete;
+
+    /// @brief Whether the connection is to a replica rather than the primary
+    bool is_replica() const { return replica_ != nullptr; }
+
+    /// @brief Forward -> operator to the underlying connection
+    PostgreSQLConnection* operator->() { return connection_.operator->(); }
+
+    /// @brief Forward const -> operator to the underlying connection
+    const PostgreSQLConnection* operator->() const { return connection_.operator->(); }
+
+    /// @brief Allow checking if connection is valid
+    explicit operator bool() const { return static_cast<bool>(connection_); }
+  };
+
+private:
+  PostgreSQLRoutingPoolConfig config_;
+  std::shared_ptr<PostgreSQLConnectionPool> primary_;
+  std::vector<std::shared_ptr<Replica>> replicas_;
+
+  /// Rotates the replica tried first, so equally good replicas share the load
+  std::atomic<size_t> next_replica_{0};
+
+  // Background health checks, started by initialize() when there are replicas
+  std::thread health_thread_;
+  std::mutex health_mutex_;
+  std::condition_variable health_cv_;
+  bool stopping_ = false;  ///< Guarded by health_mutex_
+
+  /// @brief Check the replicas every health_check_interval until the pool is destroyed
+  void run_health_checks();
+
+  /// @brief Measure one replica and update its status
+  void check_replica(Replica& replica) const;
+};
+
+}  // namespace relx::connection
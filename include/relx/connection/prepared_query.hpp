@@ -0,0 +1,110 @@
+#pragma once
+
+#include "../query/param.hpp"
+#include "../query/sql_writer.hpp"
+#include "connection.hpp"
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <typeinfo>
+#include <vector>
+
+namespace relx::connection {
+
+/// @brief Parameter values of a prepared query, laid out in placeholder order
+/// @details Holds the values the query was rendered with, which stay fixed, and remembers where
+/// each Param goes. Binding writes the arguments straight into those positions: types with a
+/// binary encoding are encoded in place, reusing the buffers of the previous execution.
+/// @tparam Params The Param value types, in placeholder order
+template <typename... Params>
+class PreparedParams {
+public:
+  static_assert(sizeof...(Params) > 0, "A prepared query needs at least one relx::param");
+
+  /// @brief Take the parameters of a rendered query and check them against Params
+  /// @details The compile-time parameter list is derived from the query type, so it only
+  /// disagrees with the rendered placeholders if a Param sits inside an expression that does
+  /// not render natively, or if a builder renders its parts out of declaration order.
+  /// @param writer A writer the query was rendered to with typed parameters
+  /// @return The parameters, or an error describing the mismatch
+  static ConnectionResult<PreparedParams> from_writer(const query::SqlWriter& writer) {
+    const auto& slots = writer.param_slots();
+    if (slots.size() != sizeof...(Params)) {
+      return std::unexpected(ConnectionError{
+          .message = "Prepared query renders " + std::to_string(slots.size()) +
+                     " parameters but its type declares " + std::to_string(sizeof...(Params)),
+          .error_code = -1});
+    }
+
+    const std::array<const std::type_info*, sizeof...(Params)> expected{&typeid(Params)...};
+    PreparedParams result;
+    for (size_t i = 0; i < slots.size(); ++i) {
+      if (*slots[i].type != *expected[i]) {
+        return std::unexpected(ConnectionError{
+            .message = "Parameter '" + std::string(slots[i].name) + "' is rendered at position " +
+                       std::to_string(i + 1) + ", where the query type declares a different type",
+            .error_code = -1});
+      }
+      result.slots_[i] = slots[i].index;
+    }
+
+    result.values_ = writer.params();
+    result.types_ = writer.param_types();
+    return result;
+  }
+
+  /// @brief Write the arguments of one execution into their parameter positions
+  /// @param args One value per Param, in placeholder order
+  void bind(const Params&... args) {
+    size_t i = 0;
+    (encode(args, values_[slots_[i++]]), ...);
+  }
+
+  /// @brief Get all parameter values, including those fixed when the query was rendered
+  const std::vector<std::string>& values() const { return values_; }
+
+  /// @brief Move the parameter values out, e.g. into a coroutine that outlives this object
+  std::vector<std::string> take_values() { return std::move(values_); }
+
+  /// @brief Get the parameter type OIDs and formats
+  const query::ParamTypes& types() const { return types_; }
+
+private:
+  std::vector<std::string> values_;
+  query::ParamTypes types_;
+  std::array<size_t, sizeof...(Params)> slots_{};
+
+  template <typename T>
+  static void encode(const T& value, std::string& out) {
+    if constexpr (schema::BinaryParamType<T>) {
+      out.clear();
+      schema::column_traits<T>::to_pg_binary(value, out);
+    } else if constexpr (std::convertible_to<const T&, std::string_view>) {
+      out.assign(std::string_view(value));
+    } else {
+      out = schema::column_traits<T>::to_sql_string(value);
+    }
+  }
+};
+
+/// @brief Instantiate a prepared query template with the Param types of a query
+/// @tparam Prepared The prepared query template, e.g. PreparedQuery
+/// @tparam ParamTuple A std::tuple of the Param value types
+template <template <typename...> class Prepared, typename ParamTuple>
+struct prepared_query_for;
+
+template <template <typename...> class Prepared, typename... Params>
+struct prepared_query_for<Prepared, std::tuple<Params...>> {
+  using type = Prepared<Params...>;
+};
+
+/// @tparam Query The query expression type
+template <template <typename...> class Prepared, typename Query>
+using prepared_query_for_t =
+    typename prepared_query_for<Prepared, query::param_types_t<Query>>::type;
+
+}  // namespace relx::connection
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "postgresql_errors.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace relx::connection {
+
+/// @brief error_code of the ConnectionError returned for a query stopped by its limits
+inline constexpr int query_cancelled_error = static_cast<int>(PostgreSQLErrorCode::QueryCancelled);
+
+/// @brief Cancels a running query from any thread
+/// @details Pass the token in QueryOptions. cancel() asks the server to stop the query running
+/// under the token, and calls started afterwards fail without reaching the server until
+/// reset() is called. A token serves one query at a time.
+class CancelToken {
+public:
+  /// @brief Cancel the query running under the token, if any, and the ones started later
+  void cancel() {
+    const std::lock_guard lock(mutex_);
+    cancelled_ = true;
+    if (canceller_) {
+      canceller_();
+    }
+  }
+
+  /// @brief Check if cancel() was called since the token was created or reset
+  bool is_cancelled() const {
+    const std::lock_guard lock(mutex_);
+    return cancelled_;
+  }
+
+  /// @brief Let queries run under the token again
+  void reset() {
+    const std::lock_guard lock(mutex_);
+    cancelled_ = false;
+  }
+
+  /// @brief Register how to stop the query that starts running under the token
+  /// @details Called by the connection running the query. The canceller is called at once if
+  /// the token is already cancelled, and otherwise by cancel() on the thread calling it.
+  void attach(std::function<void()> canceller) {
+    const std::lock_guard lock(mutex_);
+    canceller_ = std::move(canceller);
+    if (cancelled_) {
+      canceller_();
+    }
+  }
+
+  /// @brief Forget the canceller once its query has finished
+  /// @details Waits for a cancel() in progress, so the canceller can use the connection safely
+  void detach() {
+    const std::lock_guard lock(mutex_);
+    canceller_ = nullptr;
+  }
+
+private:
+  mutable std::mutex mutex_;
+  bool cancelled_ = false;
+  std::function<void()> canceller_;
+};
+
+/// @brief Limits of a single call
+/// @details A call that runs past its deadline or whose token is cancelled is cancelled on the
+/// server with a cancel request and fails with query_cancelled_error; the connection can be
+/// used again afterwards.
+struct QueryOptions {
+  /// Fail the call once it has run this long
+  std::optional<std::chrono::milliseconds> timeout;
+  /// Fail the call at this point in time, e.g. the deadline of the request being served
+  std::optional<std::chrono::steady_clock::time_point> deadline;
+  /// Cancels the call when triggered from any thread; not owned, null for none
+  CancelToken* cancel_token = nullptr;
+
+  /// @brief The earlier of deadline and now + timeout, or time_point::max() if neither is set
+  std::chrono::steady_clock::time_point expiry() const {
+    auto expiry = deadline.value_or(std::chrono::steady_clock::time_point::max());
+    if (timeout) {
+      expiry = std::min(expiry, std::chrono::steady_clock::now() + *timeout);
+    }
+    return expiry;
+  }
+
+  /// @brief Copy with the timeout turned into a deadline, so it counts from now
+  QueryOptions started() const { return {.deadline = expiry(), .cancel_token = cancel_token}; }
+
+  /// @brief Check if the options limit the call at all
+  bool limited() const { return timeout || deadline || cancel_token != nullptr; }
+};
+
+}  // namespace relx::connection
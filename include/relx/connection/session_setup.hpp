@@ -0,0 +1,55 @@
+#pragma once
+
+#include "../query/core.hpp"
+#include "../query/param.hpp"
+#include "../query/sql_writer.hpp"
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace relx::connection {
+
+/// @brief A statement prepared on new connections ahead of its first execution
+/// @details The SQL and parameter types must be exactly what the connection renders for the
+/// query, so build it with warm_statement().
+struct WarmStatement {
+  std::string sql;
+  query::ParamTypes types;
+};
+
+/// @brief Render a query the way PostgreSQL connections execute it
+/// @details Only the shape of the query matters: executing any query that renders to the same
+/// SQL with the same parameter types, whatever the values, reuses the warmed statement.
+/// @tparam Query The query expression type
+/// @param query A query with representative parameter values
+/// @return The statement to add to SessionSetup::statements
+template <query::SqlExpr Query>
+WarmStatement warm_statement(const Query& query) {
+  static_assert(!query::ParameterizedQuery<Query>,
+                "Queries with relx::param placeholders must be executed through prepare()");
+  query::SqlWriterLease writer(query::PlaceholderStyle::Numbered);
+  writer->set_typed_params(true);
+  query::render_to(*writer, query);
+  return WarmStatement{.sql = writer->take_sql(), .types = writer->take_param_types()};
+}
+
+/// @brief Work done on every new connection before a pool hands it out
+/// @details Everything is sent in one batch, so the first request on a new connection does not
+/// pay for SET statements and statement preparation.
+struct SessionSetup {
+  /// @brief Session settings as name and value, e.g. {"statement_timeout", "5s"}
+  std::vector<std::pair<std::string, std::string>> settings;
+
+  /// @brief Statements to prepare into the connection's statement cache
+  /// @note Enables the statement cache on the connection if it is not enabled yet
+  std::vector<WarmStatement> statements;
+
+  /// @brief Capacity of the statement cache enabled for statements
+  size_t statement_cache_capacity = 256;
+
+  bool empty() const { return settings.empty() && statements.empty(); }
+};
+
+}  // namespace relx::connection
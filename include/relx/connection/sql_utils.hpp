@@ -1,15 +1,23 @@
 #pragma once
 
+#include "../query/sql_writer.hpp"
+
 #include <string>
+#include <vector>
 
 // Forward declarations
 namespace relx::result {
 class ResultSet;
 }
+namespace relx::connection {
+struct QueryStats;
+}
 
 // Forward declare PostgreSQL types to avoid libpq header dependency
 struct pg_result;
 using PGresult = pg_result;
+struct pg_conn;
+using PGconn = pg_conn;
 
 namespace relx::connection::sql_utils {
 
@@ -23,15 +31,52 @@ namespace relx::connection::sql_utils {
 /// @return SQL string with $1, $2, etc. placeholders
 std::string convert_placeholders_to_postgresql(const std::string& sql);
 
+/// @brief Bind parameters laid out the way libpq's PQexecParams family expects them
+/// @details Text-only parameter lists leave the type, length and format arrays null, so the
+/// server infers every type. The object points into the parameter vectors it was built from,
+/// which must outlive it.
+struct PgParams {
+  std::vector<const char*> values;
+  std::vector<int> lengths;
+  const unsigned int* types = nullptr;  ///< libpq Oid array, or null
+  const int* formats = nullptr;         ///< 1 for binary parameters, or null if all are text
+
+  int count() const { return static_cast<int>(values.size()); }
+  const char* const* value_data() const { return values.empty() ? nullptr : values.data(); }
+  const int* length_data() const { return lengths.empty() ? nullptr : lengths.data(); }
+};
+
+/// @brief Lay out bind parameters for libpq
+/// @param params The parameter values, text or binary
+/// @param types Their type OIDs and formats; empty if every parameter is untyped text
+/// @return Pointers to pass to PQexecParams, PQsendQueryParams or PQsendQueryPrepared
+PgParams make_pg_params(const std::vector<std::string>& params,
+                        const query::ParamTypes& types = {});
+
 /// @brief Convert IsolationLevel enum to PostgreSQL isolation level string
 /// @param isolation_level The isolation level enum value (cast from IsolationLevel)
 /// @return PostgreSQL-compatible isolation level string
 std::string isolation_level_to_postgresql_string(int isolation_level);
 
+/// @brief Build one statement that applies several session settings
+/// @param count Number of settings
+/// @return "SELECT set_config($1, $2, false), ..." taking each name and value as parameters
+std::string set_config_sql(size_t count);
+
 /// @brief Process PostgreSQL result into relx ResultSet format
 /// @param pg_result Pointer to PGresult from libpq
 /// @param convert_bytea Whether to convert BYTEA columns from hex to binary
 /// @return ResultSet containing the processed data
 result::ResultSet process_postgresql_result(PGresult* pg_result, bool convert_bytea = false);
 
+/// @brief Count the outcome of a statement
+/// @param stats The counters of the connection that ran it
+/// @param pg_result Its result, or null if the statement could not be sent or read
+void count_query(QueryStats& stats, const PGresult* pg_result);
+
+/// @brief Discard the results of a running query that have already arrived, without waiting
+/// @param pg_conn Connection whose query is being abandoned
+/// @return True if the query has finished, so there is nothing left to cancel
+bool discard_available_results(PGconn* pg_conn);
+
 }  // namespace relx::connection::sql_utils
\ No newline at end of file
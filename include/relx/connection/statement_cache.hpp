@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace relx::connection {
+
+/// @brief Counters describing how well a prepared-statement cache is doing
+struct StatementCacheStats {
+  uint64_t hits = 0;        ///< Executions that reused an already prepared statement
+  uint64_t misses = 0;      ///< Executions that had to prepare a new statement
+  uint64_t evictions = 0;   ///< Statements deallocated to make room for new ones
+  uint64_t reprepares = 0;  ///< Statements prepared again after the server invalidated them
+
+  /// @brief Fraction of executions served by an already prepared statement
+  /// @return A value between 0 and 1, or 0 if nothing was executed yet
+  double hit_rate() const {
+    const uint64_t total = hits + misses;
+    return total == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(total);
+  }
+};
+
+/// @brief LRU map from rendered SQL text to the name of a server-side prepared statement
+/// @details The cache only does the bookkeeping; the owning connection prepares, executes and
+/// deallocates the statements. It is used by both the synchronous and asynchronous connections.
+class StatementCache {
+public:
+  /// @brief Result of looking up a SQL string
+  struct Entry {
+    std::string name;                    ///< Name of the prepared statement to execute
+    bool needs_prepare = false;          ///< True if the statement was just added to the cache
+    std::optional<std::string> evicted;  ///< Statement that must be deallocated, if any
+  };
+
+  /// @brief Constructor
+  /// @param capacity Maximum number of prepared statements kept per connection
+  explicit StatementCache(size_t capacity) : capacity_(capacity == 0 ? 1 : capacity) {}
+
+  /// @brief Look up the statement for a SQL string, adding it as most recently used
+  /// @param sql The SQL text, or a key built by key_for()
+  /// @return The statement name and what the caller has to do before executing it
+  Entry acquire(const std::string& sql) {
+    if (auto it = index_.find(sql); it != index_.end()) {
+      lru_.splice(lru_.begin(), lru_, it->second);
+      ++stats_.hits;
+      return Entry{.name = it->second->second, .needs_prepare = false, .evicted = std::nullopt};
+    }
+
+    ++stats_.misses;
+    Entry entry{.name = "relx_cached_" + std::to_string(next_id_++), .needs_prepare = true};
+
+    if (lru_.size() >= capacity_) {
+      entry.evicted = std::move(lru_.back().second);
+      index_.erase(lru_.back().first);
+      lru_.pop_back();
+      ++stats_.evictions;
+    }
+
+    lru_.emplace_front(sql, entry.name);
+    index_.emplace(sql, lru_.begin());
+    return entry;
+  }
+
+  /// @brief Forget a SQL string, e.g. because preparing it failed
+  /// @param sql The SQL text to remove
+  void erase(const std::string& sql) {
+    if (auto it = index_.find(sql); it != index_.end()) {
+      lru_.erase(it->second);
+      index_.erase(it);
+    }
+  }
+
+  /// @brief Forget every statement, e.g. after the connection was closed
+  void clear() {
+    lru_.clear();
+    index_.clear();
+  }
+
+  /// @brief Count a statement that had to be prepared again
+  void record_reprepare() { ++stats_.reprepares; }
+
+  /// @brief Get the names of every cached statement
+  /// @return Statement names, most recently used first
+  std::vector<std::string> names() const {
+    std::vector<std::string> result;
+    result.reserve(lru_.size());
+    for (const auto& [sql, name] : lru_) {
+      result.push_back(name);
+    }
+    return result;
+  }
+
+  size_t size() const { return lru_.size(); }
+  size_t capacity() const { return capacity_; }
+  const StatementCacheStats& stats() const { return stats_; }
+
+  /// @brief Build the cache key for SQL executed with parameters of the given types
+  /// @details A statement is prepared for specific parameter types, so the same text executed
+  /// with e.g. int4 and int8 parameters needs two statements.
+  /// @param sql The SQL text
+  /// @param oids The parameter type OIDs, empty if the server infers every type
+  /// @return The key to pass to acquire() and erase()
+  static std::string key_for(const std::string& sql, const std::vector<unsigned int>& oids) {
+    if (oids.empty()) {
+      return sql;
+    }
+
+    // The SQL text never contains a NUL byte, so it cleanly separates text and types
+    std::string key;
+    key.reserve(sql.size() + 1 + oids.size() * sizeof(unsigned int));
+    key.append(sql);
+    key.push_back('\0');
+    key.append(reinterpret_cast<const char*>(oids.data()), oids.size() * sizeof(unsigned int));
+    return key;
+  }
+
+  /// @brief Check if an execution error means the cached statement must be prepared again
+  /// @param sqlstate The SQLSTATE of the error
+  /// @param message The error message
+  /// @return True for "cached plan must not change result type" (the table changed under the
+  /// statement) and for statements that no longer exist on the server (e.g. after DISCARD ALL)
+  static bool is_stale_statement_error(std::string_view sqlstate, std::string_view message) {
+    return sqlstate == "26000" ||
+           (sqlstate == "0A000" &&
+            message.find("cached plan must not change result type") != std::string_view::npos);
+  }
+
+private:
+  using LruList = std::list<std::pair<std::string, std::string>>;  // SQL text, statement name
+
+  size_t capacity_;
+  uint64_t next_id_ = 0;
+  LruList lru_;
+  std::unordered_map<std::string, LruList::iterator> index_;
+  StatementCacheStats stats_;
+};
+
+}  // namespace relx::connection
@@ -11,8 +11,11 @@
 #include "query/insert.hpp"
 #include "query/literals.hpp"
 #include "query/operators.hpp"
+#include "query/param.hpp"
 #include "query/schema_adapter.hpp"
 #include "query/select.hpp"
+#include "query/shape.hpp"
+#include "query/sql_writer.hpp"
 #include "query/update.hpp"
 #include "query/value.hpp"
 
@@ -131,6 +134,7 @@ using query::like;
 using query::max;
 using query::min;
 using query::on;
+using query::param;
 using query::select;
 using query::select_expr;
 using query::sum;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "core.hpp"
+#include "sql_writer.hpp"
 
 #include <iostream>
 #include <memory>
@@ -54,6 +55,18 @@ public:
 
   const Column& column() const { return col_; }
 
+  void render(SqlWriter& writer) const {
+    using parent_table = typename Column::table_type;
+    const std::string_view table = parent_table::table_name;
+    if (!table.empty()) {
+      writer.append(table).append('.');
+    }
+    writer.append(Column::name);
+  }
+
+  /// @brief Column and table names are part of the type, so nothing is appended
+  void append_shape(std::string& /*key*/) const {}
+
 private:
   const Column& col_;
 };
@@ -86,6 +99,11 @@ public:
 
   std::vector<std::string> bind_params() const override { return expr_->bind_params(); }
 
+  void render(SqlWriter& writer) const {
+    render_to(writer, *expr_);
+    writer.append(" AS ").append(alias_);
+  }
+
   std::string column_name() const override { return alias_; }
 
   std::string table_name() const override { return ""; }
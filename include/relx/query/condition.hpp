@@ -3,6 +3,8 @@
 #include "column_expression.hpp"
 #include "core.hpp"
 #include "schema_adapter.hpp"
+#include "shape.hpp"
+#include "sql_writer.hpp"
 
 #include <memory>
 #include <sstream>
@@ -18,17 +20,25 @@ public:
   BinaryCondition(Left left, std::string op, Right right)
       : left_(std::move(left)), op_(std::move(op)), right_(std::move(right)) {}
 
-  std::string to_sql() const override {
-    std::stringstream ss;
-    ss << "(" << left_.to_sql() << " " << op_ << " " << right_.to_sql() << ")";
-    return ss.str();
+  std::string to_sql() const override { return rendered_sql(*this); }
+
+  std::vector<std::string> bind_params() const override { return rendered_params(*this); }
+
+  void render(SqlWriter& writer) const {
+    writer.append('(');
+    render_to(writer, left_);
+    writer.append(' ').append(op_).append(' ');
+    render_to(writer, right_);
+    writer.append(')');
   }
 
-  std::vector<std::string> bind_params() const override {
-    auto left_params = left_.bind_params();
-    auto right_params = right_.bind_params();
-    left_params.insert(left_params.end(), right_params.begin(), right_params.end());
-    return left_params;
+  /// @brief The operator is chosen at runtime, so it is part of the shape key
+  void append_shape(std::string& key) const
+    requires StaticShapeExpr<Left> && StaticShapeExpr<Right>
+  {
+    left_.append_shape(key);
+    append_shape_text(key, op_);
+    right_.append_shape(key);
   }
 
 private:
@@ -92,27 +102,22 @@ class TypedInCondition : public SqlExpression {
 public:
   TypedInCondition(Expr expr, Range values) : expr_(std::move(expr)), values_(std::move(values)) {}
 
-  std::string to_sql() const override {
-    std::stringstream ss;
-    ss << expr_.to_sql() << " IN (";
+  std::string to_sql() const override { return rendered_sql(*this); }
+
+  std::vector<std::string> bind_params() const override { return rendered_params(*this); }
+
+  void render(SqlWriter& writer) const {
+    render_to(writer, expr_);
+    writer.append(" IN (");
     bool first = true;
-    for (const auto& _ : values_) {
+    for (const auto& value : values_) {
       if (!first) {
-        ss << ", ";
+        writer.append(", ");
       }
-      ss << "?";
+      writer.param(value);
       first = false;
     }
-    ss << ")";
-    return ss.str();
-  }
-
-  std::vector<std::string> bind_params() const override {
-    auto params = expr_.bind_params();
-    for (const auto& value : values_) {
-      params.push_back(value);
-    }
-    return params;
+    writer.append(')');
   }
 
 private:
@@ -152,27 +157,22 @@ class InCondition : public SqlExpression {
 public:
   InCondition(Expr expr, Range values) : expr_(std::move(expr)), values_(std::move(values)) {}
 
-  std::string to_sql() const override {
-    std::stringstream ss;
-    ss << expr_.to_sql() << " IN (";
+  std::string to_sql() const override { return rendered_sql(*this); }
+
+  std::vector<std::string> bind_params() const override { return rendered_params(*this); }
+
+  void render(SqlWriter& writer) const {
+    render_to(writer, expr_);
+    writer.append(" IN (");
     bool first = true;
-    for (const auto& _ : values_) {
+    for (const auto& value : values_) {
       if (!first) {
-        ss << ", ";
+        writer.append(", ");
       }
-      ss << "?";
+      writer.param(value);
       first = false;
     }
-    ss << ")";
-    return ss.str();
-  }
-
-  std::vector<std::string> bind_params() const override {
-    auto params = expr_.bind_params();
-    for (const auto& value : values_) {
-      params.push_back(value);
-    }
-    return params;
+    writer.append(')');
   }
 
 private:
@@ -199,12 +199,19 @@ public:
   LikeCondition(Expr expr, std::string pattern)
       : expr_(std::move(expr)), pattern_(std::move(pattern)) {}
 
-  std::string to_sql() const override { return expr_.to_sql() + " LIKE ?"; }
+  std::string to_sql() const override { return rendered_sql(*this); }
+
+  std::vector<std::string> bind_params() const override { return rendered_params(*this); }
 
-  std::vector<std::string> bind_params() const override {
-    auto params = expr_.bind_params();
-    params.push_back(pattern_);
-    return params;
+  void render(SqlWriter& writer) const {
+    render_to(writer, expr_);
+    writer.append(" LIKE ").param(pattern_);
+  }
+
+  void append_shape(std::string& key) const
+    requires StaticShapeExpr<Expr>
+  {
+    expr_.append_shape(key);
   }
 
 private:
@@ -229,13 +236,19 @@ public:
   BetweenCondition(Expr expr, std::string lower, std::string upper)
       : expr_(std::move(expr)), lower_(std::move(lower)), upper_(std::move(upper)) {}
 
-  std::string to_sql() const override { return expr_.to_sql() + " BETWEEN ? AND ?"; }
+  std::string to_sql() const override { return rendered_sql(*this); }
+
+  std::vector<std::string> bind_params() const override { return rendered_params(*this); }
+
+  void render(SqlWriter& writer) const {
+    render_to(writer, expr_);
+    writer.append(" BETWEEN ").param(lower_).append(" AND ").param(upper_);
+  }
 
-  std::vector<std::string> bind_params() const override {
-    auto params = expr_.bind_params();
-    params.push_back(lower_);
-    params.push_back(upper_);
-    return params;
+  void append_shape(std::string& key) const
+    requires StaticShapeExpr<Expr>
+  {
+    expr_.append_shape(key);
   }
 
 private:
@@ -261,9 +274,20 @@ class IsNullCondition : public SqlExpression {
 public:
   explicit IsNullCondition(Expr expr) : expr_(std::move(expr)) {}
 
-  std::string to_sql() const override { return expr_.to_sql() + " IS NULL"; }
+  std::string to_sql() const override { return rendered_sql(*this); }
 
-  std::vector<std::string> bind_params() const override { return expr_.bind_params(); }
+  std::vector<std::string> bind_params() const override { return rendered_params(*this); }
+
+  void render(SqlWriter& writer) const {
+    render_to(writer, expr_);
+    writer.append(" IS NULL");
+  }
+
+  void append_shape(std::string& key) const
+    requires StaticShapeExpr<Expr>
+  {
+    expr_.append_shape(key);
+  }
 
 private:
   Expr expr_;
@@ -284,9 +308,20 @@ class IsNotNullCondition : public SqlExpression {
 public:
   explicit IsNotNullCondition(Expr expr) : expr_(std::move(expr)) {}
 
-  std::string to_sql() const override { return expr_.to_sql() + " IS NOT NULL"; }
+  std::string to_sql() const override { return rendered_sql(*this); }
 
-  std::vector<std::string> bind_params() const override { return expr_.bind_params(); }
+  std::vector<std::string> bind_params() const override { return rendered_params(*this); }
+
+  void render(SqlWriter& writer) const {
+    render_to(writer, expr_);
+    writer.append(" IS NOT NULL");
+  }
+
+  void append_shape(std::string& key) const
+    requires StaticShapeExpr<Expr>
+  {
+    expr_.append_shape(key);
+  }
 
 private:
   Expr expr_;
@@ -307,9 +342,21 @@ class NotCondition : public SqlExpression {
 public:
   explicit NotCondition(Expr expr) : expr_(std::move(expr)) {}
 
-  std::string to_sql() const override { return "(NOT " + expr_.to_sql() + ")"; }
+  std::string to_sql() const override { return rendered_sql(*this); }
 
-  std::vector<std::string> bind_params() const override { return expr_.bind_params(); }
+  std::vector<std::string> bind_params() const override { return rendered_params(*this); }
+
+  void render(SqlWriter& writer) const {
+    writer.append("(NOT ");
+    render_to(writer, expr_);
+    writer.append(')');
+  }
+
+  void append_shape(std::string& key) const
+    requires StaticShapeExpr<Expr>
+  {
+    expr_.append_shape(key);
+  }
 
 private:
   Expr expr_;
@@ -4,6 +4,8 @@
 #include "condition.hpp"
 #include "core.hpp"
 #include "operators.hpp"
+#include "shape.hpp"
+#include "sql_writer.hpp"
 #include "value.hpp"
 
 #include <memory>
@@ -31,37 +33,36 @@ public:
   explicit DeleteQuery(Table table, Where where = std::nullopt)
       : table_(std::move(table)), where_(std::move(where)) {}
 
+  /// @brief Whether the SQL text depends only on the query type and its shape key
+  /// @details True when no part of the query has unbounded runtime structure (see
+  /// StaticShapeExpr). Such queries render their SQL once per shape and thread.
+  static constexpr bool has_static_shape = is_static_shape_v<Where>;
+
   /// @brief Generate the SQL for this DELETE query
   /// @return The SQL string
-  std::string to_sql() const {
-    std::stringstream ss;
-    ss << "DELETE FROM " << table_.table_name;
-
-    // Add WHERE clause
-    if constexpr (!std::is_same_v<Where, std::nullopt_t>) {
-      if (where_.has_value()) {
-        ss << " WHERE " << where_.value().to_sql();
-      }
+  std::string to_sql() const { return rendered_sql(*this); }
+
+  /// @brief Write the SQL and bind parameters of this query to a writer
+  /// @param writer The writer to append to
+  void render(SqlWriter& writer) const {
+    if constexpr (has_static_shape) {
+      render_memoised(writer, *this, [this](SqlWriter& w) { render_clauses(w); });
+    } else {
+      render_clauses(writer);
     }
+  }
 
-    return ss.str();
+  /// @brief Append the runtime choices that affect the SQL text to a shape key
+  /// @param key The shape key being built
+  void append_shape(std::string& key) const
+    requires has_static_shape
+  {
+    append_shape_of(key, where_);
   }
 
   /// @brief Get the bind parameters for this DELETE query
   /// @return Vector of bind parameters
-  std::vector<std::string> bind_params() const {
-    std::vector<std::string> params;
-
-    // Collect parameters from WHERE clause
-    if constexpr (!std::is_same_v<Where, std::nullopt_t>) {
-      if (where_.has_value()) {
-        auto where_params = where_.value().bind_params();
-        params.insert(params.end(), where_params.begin(), where_params.end());
-      }
-    }
-
-    return params;
-  }
+  std::vector<std::string> bind_params() const { return rendered_params(*this); }
 
   /// @brief Add a WHERE clause to the query
   /// @tparam Condition The condition type
@@ -87,6 +88,19 @@ public:
   }
 
 private:
+  // Write every clause in one pass; render() memoises the text for static shapes
+  void render_clauses(SqlWriter& writer) const {
+    writer.append("DELETE FROM ").append(table_.table_name);
+
+    // Add WHERE clause
+    if constexpr (!std::is_same_v<Where, std::nullopt_t>) {
+      if (where_.has_value()) {
+        writer.append(" WHERE ");
+        render_to(writer, where_.value());
+      }
+    }
+  }
+
   Table table_;
   Where where_;
 };
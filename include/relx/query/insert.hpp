@@ -4,6 +4,8 @@
 #include "core.hpp"
 #include "meta.hpp"
 #include "select.hpp"
+#include "shape.hpp"
+#include "sql_writer.hpp"
 #include "value.hpp"
 
 #include <iostream>
@@ -52,113 +54,48 @@ private:
   SelectStmt select_;
   ReturningColumns returning_columns_;
 
-  // Helper to convert a tuple of column references to column names for INSERT
-  std::string columns_to_sql() const {
-    std::stringstream ss;
-    ss << "(";
-    int i = 0;
-    std::apply(
-        [&](const auto&... cols) { ((ss << (i++ > 0 ? ", " : "") << cols.column_name()), ...); },
-        columns_);
-    ss << ")";
-    return ss.str();
-  }
-
-  // Helper to convert a tuple of values to SQL for a single row VALUES clause
-  template <typename ValueTuple>
-  std::string values_row_to_sql(const ValueTuple& value_tuple) const {
-    std::stringstream ss;
-    ss << "(";
-    int i = 0;
-    std::apply([&](const auto&... vals) { ((ss << (i++ > 0 ? ", " : "") << vals.to_sql()), ...); },
-               value_tuple);
-    ss << ")";
-    return ss.str();
-  }
-
-  // Helper to convert a tuple of value tuples to SQL for the VALUES clause
-  std::string values_to_sql() const {
-    std::stringstream ss;
-    ss << "VALUES ";
-    int i = 0;
-    std::apply(
-        [&](const auto&... value_tuples) {
-          ((ss << (i++ > 0 ? ", " : "") << values_row_to_sql(value_tuples)), ...);
-        },
-        values_);
-    return ss.str();
-  }
-
-  // Helper to collect bind parameters from a tuple of values
-  template <typename ValueTuple>
-  std::vector<std::string> values_row_bind_params(const ValueTuple& value_tuple) const {
-    std::vector<std::string> params;
-
-    std::apply(
-        [&](const auto&... vals) {
-          auto process_val = [&params](const auto& val) {
-            auto val_params = val.bind_params();
-            params.insert(params.end(), val_params.begin(), val_params.end());
-          };
-
-          (process_val(vals), ...);
-        },
-        value_tuple);
+  // Write every clause in one pass; render() memoises the text for static shapes
+  void render_clauses(SqlWriter& writer) const {
+    writer.append("INSERT INTO ").append(table_.table_name);
 
-    return params;
-  }
-
-  // Helper to collect bind parameters from a tuple of value tuples
-  std::vector<std::string> values_bind_params() const {
-    std::vector<std::string> params;
-
-    std::apply(
-        [&](const auto&... value_tuples) {
-          auto process_tuple = [&params, this](const auto& tuple) {
-            auto tuple_params = values_row_bind_params(tuple);
-            params.insert(params.end(), tuple_params.begin(), tuple_params.end());
-          };
-
-          (process_tuple(value_tuples), ...);
-        },
-        values_);
-
-    return params;
-  }
-
-  // Helper to convert the RETURNING clause to SQL
-  std::string returning_to_sql() const {
-    if constexpr (is_empty_tuple<ReturningColumns>()) {
-      return "";
-    } else {
-      std::stringstream ss;
-      ss << " RETURNING ";
+    // Add columns clause if columns are specified
+    if constexpr (!is_empty_tuple<Columns>()) {
+      writer.append(" (");
       int i = 0;
-      std::apply(
-          [&](const auto&... cols) { ((ss << (i++ > 0 ? ", " : "") << cols.to_sql()), ...); },
-          returning_columns_);
-      return ss.str();
+      apply_tuple(
+          [&](const auto& col) {
+            using column_type = typename std::remove_cvref_t<decltype(col)>::column_type;
+            writer.append(i++ > 0 ? ", " : "").append(column_type::name);
+          },
+          columns_);
+      writer.append(')');
     }
-  }
 
-  // Helper to collect bind parameters from RETURNING clause
-  std::vector<std::string> returning_bind_params() const {
-    std::vector<std::string> params;
-
-    if constexpr (!is_empty_tuple<ReturningColumns>()) {
-      std::apply(
-          [&](const auto&... cols) {
-            auto process_col = [&params](const auto& col) {
-              auto col_params = col.bind_params();
-              params.insert(params.end(), col_params.begin(), col_params.end());
-            };
-
-            (process_col(cols), ...);
+    // INSERT ... VALUES ...
+    if constexpr (!is_empty_tuple<Values>() && std::is_same_v<SelectStmt, std::nullopt_t>) {
+      writer.append(" VALUES ");
+      int i = 0;
+      apply_tuple(
+          [&](const auto& value_tuple) {
+            writer.append(i++ > 0 ? ", (" : "(");
+            render_tuple(writer, value_tuple, ", ");
+            writer.append(')');
           },
-          returning_columns_);
+          values_);
+    }
+    // INSERT ... SELECT ...
+    else if constexpr (!std::is_same_v<SelectStmt, std::nullopt_t>) {
+      if (select_.has_value()) {
+        writer.append(' ');
+        render_to(writer, select_.value());
+      }
     }
 
-    return params;
+    // Add RETURNING clause if specified
+    if constexpr (!is_empty_tuple<ReturningColumns>()) {
+      writer.append(" RETURNING ");
+      render_tuple(writer, returning_columns_, ", ");
+    }
   }
 
 public:
@@ -179,60 +116,40 @@ public:
       : table_(std::move(table)), columns_(std::move(columns)), values_(std::move(values)),
         select_(std::move(select)), returning_columns_(std::move(returning_columns)) {}
 
+  /// @brief Whether the SQL text depends only on the query type and its shape key
+  /// @details True when no part of the query has unbounded runtime structure (see
+  /// StaticShapeExpr). Such queries render their SQL once per shape and thread.
+  static constexpr bool has_static_shape =
+      is_static_shape_v<Values> && is_static_shape_v<SelectStmt> &&
+      is_static_shape_v<ReturningColumns>;
+
   /// @brief Generate the SQL for this INSERT query
   /// @return The SQL string
-  std::string to_sql() const {
-    std::stringstream ss;
-    ss << "INSERT INTO " << table_.table_name;
-
-    // Add columns clause if columns are specified
-    if constexpr (!is_empty_tuple<Columns>()) {
-      ss << " " << columns_to_sql();
-    }
-
-    // Handle different types of INSERT statements
+  std::string to_sql() const { return rendered_sql(*this); }
 
-    // INSERT ... VALUES ...
-    if constexpr (!is_empty_tuple<Values>() && std::is_same_v<SelectStmt, std::nullopt_t>) {
-      ss << " " << values_to_sql();
-    }
-    // INSERT ... SELECT ...
-    else if constexpr (!std::is_same_v<SelectStmt, std::nullopt_t>) {
-      if (select_.has_value()) {
-        ss << " " << select_.value().to_sql();
-      }
+  /// @brief Write the SQL and bind parameters of this query to a writer
+  /// @param writer The writer to append to
+  void render(SqlWriter& writer) const {
+    if constexpr (has_static_shape) {
+      render_memoised(writer, *this, [this](SqlWriter& w) { render_clauses(w); });
+    } else {
+      render_clauses(writer);
     }
+  }
 
-    // Add RETURNING clause if specified
-    ss << returning_to_sql();
-
-    return ss.str();
+  /// @brief Append the runtime choices that affect the SQL text to a shape key
+  /// @param key The shape key being built
+  void append_shape(std::string& key) const
+    requires has_static_shape
+  {
+    append_shape_of(key, values_);
+    append_shape_of(key, select_);
+    append_shape_of(key, returning_columns_);
   }
 
   /// @brief Get the bind parameters for this INSERT query
   /// @return Vector of bind parameters
-  std::vector<std::string> bind_params() const {
-    std::vector<std::string> params;
-
-    // INSERT ... VALUES ...
-    if constexpr (!is_empty_tuple<Values>() && std::is_same_v<SelectStmt, std::nullopt_t>) {
-      auto values_params = values_bind_params();
-      params.insert(params.end(), values_params.begin(), values_params.end());
-    }
-    // INSERT ... SELECT ...
-    else if constexpr (!std::is_same_v<SelectStmt, std::nullopt_t>) {
-      if (select_.has_value()) {
-        auto select_params = select_.value().bind_params();
-        params.insert(params.end(), select_params.begin(), select_params.end());
-      }
-    }
-
-    // Add RETURNING bind parameters
-    auto returning_params = returning_bind_params();
-    params.insert(params.end(), returning_params.begin(), returning_params.end());
-
-    return params;
-  }
+  std::vector<std::string> bind_params() const { return rendered_params(*this); }
 
   /// @brief Specify columns to insert into
   /// @tparam Cols Column types
@@ -4,6 +4,7 @@
 #include "../query/date_concepts.hpp"
 #include "../query/function.hpp"
 #include "../query/meta.hpp"
+#include "../query/param.hpp"
 #include "../query/schema_adapter.hpp"
 #include "../query/value.hpp"
 #include "../schema/column.hpp"
@@ -136,6 +137,44 @@ auto operator<=(const column<TableT, Name, T, Modifiers...>& col, const ValueTyp
   return col <= query::val(value);
 }
 
+// Comparisons with a prepared query parameter; the parameter type must match the column type
+
+template <typename TableT, fixed_string Name, typename T, typename... Modifiers, typename P>
+auto operator==(const column<TableT, Name, T, Modifiers...>& col, query::Param<P> param) {
+  static_assert(type_checking::TypeCompatible<T, P>, type_checking::type_error_message);
+  return query::to_expr(col) == std::move(param);
+}
+
+template <typename TableT, fixed_string Name, typename T, typename... Modifiers, typename P>
+auto operator!=(const column<TableT, Name, T, Modifiers...>& col, query::Param<P> param) {
+  static_assert(type_checking::TypeCompatible<T, P>, type_checking::type_error_message);
+  return query::to_expr(col) != std::move(param);
+}
+
+template <typename TableT, fixed_string Name, typename T, typename... Modifiers, typename P>
+auto operator>(const column<TableT, Name, T, Modifiers...>& col, query::Param<P> param) {
+  static_assert(type_checking::TypeCompatible<T, P>, type_checking::type_error_message);
+  return query::to_expr(col) > std::move(param);
+}
+
+template <typename TableT, fixed_string Name, typename T, typename... Modifiers, typename P>
+auto operator<(const column<TableT, Name, T, Modifiers...>& col, query::Param<P> param) {
+  static_assert(type_checking::TypeCompatible<T, P>, type_checking::type_error_message);
+  return query::to_expr(col) < std::move(param);
+}
+
+template <typename TableT, fixed_string Name, typename T, typename... Modifiers, typename P>
+auto operator>=(const column<TableT, Name, T, Modifiers...>& col, query::Param<P> param) {
+  static_assert(type_checking::TypeCompatible<T, P>, type_checking::type_error_message);
+  return query::to_expr(col) >= std::move(param);
+}
+
+template <typename TableT, fixed_string Name, typename T, typename... Modifiers, typename P>
+auto operator<=(const column<TableT, Name, T, Modifiers...>& col, query::Param<P> param) {
+  static_assert(type_checking::TypeCompatible<T, P>, type_checking::type_error_message);
+  return query::to_expr(col) <= std::move(param);
+}
+
 // Column to column equality comparison
 template <typename TableT1, fixed_string Name1, typename T1, typename... Modifiers1,
           typename TableT2, fixed_string Name2, typename T2, typename... Modifiers2>
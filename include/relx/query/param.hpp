@@ -0,0 +1,88 @@
+#pragma once
+
+#include "core.hpp"
+#include "sql_writer.hpp"
+
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+namespace relx::query {
+
+/// @brief A named placeholder whose value is supplied when a prepared query is executed
+/// @details Query builders accept a Param wherever they accept a value. The query is then
+/// prepared once with PostgreSQLConnection::prepare() and executed many times with different
+/// arguments, which are checked against the parameter types at compile time.
+/// @tparam T The C++ type of the value, which must have column_traits
+template <typename T>
+class Param : public SqlExpression {
+public:
+  static_assert(!std::is_reference_v<T> && !std::is_const_v<T>,
+                "Param types must be plain value types");
+  static_assert(!schema::column_traits<T>::nullable,
+                "Param does not support NULL values; use a separate query with val(std::nullopt)");
+
+  using value_type = T;
+
+  explicit Param(std::string name) : name_(std::move(name)) {}
+
+  std::string to_sql() const override { return "?"; }
+
+  /// @brief A parameter has no value until the prepared query is executed
+  /// @return A single empty string, so the parameter count still matches the placeholders
+  std::vector<std::string> bind_params() const override { return {std::string()}; }
+
+  void render(SqlWriter& writer) const {
+    writer.placeholder();
+    writer.bind_slot<T>(name_);
+  }
+
+  const std::string& name() const { return name_; }
+
+  /// @brief Parameters always render as a placeholder, so nothing is appended
+  void append_shape(std::string& /*key*/) const {}
+
+private:
+  std::string name_;
+};
+
+/// @brief Create a named query parameter
+/// @tparam T The C++ type of the value supplied at execution time
+/// @param name The parameter name, used in error messages
+/// @return A Param expression
+template <typename T>
+auto param(std::string name) {
+  return Param<T>(std::move(name));
+}
+
+/// @brief Collect the value types of every Param in an expression type, in rendering order
+/// @details The default walks the template arguments of class templates, which matches the
+/// order in which conditions, tuples and the INSERT, UPDATE and DELETE builders render their
+/// parts. Types whose template arguments are not rendered in declaration order specialize this
+/// trait. Prepared queries verify the order at runtime against the rendered placeholders.
+template <typename T>
+struct param_types {
+  using type = std::tuple<>;
+};
+
+template <typename T>
+struct param_types<Param<T>> {
+  using type = std::tuple<T>;
+};
+
+template <template <typename...> class Template, typename... Ts>
+struct param_types<Template<Ts...>> {
+  using type = decltype(std::tuple_cat(std::declval<typename param_types<Ts>::type>()...));
+};
+
+template <typename T>
+using param_types_t = typename param_types<std::remove_cvref_t<T>>::type;
+
+/// @brief Concept for queries that contain at least one Param
+template <typename T>
+concept ParameterizedQuery = std::tuple_size_v<param_types_t<T>> > 0;
+
+}  // namespace relx::query
@@ -5,6 +5,8 @@
 #include "column_expression.hpp"
 #include "core.hpp"
 #include "meta.hpp"
+#include "shape.hpp"
+#include "sql_writer.hpp"
 
 #include <string>
 #include <string_view>
@@ -34,6 +36,23 @@ public:
 
   const C& column() const { return col_; }
 
+  void render(SqlWriter& writer) const {
+    if (!table_name_.empty()) {
+      writer.append(table_name_).append('.');
+    }
+    writer.append(C::name);
+  }
+
+  /// @brief Only a table name other than the column's own table changes the rendered SQL
+  void append_shape(std::string& key) const {
+    if (table_name_ == get_parent_table_name()) {
+      key.push_back('\0');
+    } else {
+      key.push_back('\1');
+      append_shape_text(key, table_name_);
+    }
+  }
+
 private:
   const C& col_;
   std::string_view table_name_;
@@ -4,7 +4,10 @@
 #include "condition.hpp"
 #include "core.hpp"
 #include "meta.hpp"
+#include "param.hpp"
 #include "relx/schema/fixed_string.hpp"
+#include "shape.hpp"
+#include "sql_writer.hpp"
 #include "value.hpp"
 
 #include <iostream>
@@ -33,6 +36,14 @@ struct JoinSpec {
   Table table;
   Condition condition;
   JoinType type;
+
+  /// @brief The join type is chosen at runtime, so it is part of the shape key
+  void append_shape(std::string& key) const
+    requires StaticShapeExpr<Condition>
+  {
+    key.push_back(static_cast<char>(type));
+    condition.append_shape(key);
+  }
 };
 
 /// @brief Create a join condition with the ON clause
@@ -92,190 +103,49 @@ public:
         order_bys_(std::move(order_bys)), having_(std::move(having)), limit_(std::move(limit)),
         offset_(std::move(offset)) {}
 
+  /// @brief Whether the SQL text depends only on the query type and its shape key
+  /// @details True when no part of the query has unbounded runtime structure (see
+  /// StaticShapeExpr). Such queries render their SQL once per shape and thread.
+  static constexpr bool has_static_shape =
+      is_static_shape_v<Columns> && is_static_shape_v<Joins> && is_static_shape_v<Where> &&
+      is_static_shape_v<GroupBys> && is_static_shape_v<OrderBys> &&
+      is_static_shape_v<HavingCond> && is_static_shape_v<LimitVal> &&
+      is_static_shape_v<OffsetVal>;
+
   /// @brief Generate the SQL for this SELECT query
   /// @return The SQL string
-  std::string to_sql() const {
-    std::stringstream ss;
-    ss << "SELECT ";
-
-    // Add DISTINCT if enabled
-    if constexpr (IsDistinct) {
-      ss << "DISTINCT ";
-    }
-
-    // Add columns
-    ss << tuple_to_sql(columns_, ", ");
-
-    // Add FROM clause if tables are specified
-    if constexpr (!is_empty_tuple<Tables>()) {
-      ss << " FROM ";
-      int i = 0;
-      std::apply(
-          [&](const auto&... tables) { ((ss << (i++ > 0 ? ", " : "") << tables.table_name), ...); },
-          tables_);
-    }
-
-    // Add JOINs
-    if constexpr (!is_empty_tuple<Joins>()) {
-      apply_tuple(
-          [&](const auto& join) {
-            ss << " ";
-
-            switch (join.type) {
-            case JoinType::Inner:
-              ss << "JOIN ";
-              break;
-            case JoinType::Left:
-              ss << "LEFT JOIN ";
-              break;
-            case JoinType::Right:
-              ss << "RIGHT JOIN ";
-              break;
-            case JoinType::Full:
-              ss << "FULL JOIN ";
-              break;
-            case JoinType::Cross:
-              ss << "CROSS JOIN ";
-              break;
-            }
-
-            ss << join.table.table_name;
-
-            if (join.type != JoinType::Cross) {
-              ss << " ON ";
-              ss << join.condition.to_sql();
-            }
-          },
-          joins_);
-    }
-
-    // Add WHERE clause
-    if constexpr (!std::is_same_v<Where, std::nullopt_t>) {
-      if (where_.has_value()) {
-        ss << " WHERE " << where_.value().to_sql();
-      }
-    }
-
-    // Add GROUP BY clause
-    if constexpr (!is_empty_tuple<GroupBys>()) {
-      ss << " GROUP BY " << tuple_to_sql(group_bys_, ", ");
-    }
-
-    // Add HAVING clause
-    if constexpr (!std::is_same_v<HavingCond, std::nullopt_t>) {
-      if (having_.has_value()) {
-        ss << " HAVING " << having_.value().to_sql();
-      }
-    }
-
-    // Add ORDER BY clause
-    if constexpr (!is_empty_tuple<OrderBys>()) {
-      ss << " ORDER BY " << tuple_to_sql(order_bys_, ", ");
-    }
-
-    // Add LIMIT clause
-    if constexpr (!std::is_same_v<LimitVal, std::nullopt_t>) {
-      if constexpr (std::is_same_v<LimitVal, Value<int>>) {
-        ss << " LIMIT " << limit_.to_sql();
-      } else if (limit_.has_value()) {
-        ss << " LIMIT " << limit_.value().to_sql();
-      }
-    }
-
-    // Add OFFSET clause
-    if constexpr (!std::is_same_v<OffsetVal, std::nullopt_t>) {
-      if constexpr (std::is_same_v<OffsetVal, Value<int>>) {
-        ss << " OFFSET " << offset_.to_sql();
-      } else if (offset_.has_value()) {
-        ss << " OFFSET " << offset_.value().to_sql();
-      }
-    }
-
-    return ss.str();
-  }
+  std::string to_sql() const { return rendered_sql(*this); }
 
   /// @brief Get the bind parameters for this SELECT query
   /// @return Vector of bind parameters
-  std::vector<std::string> bind_params() const {
-    std::vector<std::string> params;
-
-    // Collect parameters from columns
-    if constexpr (!is_empty_tuple<Columns>()) {
-      auto column_params = tuple_bind_params(columns_);
-      params.insert(params.end(), column_params.begin(), column_params.end());
-    }
-
-    // Tables don't have bind parameters, so we skip collecting them
-
-    // Collect parameters from joins
-    if constexpr (!is_empty_tuple<Joins>()) {
-      std::apply(
-          [&](const auto&... joins) {
-            (([&]() {
-               try {
-                 auto join_params = joins.condition.bind_params();
-                 params.insert(params.end(), join_params.begin(), join_params.end());
-               } catch (const std::exception& e) {
-                 // Log error and continue
-                 std::print("Error collecting join params: {}", e.what());
-               }
-             })(),
-             ...);
-          },
-          joins_);
-    }
-
-    // Collect where parameter
-    if constexpr (!std::is_same_v<Where, std::nullopt_t>) {
-      if (where_.has_value()) {
-        auto where_params = where_.value().bind_params();
-        params.insert(params.end(), where_params.begin(), where_params.end());
-      }
-    }
-
-    // Collect group by parameters
-    if constexpr (!is_empty_tuple<GroupBys>()) {
-      auto group_params = tuple_bind_params(group_bys_);
-      params.insert(params.end(), group_params.begin(), group_params.end());
-    }
-
-    // Collect having parameter
-    if constexpr (!std::is_same_v<HavingCond, std::nullopt_t>) {
-      if (having_.has_value()) {
-        auto having_params = having_.value().bind_params();
-        params.insert(params.end(), having_params.begin(), having_params.end());
-      }
-    }
-
-    // Collect order by parameters
-    if constexpr (!is_empty_tuple<OrderBys>()) {
-      auto order_params = tuple_bind_params(order_bys_);
-      params.insert(params.end(), order_params.begin(), order_params.end());
-    }
-
-    // Collect limit parameter
-    if constexpr (!std::is_same_v<LimitVal, std::nullopt_t>) {
-      if constexpr (std::is_same_v<LimitVal, Value<int>>) {
-        auto limit_params = limit_.bind_params();
-        params.insert(params.end(), limit_params.begin(), limit_params.end());
-      } else if (limit_.has_value()) {
-        auto limit_params = limit_.value().bind_params();
-        params.insert(params.end(), limit_params.begin(), limit_params.end());
-      }
-    }
-
-    // Collect offset parameter
-    if constexpr (!std::is_same_v<OffsetVal, std::nullopt_t>) {
-      if constexpr (std::is_same_v<OffsetVal, Value<int>>) {
-        auto offset_params = offset_.bind_params();
-        params.insert(params.end(), offset_params.begin(), offset_params.end());
-      } else if (offset_.has_value()) {
-        auto offset_params = offset_.value().bind_params();
-        params.insert(params.end(), offset_params.begin(), offset_params.end());
-      }
+  std::vector<std::string> bind_params() const { return rendered_params(*this); }
+
+  /// @brief Write the SQL and bind parameters of this query to a writer
+  /// @details Queries with a static shape append their memoised text and only walk the
+  /// expression tree to collect parameters.
+  /// @param writer The writer to append to
+  void render(SqlWriter& writer) const {
+    if constexpr (has_static_shape) {
+      render_memoised(writer, *this, [this](SqlWriter& w) { render_clauses(w); });
+    } else {
+      render_clauses(writer);
     }
+  }
 
-    return params;
+  /// @brief Append the runtime choices that affect the SQL text to a shape key
+  /// @details Also makes a static SELECT usable as a static subquery.
+  /// @param key The shape key being built
+  void append_shape(std::string& key) const
+    requires has_static_shape
+  {
+    append_shape_of(key, columns_);
+    append_shape_of(key, joins_);
+    append_shape_of(key, where_);
+    append_shape_of(key, group_bys_);
+    append_shape_of(key, order_bys_);
+    append_shape_of(key, having_);
+    append_shape_of(key, limit_);
+    append_shape_of(key, offset_);
   }
 
   /// @brief Add a FROM clause to the query
@@ -368,6 +238,8 @@ public:
       // TODO Get rid of this dummy conditions somehow
       std::string to_sql() const override { return "1=1"; }
       std::vector<std::string> bind_params() const override { return {}; }
+      void render(SqlWriter& writer) const { writer.append("1=1"); }
+      void append_shape(std::string& /*key*/) const {}
     };
 
     return join(table, DummyCondition{}, JoinType::Cross);
@@ -479,6 +351,112 @@ public:
   }
 
 private:
+  // Write every clause in one pass; render() memoises the text for static shapes
+  void render_clauses(SqlWriter& writer) const {
+    writer.append("SELECT ");
+
+    // Add DISTINCT if enabled
+    if constexpr (IsDistinct) {
+      writer.append("DISTINCT ");
+    }
+
+    // Add columns
+    render_tuple(writer, columns_, ", ");
+
+    // Add FROM clause if tables are specified
+    if constexpr (!is_empty_tuple<Tables>()) {
+      writer.append(" FROM ");
+      int i = 0;
+      apply_tuple(
+          [&](const auto& table) {
+            writer.append(i++ > 0 ? ", " : "").append(table.table_name);
+          },
+          tables_);
+    }
+
+    // Add JOINs
+    if constexpr (!is_empty_tuple<Joins>()) {
+      apply_tuple(
+          [&](const auto& join) {
+            switch (join.type) {
+            case JoinType::Inner:
+              writer.append(" JOIN ");
+              break;
+            case JoinType::Left:
+              writer.append(" LEFT JOIN ");
+              break;
+            case JoinType::Right:
+              writer.append(" RIGHT JOIN ");
+              break;
+            case JoinType::Full:
+              writer.append(" FULL JOIN ");
+              break;
+            case JoinType::Cross:
+              writer.append(" CROSS JOIN ");
+              break;
+            }
+
+            writer.append(join.table.table_name);
+
+            if (join.type != JoinType::Cross) {
+              writer.append(" ON ");
+              render_to(writer, join.condition);
+            }
+          },
+          joins_);
+    }
+
+    // Add WHERE clause
+    if constexpr (!std::is_same_v<Where, std::nullopt_t>) {
+      if (where_.has_value()) {
+        writer.append(" WHERE ");
+        render_to(writer, where_.value());
+      }
+    }
+
+    // Add GROUP BY clause
+    if constexpr (!is_empty_tuple<GroupBys>()) {
+      writer.append(" GROUP BY ");
+      render_tuple(writer, group_bys_, ", ");
+    }
+
+    // Add HAVING clause
+    if constexpr (!std::is_same_v<HavingCond, std::nullopt_t>) {
+      if (having_.has_value()) {
+        writer.append(" HAVING ");
+        render_to(writer, having_.value());
+      }
+    }
+
+    // Add ORDER BY clause
+    if constexpr (!is_empty_tuple<OrderBys>()) {
+      writer.append(" ORDER BY ");
+      render_tuple(writer, order_bys_, ", ");
+    }
+
+    // Add LIMIT clause
+    if constexpr (!std::is_same_v<LimitVal, std::nullopt_t>) {
+      if constexpr (std::is_same_v<LimitVal, Value<int>>) {
+        writer.append(" LIMIT ");
+        render_to(writer, limit_);
+      } else if (limit_.has_value()) {
+        writer.append(" LIMIT ");
+        render_to(writer, limit_.value());
+      }
+    }
+
+    // Add OFFSET clause
+    if constexpr (!std::is_same_v<OffsetVal, std::nullopt_t>) {
+      if constexpr (std::is_same_v<OffsetVal, Value<int>>) {
+        writer.append(" OFFSET ");
+        render_to(writer, offset_);
+      } else if (offset_.has_value()) {
+        writer.append(" OFFSET ");
+        render_to(writer, offset_.value());
+      }
+    }
+  }
+
   Columns columns_;
   Tables tables_;
   Joins joins_;
@@ -538,9 +516,20 @@ class DescendingExpr : public SqlExpression {
 public:
   explicit DescendingExpr(Expr expr) : expr_(std::move(expr)) {}
 
-  std::string to_sql() const override { return expr_.to_sql() + " DESC"; }
+  std::string to_sql() const override { return rendered_sql(*this); }
 
-  std::vector<std::string> bind_params() const override { return expr_.bind_params(); }
+  std::vector<std::string> bind_params() const override { return rendered_params(*this); }
+
+  void render(SqlWriter& writer) const {
+    render_to(writer, expr_);
+    writer.append(" DESC");
+  }
+
+  void append_shape(std::string& key) const
+    requires StaticShapeExpr<Expr>
+  {
+    expr_.append_shape(key);
+  }
 
 private:
   Expr expr_;
@@ -570,9 +559,20 @@ class AscendingExpr : public SqlExpression {
 public:
   explicit AscendingExpr(Expr expr) : expr_(std::move(expr)) {}
 
-  std::string to_sql() const override { return expr_.to_sql() + " ASC"; }
+  std::string to_sql() const override { return rendered_sql(*this); }
 
-  std::vector<std::string> bind_params() const override { return expr_.bind_params(); }
+  std::vector<std::string> bind_params() const override { return rendered_params(*this); }
+
+  void render(SqlWriter& writer) const {
+    render_to(writer, expr_);
+    writer.append(" ASC");
+  }
+
+  void append_shape(std::string& key) const
+    requires StaticShapeExpr<Expr>
+  {
+    expr_.append_shape(key);
+  }
 
 private:
   Expr expr_;
@@ -606,6 +606,10 @@ auto select_all(const Table& table) {
     std::string to_sql() const override { return "*"; }
 
     std::vector<std::string> bind_params() const override { return {}; }
+
+    void render(SqlWriter& writer) const { writer.append('*'); }
+
+    void append_shape(std::string& /*key*/) const {}
   };
 
   // Use a star expression for simplicity
@@ -678,6 +682,10 @@ auto select_distinct_all(const Table& table) {
     std::string to_sql() const override { return "*"; }
 
     std::vector<std::string> bind_params() const override { return {}; }
+
+    void render(SqlWriter& writer) const { writer.append('*'); }
+
+    void append_shape(std::string& /*key*/) const {}
   };
 
   // Use a star expression with DISTINCT
@@ -697,4 +705,32 @@ auto select_distinct_all() {
   return select_distinct_all(table);
 }
 
+/// @brief Parameters of a SELECT in the order its clauses are rendered
+/// @details HAVING is rendered before ORDER BY, unlike the template argument order.
+template <typename Columns, typename Tables, typename Joins, typename Where, typename GroupBys,
+          typename OrderBys, typename HavingCond, typename LimitVal, typename OffsetVal,
+          bool IsDistinct>
+struct param_types<SelectQuery<Columns, Tables, Joins, Where, GroupBys, OrderBys, HavingCond,
+                               LimitVal, OffsetVal, IsDistinct>> {
+  using type = decltype(std::tuple_cat(
+      std::declval<param_types_t<Columns>>(), std::declval<param_types_t<Joins>>(),
+      std::declval<param_types_t<Where>>(), std::declval<param_types_t<GroupBys>>(),
+      std::declval<param_types_t<HavingCond>>(), std::declval<param_types_t<OrderBys>>(),
+      std::declval<param_types_t<LimitVal>>(), std::declval<param_types_t<OffsetVal>>()));
+};
+
+/// @brief Whether a query is a SELECT
+/// @details Used to route read-only queries, e.g. to replicas
+template <typename T>
+struct is_select_query : std::false_type {};
+
+template <typename Columns, typename Tables, typename Joins, typename Where, typename GroupBys,
+          typename OrderBys, typename HavingCond, typename LimitVal, typename OffsetVal,
+          bool IsDistinct>
+struct is_select_query<SelectQuery<Columns, Tables, Joins, Where, GroupBys, OrderBys, HavingCond,
+                                   LimitVal, OffsetVal, IsDistinct>> : std::true_type {};
+
+template <typename T>
+inline constexpr bool is_select_query_v = is_select_query<std::remove_cvref_t<T>>::value;
+
 }  // namespace relx::query
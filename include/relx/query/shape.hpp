@@ -0,0 +1,149 @@
+#pragma once
+
+#include "sql_writer.hpp"
+
+#include <concepts>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+namespace relx::query {
+
+/// @brief Concept for expressions whose SQL text is fully determined by their type plus a
+/// compact shape key
+/// @details Most of the SQL a query renders is fixed by its C++ type: column and table names are
+/// compile-time constants and values always render as placeholders. The few runtime choices that
+/// do change the text (a comparison operator, a join type, whether an optional value is NULL)
+/// are appended to the key by append_shape(). Expressions with unbounded runtime structure, such
+/// as IN lists or aliases, do not provide append_shape() and are rendered every time.
+template <typename T>
+concept StaticShapeExpr = requires(const T& expr, std::string& key) { expr.append_shape(key); };
+
+/// @brief Check if a query part has a static shape
+/// @details Extends StaticShapeExpr to the containers the query builders store their clauses in:
+/// absent clauses (std::nullopt_t), optional clauses and tuples of expressions.
+template <typename T>
+struct is_static_shape : std::bool_constant<StaticShapeExpr<T>> {};
+
+template <>
+struct is_static_shape<std::nullopt_t> : std::true_type {};
+
+template <typename T>
+struct is_static_shape<std::optional<T>> : is_static_shape<T> {};
+
+template <typename... Ts>
+struct is_static_shape<std::tuple<Ts...>>
+    : std::bool_constant<(is_static_shape<Ts>::value && ...)> {};
+
+template <typename T>
+inline constexpr bool is_static_shape_v = is_static_shape<T>::value;
+
+/// @brief Append a runtime string that changes the rendered SQL to a shape key
+/// @details The text is prefixed with its full length, so a key splits back into the same
+/// strings it was built from however long they are.
+/// @param key The shape key being built
+/// @param text The string, e.g. an operator
+inline void append_shape_text(std::string& key, std::string_view text) {
+  const size_t size = text.size();
+  key.append(reinterpret_cast<const char*>(&size), sizeof(size));
+  key.append(text);
+}
+
+/// @brief Append the shape of a query part to a shape key
+/// @tparam T The part type, which must satisfy is_static_shape
+/// @param key The shape key being built
+/// @param part The query part
+template <typename T>
+  requires is_static_shape_v<T>
+void append_shape_of(std::string& key, const T& part) {
+  if constexpr (std::is_same_v<T, std::nullopt_t>) {
+    // Absent clauses are part of the type
+  } else if constexpr (requires { part.has_value(); } && !StaticShapeExpr<T>) {
+    key.push_back(part.has_value() ? '1' : '0');
+    if (part.has_value()) {
+      append_shape_of(key, *part);
+    }
+  } else if constexpr (requires { std::tuple_size<T>::value; } && !StaticShapeExpr<T>) {
+    std::apply([&key](const auto&... items) { (append_shape_of(key, items), ...); }, part);
+  } else {
+    part.append_shape(key);
+  }
+}
+
+/// @brief Per-thread memo of rendered SQL for one query type
+/// @details Each query type gets its own small map from shape key to SQL text, so the common
+/// case of a query with no runtime choices is a lookup with an empty key. The map is thread
+/// local so lookups need no synchronisation; it is cleared when it grows past max_shapes, which
+/// only happens if one query type is built with many different operators or NULL patterns.
+/// @tparam Query The query builder type the SQL belongs to
+template <typename Query>
+class ShapeCache {
+public:
+  static constexpr size_t max_shapes = 64;
+
+  /// @brief Get the SQL for a shape, rendering it on first use
+  /// @param key The shape key of the query instance
+  /// @param render Callable producing the SQL text when the shape is not cached yet
+  /// @return The cached SQL text
+  template <typename Render>
+  static const std::string& get(const std::string& key, Render&& render) {
+    auto& entries = cache();
+    if (auto it = entries.find(key); it != entries.end()) {
+      return it->second;
+    }
+
+    if (entries.size() >= max_shapes) {
+      entries.clear();
+    }
+    return entries.emplace(key, std::forward<Render>(render)()).first->second;
+  }
+
+  /// @brief Get the number of shapes cached on the calling thread
+  /// @return The number of cached SQL strings
+  static size_t size() { return cache().size(); }
+
+private:
+  static std::unordered_map<std::string, std::string>& cache() {
+    thread_local std::unordered_map<std::string, std::string> entries;
+    return entries;
+  }
+};
+
+/// @brief Write a static-shape query, reusing its memoised SQL text where possible
+/// @details The text is looked up by shape key and placeholder style. Numbered text always
+/// starts at $1, so it is only reused when the query is the first thing written. The clauses
+/// are then walked once more with text output off, to collect the parameters and advance the
+/// placeholder numbering.
+/// @param writer The writer to append to
+/// @param query The query, which must provide append_shape()
+/// @param render_clauses Callable writing the query's clauses to a writer from scratch
+template <typename Query, typename RenderClauses>
+void render_memoised(SqlWriter& writer, const Query& query, RenderClauses&& render_clauses) {
+  if (!writer.writes_text() ||
+      (writer.style() == PlaceholderStyle::Numbered && writer.placeholder_count() != 0)) {
+    render_clauses(writer);
+    return;
+  }
+
+  std::string key;
+  query.append_shape(key);
+  key.push_back(static_cast<char>(writer.style()));
+  writer.append(ShapeCache<Query>::get(key, [&] {
+    SqlWriter text(writer.style());
+    text.set_collects_params(false);
+    render_clauses(text);
+    return text.take_sql();
+  }));
+
+  if (writer.collects_params() || writer.style() == PlaceholderStyle::Numbered) {
+    const SqlWriter::TextSuppressor no_text(writer);
+    render_clauses(writer);
+  }
+}
+
+}  // namespace relx::query
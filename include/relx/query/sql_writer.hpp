@@ -0,0 +1,391 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <charconv>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+namespace relx::query {
+
+/// @brief How a SqlWriter spells parameter placeholders
+enum class PlaceholderStyle {
+  Question,  ///< Every placeholder is "?", as returned by to_sql()
+  Numbered   ///< Placeholders are numbered "$1", "$2", ... as PostgreSQL expects
+};
+
+/// @brief PostgreSQL types and wire formats of a query's bind parameters
+/// @details Filled in parallel with the parameter values by a SqlWriter with typed parameters
+/// enabled. Empty vectors mean every parameter is text and the server infers its type.
+struct ParamTypes {
+  std::vector<unsigned int> oids;  ///< Type OID per parameter (libpq's Oid), 0 to infer it
+  std::vector<int> formats;        ///< 0 for text, 1 for binary, per parameter
+
+  bool empty() const { return oids.empty(); }
+
+  void clear() {
+    oids.clear();
+    formats.clear();
+  }
+};
+
+/// @brief A parameter whose value is only supplied when a prepared query is executed
+struct ParamSlot {
+  std::string_view name;       ///< Name of the Param, valid while the query is alive
+  const std::type_info* type;  ///< C++ type of the value
+  size_t index;                ///< Position of the parameter in SqlWriter::params()
+};
+
+/// @brief Single-pass sink for the SQL text and bind parameters of a query
+/// @details Expressions append their SQL text and parameters to one writer in a single walk of
+/// the expression tree, instead of building a string and a parameter vector per node.
+/// Placeholders are numbered as they are written, so the result can be sent to PostgreSQL
+/// without rescanning it. A writer can be reset and reused, keeping its buffers.
+///
+/// Either half of the output can be switched off: to_sql() only needs the text and
+/// bind_params() only needs the parameters, which are then not formatted at all.
+///
+/// With typed parameters enabled, values whose column_traits provide a binary encoding are
+/// written in PostgreSQL's binary format and their type OIDs are recorded in param_types().
+/// Other values, strings in particular, stay text with an unspecified type. Typed parameters
+/// are only meaningful to connections that send param_types() along with the values.
+class SqlWriter {
+public:
+  /// @brief Constructor
+  /// @param style How placeholders are written
+  explicit SqlWriter(PlaceholderStyle style = PlaceholderStyle::Question) : style_(style) {}
+
+  /// @brief Clear the output and start a new query, keeping the allocated buffers
+  /// @param style How placeholders are written
+  void reset(PlaceholderStyle style = PlaceholderStyle::Question) {
+    sql_.clear();
+    params_.clear();
+    placeholder_count_ = 0;
+    style_ = style;
+    writes_text_ = true;
+    collects_params_ = true;
+    typed_params_ = false;
+    param_types_.clear();
+    slots_.clear();
+  }
+
+  /// @brief Append SQL text
+  /// @param text The text to append
+  /// @return Reference to this writer for chaining
+  SqlWriter& append(std::string_view text) {
+    if (writes_text_) {
+      sql_.append(text);
+    }
+    return *this;
+  }
+
+  /// @brief Append a single character of SQL text
+  /// @param c The character to append
+  /// @return Reference to this writer for chaining
+  SqlWriter& append(char c) {
+    if (writes_text_) {
+      sql_.push_back(c);
+    }
+    return *this;
+  }
+
+  /// @brief Append the next parameter placeholder
+  /// @return Reference to this writer for chaining
+  SqlWriter& placeholder() {
+    ++placeholder_count_;
+    if (!writes_text_) {
+      return *this;
+    }
+
+    if (style_ == PlaceholderStyle::Question) {
+      sql_.push_back('?');
+    } else {
+      char digits[24];
+      const auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), placeholder_count_);
+      sql_.push_back('$');
+      sql_.append(digits, end);
+    }
+    return *this;
+  }
+
+  /// @brief Add a bind parameter
+  /// @param value The parameter value in PostgreSQL text format
+  void bind(std::string value) {
+    if (collects_params_) {
+      params_.push_back(std::move(value));
+      if (typed_params_) {
+        param_types_.oids.push_back(0);
+        param_types_.formats.push_back(0);
+      }
+    }
+  }
+
+  /// @brief Add a bind parameter from a C++ value
+  /// @details Uses the binary encoding of column_traits<T> when typed parameters are enabled and
+  /// the type has one, and its text representation otherwise.
+  /// @tparam T The value type
+  /// @param value The parameter value
+  template <typename T>
+  void bind_value(const T& value) {
+    if (!collects_params_) {
+      return;
+    }
+
+    if constexpr (schema::BinaryParamType<T>) {
+      if (typed_params_) {
+        schema::column_traits<T>::to_pg_binary(value, params_.emplace_back());
+        param_types_.oids.push_back(schema::column_traits<T>::pg_type_oid);
+        param_types_.formats.push_back(1);
+        return;
+      }
+    }
+    bind(schema::column_traits<T>::to_sql_string(value));
+  }
+
+  /// @brief Add a parameter whose value is supplied later, see Param
+  /// @details An empty value is bound so later parameters keep their positions; the slot
+  /// records where the real value goes.
+  /// @tparam T The C++ type of the value
+  /// @param name The parameter name
+  template <typename T>
+  void bind_slot(std::string_view name) {
+    if (!collects_params_) {
+      return;
+    }
+
+    slots_.push_back(ParamSlot{.name = name, .type = &typeid(T), .index = params_.size()});
+    params_.emplace_back();
+    if (typed_params_) {
+      if constexpr (schema::BinaryParamType<T>) {
+        param_types_.oids.push_back(schema::column_traits<T>::pg_type_oid);
+        param_types_.formats.push_back(1);
+      } else {
+        param_types_.oids.push_back(0);
+        param_types_.formats.push_back(0);
+      }
+    }
+  }
+
+  /// @brief Append a placeholder and its parameter
+  /// @param value The parameter value in PostgreSQL text format
+  /// @return Reference to this writer for chaining
+  SqlWriter& param(std::string value) {
+    placeholder();
+    bind(std::move(value));
+    return *this;
+  }
+
+  /// @brief Append SQL text that contains "?" placeholders, renumbering them as needed
+  /// @details Used for expressions that only implement to_sql(). Question marks inside quoted
+  /// strings and identifiers are left alone.
+  /// @param text The SQL text
+  void append_with_placeholders(std::string_view text) {
+    bool in_single_quotes = false;
+    bool in_double_quotes = false;
+    size_t copied = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+      const char c = text[i];
+      if (c == '\'' && !in_double_quotes) {
+        in_single_quotes = !in_single_quotes;
+      } else if (c == '"' && !in_single_quotes) {
+        in_double_quotes = !in_double_quotes;
+      } else if (c == '?' && !in_single_quotes && !in_double_quotes) {
+        append(text.substr(copied, i - copied));
+        placeholder();
+        copied = i + 1;
+      }
+    }
+    append(text.substr(copied));
+  }
+
+  /// @brief Check if SQL text is being written
+  bool writes_text() const { return writes_text_; }
+
+  /// @brief Check if bind parameters are being collected
+  bool collects_params() const { return collects_params_; }
+
+  /// @brief Turn writing of SQL text on or off; placeholders are still counted
+  void set_writes_text(bool enabled) { writes_text_ = enabled; }
+
+  /// @brief Turn collection of bind parameters on or off
+  void set_collects_params(bool enabled) { collects_params_ = enabled; }
+
+  /// @brief Check if parameters are written with explicit types and binary encodings
+  bool typed_params() const { return typed_params_; }
+
+  /// @brief Turn typed parameters on or off; must be set before the first parameter is bound
+  void set_typed_params(bool enabled) { typed_params_ = enabled; }
+
+  PlaceholderStyle style() const { return style_; }
+  size_t placeholder_count() const { return placeholder_count_; }
+  const std::string& sql() const { return sql_; }
+  const std::vector<std::string>& params() const { return params_; }
+
+  /// @brief Get the parameter types, empty unless typed parameters are enabled
+  const ParamTypes& param_types() const { return param_types_; }
+
+  /// @brief Get the parameters bound with bind_slot(), in placeholder order
+  const std::vector<ParamSlot>& param_slots() const { return slots_; }
+
+  /// @brief Move the SQL text out of the writer
+  std::string take_sql() { return std::move(sql_); }
+
+  /// @brief Move the bind parameters out of the writer
+  std::vector<std::string> take_params() { return std::move(params_); }
+
+  /// @brief Move the parameter types out of the writer
+  ParamTypes take_param_types() { return std::move(param_types_); }
+
+  /// @brief Turns off text output for the lifetime of the object
+  /// @details Lets a node that appended cached SQL text walk its children again only to collect
+  /// their parameters.
+  class TextSuppressor {
+  public:
+    explicit TextSuppressor(SqlWriter& writer)
+        : writer_(writer), previous_(writer.writes_text()) {
+      writer_.set_writes_text(false);
+    }
+    ~TextSuppressor() { writer_.set_writes_text(previous_); }
+
+    TextSuppressor(const TextSuppressor&) = delete;
+    TextSuppressor& operator=(const TextSuppressor&) = delete;
+
+  private:
+    SqlWriter& writer_;
+    bool previous_;
+  };
+
+private:
+  std::string sql_;
+  std::vector<std::string> params_;
+  ParamTypes param_types_;
+  std::vector<ParamSlot> slots_;
+  size_t placeholder_count_ = 0;
+  PlaceholderStyle style_;
+  bool writes_text_ = true;
+  bool collects_params_ = true;
+  bool typed_params_ = false;
+};
+
+/// @brief A per-thread SqlWriter that keeps its buffers between queries
+/// @details Holding one reserves a writer on the calling thread; it is released again when the
+/// lease is destroyed. Nested leases get distinct writers, so rendering a query while another
+/// lease is alive is safe. Do not keep a lease across a coroutine suspension point.
+class SqlWriterLease {
+public:
+  /// @brief Reserve and reset the calling thread's next free writer
+  /// @param style How placeholders are written
+  explicit SqlWriterLease(PlaceholderStyle style = PlaceholderStyle::Question) {
+    auto& pool = writers();
+    if (depth() == pool.size()) {
+      pool.emplace_back();
+    }
+    writer_ = &pool[depth()++];
+    writer_->reset(style);
+  }
+
+  ~SqlWriterLease() { --depth(); }
+
+  SqlWriterLease(const SqlWriterLease&) = delete;
+  SqlWriterLease& operator=(const SqlWriterLease&) = delete;
+
+  SqlWriter& operator*() const { return *writer_; }
+  SqlWriter* operator->() const { return writer_; }
+
+private:
+  SqlWriter* writer_;
+
+  // A deque keeps references stable while nested leases add writers
+  static std::deque<SqlWriter>& writers() {
+    thread_local std::deque<SqlWriter> pool;
+    return pool;
+  }
+
+  static size_t& depth() {
+    thread_local size_t in_use = 0;
+    return in_use;
+  }
+};
+
+/// @brief Concept for expressions that write themselves to a SqlWriter
+template <typename T>
+concept RenderableExpr = requires(const T& expr, SqlWriter& writer) { expr.render(writer); };
+
+/// @brief Write an expression to a SqlWriter
+/// @details Expressions implementing render() write directly. Any other SqlExpr is adapted
+/// through its to_sql() and bind_params().
+/// @param writer The writer to append to
+/// @param expr The expression
+template <typename Expr>
+void render_to(SqlWriter& writer, const Expr& expr) {
+  if constexpr (RenderableExpr<Expr>) {
+    expr.render(writer);
+  } else {
+    static_assert(SqlExpr<Expr>, "render_to() requires a SQL expression");
+    if (writer.writes_text()) {
+      writer.append_with_placeholders(expr.to_sql());
+      if (writer.collects_params()) {
+        for (auto&& param : expr.bind_params()) {
+          writer.bind(std::string(std::move(param)));
+        }
+      }
+    } else {
+      // Every "?" in the text has exactly one parameter, so the numbering stays in step
+      for (auto&& param : expr.bind_params()) {
+        writer.placeholder();
+        writer.bind(std::string(std::move(param)));
+      }
+    }
+  }
+}
+
+/// @brief Write every expression of a tuple to a SqlWriter
+/// @param writer The writer to append to
+/// @param tuple The expressions
+/// @param separator Text written between two expressions
+template <typename Tuple>
+void render_tuple(SqlWriter& writer, const Tuple& tuple, std::string_view separator) {
+  std::apply(
+      [&](const auto&... items) {
+        bool first = true;
+        auto render_item = [&](const auto& item) {
+          if (!first) {
+            writer.append(separator);
+          }
+          first = false;
+          render_to(writer, item);
+        };
+        (render_item(items), ...);
+      },
+      tuple);
+}
+
+/// @brief Render the SQL text of an expression with "?" placeholders
+/// @param expr The expression
+/// @return The SQL text
+template <typename Expr>
+std::string rendered_sql(const Expr& expr) {
+  SqlWriter writer(PlaceholderStyle::Question);
+  writer.set_collects_params(false);
+  render_to(writer, expr);
+  return writer.take_sql();
+}
+
+/// @brief Collect the bind parameters of an expression without rendering its text
+/// @param expr The expression
+/// @return The bind parameters in placeholder order
+template <typename Expr>
+std::vector<std::string> rendered_params(const Expr& expr) {
+  SqlWriter writer(PlaceholderStyle::Question);
+  writer.set_writes_text(false);
+  render_to(writer, expr);
+  return writer.take_params();
+}
+
+}  // namespace relx::query
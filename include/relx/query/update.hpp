@@ -6,6 +6,8 @@
 #include "function.hpp"
 #include "meta.hpp"
 #include "operators.hpp"
+#include "shape.hpp"
+#include "sql_writer.hpp"
 #include "value.hpp"
 
 #include <iostream>
@@ -28,9 +30,20 @@ struct SetItem {
   // Constructor to ensure the SetItem can be properly initialized
   SetItem(ColumnRef<Column> col, Value val) : column(std::move(col)), value(std::move(val)) {}
 
-  std::string to_sql() const { return column.column_name() + " = " + value.to_sql(); }
+  std::string to_sql() const { return rendered_sql(*this); }
 
-  std::vector<std::string> bind_params() const { return value.bind_params(); }
+  std::vector<std::string> bind_params() const { return rendered_params(*this); }
+
+  void render(SqlWriter& writer) const {
+    writer.append(Column::name).append(" = ");
+    render_to(writer, value);
+  }
+
+  void append_shape(std::string& key) const
+    requires StaticShapeExpr<Value>
+  {
+    value.append_shape(key);
+  }
 };
 
 /// @brief Base UPDATE query builder
@@ -47,39 +60,29 @@ private:
   Where where_;
   ReturningColumns returning_columns_;
 
-  // Helper to convert the RETURNING clause to SQL
-  std::string returning_to_sql() const {
-    if constexpr (is_empty_tuple<ReturningColumns>()) {
-      return "";
-    } else {
-      std::stringstream ss;
-      ss << " RETURNING ";
-      int i = 0;
-      std::apply(
-          [&](const auto&... cols) { ((ss << (i++ > 0 ? ", " : "") << cols.to_sql()), ...); },
-          returning_columns_);
-      return ss.str();
+  // Write every clause in one pass; render() memoises the text for static shapes
+  void render_clauses(SqlWriter& writer) const {
+    writer.append("UPDATE ").append(table_.table_name);
+
+    // Add SET clause
+    if constexpr (!is_empty_tuple<Sets>()) {
+      writer.append(" SET ");
+      render_tuple(writer, sets_, ", ");
     }
-  }
 
-  // Helper to collect bind parameters from RETURNING clause
-  std::vector<std::string> returning_bind_params() const {
-    std::vector<std::string> params;
+    // Add WHERE clause
+    if constexpr (!std::is_same_v<Where, std::nullopt_t>) {
+      if (where_.has_value()) {
+        writer.append(" WHERE ");
+        render_to(writer, where_.value());
+      }
+    }
 
+    // Add RETURNING clause if specified
     if constexpr (!is_empty_tuple<ReturningColumns>()) {
-      std::apply(
-          [&](const auto&... cols) {
-            auto process_col = [&params](const auto& col) {
-              auto col_params = col.bind_params();
-              params.insert(params.end(), col_params.begin(), col_params.end());
-            };
-
-            (process_col(cols), ...);
-          },
-          returning_columns_);
+      writer.append(" RETURNING ");
+      render_tuple(writer, returning_columns_, ", ");
     }
-
-    return params;
   }
 
 public:
@@ -98,56 +101,40 @@ public:
       : table_(std::move(table)), sets_(std::move(sets)), where_(std::move(where)),
         returning_columns_(std::move(returning_columns)) {}
 
+  /// @brief Whether the SQL text depends only on the query type and its shape key
+  /// @details True when no part of the query has unbounded runtime structure (see
+  /// StaticShapeExpr). Such queries render their SQL once per shape and thread.
+  static constexpr bool has_static_shape =
+      is_static_shape_v<Sets> && is_static_shape_v<Where> &&
+      is_static_shape_v<ReturningColumns>;
+
   /// @brief Generate the SQL for this UPDATE query
   /// @return The SQL string
-  std::string to_sql() const {
-    std::stringstream ss;
-    ss << "UPDATE " << table_.table_name;
-
-    // Add SET clause
-    if constexpr (!is_empty_tuple<Sets>()) {
-      ss << " SET ";
-      ss << tuple_to_sql(sets_, ", ");
-    }
+  std::string to_sql() const { return rendered_sql(*this); }
 
-    // Add WHERE clause
-    if constexpr (!std::is_same_v<Where, std::nullopt_t>) {
-      if (where_.has_value()) {
-        ss << " WHERE " << where_.value().to_sql();
-      }
+  /// @brief Write the SQL and bind parameters of this query to a writer
+  /// @param writer The writer to append to
+  void render(SqlWriter& writer) const {
+    if constexpr (has_static_shape) {
+      render_memoised(writer, *this, [this](SqlWriter& w) { render_clauses(w); });
+    } else {
+      render_clauses(writer);
     }
+  }
 
-    // Add RETURNING clause if specified
-    ss << returning_to_sql();
-
-    return ss.str();
+  /// @brief Append the runtime choices that affect the SQL text to a shape key
+  /// @param key The shape key being built
+  void append_shape(std::string& key) const
+    requires has_static_shape
+  {
+    append_shape_of(key, sets_);
+    append_shape_of(key, where_);
+    append_shape_of(key, returning_columns_);
   }
 
   /// @brief Get the bind parameters for this UPDATE query
   /// @return Vector of bind parameters
-  std::vector<std::string> bind_params() const {
-    std::vector<std::string> params;
-
-    // Collect parameters from SET items
-    if constexpr (!is_empty_tuple<Sets>()) {
-      auto set_params = tuple_bind_params(sets_);
-      params.insert(params.end(), set_params.begin(), set_params.end());
-    }
-
-    // Collect where parameter
-    if constexpr (!std::is_same_v<Where, std::nullopt_t>) {
-      if (where_.has_value()) {
-        auto where_params = where_.value().bind_params();
-        params.insert(params.end(), where_params.begin(), where_params.end());
-      }
-    }
-
-    // Add RETURNING bind parameters
-    auto returning_params = returning_bind_params();
-    params.insert(params.end(), returning_params.begin(), returning_params.end());
-
-    return params;
-  }
+  std::vector<std::string> bind_params() const { return rendered_params(*this); }
 
   /// @brief Add or replace a SET clause assignment
   /// @tparam Col The column type
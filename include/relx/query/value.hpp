@@ -1,6 +1,7 @@
 #pragma once
 
 #include "core.hpp"
+#include "sql_writer.hpp"
 
 #include <optional>
 #include <sstream>
@@ -24,8 +25,16 @@ public:
     return {schema::column_traits<T>::to_sql_string(value_)};
   }
 
+  void render(SqlWriter& writer) const {
+    writer.placeholder();
+    writer.bind_value(value_);
+  }
+
   const T& value() const { return value_; }
 
+  /// @brief Values always render as a placeholder, so nothing is appended
+  void append_shape(std::string& /*key*/) const {}
+
 private:
   T value_;
 };
@@ -52,8 +61,20 @@ public:
     return {};
   }
 
+  void render(SqlWriter& writer) const {
+    if (!value_.has_value()) {
+      writer.append("NULL");
+      return;
+    }
+    writer.placeholder();
+    writer.bind_value(*value_);
+  }
+
   const std::optional<T>& value() const { return value_; }
 
+  /// @brief The value renders as a placeholder or as NULL depending on whether it is set
+  void append_shape(std::string& key) const { key.push_back(value_.has_value() ? '1' : '0'); }
+
 private:
   std::optional<T> value_;
 };
@@ -70,8 +91,18 @@ public:
 
   std::vector<std::string> bind_params() const override { return {value_}; }
 
+  void render(SqlWriter& writer) const {
+    writer.placeholder();
+    if (writer.collects_params()) {
+      writer.bind(value_);
+    }
+  }
+
   const std::string& value() const { return value_; }
 
+  /// @brief Values always render as a placeholder, so nothing is appended
+  void append_shape(std::string& /*key*/) const {}
+
 private:
   std::string value_;
 };
@@ -88,8 +119,18 @@ public:
 
   std::vector<std::string> bind_params() const override { return {std::string(value_)}; }
 
+  void render(SqlWriter& writer) const {
+    writer.placeholder();
+    if (writer.collects_params()) {
+      writer.bind(std::string(value_));
+    }
+  }
+
   std::string_view value() const { return value_; }
 
+  /// @brief Values always render as a placeholder, so nothing is appended
+  void append_shape(std::string& /*key*/) const {}
+
 private:
   std::string_view value_;
 };
@@ -106,8 +147,18 @@ public:
 
   std::vector<std::string> bind_params() const override { return {std::string(value_)}; }
 
+  void render(SqlWriter& writer) const {
+    writer.placeholder();
+    if (writer.collects_params()) {
+      writer.bind(std::string(value_));
+    }
+  }
+
   const char* value() const { return value_; }
 
+  /// @brief Values always render as a placeholder, so nothing is appended
+  void append_shape(std::string& /*key*/) const {}
+
 private:
   const char* value_;
 };
@@ -225,6 +225,10 @@ struct column_traits<std::chrono::system_clock::time_point> {
 
     return utc_time_point + fractional_seconds;
   }
+
+  // No binary encoding: a time point may be stored in a TIMESTAMP or a TIMESTAMPTZ column, and
+  // sending it typed as either one makes the server convert it through the session TimeZone
+  // for the other. As text with an unspecified type, the server parses it as the column's type.
 };
 
 /// @brief Column traits for std::chrono::year_month_day
@@ -253,6 +257,14 @@ struct column_traits<std::chrono::year_month_day> {
                                        std::chrono::month{static_cast<unsigned>(month)},
                                        std::chrono::day{static_cast<unsigned>(day)}};
   }
+  static constexpr uint32_t pg_type_oid = 1082;  // date
+
+  /// @brief Append days since 2000-01-01 as a big-endian int32
+  static void to_pg_binary(const std::chrono::year_month_day& value, std::string& out) {
+    constexpr auto postgres_epoch = std::chrono::sys_days{std::chrono::year{2000} / 1 / 1};
+    append_network_order(
+        out, static_cast<int32_t>((std::chrono::sys_days{value} - postgres_epoch).count()));
+  }
 };
 
 }  // namespace relx::schema
\ No newline at end of file
@@ -2,6 +2,9 @@
 
 #include "fixed_string.hpp"
 
+#include <bit>
+#include <concepts>
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -27,8 +30,25 @@ struct column_traits {
 
   /// @brief Parse a SQL string representation to a C++ value
   static T from_sql_string(const std::string& value);
+
+  // Types PostgreSQL can receive in binary form additionally provide:
+  //   static constexpr uint32_t pg_type_oid;  // OID of the PostgreSQL type
+  //   static void to_pg_binary(const T& value, std::string& out);  // append the binary encoding
 };
 
+/// @brief Append an integer to a buffer in network byte order
+/// @details PostgreSQL's binary formats are big-endian regardless of the client platform.
+/// @param out The buffer to append to
+/// @param value The value, written as sizeof(T) bytes
+template <std::integral T>
+void append_network_order(std::string& out, T value) {
+  using Unsigned = std::make_unsigned_t<T>;
+  const auto bits = static_cast<Unsigned>(value);
+  for (int shift = static_cast<int>(sizeof(T) - 1) * 8; shift >= 0; shift -= 8) {
+    out.push_back(static_cast<char>((bits >> shift) & 0xFF));
+  }
+}
+
 // Specializations for common types
 
 template <>
@@ -39,6 +59,12 @@ struct column_traits<int> {
   static std::string to_sql_string(const int& value) { return std::to_string(value); }
 
   static int from_sql_string(const std::string& value) { return std::stoi(value); }
+
+  static constexpr uint32_t pg_type_oid = 23;  // int4
+
+  static void to_pg_binary(const int& value, std::string& out) {
+    append_network_order(out, static_cast<int32_t>(value));
+  }
 };
 
 template <>
@@ -49,6 +75,12 @@ struct column_traits<double> {
   static std::string to_sql_string(const double& value) { return std::to_string(value); }
 
   static double from_sql_string(const std::string& value) { return std::stod(value); }
+
+  static constexpr uint32_t pg_type_oid = 701;  // float8
+
+  static void to_pg_binary(const double& value, std::string& out) {
+    append_network_order(out, std::bit_cast<uint64_t>(value));
+  }
 };
 
 template <>
@@ -93,6 +125,10 @@ struct column_traits<bool> {
   static bool from_sql_string(const std::string& value) {
     return value == "1" || value == "true" || value == "TRUE";
   }
+
+  static constexpr uint32_t pg_type_oid = 16;  // bool
+
+  static void to_pg_binary(const bool& value, std::string& out) { out.push_back(value ? 1 : 0); }
 };
 
 template <>
@@ -103,6 +139,12 @@ struct column_traits<float> {
   static std::string to_sql_string(const float& value) { return std::to_string(value); }
 
   static float from_sql_string(const std::string& value) { return std::stof(value); }
+
+  static constexpr uint32_t pg_type_oid = 700;  // float4
+
+  static void to_pg_binary(const float& value, std::string& out) {
+    append_network_order(out, std::bit_cast<uint32_t>(value));
+  }
 };
 
 template <>
@@ -113,6 +155,12 @@ struct column_traits<long> {
   static std::string to_sql_string(const long& value) { return std::to_string(value); }
 
   static long from_sql_string(const std::string& value) { return std::stol(value); }
+
+  static constexpr uint32_t pg_type_oid = sizeof(long) == 8 ? 20 : 23;  // int8 or int4
+
+  static void to_pg_binary(const long& value, std::string& out) {
+    append_network_order(out, value);
+  }
 };
 
 template <>
@@ -123,6 +171,12 @@ struct column_traits<long long> {
   static std::string to_sql_string(const long long& value) { return std::to_string(value); }
 
   static long long from_sql_string(const std::string& value) { return std::stoll(value); }
+
+  static constexpr uint32_t pg_type_oid = 20;  // int8
+
+  static void to_pg_binary(const long long& value, std::string& out) {
+    append_network_order(out, static_cast<int64_t>(value));
+  }
 };
 
 // Add specialization for std::optional types
@@ -157,6 +211,15 @@ struct column_traits<std::nullopt_t> {
   static std::nullopt_t from_sql_string(const std::string& /*value*/) { return std::nullopt; }
 };
 
+/// @brief Concept for types that can be sent to PostgreSQL as binary bind parameters
+/// @details Such parameters carry an explicit type OID, so the server neither parses their text
+/// nor has to infer their type from the surrounding SQL.
+template <typename T>
+concept BinaryParamType = requires(const T& value, std::string& out) {
+  { column_traits<T>::pg_type_oid } -> std::convertible_to<uint32_t>;
+  column_traits<T>::to_pg_binary(value, out);
+};
+
 // Concept for defining what is a valid SQL column type
 template <typename T>
 concept ColumnTypeConcept = requires {
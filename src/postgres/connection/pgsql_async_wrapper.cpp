@@ -13,6 +13,10 @@ static std::string convert_placeholders(const std::string& sql) {
 
 // Implementation of PreparedStatement methods
 boost::asio::awaitable<PgResult<void>> PreparedStatement::prepare() {
+  if (!conn_.running_on_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(conn_.strand(), prepare(), boost::asio::use_awaitable);
+  }
+
   if (prepared_) {
     co_return PgResult<void>{};
   }
@@ -20,31 +24,36 @@ boost::asio::awaitable<PgResult<void>> PreparedStatement::prepare() {
   // Convert ? placeholders to $n format
   const std::string pg_query = convert_placeholders(query_);
 
-  if (!PQsendPrepare(conn_.native_handle(), name_.c_str(), pg_query.c_str(), 0, nullptr)) {
-    co_return std::unexpected(PgError::from_conn(conn_.native_handle()));
-  }
-
-  auto flush_result = co_await conn_.flush_outgoing_data();
-  if (!flush_result) {
-    co_return std::unexpected(flush_result.error());
-  }
-
-  auto res_result = co_await conn_.get_query_result();
+  // Executions pipelined behind the Parse can use the statement before its result arrives,
+  // so mark it prepared up front and undo that if preparing fails
+  prepared_ = true;
+  auto res_result = co_await conn_.submit([&](PGconn* conn) {
+    return PQsendPrepare(conn, name_.c_str(), pg_query.c_str(),
+                         static_cast<int>(param_types_.size()),
+                         param_types_.empty() ? nullptr : param_types_.data()) == 1;
+  });
   if (!res_result) {
+    prepared_ = false;
     co_return std::unexpected(res_result.error());
   }
 
   if (!*res_result) {
+    prepared_ = false;
     co_return std::unexpected(PgError{.message = res_result->error_message(),
                                       .error_code = static_cast<int>(res_result->status())});
   }
 
-  prepared_ = true;
   co_return PgResult<void>{};
 }
 
 boost::asio::awaitable<PgResult<Result>> PreparedStatement::execute(
-    const std::vector<std::string>& params) {
+    const std::vector<std::string>& params, const relx::query::ParamTypes& types,
+    const connection::QueryOptions& options) {
+  if (!conn_.running_on_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(conn_.strand(), execute(params, types, options),
+                                             boost::asio::use_awaitable);
+  }
+
   if (!prepared_) {
     auto prepare_result = co_await prepare();
     if (!prepare_result) {
@@ -52,31 +61,25 @@ boost::asio::awaitable<PgResult<Result>> PreparedStatement::execute(
     }
   }
 
-  // Convert parameters
-  std::vector<const char*> values;
-  values.reserve(params.size());
-  for (const auto& param : params) {
-    values.push_back(param.c_str());
-  }
-
-  if (!PQsendQueryPrepared(conn_.native_handle(), name_.c_str(), static_cast<int>(values.size()),
-                           values.data(),
-                           nullptr,  // param lengths - null-terminated strings
-                           nullptr,  // param formats - text format
-                           0         // result format - text format
-                           )) {
-    co_return std::unexpected(PgError::from_conn(conn_.native_handle()));
-  }
-
-  auto flush_result = co_await conn_.flush_outgoing_data();
-  if (!flush_result) {
-    co_return std::unexpected(flush_result.error());
-  }
-
-  co_return co_await conn_.get_query_result();
+  const auto pg_params = relx::connection::sql_utils::make_pg_params(params, types);
+
+  co_return co_await conn_.submit(
+      [&](PGconn* conn) {
+        return PQsendQueryPrepared(conn, name_.c_str(), pg_params.count(),
+                                   pg_params.value_data(), pg_params.length_data(),
+                                   pg_params.formats,
+                                   0  // result format - text format
+                                   ) == 1;
+      },
+      options);
 }
 
 boost::asio::awaitable<PgResult<void>> PreparedStatement::deallocate() {
+  if (!conn_.running_on_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(conn_.strand(), deallocate(),
+                                             boost::asio::use_awaitable);
+  }
+
   if (!prepared_) {
     co_return PgResult<void>{};
   }
@@ -4,6 +4,7 @@
 
 #include <iostream>
 #include <regex>
+#include <utility>
 
 namespace relx::connection {
 
@@ -26,8 +27,15 @@ PostgreSQLAsyncConnection::~PostgreSQLAsyncConnection() {
 
 PostgreSQLAsyncConnection::PostgreSQLAsyncConnection(PostgreSQLAsyncConnection&& other) noexcept
     : io_context_(other.io_context_), connection_string_(std::move(other.connection_string_)),
-      async_conn_(std::move(other.async_conn_)), is_connected_(other.is_connected_) {
+      async_conn_(std::move(other.async_conn_)), is_connected_(other.is_connected_),
+      statement_cache_(std::move(other.statement_cache_)),
+      stale_statements_(std::move(other.stale_statements_)),
+      prepared_query_count_(other.prepared_query_count_),
+      session_settings_(std::move(other.session_settings_)), query_stats_(other.query_stats_),
+      conversion_executor_(std::move(other.conversion_executor_)),
+      offload_min_rows_(other.offload_min_rows_) {
   other.is_connected_ = false;
+  other.statement_cache_.reset();
 }
 
 PostgreSQLAsyncConnection& PostgreSQLAsyncConnection::operator=(
@@ -41,6 +49,14 @@ PostgreSQLAsyncConnection& PostgreSQLAsyncConnection::operator=(
     connection_string_ = std::move(other.connection_string_);
     async_conn_ = std::move(other.async_conn_);
     is_connected_ = other.is_connected_;
+    statement_cache_ = std::move(other.statement_cache_);
+    other.statement_cache_.reset();
+    stale_statements_ = std::move(other.stale_statements_);
+    prepared_query_count_ = other.prepared_query_count_;
+    session_settings_ = std::move(other.session_settings_);
+    query_stats_ = other.query_stats_;
+    conversion_executor_ = std::move(other.conversion_executor_);
+    offload_min_rows_ = other.offload_min_rows_;
 
     other.is_connected_ = false;
   }
@@ -56,15 +72,19 @@ bool PostgreSQLAsyncConnection::in_transaction() const {
 }
 
 boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncConnection::connect() {
-  if (is_connected()) {
-    co_return ConnectionResult<void>{};  // Already connected
-  }
-
   // Make sure the connection object exists
   if (!async_conn_) {
     async_conn_ = std::make_unique<pgsql_async_wrapper::Connection>(io_context_);
   }
 
+  if (off_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(strand(), connect(), boost::asio::use_awaitable);
+  }
+
+  if (is_connected()) {
+    co_return ConnectionResult<void>{};  // Already connected
+  }
+
   // Connect with a copy of the connection string
   const std::string conn_str_copy = connection_string_;
   auto connect_result = co_await async_conn_->connect(conn_str_copy);
@@ -80,6 +100,10 @@ boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncConnection::connec
 }
 
 boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncConnection::disconnect() {
+  if (off_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(strand(), disconnect(), boost::asio::use_awaitable);
+  }
+
   if (!is_connected()) {
     co_return ConnectionResult<void>{};  // Already disconnected
   }
@@ -88,12 +112,26 @@ boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncConnection::discon
     async_conn_->close();
   }
 
+  // Prepared statements and settings die with the session
+  if (statement_cache_) {
+    statement_cache_->clear();
+  }
+  session_settings_.clear();
+
   is_connected_ = false;
   co_return ConnectionResult<void>{};
 }
 
 boost::asio::awaitable<ConnectionResult<result::ResultSet>> PostgreSQLAsyncConnection::execute_raw(
-    std::string sql, std::vector<std::string> params) {
+    std::string sql, std::vector<std::string> params, QueryOptions options) {
+  // The timeout counts from the call, not from the hop onto the strand
+  options = options.started();
+  if (off_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(
+        strand(), execute_raw(std::move(sql), std::move(params), options),
+        boost::asio::use_awaitable);
+  }
+
   if (!is_connected()) {
     co_return std::unexpected(
         ConnectionError{.message = "Not connected to database", .error_code = -1});
@@ -108,7 +146,8 @@ boost::asio::awaitable<ConnectionResult<result::ResultSet>> PostgreSQLAsyncConne
   const std::string sql_copy = sql;
   const std::vector<std::string> params_copy = params;
 
-  auto pg_result = co_await async_conn_->query(sql_copy, params_copy);
+  auto pg_result = co_await async_conn_->query(sql_copy, params_copy, {}, options);
+  count_query(pg_result);
 
   if (!pg_result) {
     co_return std::unexpected(
@@ -117,16 +156,387 @@ boost::asio::awaitable<ConnectionResult<result::ResultSet>> PostgreSQLAsyncConne
   }
 
   // Convert the result to our ResultSet type
-  auto result_set = convert_result(*pg_result);
-  if (!result_set) {
-    co_return std::unexpected(result_set.error());
+  co_return co_await convert_offloaded(std::move(*pg_result));
+}
+
+boost::asio::awaitable<ConnectionResult<result::ResultSet>>
+PostgreSQLAsyncConnection::execute_query_sql(std::string sql, std::vector<std::string> params,
+                                             query::ParamTypes types, QueryOptions options) {
+  if (off_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(
+        strand(),
+        execute_query_sql(std::move(sql), std::move(params), std::move(types), options),
+        boost::asio::use_awaitable);
+  }
+
+  if (!is_connected()) {
+    co_return std::unexpected(
+        ConnectionError{.message = "Not connected to database", .error_code = -1});
   }
 
-  co_return *result_set;
+  if (!statement_cache_) {
+    auto pg_result = co_await async_conn_->query(sql, params, types, options);
+    count_query(pg_result);
+    if (!pg_result) {
+      co_return std::unexpected(
+          ConnectionError{.message = "Query execution failed: " + pg_result.error().message,
+                          .error_code = pg_result.error().error_code});
+    }
+    co_return co_await convert_offloaded(std::move(*pg_result));
+  }
+
+  const std::string key = StatementCache::key_for(sql, types.oids);
+  const auto entry = statement_cache_->acquire(key);
+  if (entry.evicted) {
+    // Deallocated in the round trip of the prepare below, which evictions always come with
+    async_conn_->release_prepared(*entry.evicted);
+  }
+
+  // Preparing first puts the Parse on the wire before anything can suspend, so concurrent
+  // executions of the same SQL that hit the cache are pipelined behind it
+  if (entry.needs_prepare) {
+    auto prepare_result = co_await async_conn_->prepare_statement(entry.name, sql, types.oids);
+    if (!prepare_result) {
+      statement_cache_->erase(key);
+      co_return std::unexpected(ConnectionError{.message = "Failed to prepare statement: " +
+                                                           prepare_result.error().message,
+                                                .error_code = prepare_result.error().error_code});
+    }
+  }
+
+  // The limits cover the execution only: a prepare that is given up on leaves the cache
+  // entry pointing at a statement that may never exist
+  auto pg_result = co_await async_conn_->execute_prepared(entry.name, params, types, options);
+
+  if (pg_result && pg_result->status() == PGRES_FATAL_ERROR) {
+    const char* sqlstate = PQresultErrorField(pg_result->get(), PG_DIAG_SQLSTATE);
+    if (StatementCache::is_stale_statement_error(sqlstate ? sqlstate : "",
+                                                 pg_result->error_message())) {
+      if (!async_conn_->in_transaction()) {
+        // Outside a transaction nothing was lost, so prepare the statement again and retry
+        statement_cache_->record_reprepare();
+        async_conn_->release_prepared(entry.name);
+        auto prepare_result = co_await async_conn_->prepare_statement(entry.name, sql, types.oids);
+        if (!prepare_result) {
+          statement_cache_->erase(key);
+          co_return std::unexpected(ConnectionError{
+              .message = "Failed to prepare statement: " + prepare_result.error().message,
+              .error_code = prepare_result.error().error_code});
+        }
+        pg_result = co_await async_conn_->execute_prepared(entry.name, params, types, options);
+      } else {
+        // The failed transaction has to be rolled back first; prepare afresh next time
+        statement_cache_->erase(key);
+      }
+    }
+  }
+  count_query(pg_result);
+
+  if (!pg_result) {
+    co_return std::unexpected(
+        ConnectionError{.message = "Query execution failed: " + pg_result.error().message,
+                        .error_code = pg_result.error().error_code});
+  }
+
+  co_return co_await convert_offloaded(std::move(*pg_result));
+}
+
+boost::asio::awaitable<ConnectionResult<std::vector<result::ResultSet>>>
+PostgreSQLAsyncConnection::execute_statements(
+    std::vector<pgsql_async_wrapper::Connection::Statement> statements, QueryOptions options) {
+  options = options.started();
+  if (off_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(
+        strand(), execute_statements(std::move(statements), options), boost::asio::use_awaitable);
+  }
+
+  if (!is_connected()) {
+    co_return std::unexpected(
+        ConnectionError{.message = "Not connected to database", .error_code = -1});
+  }
+
+  auto pg_results = co_await async_conn_->query_batch(std::move(statements), options);
+  if (!pg_results) {
+    count_query(std::unexpected(pg_results.error()));
+    co_return std::unexpected(
+        ConnectionError{.message = "Query execution failed: " + pg_results.error().message,
+                        .error_code = pg_results.error().error_code});
+  }
+
+  std::vector<result::ResultSet> result_sets;
+  result_sets.reserve(pg_results->size());
+  for (size_t i = 0; i < pg_results->size(); ++i) {
+    auto& pg_result = (*pg_results)[i];
+    sql_utils::count_query(query_stats_, pg_result.get());
+
+    // Only the first failure is reported; the statements after it were skipped by the server
+    auto result_set = co_await convert_offloaded(std::move(pg_result));
+    if (!result_set) {
+      co_return std::unexpected(ConnectionError{
+          .message = "Pipeline statement " + std::to_string(i) + " failed: " +
+                     result_set.error().message,
+          .error_code = result_set.error().error_code});
+    }
+    result_sets.push_back(std::move(*result_set));
+  }
+  co_return result_sets;
+}
+
+boost::asio::awaitable<ConnectionResult<result::ResultSet>>
+PostgreSQLAsyncConnection::convert_offloaded(pgsql_async_wrapper::Result pg_result) {
+  const auto rows = static_cast<size_t>(pg_result.rows());
+  co_return co_await offload(
+      rows, [pg_result = std::move(pg_result)] { return convert_result(pg_result); });
+}
+
+void PostgreSQLAsyncConnection::count_query(
+    const pgsql_async_wrapper::PgResult<pgsql_async_wrapper::Result>& pg_result) {
+  sql_utils::count_query(query_stats_, pg_result ? pg_result->get() : nullptr);
+  if (!pg_result && pg_result.error().error_code == query_cancelled_error) {
+    ++query_stats_.timeouts;
+  }
+}
+
+boost::asio::awaitable<ConnectionResult<std::string>>
+PostgreSQLAsyncConnection::prepare_query_sql(std::string sql, query::ParamTypes types) {
+  if (off_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(
+        strand(), prepare_query_sql(std::move(sql), std::move(types)), boost::asio::use_awaitable);
+  }
+
+  if (!is_connected()) {
+    co_return std::unexpected(
+        ConnectionError{.message = "Not connected to database", .error_code = -1});
+  }
+
+  // Statements of destroyed prepared queries are deallocated in the round trip of this prepare
+  std::vector<std::string> stale;
+  {
+    const std::lock_guard lock(stale_mutex_);
+    stale = std::exchange(stale_statements_, {});
+  }
+  for (const auto& stale_name : stale) {
+    async_conn_->release_prepared(stale_name);
+  }
+
+  std::string name = "relx_query_" + std::to_string(++prepared_query_count_);
+  auto prepare_result = co_await async_conn_->prepare_statement(name, sql, std::move(types.oids));
+  if (!prepare_result) {
+    co_return std::unexpected(ConnectionError{
+        .message = "Failed to prepare statement: " + prepare_result.error().message,
+        .error_code = prepare_result.error().error_code});
+  }
+  co_return name;
+}
+
+boost::asio::awaitable<ConnectionResult<result::ResultSet>>
+PostgreSQLAsyncConnection::execute_prepared_query(std::string name,
+                                                  std::vector<std::string> params,
+                                                  query::ParamTypes types,
+                                                  QueryOptions options) {
+  options = options.started();
+  if (off_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(
+        strand(),
+        execute_prepared_query(std::move(name), std::move(params), std::move(types), options),
+        boost::asio::use_awaitable);
+  }
+
+  if (!is_connected()) {
+    co_return std::unexpected(
+        ConnectionError{.message = "Not connected to database", .error_code = -1});
+  }
+
+  auto pg_result = co_await async_conn_->execute_prepared(name, params, types, options);
+  count_query(pg_result);
+  if (!pg_result) {
+    co_return std::unexpected(
+        ConnectionError{.message = "Query execution failed: " + pg_result.error().message,
+                        .error_code = pg_result.error().error_code});
+  }
+  co_return co_await convert_offloaded(std::move(*pg_result));
+}
+
+boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncConnection::apply_session_setup(
+    SessionSetup setup) {
+  namespace asio = boost::asio;
+
+  if (off_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(strand(), apply_session_setup(std::move(setup)),
+                                             boost::asio::use_awaitable);
+  }
+
+  if (!is_connected()) {
+    co_return std::unexpected(
+        ConnectionError{.message = "Not connected to database", .error_code = -1});
+  }
+
+  /// Counts off the statements still in flight and wakes the caller after the last one
+  struct Batch {
+    explicit Batch(const pgsql_async_wrapper::Connection::Strand& strand)
+        : done(strand, asio::steady_timer::time_point::max()) {}
+
+    asio::steady_timer done;
+    size_t remaining = 0;
+    std::optional<ConnectionError> error;
+  };
+  auto batch = std::make_shared<Batch>(strand());
+  auto finish = [batch](std::exception_ptr exception, std::optional<ConnectionError> error) {
+    if (exception && !error) {
+      error = ConnectionError{.message = "Session setup statement failed", .error_code = -1};
+    }
+    if (error && !batch->error) {
+      batch->error = std::move(error);
+    }
+    if (--batch->remaining == 0) {
+      batch->done.cancel();
+    }
+  };
+
+  // Every statement is started before any reply is awaited, so they are pipelined
+  std::vector<std::string> setting_params;
+  for (auto& [name, value] : setup.settings) {
+    if (session_setting(name) != value) {
+      setting_params.push_back(name);
+      setting_params.push_back(value);
+    }
+  }
+  if (!setting_params.empty()) {
+    ++batch->remaining;
+    asio::co_spawn(strand(),
+                   run_setup_statement({}, sql_utils::set_config_sql(setting_params.size() / 2),
+                                       setting_params, {}),
+                   finish);
+  }
+
+  std::vector<std::string> warmed_keys;
+  if (!setup.statements.empty()) {
+    enable_statement_cache(setup.statement_cache_capacity);
+    for (auto& statement : setup.statements) {
+      std::string key = StatementCache::key_for(statement.sql, statement.types.oids);
+      auto entry = statement_cache_->acquire(key);
+      if (entry.evicted) {
+        release_prepared_query(std::move(*entry.evicted));
+      }
+      if (entry.needs_prepare) {
+        ++batch->remaining;
+        asio::co_spawn(strand(),
+                       run_setup_statement(entry.name, std::move(statement.sql), {},
+                                           std::move(statement.types)),
+                       finish);
+        warmed_keys.push_back(std::move(key));
+      }
+    }
+  }
+
+  if (batch->remaining > 0) {
+    boost::system::error_code ec;
+    co_await batch->done.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+  }
+
+  if (batch->error) {
+    for (const auto& key : warmed_keys) {
+      statement_cache_->erase(key);
+    }
+    co_return std::unexpected(*batch->error);
+  }
+
+  // Settings made inside a transaction are undone by a rollback, so they are not tracked
+  for (size_t i = 0; i < setting_params.size(); i += 2) {
+    if (in_transaction()) {
+      session_settings_.erase(setting_params[i]);
+    } else {
+      session_settings_[setting_params[i]] = setting_params[i + 1];
+    }
+  }
+  co_return ConnectionResult<void>{};
+}
+
+boost::asio::awaitable<std::optional<ConnectionError>>
+PostgreSQLAsyncConnection::run_setup_statement(std::string statement_name, std::string sql,
+                                               std::vector<std::string> params,
+                                               query::ParamTypes types) {
+  if (!statement_name.empty()) {
+    auto prepare_result =
+        co_await async_conn_->prepare_statement(statement_name, sql, std::move(types.oids));
+    if (!prepare_result) {
+      co_return ConnectionError{.message = "Failed to prepare statement: " +
+                                           prepare_result.error().message,
+                                .error_code = prepare_result.error().error_code};
+    }
+    co_return std::nullopt;
+  }
+
+  auto pg_result = co_await async_conn_->query(sql, params, types);
+  if (!pg_result) {
+    co_return ConnectionError{.message = "Query execution failed: " + pg_result.error().message,
+                              .error_code = pg_result.error().error_code};
+  }
+  if (auto result_set = convert_result(*pg_result); !result_set) {
+    co_return result_set.error();
+  }
+  co_return std::nullopt;
+}
+
+boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncConnection::set_session(
+    std::string name, std::string value) {
+  SessionSetup setup;
+  setup.settings.emplace_back(std::move(name), std::move(value));
+  co_return co_await apply_session_setup(std::move(setup));
+}
+
+std::optional<std::string> PostgreSQLAsyncConnection::session_setting(
+    const std::string& name) const {
+  if (auto it = session_settings_.find(name); it != session_settings_.end()) {
+    return it->second;
+  }
+  return std::nullopt;
+}
+
+void PostgreSQLAsyncConnection::enable_statement_cache(size_t capacity) {
+  if (!statement_cache_) {
+    statement_cache_.emplace(capacity);
+  }
+}
+
+boost::asio::awaitable<ConnectionResult<void>>
+PostgreSQLAsyncConnection::disable_statement_cache() {
+  if (off_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(strand(), disable_statement_cache(),
+                                             boost::asio::use_awaitable);
+  }
+
+  if (!statement_cache_) {
+    co_return ConnectionResult<void>{};
+  }
+
+  const auto names = statement_cache_->names();
+  statement_cache_.reset();
+
+  if (!is_connected()) {
+    co_return ConnectionResult<void>{};
+  }
+
+  for (const auto& name : names) {
+    auto deallocate_result = co_await async_conn_->deallocate_prepared(name);
+    if (!deallocate_result) {
+      co_return std::unexpected(
+          ConnectionError{.message = "Failed to deallocate statement: " +
+                                     deallocate_result.error().message,
+                          .error_code = deallocate_result.error().error_code});
+    }
+  }
+
+  co_return ConnectionResult<void>{};
 }
 
 boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncConnection::begin_transaction(
     IsolationLevel isolation_level) {
+  if (off_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(strand(), begin_transaction(isolation_level),
+                                             boost::asio::use_awaitable);
+  }
+
   if (!is_connected()) {
     co_return std::unexpected(
         ConnectionError{.message = "Not connected to database", .error_code = -1});
@@ -166,6 +576,11 @@ boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncConnection::begin_
 }
 
 boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncConnection::commit_transaction() {
+  if (off_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(strand(), commit_transaction(),
+                                             boost::asio::use_awaitable);
+  }
+
   if (!is_connected()) {
     co_return std::unexpected(
         ConnectionError{.message = "Not connected to database", .error_code = -1});
@@ -188,6 +603,11 @@ boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncConnection::commit
 }
 
 boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncConnection::rollback_transaction() {
+  if (off_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(strand(), rollback_transaction(),
+                                             boost::asio::use_awaitable);
+  }
+
   if (!is_connected()) {
     co_return std::unexpected(
         ConnectionError{.message = "Not connected to database", .error_code = -1});
@@ -209,7 +629,34 @@ boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncConnection::rollba
   co_return ConnectionResult<void>{};
 }
 
+ConnectionResult<void> PostgreSQLAsyncConnection::defer_raw(std::string sql,
+                                                            std::vector<std::string> params,
+                                                            query::ParamTypes types) {
+  if (!is_connected()) {
+    return std::unexpected(
+        ConnectionError{.message = "Not connected to database", .error_code = -1});
+  }
+
+  if (!params.empty()) {
+    sql = convert_placeholders(sql);
+  }
+
+  auto defer_result = async_conn_->defer(std::move(sql), std::move(params), std::move(types));
+  if (!defer_result) {
+    return std::unexpected(
+        ConnectionError{.message = "Deferred statements require an active transaction",
+                        .error_code = defer_result.error().error_code});
+  }
+
+  return {};
+}
+
 boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncConnection::reset_connection_state() {
+  if (off_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(strand(), reset_connection_state(),
+                                             boost::asio::use_awaitable);
+  }
+
   if (!is_connected()) {
     co_return ConnectionResult<void>{};  // Nothing to reset if not connected
   }
@@ -223,6 +670,18 @@ boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncConnection::reset_
     co_return ConnectionResult<void>{};
   }
 
+  // Wait out queries abandoned by a timeout or cancellation, which are still in flight
+  if (async_conn_->pending_queries() > 0) {
+    [[maybe_unused]] auto drained = co_await async_conn_->flush_deferred();
+  }
+
+  // Anything still running is a stream abandoned without its cleanup; cancel it rather than
+  // read every remaining row, unless the cancel would abort a transaction. The request is sent
+  // by the cancel worker thread, so the strand goes on draining meanwhile
+  if (!async_conn_->in_transaction() && !sql_utils::discard_available_results(pg_conn)) {
+    async_conn_->request_cancel();
+  }
+
   try {
     // Consume any remaining results from the connection to clean up the state
     while (true) {
@@ -250,7 +709,7 @@ boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncConnection::reset_
         
         boost::system::error_code ec;
         co_await (*socket_result)->async_wait(
-            boost::asio::ip::tcp::socket::wait_read,
+            boost::asio::posix::stream_descriptor::wait_read,
             boost::asio::redirect_error(boost::asio::use_awaitable, ec));
 
         if (ec) {
@@ -0,0 +1,281 @@
+#include "relx/connection/postgresql_async_connection_pool.hpp"
+
+#include <algorithm>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+namespace relx::connection {
+
+namespace asio = boost::asio;
+
+PostgreSQLAsyncConnectionPool::PostgreSQLAsyncConnectionPool(
+    asio::io_context& io_context, PostgreSQLAsyncConnectionPoolConfig config)
+    : io_context_(io_context), config_(std::move(config)), strand_(asio::make_strand(io_context)),
+      metrics_(config_.metrics_sink) {}
+
+asio::awaitable<ConnectionPoolResult<void>> PostgreSQLAsyncConnectionPool::initialize() {
+  auto self = shared_from_this();
+
+  size_t to_open = 0;
+  {
+    const std::lock_guard<std::mutex> lock(pool_mutex_);
+    const size_t target = std::min(config_.initial_size, config_.max_size);
+    to_open = target > total_connections_ ? target - total_connections_ : 0;
+    total_connections_ += to_open;
+  }
+
+  for (size_t i = 0; i < to_open; ++i) {
+    auto connection = make_connection();
+    auto result = co_await connect(self, connection);
+    if (!result) {
+      {
+        // Give back the slots reserved for this and the remaining connections
+        const std::lock_guard<std::mutex> lock(pool_mutex_);
+        total_connections_ -= to_open - i;
+      }
+      co_return std::unexpected(ConnectionPoolError{
+          .message = "Failed to initialize connection pool: " + result.error().message,
+          .error_code = result.error().error_code});
+    }
+    release(std::move(connection));
+  }
+
+  co_return ConnectionPoolResult<void>{};
+}
+
+asio::awaitable<ConnectionPoolResult<PostgreSQLAsyncConnectionPool::PooledConnection>>
+PostgreSQLAsyncConnectionPool::acquire() {
+  return acquire(config_.connection_timeout);
+}
+
+asio::awaitable<ConnectionPoolResult<PostgreSQLAsyncConnectionPool::PooledConnection>>
+PostgreSQLAsyncConnectionPool::acquire(std::chrono::milliseconds timeout) {
+  auto self = shared_from_this();
+
+  if (config_.max_size == 0) {
+    co_return std::unexpected(
+        ConnectionPoolError{.message = "Connection pool has no capacity", .error_code = -1});
+  }
+
+  if (metrics_.report_due()) {
+    metrics_.report(metrics());
+  }
+  const auto started = std::chrono::steady_clock::now();
+
+  // The expiry is set before the waiter is visible to other threads
+  auto waiter = std::make_shared<Waiter>(strand_);
+  waiter->timer.expires_after(timeout);
+
+  std::shared_ptr<PostgreSQLAsyncConnection> connection;
+  bool open_new = false;
+  {
+    const std::lock_guard<std::mutex> lock(pool_mutex_);
+    if (!idle_.empty()) {
+      connection = std::move(idle_.back());
+      idle_.pop_back();
+      ++active_connections_;
+    } else {
+      if (total_connections_ < config_.max_size) {
+        ++total_connections_;
+        open_new = true;
+      }
+      waiters_.push_back(waiter);
+    }
+  }
+
+  if (connection) {
+    metrics_.checkout_wait.record(std::chrono::steady_clock::now() - started);
+    metrics_.checkouts.add();
+    co_return PooledConnection(std::move(connection), self);
+  }
+
+  if (open_new) {
+    asio::co_spawn(io_context_, open_connection(self), asio::detached);
+  }
+
+  // Wait on the strand, so the check and starting the wait cannot interleave with a cancel
+  // posted by wake()
+  co_await asio::co_spawn(strand_, wait_on_strand(self, waiter), asio::use_awaitable);
+
+  {
+    const std::lock_guard<std::mutex> lock(pool_mutex_);
+    if (waiter->connection) {
+      connection = std::move(waiter->connection);
+    } else if (!waiter->error) {
+      // Timed out; a connection handed over later goes to the next waiter instead
+      std::erase(waiters_, waiter);
+    }
+  }
+
+  metrics_.checkout_wait.record(std::chrono::steady_clock::now() - started);
+  if (connection) {
+    metrics_.checkouts.add();
+    co_return PooledConnection(std::move(connection), self);
+  }
+  if (waiter->error) {
+    co_return std::unexpected(*waiter->error);
+  }
+  metrics_.checkout_timeouts.add();
+  co_return std::unexpected(ConnectionPoolError{.message = "Timed out waiting for a connection",
+                                                .error_code = pool_timeout_error});
+}
+
+asio::awaitable<void> PostgreSQLAsyncConnectionPool::wait_on_strand(
+    std::shared_ptr<PostgreSQLAsyncConnectionPool> self, std::shared_ptr<Waiter> waiter) {
+  {
+    const std::lock_guard<std::mutex> lock(self->pool_mutex_);
+    if (waiter->connection || waiter->error) {
+      co_return;
+    }
+  }
+  boost::system::error_code ec;
+  co_await waiter->timer.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+}
+
+PoolMetrics PostgreSQLAsyncConnectionPool::metrics() const {
+  auto snapshot = metrics_.snapshot();
+  const std::lock_guard<std::mutex> lock(pool_mutex_);
+  snapshot.active_connections = active_connections_;
+  snapshot.idle_connections = idle_.size();
+  snapshot.total_connections = total_connections_;
+  return snapshot;
+}
+
+size_t PostgreSQLAsyncConnectionPool::active_connections() const {
+  const std::lock_guard<std::mutex> lock(pool_mutex_);
+  return active_connections_;
+}
+
+size_t PostgreSQLAsyncConnectionPool::idle_connections() const {
+  const std::lock_guard<std::mutex> lock(pool_mutex_);
+  return idle_.size();
+}
+
+size_t PostgreSQLAsyncConnectionPool::waiting() const {
+  const std::lock_guard<std::mutex> lock(pool_mutex_);
+  return waiters_.size();
+}
+
+asio::awaitable<void> PostgreSQLAsyncConnectionPool::open_connection(
+    std::shared_ptr<PostgreSQLAsyncConnectionPool> self) {
+  auto connection = self->make_connection();
+  auto result = co_await connect(self, connection);
+  if (!result) {
+    self->discard(ConnectionPoolError{
+        .message = "Failed to connect to database: " + result.error().message,
+        .error_code = result.error().error_code});
+    co_return;
+  }
+  self->release(std::move(connection));
+}
+
+void PostgreSQLAsyncConnectionPool::return_connection(
+    std::shared_ptr<PostgreSQLAsyncConnection> connection) {
+  {
+    const std::lock_guard<std::mutex> lock(pool_mutex_);
+    --active_connections_;
+  }
+
+  if (!connection->is_connected()) {
+    discard(std::nullopt);
+    return;
+  }
+
+  if (connection->in_transaction()) {
+    asio::co_spawn(io_context_, roll_back_and_return(shared_from_this(), std::move(connection)),
+                   asio::detached);
+    return;
+  }
+
+  release(std::move(connection));
+}
+
+asio::awaitable<void> PostgreSQLAsyncConnectionPool::roll_back_and_return(
+    std::shared_ptr<PostgreSQLAsyncConnectionPool> self,
+    std::shared_ptr<PostgreSQLAsyncConnection> connection) {
+  auto result = co_await connection->rollback_transaction();
+  if (!result || !connection->is_connected()) {
+    self->discard(std::nullopt);
+    co_return;
+  }
+  self->release(std::move(connection));
+}
+
+void PostgreSQLAsyncConnectionPool::release(std::shared_ptr<PostgreSQLAsyncConnection> connection) {
+  std::shared_ptr<Waiter> waiter;
+  {
+    const std::lock_guard<std::mutex> lock(pool_mutex_);
+    if (waiters_.empty()) {
+      idle_.push_back(std::move(connection));
+      return;
+    }
+
+    waiter = std::move(waiters_.front());
+    waiters_.pop_front();
+    waiter->connection = std::move(connection);
+    ++active_connections_;
+  }
+  wake(waiter);
+}
+
+void PostgreSQLAsyncConnectionPool::discard(std::optional<ConnectionPoolError> error) {
+  std::shared_ptr<Waiter> failed;
+  bool open_new = false;
+  {
+    const std::lock_guard<std::mutex> lock(pool_mutex_);
+    --total_connections_;
+    if (!error) {
+      // Only an open connection is discarded without an error
+      metrics_.connections_closed.add();
+    }
+    if (!waiters_.empty()) {
+      if (error) {
+        // Opening a connection for the waiter failed; report it rather than retry forever
+        failed = std::move(waiters_.front());
+        waiters_.pop_front();
+        failed->error = std::move(error);
+      } else if (total_connections_ < config_.max_size) {
+        ++total_connections_;
+        open_new = true;
+      }
+    }
+  }
+
+  if (failed) {
+    wake(failed);
+  }
+  if (open_new) {
+    asio::co_spawn(io_context_, open_connection(shared_from_this()), asio::detached);
+  }
+}
+
+void PostgreSQLAsyncConnectionPool::wake(const std::shared_ptr<Waiter>& waiter) {
+  asio::post(strand_, [waiter] { waiter->timer.cancel(); });
+}
+
+std::shared_ptr<PostgreSQLAsyncConnection> PostgreSQLAsyncConnectionPool::make_connection() const {
+  return std::make_shared<PostgreSQLAsyncConnection>(io_context_, config_.connection_params);
+}
+
+asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncConnectionPool::connect(
+    std::shared_ptr<PostgreSQLAsyncConnectionPool> self,
+    std::shared_ptr<PostgreSQLAsyncConnection> connection) {
+  const auto started = std::chrono::steady_clock::now();
+  auto result = co_await connection->connect();
+  if (result) {
+    result = co_await connection->apply_session_setup(self->config_.session_setup);
+  }
+  if (!result) {
+    self->metrics_.connect_failures.add();
+    co_return result;
+  }
+  self->metrics_.connect_latency.record(std::chrono::steady_clock::now() - started);
+  self->metrics_.connections_opened.add();
+  co_return result;
+}
+
+}  // namespace relx::connection
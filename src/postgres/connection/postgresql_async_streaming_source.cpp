@@ -67,6 +67,11 @@ PostgreSQLAsyncStreamingSource& PostgreSQLAsyncStreamingSource::operator=(
 }
 
 boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncStreamingSource::initialize() {
+  if (!connection_.get_async_conn().running_on_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(connection_.strand(), initialize(),
+                                             boost::asio::use_awaitable);
+  }
+
   if (initialized_) {
     co_return ConnectionResult<void>{};
   }
@@ -81,6 +86,11 @@ boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncStreamingSource::i
 }
 
 boost::asio::awaitable<std::optional<std::string>> PostgreSQLAsyncStreamingSource::get_next_row() {
+  if (!connection_.get_async_conn().running_on_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(connection_.strand(), get_next_row(),
+                                             boost::asio::use_awaitable);
+  }
+
   if (!initialized_) {
     auto init_result = co_await initialize();
     if (!init_result) {
@@ -157,7 +167,7 @@ boost::asio::awaitable<std::optional<std::string>> PostgreSQLAsyncStreamingSourc
       
       boost::system::error_code ec;
       co_await (*socket_result)->async_wait(
-          boost::asio::ip::tcp::socket::wait_read,
+          boost::asio::posix::stream_descriptor::wait_read,
           boost::asio::redirect_error(boost::asio::use_awaitable, ec));
 
       if (ec) {
@@ -187,6 +197,13 @@ boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncStreamingSource::s
     co_return std::unexpected(ConnectionError{.message = "Invalid connection", .error_code = -1});
   }
 
+  // Streaming bypasses the pipeline, so a deferred BEGIN has to be sent first
+  auto flush_result = co_await connection_.get_async_conn().flush_deferred();
+  if (!flush_result) {
+    co_return std::unexpected(ConnectionError{.message = flush_result.error().message,
+                                              .error_code = flush_result.error().error_code});
+  }
+
   try {
     int result_code;
 
@@ -282,7 +299,7 @@ boost::asio::awaitable<ConnectionResult<void>> PostgreSQLAsyncStreamingSource::s
       
       boost::system::error_code ec;
       co_await (*socket_result)->async_wait(
-          boost::asio::ip::tcp::socket::wait_read,
+          boost::asio::posix::stream_descriptor::wait_read,
           boost::asio::redirect_error(boost::asio::use_awaitable, ec));
 
       if (ec) {
@@ -367,11 +384,24 @@ std::string PostgreSQLAsyncStreamingSource::convert_pg_bytea_to_binary(
   return binary_result;
 }
 
+void PostgreSQLAsyncStreamingSource::cancel_remaining_rows(PGconn* pg_conn) {
+  // Stopping early: rather than transfer and discard every remaining row, ask the server to
+  // cancel the query, unless the rest has already arrived. The request does not block the
+  // strand; the cancel worker thread sends it. Inside a transaction the cancel would abort the
+  // transaction, so the rows are drained as before.
+  auto& async_conn = connection_.get_async_conn();
+  if (!finished_ && !async_conn.in_transaction() &&
+      !sql_utils::discard_available_results(pg_conn)) {
+    async_conn.request_cancel();
+  }
+}
+
 void PostgreSQLAsyncStreamingSource::cleanup() {
   if (query_active_) {
-    // Consume any remaining results to clean up the connection state
     PGconn* pg_conn = connection_.get_async_conn().native_handle();
     if (pg_conn) {
+      // Cancel the rest of an abandoned stream so the blocking drain below stays short
+      cancel_remaining_rows(pg_conn);
       PGresult* result;
       while ((result = PQgetResult(pg_conn)) != nullptr) {
         PQclear(result);
@@ -387,6 +417,11 @@ void PostgreSQLAsyncStreamingSource::cleanup() {
 }
 
 boost::asio::awaitable<void> PostgreSQLAsyncStreamingSource::async_cleanup() {
+  if (!connection_.get_async_conn().running_on_strand(co_await boost::asio::this_coro::executor)) {
+    co_return co_await boost::asio::co_spawn(connection_.strand(), async_cleanup(),
+                                             boost::asio::use_awaitable);
+  }
+
   if (!query_active_) {
     co_return;
   }
@@ -398,6 +433,8 @@ boost::asio::awaitable<void> PostgreSQLAsyncStreamingSource::async_cleanup() {
     co_return;
   }
 
+  cancel_remaining_rows(pg_conn);
+
   try {
     // Asynchronously consume any remaining results to clean up the connection state
     while (query_active_) {
@@ -425,7 +462,7 @@ boost::asio::awaitable<void> PostgreSQLAsyncStreamingSource::async_cleanup() {
         
         boost::system::error_code ec;
         co_await (*socket_result)->async_wait(
-            boost::asio::ip::tcp::socket::wait_read,
+            boost::asio::posix::stream_descriptor::wait_read,
             boost::asio::redirect_error(boost::asio::use_awaitable, ec));
 
         if (ec) {
@@ -1,17 +1,27 @@
 #include "relx/connection/postgresql_connection.hpp"
 
 #include "relx/connection/meta.hpp"
+#include "relx/connection/postgresql_pipeline.hpp"
 #include "relx/connection/postgresql_statement.hpp"
 #include "relx/connection/sql_utils.hpp"
 
+#include <array>
+#include <chrono>
+#include <climits>
 #include <iostream>
 #include <regex>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 
 #include <libpq-fe.h>
+#include <poll.h>
 namespace relx::connection {
 
+/// How long a limited call waits for the server to answer its cancel request before the
+/// connection is closed instead
+constexpr auto cancel_grace_period = std::chrono::seconds(2);
+
 // RAII wrapper for PGresult
 class PGResultWrapper {
 public:
@@ -62,6 +72,51 @@ private:
   PGresult* result_;
 };
 
+/// Map the status of a PGresult from a single statement to a ConnectionResult
+static ConnectionResult<void> check_result_status(PGresult* result) {
+  const ExecStatusType status = PQresultStatus(result);
+
+  // Handle different result statuses
+  switch (status) {
+  case PGRES_COMMAND_OK:
+  case PGRES_TUPLES_OK:
+  case PGRES_SINGLE_TUPLE:
+    // These are all success cases
+    break;
+
+  case PGRES_EMPTY_QUERY:
+    return std::unexpected(ConnectionError{.message = "Empty query string was executed",
+                                           .error_code = static_cast<int>(status)});
+
+  case PGRES_NONFATAL_ERROR:
+    // Log the warning but continue processing
+    // TODO more customizable user behavior for this
+    std::cerr << "PostgreSQL warning: " << PQresultErrorMessage(result) << std::endl;
+    break;
+
+  case PGRES_COPY_IN:
+  case PGRES_COPY_OUT:
+  case PGRES_COPY_BOTH:
+    return std::unexpected(
+        ConnectionError{.message = "COPY operations are not supported in this context",
+                        .error_code = static_cast<int>(status)});
+
+  case PGRES_PIPELINE_SYNC:
+    return std::unexpected(
+        ConnectionError{.message = "Pipeline operations are not supported in this context",
+                        .error_code = static_cast<int>(status)});
+
+  case PGRES_BAD_RESPONSE:
+  case PGRES_FATAL_ERROR:
+  case PGRES_PIPELINE_ABORTED:
+    const std::string error_msg = PQresultErrorMessage(result);
+    return std::unexpected(ConnectionError{.message = "PostgreSQL error: " + error_msg,
+                                           .error_code = static_cast<int>(status)});
+  }
+
+  return {};
+}
+
 PostgreSQLConnection::PostgreSQLConnection(std::string_view connection_string)
     : connection_string_(connection_string) {}
 
@@ -74,7 +129,13 @@ PostgreSQLConnection::~PostgreSQLConnection() {
 
 PostgreSQLConnection::PostgreSQLConnection(PostgreSQLConnection&& other) noexcept
     : connection_string_(std::move(other.connection_string_)), pg_conn_(other.pg_conn_),
-      is_connected_(other.is_connected_), in_transaction_(other.in_transaction_) {
+      is_connected_(other.is_connected_), in_transaction_(other.in_transaction_),
+      deferred_begin_(std::move(other.deferred_begin_)), deferred_(std::move(other.deferred_)),
+      statement_cache_(std::move(other.statement_cache_)),
+      stale_statements_(std::move(other.stale_statements_)),
+      prepared_query_count_(other.prepared_query_count_),
+      session_settings_(std::move(other.session_settings_)), query_stats_(other.query_stats_),
+      cancel_(std::exchange(other.cancel_, nullptr)) {
   other.pg_conn_ = nullptr;
   other.is_connected_ = false;
   other.in_transaction_ = false;
@@ -87,6 +148,15 @@ PostgreSQLConnection& PostgreSQLConnection::operator=(PostgreSQLConnection&& oth
     pg_conn_ = other.pg_conn_;
     is_connected_ = other.is_connected_;
     in_transaction_ = other.in_transaction_;
+    deferred_begin_ = std::move(other.deferred_begin_);
+    deferred_ = std::move(other.deferred_);
+    statement_cache_ = std::move(other.statement_cache_);
+    stale_statements_ = std::move(other.stale_statements_);
+    prepared_query_count_ = other.prepared_query_count_;
+    session_settings_ = std::move(other.session_settings_);
+    query_stats_ = other.query_stats_;
+    cancel_ = std::exchange(other.cancel_, nullptr);
+    other.statement_cache_.reset();
     other.pg_conn_ = nullptr;
     other.is_connected_ = false;
     other.in_transaction_ = false;
@@ -114,11 +184,68 @@ ConnectionResult<void> PostgreSQLConnection::connect() {
   return {};
 }
 
+ConnectionResult<PostgreSQLConnection::ConnectState> PostgreSQLConnection::start_connect() {
+  if (is_connected_) {
+    return ConnectState::Connected;
+  }
+
+  pg_conn_ = PQconnectStart(connection_string_.c_str());
+  if (pg_conn_ == nullptr || PQstatus(pg_conn_) == CONNECTION_BAD) {
+    const std::string error_msg = pg_conn_ ? PQerrorMessage(pg_conn_) : "out of memory";
+    PQfinish(pg_conn_);
+    pg_conn_ = nullptr;
+    return std::unexpected(ConnectionError{
+        .message = "Failed to connect to PostgreSQL database: " + error_msg,
+        .error_code = static_cast<int>(CONNECTION_BAD)});
+  }
+
+  // libpq asks for the socket to be writable before the first poll
+  return ConnectState::WaitWrite;
+}
+
+ConnectionResult<PostgreSQLConnection::ConnectState> PostgreSQLConnection::continue_connect() {
+  if (is_connected_) {
+    return ConnectState::Connected;
+  }
+  if (pg_conn_ == nullptr) {
+    return std::unexpected(
+        ConnectionError{.message = "Connection was not started", .error_code = -1});
+  }
+
+  switch (PQconnectPoll(pg_conn_)) {
+    case PGRES_POLLING_READING:
+      return ConnectState::WaitRead;
+    case PGRES_POLLING_WRITING:
+      return ConnectState::WaitWrite;
+    case PGRES_POLLING_OK:
+      is_connected_ = true;
+      return ConnectState::Connected;
+    default: {
+      const std::string error_msg = PQerrorMessage(pg_conn_);
+      PQfinish(pg_conn_);
+      pg_conn_ = nullptr;
+      return std::unexpected(ConnectionError{
+          .message = "Failed to connect to PostgreSQL database: " + error_msg,
+          .error_code = static_cast<int>(CONNECTION_BAD)});
+    }
+  }
+}
+
+int PostgreSQLConnection::socket() const {
+  return pg_conn_ ? PQsocket(pg_conn_) : -1;
+}
+
 ConnectionResult<void> PostgreSQLConnection::disconnect() {
   if (!is_connected_ || !pg_conn_) {
+    // A connection abandoned part way through start_connect() still has to be freed
+    PQfinish(pg_conn_);
     is_connected_ = false;
     in_transaction_ = false;
+    deferred_begin_.clear();
+    deferred_.clear();
     pg_conn_ = nullptr;
+    PQfreeCancel(cancel_);
+    cancel_ = nullptr;
     return {};  // Already disconnected
   }
 
@@ -135,6 +262,15 @@ ConnectionResult<void> PostgreSQLConnection::disconnect() {
   is_connected_ = false;
   in_transaction_ = false;
   pg_conn_ = nullptr;
+  PQfreeCancel(cancel_);
+  cancel_ = nullptr;
+  session_settings_.clear();
+
+  // Prepared statements die with the session
+  if (statement_cache_) {
+    statement_cache_->clear();
+  }
+  stale_statements_.clear();
   return {};
 }
 
@@ -160,6 +296,160 @@ ConnectionResult<PGresult*> PostgreSQLConnection::handle_pg_result(PGresult* res
 constexpr bool ultra_verbose = false;
 ConnectionResult<result::ResultSet> PostgreSQLConnection::execute_raw(
     const std::string& sql, const std::vector<std::string>& params) {
+  return execute_params(sql, params, {});
+}
+
+ConnectionResult<result::ResultSet> PostgreSQLConnection::execute_raw(
+    const std::string& sql, const std::vector<std::string>& params, const QueryOptions& options) {
+  const LimitScope scope(*this, options);
+  return scope.finish(execute_params(sql, params, {}));
+}
+
+PostgreSQLConnection::LimitScope::LimitScope(PostgreSQLConnection& connection,
+                                             const QueryOptions& options)
+    : connection_(connection), previous_(connection.limits_) {
+  if (options.limited()) {
+    connection_.limits_ = options.started();
+  }
+  connection_.limit_reached_ = false;
+}
+
+PostgreSQLConnection::LimitScope::~LimitScope() {
+  connection_.limits_ = previous_;
+}
+
+ConnectionError PostgreSQLConnection::LimitScope::limit_error() const {
+  const auto* token = connection_.limits_ ? connection_.limits_->cancel_token : nullptr;
+  const bool cancelled = token != nullptr && token->is_cancelled();
+  return ConnectionError{.message = cancelled ? "Query cancelled" : "Query timed out",
+                         .error_code = query_cancelled_error};
+}
+
+PGresult* PostgreSQLConnection::exec_simple(const char* sql) {
+  if (!limits_) {
+    return PQexec(pg_conn_, sql);
+  }
+  return exec_limited([&] { return PQsendQuery(pg_conn_, sql) == 1; });
+}
+
+PGresult* PostgreSQLConnection::exec_limited(const std::function<bool()>& send) {
+  if (limits_expired() || !send()) {
+    return nullptr;
+  }
+
+  // Collect the results the way PQexec does, without blocking past the deadline
+  auto wait = begin_limited_wait();
+  PGresult* last_result = nullptr;
+  while (PQconsumeInput(pg_conn_) == 1) {
+    bool finished = false;
+    while (!finished && PQisBusy(pg_conn_) == 0) {
+      PGresult* result = PQgetResult(pg_conn_);
+      if (result == nullptr) {
+        finished = true;
+        break;
+      }
+      PQclear(last_result);
+      last_result = result;
+      const auto status = PQresultStatus(result);
+      finished = status == PGRES_COPY_IN || status == PGRES_COPY_OUT || status == PGRES_COPY_BOTH;
+    }
+    if (finished) {
+      break;
+    }
+
+    if (!wait_for_input(wait)) {
+      PQclear(last_result);
+      return nullptr;
+    }
+  }
+
+  end_limited_wait();
+  return last_result;
+}
+
+bool PostgreSQLConnection::limits_expired() {
+  const CancelToken* token = limits_->cancel_token;
+  if ((token != nullptr && token->is_cancelled()) ||
+      std::chrono::steady_clock::now() >= limits_->expiry()) {
+    limit_reached_ = true;
+    return true;
+  }
+  return false;
+}
+
+PostgreSQLConnection::LimitedWait PostgreSQLConnection::begin_limited_wait() {
+  if (cancel_ == nullptr) {
+    cancel_ = PQgetCancel(pg_conn_);
+  }
+  if (CancelToken* token = limits_->cancel_token; token != nullptr) {
+    // PQcancel opens its own connection to the server, so any thread may call it
+    token->attach([cancel = cancel_] {
+      std::array<char, 256> error_buffer{};
+      PQcancel(cancel, error_buffer.data(), static_cast<int>(error_buffer.size()));
+    });
+  }
+  return LimitedWait{.deadline = limits_->expiry()};
+}
+
+bool PostgreSQLConnection::wait_for_input(LimitedWait& wait) {
+  CancelToken* token = limits_->cancel_token;
+  const auto now = std::chrono::steady_clock::now();
+  if (!wait.cancel_sent && token != nullptr && token->is_cancelled()) {
+    // cancel() already sent the cancel request
+    wait.cancel_sent = true;
+    wait.deadline = std::min(wait.deadline, now + cancel_grace_period);
+  } else if (now >= wait.deadline) {
+    if (wait.cancel_sent) {
+      // The server did not answer the cancel request either, so the connection is lost
+      if (token != nullptr) {
+        token->detach();
+      }
+      limit_reached_ = true;
+      in_transaction_ = false;
+      deferred_begin_.clear();
+      deferred_.clear();
+      disconnect();
+      return false;
+    }
+    request_cancel();
+    wait.cancel_sent = true;
+    limit_reached_ = true;
+    wait.deadline = now + cancel_grace_period;
+  }
+
+  int timeout_ms = -1;
+  if (wait.deadline != std::chrono::steady_clock::time_point::max()) {
+    const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(wait.deadline - now);
+    timeout_ms = static_cast<int>(std::min<int64_t>(remaining.count(), INT_MAX));
+  }
+  pollfd pfd{.fd = PQsocket(pg_conn_), .events = POLLIN, .revents = 0};
+  // An interrupted poll just goes round the loop again
+  poll(&pfd, 1, timeout_ms);
+  return true;
+}
+
+void PostgreSQLConnection::end_limited_wait() {
+  if (CancelToken* token = limits_->cancel_token; token != nullptr) {
+    token->detach();
+    limit_reached_ = limit_reached_ || token->is_cancelled();
+  }
+}
+
+bool PostgreSQLConnection::request_cancel() {
+  if (pg_conn_ == nullptr) {
+    return false;
+  }
+  if (cancel_ == nullptr) {
+    cancel_ = PQgetCancel(pg_conn_);
+  }
+  std::array<char, 256> error_buffer{};
+  return cancel_ != nullptr &&
+         PQcancel(cancel_, error_buffer.data(), static_cast<int>(error_buffer.size())) == 1;
+}
+
+ConnectionResult<result::ResultSet> PostgreSQLConnection::execute_params(
+    const std::string& sql, const std::vector<std::string>& params,
+    const query::ParamTypes& types) {
   if constexpr (ultra_verbose) {
     std::cout << "Executing raw SQL: " << sql << std::endl;
     for (const auto& param : params) {
@@ -179,78 +469,52 @@ ConnectionResult<result::ResultSet> PostgreSQLConnection::execute_raw(
                                            .error_code = static_cast<int>(PQstatus(pg_conn_))});
   }
 
+  if (!deferred_.empty() || (!deferred_begin_.empty() && !params.empty())) {
+    // Send the deferred statements and this one as a single pipeline
+    auto batch = pipeline();
+    batch.add_raw(sql, params, types);
+    auto results = batch.sync();
+    if (!results) {
+      return std::unexpected(results.error());
+    }
+    return std::move(results->back());
+  }
+
   PGResultWrapper pg_result(nullptr);
 
   if (params.empty()) {
-    // Execute without parameters
-    pg_result = PGResultWrapper(PQexec(pg_conn_, sql.c_str()));
+    // Execute without parameters. A deferred BEGIN rides along in the same simple query.
+    if (!deferred_begin_.empty()) {
+      const std::string batch_sql = deferred_begin_ + "; " + sql;
+      deferred_begin_.clear();
+      pg_result = PGResultWrapper(exec_simple(batch_sql.c_str()));
+    } else {
+      pg_result = PGResultWrapper(exec_simple(sql.c_str()));
+    }
   } else {
     // Convert ? placeholders to $1, $2, etc.
     const std::string pg_sql = convert_placeholders(sql);
-
-    // Prepare parameter values array
-    std::vector<const char*> param_values;
-    param_values.reserve(params.size());
-
-    for (const auto& param : params) {
-      param_values.push_back(param.c_str());
-    }
-
-    // Execute with parameters
-    pg_result = PGResultWrapper(PQexecParams(pg_conn_, pg_sql.c_str(),
-                                             static_cast<int>(params.size()),
-                                             nullptr,  // Use default parameter types
-                                             param_values.data(),
-                                             nullptr,  // All parameters are text format
-                                             nullptr,  // All parameters are text format
-                                             0         // Use text format for results
-                                             ));
+    const auto pg_params = sql_utils::make_pg_params(params, types);
+
+    // Execute with parameters; PQsendQueryParams takes the same arguments when limited
+    auto run = [&](auto libpq_function) {
+      return libpq_function(pg_conn_, pg_sql.c_str(), pg_params.count(), pg_params.types,
+                            pg_params.value_data(), pg_params.length_data(), pg_params.formats,
+                            0  // Use text format for results
+      );
+    };
+    pg_result = PGResultWrapper(limits_ ? exec_limited([&] { return run(PQsendQueryParams) == 1; })
+                                        : run(PQexecParams));
   }
+  sql_utils::count_query(query_stats_, pg_result.get());
 
   // Check if memory allocation failed
   if (!pg_result.get()) {
     return std::unexpected(ConnectionError{.message = "Failed to execute query", .error_code = -1});
   }
 
-  // Handle the result
-  const ExecStatusType status = PQresultStatus(pg_result.get());
-
-  // Handle different result statuses
-  switch (status) {
-  case PGRES_COMMAND_OK:
-  case PGRES_TUPLES_OK:
-  case PGRES_SINGLE_TUPLE:
-    // These are all success cases
-    break;
-
-  case PGRES_EMPTY_QUERY:
-    return std::unexpected(ConnectionError{.message = "Empty query string was executed",
-                                           .error_code = static_cast<int>(status)});
-
-  case PGRES_NONFATAL_ERROR:
-    // Log the warning but continue processing
-    // TODO more customizable user behavior for this
-    std::cerr << "PostgreSQL warning: " << PQresultErrorMessage(pg_result.get()) << std::endl;
-    break;
-
-  case PGRES_COPY_IN:
-  case PGRES_COPY_OUT:
-  case PGRES_COPY_BOTH:
-    return std::unexpected(
-        ConnectionError{.message = "COPY operations are not supported in this context",
-                        .error_code = static_cast<int>(status)});
-
-  case PGRES_PIPELINE_SYNC:
-    return std::unexpected(
-        ConnectionError{.message = "Pipeline operations are not supported in this context",
-                        .error_code = static_cast<int>(status)});
-
-  case PGRES_BAD_RESPONSE:
-  case PGRES_FATAL_ERROR:
-  case PGRES_PIPELINE_ABORTED:
-    const std::string error_msg = PQresultErrorMessage(pg_result.get());
-    return std::unexpected(ConnectionError{.message = "PostgreSQL error: " + error_msg,
-                                           .error_code = static_cast<int>(status)});
+  if (auto status_result = check_result_status(pg_result.get()); !status_result) {
+    return std::unexpected(status_result.error());
   }
 
   // Process result using shared utility function
@@ -270,6 +534,10 @@ ConnectionResult<result::ResultSet> PostgreSQLConnection::execute_raw_binary(
         ConnectionError{.message = "Parameter count mismatch with binary flags", .error_code = -1});
   }
 
+  if (auto flush_result = flush_deferred(); !flush_result) {
+    return std::unexpected(flush_result.error());
+  }
+
   PGResultWrapper pg_result(nullptr);
 
   if (params.empty()) {
@@ -302,6 +570,7 @@ ConnectionResult<result::ResultSet> PostgreSQLConnection::execute_raw_binary(
                      0  // Use text format for results
                      ));
   }
+  sql_utils::count_query(query_stats_, pg_result.get());
 
   auto result_handler = handle_pg_result(pg_result.get());
   if (!result_handler) {
@@ -331,13 +600,8 @@ ConnectionResult<void> PostgreSQLConnection::begin_transaction(IsolationLevel is
   const std::string isolation_level_str = sql_utils::isolation_level_to_postgresql_string(
       static_cast<int>(isolation_level));
 
-  // Execute the transaction begin statement with isolation level
-  const std::string begin_sql = "BEGIN ISOLATION LEVEL " + isolation_level_str;
-  auto result = execute_raw(begin_sql);
-  if (!result) {
-    return std::unexpected(result.error());
-  }
-
+  // The BEGIN is sent together with the first statement of the transaction
+  deferred_begin_ = "BEGIN ISOLATION LEVEL " + isolation_level_str;
   in_transaction_ = true;
   return {};
 }
@@ -353,7 +617,14 @@ ConnectionResult<void> PostgreSQLConnection::commit_transaction() {
         ConnectionError{.message = "No transaction in progress", .error_code = -1});
   }
 
-  // Execute the commit statement
+  if (!deferred_begin_.empty() && deferred_.empty()) {
+    // Nothing was ever sent, so there is nothing to commit on the server
+    deferred_begin_.clear();
+    in_transaction_ = false;
+    return {};
+  }
+
+  // Deferred statements and the COMMIT share one round trip
   auto result = execute_raw("COMMIT");
   if (!result) {
     return std::unexpected(result.error());
@@ -363,6 +634,11 @@ ConnectionResult<void> PostgreSQLConnection::commit_transaction() {
   return {};
 }
 
+ConnectionResult<void> PostgreSQLConnection::commit_transaction(const QueryOptions& options) {
+  const LimitScope scope(*this, options);
+  return scope.finish(commit_transaction());
+}
+
 ConnectionResult<void> PostgreSQLConnection::rollback_transaction() {
   if (!is_connected_ || !pg_conn_) {
     return std::unexpected(
@@ -374,6 +650,14 @@ ConnectionResult<void> PostgreSQLConnection::rollback_transaction() {
         ConnectionError{.message = "No transaction in progress", .error_code = -1});
   }
 
+  deferred_.clear();
+  if (!deferred_begin_.empty()) {
+    // The server never saw the transaction
+    deferred_begin_.clear();
+    in_transaction_ = false;
+    return {};
+  }
+
   // Execute the rollback statement
   auto result = execute_raw("ROLLBACK");
   if (!result) {
@@ -388,6 +672,73 @@ bool PostgreSQLConnection::in_transaction() const {
   return in_transaction_;
 }
 
+ConnectionResult<void> PostgreSQLConnection::defer_raw(std::string sql,
+                                                       std::vector<std::string> params,
+                                                       query::ParamTypes types) {
+  if (!is_connected_ || !pg_conn_) {
+    return std::unexpected(
+        ConnectionError{.message = "Not connected to database", .error_code = -1});
+  }
+
+  if (!in_transaction_) {
+    return std::unexpected(
+        ConnectionError{.message = "Deferred statements require an active transaction",
+                        .error_code = -1});
+  }
+
+  deferred_.push_back(
+      {.sql = std::move(sql), .params = std::move(params), .types = std::move(types)});
+  return {};
+}
+
+ConnectionResult<void> PostgreSQLConnection::flush_deferred() {
+  auto statements = take_deferred_statements();
+  if (statements.empty()) {
+    return {};
+  }
+
+  auto batch = pipeline();
+  for (auto& statement : statements) {
+    batch.add_raw(std::move(statement.sql), std::move(statement.params),
+                  std::move(statement.types));
+  }
+
+  auto results = batch.sync();
+  if (!results) {
+    return std::unexpected(results.error());
+  }
+  return {};
+}
+
+std::vector<PostgreSQLConnection::DeferredStatement>
+PostgreSQLConnection::take_deferred_statements() {
+  std::vector<DeferredStatement> statements;
+  if (deferred_begin_.empty() && deferred_.empty()) {
+    return statements;
+  }
+
+  statements.reserve(deferred_.size() + 1);
+  if (!deferred_begin_.empty()) {
+    statements.push_back({.sql = std::move(deferred_begin_), .params = {}});
+    deferred_begin_.clear();
+  }
+  for (auto& statement : deferred_) {
+    statements.push_back(std::move(statement));
+  }
+  deferred_.clear();
+  return statements;
+}
+
+ConnectionResult<std::vector<result::ResultSet>> PostgreSQLConnection::execute_statements(
+    std::vector<DeferredStatement> statements) {
+  PostgreSQLPipeline pipeline(*this);
+  for (auto& statement : statements) {
+    pipeline.add_raw(std::move(statement.sql), std::move(statement.params),
+                     std::move(statement.types));
+  }
+  return pipeline.sync();
+}
+
 std::string PostgreSQLConnection::convert_placeholders(const std::string& sql) {
   return sql_utils::convert_placeholders_to_postgresql(sql);
 }
@@ -415,4 +766,295 @@ std::unique_ptr<PostgreSQLStatement> PostgreSQLConnection::prepare_statement(
   return std::make_unique<PostgreSQLStatement>(*this, name, sql, param_count);
 }
 
+void PostgreSQLConnection::enable_statement_cache(size_t capacity) {
+  if (!statement_cache_) {
+    statement_cache_.emplace(capacity);
+  }
+}
+
+void PostgreSQLConnection::disable_statement_cache() {
+  if (!statement_cache_) {
+    return;
+  }
+
+  auto names = statement_cache_->names();
+  stale_statements_.insert(stale_statements_.end(), names.begin(), names.end());
+  statement_cache_.reset();
+
+  if (is_connected_ && pg_conn_) {
+    deallocate_stale_statements();
+  }
+}
+
+ConnectionResult<void> PostgreSQLConnection::apply_session_setup(const SessionSetup& setup) {
+  if (!is_connected_ || !pg_conn_) {
+    return std::unexpected(
+        ConnectionError{.message = "Not connected to database", .error_code = -1});
+  }
+
+  PostgreSQLPipeline batch(*this);
+
+  std::vector<std::string> setting_params;
+  for (const auto& [name, value] : setup.settings) {
+    if (session_setting(name) != value) {
+      setting_params.push_back(name);
+      setting_params.push_back(value);
+    }
+  }
+  if (!setting_params.empty()) {
+    batch.add_raw(sql_utils::set_config_sql(setting_params.size() / 2), setting_params);
+  }
+
+  std::vector<std::string> warmed_keys;
+  if (!setup.statements.empty()) {
+    enable_statement_cache(setup.statement_cache_capacity);
+    for (const auto& statement : setup.statements) {
+      std::string key = StatementCache::key_for(statement.sql, statement.types.oids);
+      auto entry = statement_cache_->acquire(key);
+      if (entry.evicted) {
+        stale_statements_.push_back(std::move(*entry.evicted));
+      }
+      if (entry.needs_prepare) {
+        batch.add_prepare(entry.name, statement.sql, statement.types);
+        warmed_keys.push_back(std::move(key));
+      }
+    }
+  }
+
+  if (batch.empty()) {
+    return {};
+  }
+
+  auto result = batch.sync();
+  if (!result) {
+    for (const auto& key : warmed_keys) {
+      statement_cache_->erase(key);
+    }
+    return std::unexpected(result.error());
+  }
+
+  // Settings made inside a transaction are undone by a rollback, so they are not tracked
+  for (size_t i = 0; i < setting_params.size(); i += 2) {
+    if (in_transaction_) {
+      session_settings_.erase(setting_params[i]);
+    } else {
+      session_settings_[setting_params[i]] = setting_params[i + 1];
+    }
+  }
+  return {};
+}
+
+ConnectionResult<void> PostgreSQLConnection::set_session(const std::string& name,
+                                                         const std::string& value) {
+  return apply_session_setup(SessionSetup{.settings = {{name, value}}});
+}
+
+std::optional<std::string> PostgreSQLConnection::session_setting(const std::string& name) const {
+  if (auto it = session_settings_.find(name); it != session_settings_.end()) {
+    return it->second;
+  }
+  return std::nullopt;
+}
+
+ConnectionResult<result::ResultSet> PostgreSQLConnection::execute_query_sql(
+    const std::string& sql, const std::vector<std::string>& params,
+    const query::ParamTypes& types) {
+  // Deferred statements ride along with execute_params, which keeps them in one round trip
+  if (!statement_cache_ || !is_connected_ || !pg_conn_ || deferred_count() > 0) {
+    return execute_params(sql, params, types);
+  }
+  return execute_cached(sql, params, types);
+}
+
+ConnectionResult<result::ResultSet> PostgreSQLConnection::execute_cached(
+    const std::string& sql, const std::vector<std::string>& params,
+    const query::ParamTypes& types) {
+  const std::string key = StatementCache::key_for(sql, types.oids);
+  const auto entry = statement_cache_->acquire(key);
+  if (entry.evicted) {
+    // Deallocated in the round trip of the next prepare, which evictions always come with
+    stale_statements_.push_back(*entry.evicted);
+  }
+
+  const std::string pg_sql = params.empty() ? sql : convert_placeholders(sql);
+
+  const auto pg_params = sql_utils::make_pg_params(params, types);
+
+  // The statement is prepared with the parameter types it is executed with
+  auto prepare = [&] { return prepare_sql(entry.name, pg_sql, types); };
+
+  auto execute = [&]() {
+    auto run = [&](auto libpq_function) {
+      return libpq_function(pg_conn_, entry.name.c_str(), pg_params.count(),
+                            pg_params.value_data(), pg_params.length_data(), pg_params.formats,
+                            0  // Use text format for results
+      );
+    };
+    return PGResultWrapper(limits_
+                               ? exec_limited([&] { return run(PQsendQueryPrepared) == 1; })
+                               : run(PQexecPrepared));
+  };
+
+  if (entry.needs_prepare) {
+    if (auto prepare_result = prepare(); !prepare_result) {
+      statement_cache_->erase(key);
+      return std::unexpected(prepare_result.error());
+    }
+  }
+
+  PGResultWrapper pg_result = execute();
+  if (!pg_result.get()) {
+    return std::unexpected(ConnectionError{.message = "Failed to execute query", .error_code = -1});
+  }
+
+  if (PQresultStatus(pg_result.get()) == PGRES_FATAL_ERROR) {
+    const char* sqlstate = PQresultErrorField(pg_result.get(), PG_DIAG_SQLSTATE);
+    if (StatementCache::is_stale_statement_error(sqlstate ? sqlstate : "",
+                                                 PQresultErrorMessage(pg_result.get()))) {
+      if (PQtransactionStatus(pg_conn_) == PQTRANS_IDLE) {
+        // Outside a transaction nothing was lost, so prepare the statement again and retry
+        statement_cache_->record_reprepare();
+        stale_statements_.push_back(entry.name);
+        if (auto prepare_result = prepare(); !prepare_result) {
+          statement_cache_->erase(key);
+          return std::unexpected(prepare_result.error());
+        }
+        pg_result = execute();
+      } else {
+        // The failed transaction has to be rolled back first; prepare afresh next time
+        statement_cache_->erase(key);
+        stale_statements_.push_back(entry.name);
+      }
+    }
+  }
+  sql_utils::count_query(query_stats_, pg_result.get());
+
+  if (!pg_result.get()) {
+    return std::unexpected(ConnectionError{.message = "Failed to execute query", .error_code = -1});
+  }
+
+  if (auto status_result = check_result_status(pg_result.get()); !status_result) {
+    return std::unexpected(status_result.error());
+  }
+
+  return sql_utils::process_postgresql_result(pg_result.get(), false);
+}
+
+void PostgreSQLConnection::deallocate_stale_statements() {
+  // An empty pipeline sends nothing but the stale statements' DEALLOCATE segment
+  [[maybe_unused]] auto result = PostgreSQLPipeline(*this).sync();
+}
+
+std::vector<std::string> PostgreSQLConnection::take_stale_statements() {
+  // DEALLOCATE fails inside an aborted transaction, so wait until it is over
+  if (stale_statements_.empty() || PQtransactionStatus(pg_conn_) == PQTRANS_INERROR) {
+    return {};
+  }
+  return std::exchange(stale_statements_, {});
+}
+
+ConnectionResult<void> PostgreSQLConnection::prepare_sql(const std::string& name,
+                                                         const std::string& sql,
+                                                         const query::ParamTypes& types) {
+  if (!stale_statements_.empty()) {
+    PostgreSQLPipeline batch(*this);
+    batch.add_prepare(name, sql, types);
+    auto result = batch.sync();
+    if (!result) {
+      return std::unexpected(result.error());
+    }
+    return {};
+  }
+
+  auto run = [&](auto libpq_function) {
+    return libpq_function(pg_conn_, name.c_str(), sql.c_str(),
+                          static_cast<int>(types.oids.size()),
+                          types.oids.empty() ? nullptr : types.oids.data());
+  };
+  const PGResultWrapper prepared(
+      limits_ ? exec_limited([&] { return run(PQsendPrepare) == 1; }) : run(PQprepare));
+  if (auto result = handle_pg_result(prepared.get(), PGRES_COMMAND_OK); !result) {
+    return std::unexpected(result.error());
+  }
+  return {};
+}
+
+ConnectionResult<std::string> PostgreSQLConnection::prepare_query_sql(
+    const std::string& sql, const query::ParamTypes& types) {
+  if (!is_connected_ || !pg_conn_) {
+    return std::unexpected(
+        ConnectionError{.message = "Not connected to database", .error_code = -1});
+  }
+
+  std::string name = "relx_query_" + std::to_string(++prepared_query_count_);
+  if (auto result = prepare_sql(name, sql, types); !result) {
+    return std::unexpected(result.error());
+  }
+  return name;
+}
+
+ConnectionResult<result::ResultSet> PostgreSQLConnection::execute_prepared_query(
+    const std::string& name, const std::vector<std::string>& params,
+    const query::ParamTypes& types) {
+  if (!is_connected_ || !pg_conn_) {
+    return std::unexpected(
+        ConnectionError{.message = "Not connected to database", .error_code = -1});
+  }
+
+  if (deferred_count() > 0) {
+    // Send the deferred statements and this one as a single pipeline
+    auto batch = pipeline();
+    batch.add_prepared(name, params, types);
+    auto results = batch.sync();
+    if (!results) {
+      return std::unexpected(results.error());
+    }
+    return std::move(results->back());
+  }
+
+  const auto pg_params = sql_utils::make_pg_params(params, types);
+  auto run = [&](auto libpq_function) {
+    return libpq_function(pg_conn_, name.c_str(), pg_params.count(), pg_params.value_data(),
+                          pg_params.length_data(), pg_params.formats,
+                          0  // Use text format for results
+    );
+  };
+  const PGResultWrapper pg_result(
+      limits_ ? exec_limited([&] { return run(PQsendQueryPrepared) == 1; })
+              : run(PQexecPrepared));
+  sql_utils::count_query(query_stats_, pg_result.get());
+  if (!pg_result.get()) {
+    return std::unexpected(ConnectionError{.message = "Failed to execute query", .error_code = -1});
+  }
+
+  if (auto status_result = check_result_status(pg_result.get()); !status_result) {
+    return std::unexpected(status_result.error());
+  }
+
+  return sql_utils::process_postgresql_result(pg_result.get(), false);
+}
+
+PostgreSQLPipeline PostgreSQLConnection::pipeline() {
+  return PostgreSQLPipeline(*this);
+}
+
+ConnectionResult<std::vector<result::ResultSet>> PostgreSQLConnection::execute_batch(
+    const PostgreSQLStatement& statement,
+    const std::vector<std::vector<std::string>>& param_rows) {
+  if (!statement.is_valid()) {
+    return std::unexpected(ConnectionError{.message = "Statement is not valid", .error_code = -1});
+  }
+
+  PostgreSQLPipeline batch(*this);
+  for (const auto& params : param_rows) {
+    if (params.size() != static_cast<size_t>(statement.param_count())) {
+      return std::unexpected(
+          ConnectionError{.message = "Parameter count mismatch", .error_code = -1});
+    }
+    batch.add_prepared(statement.name(), params);
+  }
+
+  return batch.sync();
+}
+
 }  // namespace relx::connection
\ No newline at end of file
@@ -1,141 +1,875 @@
 #include "relx/connection/postgresql_connection_pool.hpp"
 
+#include <algorithm>
+#include <cerrno>
+#include <thread>
+
+#include <libpq-fe.h>
+#include <poll.h>
+
 namespace relx::connection {
 
+namespace {
+
+/// @brief Most threads applying session setup to the initial connections at once
+constexpr size_t max_setup_threads = 16;
+
+/// @brief Small per-thread number used to give each thread a home shard
+size_t thread_index() {
+  static std::atomic<size_t> next_index{0};
+  thread_local const size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+
+/// @brief The pool and slot the calling thread checked out last, for thread affinity
+struct LastSlot {
+  uint64_t pool_id = 0;
+  size_t slot = 0;
+};
+
+LastSlot& last_slot() {
+  thread_local LastSlot last;
+  return last;
+}
+
+std::chrono::steady_clock::rep now_ticks() {
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+/// @brief Check a connection without a round trip
+/// @details An idle connection should have nothing to read. If its socket is readable, the
+/// server has most likely sent an error and closed it, e.g. because the backend was terminated.
+bool connection_is_alive(PGconn* conn) {
+  if (conn == nullptr || PQstatus(conn) != CONNECTION_OK) {
+    return false;
+  }
+
+  pollfd pfd{.fd = PQsocket(conn), .events = POLLIN, .revents = 0};
+  if (pfd.fd < 0) {
+    return false;
+  }
+  const int ready = poll(&pfd, 1, 0);
+  if (ready == 0) {
+    return true;
+  }
+  if (ready < 0 || (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) {
+    return false;
+  }
+
+  // Reading sets the status to bad if the server closed the connection
+  return PQconsumeInput(conn) != 0 && PQstatus(conn) == CONNECTION_OK;
+}
+
+}  // namespace
+
 PostgreSQLConnectionPool::PostgreSQLConnectionPool(PostgreSQLConnectionPoolConfig config)
-    : config_(std::move(config)) {}
+    : config_(std::move(config)), slots_(std::make_unique<Slot[]>(config_.max_size)),
+      metrics_(config_.metrics_sink) {
+  const size_t shards = config_.shard_count != 0
+                            ? config_.shard_count
+                            : std::max<size_t>(1, std::thread::hardware_concurrency());
+  shard_count_ = std::clamp<size_t>(shards, 1, std::max<size_t>(1, config_.max_size));
+
+  static std::atomic<uint64_t> next_pool_id{1};
+  pool_id_ = next_pool_id.fetch_add(1, std::memory_order_relaxed);
+
+  // Lane 0 is the default class of get_connection() without a class name
+  lane_count_ = config_.priority_classes.size() + 1;
+  lanes_ = std::make_unique<Lane[]>(lane_count_);
+  for (size_t i = 1; i < lane_count_; ++i) {
+    const auto& priority_class = config_.priority_classes[i - 1];
+    lanes_[i].name = priority_class.name;
+    lanes_[i].reserved = std::min(priority_class.reserved, config_.max_size - total_reserved_);
+    lanes_[i].weight = std::max(1U, priority_class.weight);
+    total_reserved_ += lanes_[i].reserved;
+  }
+
+  const auto& adaptive = config_.adaptive_concurrency;
+  admission_enabled_ = !config_.priority_classes.empty() || adaptive.enabled;
+  limit_ = adaptive.enabled ? std::clamp<size_t>(adaptive.initial_limit != 0
+                                                     ? adaptive.initial_limit
+                                                     : config_.max_size,
+                                                 std::min(adaptive.min_limit, config_.max_size),
+                                                 config_.max_size)
+                            : config_.max_size;
+
+  const auto& autoscaling = config_.autoscaling;
+  const size_t min_size = std::min(autoscaling.min_size, config_.max_size);
+  target_size_ = autoscaling.enabled
+                     ? std::clamp(config_.initial_size, min_size, config_.max_size)
+                     : config_.max_size;
+
+  if (config_.maintenance_thread) {
+    maintenance_thread_ = std::thread([this] { run_maintenance(); });
+  }
+}
 
 PostgreSQLConnectionPool::~PostgreSQLConnectionPool() {
-  // Clear all idle connections
-  const std::lock_guard<std::mutex> lock(pool_mutex_);
-  while (!idle_connections_.empty()) {
-    idle_connections_.pop();
+  if (maintenance_thread_.joinable()) {
+    {
+      const std::lock_guard<std::mutex> lock(maintenance_mutex_);
+      stopping_ = true;
+    }
+    maintenance_cv_.notify_one();
+    maintenance_thread_.join();
   }
 }
 
 ConnectionPoolResult<void> PostgreSQLConnectionPool::initialize() {
+  using namespace std::chrono;
+  using ConnectState = PostgreSQLConnection::ConnectState;
+
+  /// A connection being opened into a claimed slot
+  struct Pending {
+    size_t slot;
+    std::shared_ptr<PostgreSQLConnection> connection;
+    ConnectState state;
+    steady_clock::time_point started;
+  };
+
+  std::optional<ConnectionPoolError> first_error;
+  std::vector<microseconds> latencies;
+  auto fail = [&](size_t slot, const std::string& message, int error_code) {
+    metrics_.connect_failures.add();
+    release_slot(slot);
+    if (!first_error) {
+      first_error = ConnectionPoolError{
+          .message = "Failed to initialize connection pool: " + message, .error_code = error_code};
+    }
+  };
+  // Each connection is usable as soon as it is ready, while the others are still connecting
+  auto ready = [&](Pending& pending) {
+    const auto latency = duration_cast<microseconds>(steady_clock::now() - pending.started);
+    latencies.push_back(latency);
+    metrics_.connect_latency.record(latency);
+    metrics_.connections_opened.add();
+    auto& slot = slots_[pending.slot];
+    slot.connection = std::move(pending.connection);
+    slot.last_used.store(now_ticks(), std::memory_order_relaxed);
+    slot.last_checked.store(now_ticks(), std::memory_order_relaxed);
+    ++total_connections_;
+    slot.state.store(SlotState::Idle);
+    notify_waiter();
+  };
+  // Session setup is a blocking round trip, so connections needing it are set aside and set up
+  // together once every connect has finished
+  std::vector<Pending> connected;
+  auto connected_fn = [&](Pending& pending) {
+    if (config_.session_setup.empty()) {
+      ready(pending);
+    } else {
+      connected.push_back(std::move(pending));
+    }
+  };
+
+  // Start every connection first. Consecutive slots belong to different shards.
+  std::vector<Pending> pending;
+  const size_t initial_size = std::min(config_.initial_size, config_.max_size);
+  for (size_t i = 0; i < initial_size; ++i) {
+    auto expected = SlotState::Empty;
+    if (!slots_[i].state.compare_exchange_strong(expected, SlotState::InUse)) {
+      continue;  // Already filled by an earlier initialize() or a checkout
+    }
+
+    Pending entry{.slot = i,
+                  .connection = std::make_shared<PostgreSQLConnection>(config_.connection_params),
+                  .state = ConnectState::WaitWrite,
+                  .started = steady_clock::now()};
+    auto state = entry.connection->start_connect();
+    if (!state) {
+      fail(i, state.error().message, state.error().error_code);
+      continue;
+    }
+    entry.state = *state;
+    if (entry.state == ConnectState::Connected) {
+      connected_fn(entry);
+    } else {
+      pending.push_back(std::move(entry));
+    }
+  }
+
+  // Then drive all of them from this thread, each one as soon as its socket is ready
+  const auto deadline = steady_clock::now() + config_.connection_timeout;
+  std::vector<pollfd> fds;
+  while (!pending.empty()) {
+    const auto remaining = duration_cast<milliseconds>(deadline - steady_clock::now());
+    if (remaining <= milliseconds::zero()) {
+      for (auto& entry : pending) {
+        fail(entry.slot, "Timed out connecting to database", -1);
+      }
+      break;
+    }
+
+    fds.clear();
+    for (const auto& entry : pending) {
+      fds.push_back(pollfd{
+          .fd = entry.connection->socket(),
+          .events = static_cast<short>(entry.state == ConnectState::WaitRead ? POLLIN : POLLOUT),
+          .revents = 0});
+    }
+    if (poll(fds.data(), fds.size(), static_cast<int>(remaining.count()) + 1) < 0 &&
+        errno != EINTR) {
+      for (auto& entry : pending) {
+        fail(entry.slot, "Failed to wait for connections", errno);
+      }
+      break;
+    }
+
+    for (size_t i = pending.size(); i-- > 0;) {
+      if (fds[i].revents == 0) {
+        continue;
+      }
+      auto state = pending[i].connection->continue_connect();
+      if (state && *state != ConnectState::Connected) {
+        pending[i].state = *state;
+        continue;
+      }
+      if (state) {
+        connected_fn(pending[i]);
+      } else {
+        fail(pending[i].slot, state.error().message, state.error().error_code);
+      }
+      pending.erase(pending.begin() + static_cast<std::ptrdiff_t>(i));
+    }
+  }
+
+  // Every setup batch is one round trip on its own connection; run them side by side
+  std::vector<ConnectionResult<void>> setups(connected.size());
+  std::atomic<size_t> next_setup{0};
+  auto apply_setups = [&] {
+    for (size_t i = next_setup++; i < connected.size(); i = next_setup++) {
+      setups[i] = connected[i].connection->apply_session_setup(config_.session_setup);
+    }
+  };
+  std::vector<std::thread> setup_threads;
+  for (size_t i = 1; i < std::min(connected.size(), max_setup_threads); ++i) {
+    setup_threads.emplace_back(apply_setups);
+  }
+  apply_setups();
+  for (auto& thread : setup_threads) {
+    thread.join();
+  }
+  for (size_t i = 0; i < connected.size(); ++i) {
+    if (setups[i]) {
+      ready(connected[i]);
+    } else {
+      fail(connected[i].slot, setups[i].error().message, setups[i].error().error_code);
+    }
+  }
+
+  {
+    const std::lock_guard<std::mutex> lock(pool_mutex_);
+    connect_latencies_ = std::move(latencies);
+  }
+  wake_maintenance();
+
+  if (first_error) {
+    // If we can't create the initial connections, consider it a failure
+    return std::unexpected(*first_error);
+  }
+  return {};
+}
+
+std::vector<std::chrono::microseconds> PostgreSQLConnectionPool::connect_latencies() const {
+  const std::lock_guard<std::mutex> lock(pool_mutex_);
+  return connect_latencies_;
+}
+
+ConnectionPoolResult<PostgreSQLConnectionPool::PooledConnection>
+PostgreSQLConnectionPool::get_connection() {
+  return make_pooled(get_raw_connection());
+}
+
+ConnectionPoolResult<PostgreSQLConnectionPool::PooledConnection>
+PostgreSQLConnectionPool::get_connection(std::string_view priority_class) {
+  for (size_t lane = 1; lane < lane_count_; ++lane) {
+    if (lanes_[lane].name == priority_class) {
+      return make_pooled(get_raw_connection(lane));
+    }
+  }
+  return std::unexpected(ConnectionPoolError{
+      .message = "Unknown priority class: " + std::string(priority_class), .error_code = -1});
+}
+
+ConnectionPoolResult<PostgreSQLConnectionPool::PooledConnection>
+PostgreSQLConnectionPool::make_pooled(ConnectionPoolResult<Checkout> checkout) {
+  if (!checkout) {
+    return std::unexpected(checkout.error());
+  }
+
+  return PooledConnection(std::move(checkout->connection), shared_from_this(), checkout->slot,
+                          checkout->ticket);
+}
+
+size_t PostgreSQLConnectionPool::concurrency_limit() const {
+  return limit_.load(std::memory_order_relaxed);
+}
+
+size_t PostgreSQLConnectionPool::target_size() const {
+  return target_size_.load(std::memory_order_relaxed);
+}
+
+std::vector<ScalingDecision> PostgreSQLConnectionPool::scaling_decisions() const {
   const std::lock_guard<std::mutex> lock(pool_mutex_);
+  return {decisions_.begin(), decisions_.end()};
+}
+
+ConnectionPoolResult<PostgreSQLConnectionPool::Checkout>
+PostgreSQLConnectionPool::get_raw_connection(size_t lane) {
+  using namespace std::chrono;
+
+  if (config_.max_size == 0) {
+    return std::unexpected(
+        ConnectionPoolError{.message = "Connection pool has no capacity", .error_code = -1});
+  }
+
+  // Close old connections first; this is a no-op unless a check is due
+  if (!config_.maintenance_thread) {
+    cleanup_idle_connections();
+    evaluate_autoscaling();
+    report_metrics();
+  }
+
+  const auto started = steady_clock::now();
+  const auto wait_until = started + config_.connection_timeout;
+
+  // Admission comes before the slots, so a class over its share waits without taking a slot
+  std::optional<Ticket> ticket;
+  if (admission_enabled_) {
+    ticket = admit(lane, wait_until);
+    if (!ticket) {
+      record_checkout(steady_clock::now() - started);
+      metrics_.checkout_timeouts.add();
+      return std::unexpected(ConnectionPoolError{
+          .message = "Timed out waiting for a connection", .error_code = pool_timeout_error});
+    }
+  }
+  auto fail = [&](ConnectionPoolError error) -> ConnectionPoolResult<Checkout> {
+    if (ticket) {
+      release_ticket(*ticket);
+    }
+    return std::unexpected(std::move(error));
+  };
+
+  Checkout result{};
+  while (true) {
+    auto checkout = try_checkout();
+    while (!checkout) {
+      // Every slot is in use. Register as a waiter before looking again, so a connection
+      // returned from now on is guaranteed to wake us up. Only slots are claimed under the
+      // lock; a claimed empty slot is connected once it is released.
+      std::unique_lock<std::mutex> lock(pool_mutex_);
+      ++waiters_;
+      wake_maintenance();
+      checkout = try_checkout();
+      if (!checkout && conn_available_.wait_until(lock, wait_until) == std::cv_status::timeout) {
+        --waiters_;
+        lock.unlock();
+        record_checkout(steady_clock::now() - started);
+        metrics_.checkout_timeouts.add();
+        return fail(ConnectionPoolError{.message = "Timed out waiting for a connection",
+                                        .error_code = pool_timeout_error});
+      }
+      --waiters_;
+    }
+
+    if (checkout->created) {
+      auto connected = connect_claimed(*checkout);
+      if (!connected) {
+        return fail(connected.error());
+      }
+    }
 
-  // Create initial connections
-  for (size_t i = 0; i < config_.initial_size; ++i) {
+    result = std::move(*checkout);
+    if (!config_.validate_connections || result.created || validate_checkout(result)) {
+      break;
+    }
+
+    metrics_.validation_failures.add();
+    if (config_.maintenance_thread) {
+      // The maintenance thread opens the replacement; take whichever connection is ready first
+      close_slot(result.slot);
+      wake_maintenance();
+      continue;
+    }
+
+    // Connection is invalid, try to create a new one in the same slot
+    --total_connections_;
+    metrics_.connections_closed.add();
+    auto& slot = slots_[result.slot];
+    slot.queries.store(0, std::memory_order_relaxed);
+    slot.query_errors.store(0, std::memory_order_relaxed);
+    slot.query_timeouts.store(0, std::memory_order_relaxed);
     auto conn_result = create_connection();
     if (!conn_result) {
-      // If we can't create the initial connections, consider it a failure
-      return std::unexpected(ConnectionPoolError{
-          .message = "Failed to initialize connection pool: " + conn_result.error().message,
+      release_slot(result.slot);
+      return fail(ConnectionPoolError{
+          .message = "Failed to create replacement connection: " + conn_result.error().message,
           .error_code = conn_result.error().error_code});
     }
 
-    idle_connections_.push(
-        {.connection = *conn_result, .last_used = std::chrono::steady_clock::now()});
+    ++total_connections_;
+    result.connection = std::move(*conn_result);
+    break;
   }
 
-  total_connections_ = config_.initial_size;
-  return {};
+  record_checkout(steady_clock::now() - started);
+  if (ticket) {
+    // The adaptive limit looks at how long the connection is held, not at time spent waiting
+    ticket->admitted = now_ticks();
+    result.ticket = ticket;
+  }
+
+  metrics_.checkouts.add();
+  const size_t active = ++active_connections_;
+  if (config_.autoscaling.enabled) {
+    auto peak = peak_active_.load(std::memory_order_relaxed);
+    while (active > peak &&
+           !peak_active_.compare_exchange_weak(peak, active, std::memory_order_relaxed)) {
+    }
+  }
+  if (config_.thread_affinity) {
+    last_slot() = LastSlot{.pool_id = pool_id_, .slot = result.slot};
+  }
+  return result;
 }
 
-ConnectionPoolResult<PostgreSQLConnectionPool::PooledConnection>
-PostgreSQLConnectionPool::get_connection() {
-  auto conn_result = get_raw_connection();
+std::optional<PostgreSQLConnectionPool::Checkout> PostgreSQLConnectionPool::try_checkout() {
+  if (auto slot = claim_slot(SlotState::Idle)) {
+    return Checkout{.slot = *slot, .connection = std::move(slots_[*slot].connection)};
+  }
+
+  // No idle connection anywhere; claim a free slot to connect in if there is one, unless the
+  // maintenance thread opens connections
+  if (config_.maintenance_thread || total_connections_.load() >= target_size_.load()) {
+    return std::nullopt;
+  }
+  if (auto slot = claim_slot(SlotState::Empty)) {
+    return Checkout{.slot = *slot, .created = true};
+  }
+  return std::nullopt;
+}
+
+ConnectionPoolResult<void> PostgreSQLConnectionPool::connect_claimed(Checkout& checkout) {
+  auto conn_result = create_connection();
   if (!conn_result) {
-    return std::unexpected(conn_result.error());
+    release_slot(checkout.slot);
+    return std::unexpected(ConnectionPoolError{
+        .message = "Failed to create new connection: " + conn_result.error().message,
+        .error_code = conn_result.error().error_code});
   }
 
-  return PooledConnection(*conn_result, shared_from_this());
+  ++total_connections_;
+  checkout.connection = std::move(*conn_result);
+  return {};
 }
 
-ConnectionPoolResult<std::shared_ptr<PostgreSQLConnection>>
-PostgreSQLConnectionPool::get_raw_connection() {
-  using namespace std::chrono;
+std::optional<size_t> PostgreSQLConnectionPool::claim_slot(SlotState from) {
+  if (from == SlotState::Idle && config_.thread_affinity) {
+    const auto& last = last_slot();
+    auto expected = SlotState::Idle;
+    if (last.pool_id == pool_id_ &&
+        slots_[last.slot].state.compare_exchange_strong(expected, SlotState::InUse)) {
+      return last.slot;
+    }
+  }
 
-  // Cleanup old connections first
-  cleanup_idle_connections();
+  // Shard k owns slots k, k + shard_count_, ...; start at home and steal from the others
+  const size_t home = thread_index() % shard_count_;
+  for (size_t offset = 0; offset < shard_count_; ++offset) {
+    const size_t shard = (home + offset) % shard_count_;
+    if (from == SlotState::Idle && config_.idle_order == IdleOrder::Lifo) {
+      if (auto slot = claim_most_recent(shard)) {
+        return slot;
+      }
+      continue;
+    }
+    for (size_t i = shard; i < config_.max_size; i += shard_count_) {
+      auto& state = slots_[i].state;
+      auto expected = from;
+      if (state.load() == from && state.compare_exchange_strong(expected, SlotState::InUse)) {
+        return i;
+      }
+    }
+  }
+  return std::nullopt;
+}
 
-  // Try to get an idle connection or create a new one
+std::optional<size_t> PostgreSQLConnectionPool::claim_most_recent(size_t shard) {
+  while (true) {
+    std::optional<size_t> newest;
+    std::chrono::steady_clock::rep newest_time = 0;
+    for (size_t i = shard; i < config_.max_size; i += shard_count_) {
+      if (slots_[i].state.load() != SlotState::Idle) {
+        continue;
+      }
+      const auto returned = slots_[i].last_used.load(std::memory_order_relaxed);
+      if (!newest || returned > newest_time) {
+        newest = i;
+        newest_time = returned;
+      }
+    }
+
+    if (!newest) {
+      return std::nullopt;
+    }
+    auto expected = SlotState::Idle;
+    if (slots_[*newest].state.compare_exchange_strong(expected, SlotState::InUse)) {
+      return newest;
+    }
+    // Another thread took it first; look again
+  }
+}
+
+std::optional<PostgreSQLConnectionPool::Ticket> PostgreSQLConnectionPool::admit(
+    size_t lane, std::chrono::steady_clock::time_point deadline) {
+  if (auto ticket = try_admit(lane)) {
+    return ticket;
+  }
+
+  // Register before looking again, so a place freed from now on wakes some waiting class
   std::unique_lock<std::mutex> lock(pool_mutex_);
+  auto& entry = lanes_[lane];
+  ++entry.waiters;
+  ++admission_waiters_;
+  auto ticket = try_admit(lane);
+  while (!ticket) {
+    if (entry.available.wait_until(lock, deadline) == std::cv_status::timeout) {
+      ticket = try_admit(lane);
+      break;
+    }
+    ticket = try_admit(lane);
+  }
+  --entry.waiters;
+  --admission_waiters_;
+  if (!ticket) {
+    // This thread may have been picked for a place it no longer takes; pass it on
+    notify_admission_locked();
+  }
+  return ticket;
+}
 
-  auto wait_until = steady_clock::now() + config_.connection_timeout;
+std::optional<PostgreSQLConnectionPool::Ticket> PostgreSQLConnectionPool::try_admit(size_t lane) {
+  auto& entry = lanes_[lane];
+  const auto now = now_ticks();
+
+  auto reserved = entry.reserved_used.load();
+  while (reserved < entry.reserved) {
+    if (entry.reserved_used.compare_exchange_weak(reserved, reserved + 1)) {
+      return Ticket{.lane = lane, .reserved = true, .admitted = now};
+    }
+  }
 
-  while (idle_connections_.empty()) {
-    // If we can create a new connection, do so
-    if (total_connections_ < config_.max_size) {
-      lock.unlock();
-      auto conn_result = create_connection();
-      lock.lock();
+  // The adaptive limit caps the shared places; reservations stay guaranteed
+  const size_t limit = limit_.load();
+  const size_t shared = limit > total_reserved_ ? limit - total_reserved_ : 0;
+  auto used = shared_used_.load();
+  while (used < shared) {
+    if (shared_used_.compare_exchange_weak(used, used + 1)) {
+      return Ticket{.lane = lane, .reserved = false, .admitted = now};
+    }
+  }
+  return std::nullopt;
+}
 
-      if (!conn_result) {
-        return std::unexpected(ConnectionPoolError{.message = "Failed to create new connection: " +
-                                                              conn_result.error().message,
-                                                   .error_code = conn_result.error().error_code});
-      }
+void PostgreSQLConnectionPool::release_ticket(const Ticket& ticket) {
+  if (ticket.reserved) {
+    --lanes_[ticket.lane].reserved_used;
+  } else {
+    --shared_used_;
+  }
+  if (admission_waiters_.load() > 0) {
+    const std::lock_guard<std::mutex> lock(pool_mutex_);
+    notify_admission_locked();
+  }
+}
 
-      ++total_connections_;
-      ++active_connections_;
+void PostgreSQLConnectionPool::notify_admission_locked() {
+  const size_t limit = limit_.load();
+  const bool shared_free = shared_used_.load() + total_reserved_ < limit;
 
-      return *conn_result;
+  // Smooth weighted round robin over the classes that are waiting and could be admitted
+  Lane* next = nullptr;
+  int64_t total_weight = 0;
+  for (size_t i = 0; i < lane_count_; ++i) {
+    auto& lane = lanes_[i];
+    if (lane.waiters == 0 || (!shared_free && lane.reserved_used.load() >= lane.reserved)) {
+      continue;
+    }
+    lane.current_weight += lane.weight;
+    total_weight += lane.weight;
+    if (next == nullptr || lane.current_weight > next->current_weight) {
+      next = &lane;
     }
+  }
+  if (next != nullptr) {
+    next->current_weight -= total_weight;
+    next->available.notify_one();
+  }
+}
+
+void PostgreSQLConnectionPool::update_limit(std::chrono::steady_clock::rep latency) {
+  const auto& adaptive = config_.adaptive_concurrency;
+
+  // Samples arriving while another thread updates the limit are skipped
+  std::unique_lock<std::mutex> lock(limit_mutex_, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return;
+  }
+
+  latency = std::max<std::chrono::steady_clock::rep>(latency, 1);
+  if (no_load_latency_ == 0 || latency < no_load_latency_ ||
+      ++samples_since_probe_ >= adaptive.probe_interval) {
+    no_load_latency_ = latency;
+    samples_since_probe_ = 0;
+  }
+
+  // Checkouts beyond what the no-load latency explains are queued in the database
+  const size_t limit = limit_.load();
+  const double queued =
+      static_cast<double>(limit) *
+      (1.0 - static_cast<double>(no_load_latency_) / static_cast<double>(latency));
+  size_t next = limit;
+  if (queued > adaptive.beta) {
+    next = limit - 1;
+  } else if (queued < adaptive.alpha && active_connections_.load() * 2 >= limit) {
+    // Only grow while the limit is actually used
+    next = limit + 1;
+  }
+  next = std::clamp<size_t>(next, std::min(adaptive.min_limit, config_.max_size), config_.max_size);
+  limit_.store(next);
+  lock.unlock();
+
+  if (next > limit && admission_waiters_.load() > 0) {
+    const std::lock_guard<std::mutex> pool_lock(pool_mutex_);
+    notify_admission_locked();
+  }
+}
+
+void PostgreSQLConnectionPool::record_checkout(std::chrono::steady_clock::duration wait) {
+  metrics_.checkout_wait.record(wait);
+}
 
-    // Otherwise, wait for a connection to become available
-    if (conn_available_.wait_until(lock, wait_until) == std::cv_status::timeout) {
-      return std::unexpected(
-          ConnectionPoolError{.message = "Timed out waiting for a connection", .error_code = -1});
+void PostgreSQLConnectionPool::report_metrics() {
+  if (metrics_.report_due()) {
+    metrics_.report(metrics());
+  }
+}
+
+PoolMetrics PostgreSQLConnectionPool::metrics() const {
+  auto snapshot = metrics_.snapshot();
+  snapshot.active_connections = active_connections_.load();
+  snapshot.total_connections = total_connections_.load();
+  for (size_t i = 0; i < config_.max_size; ++i) {
+    const auto& slot = slots_[i];
+    const auto state = slot.state.load(std::memory_order_relaxed);
+    if (state == SlotState::Empty) {
+      continue;
+    }
+    if (state == SlotState::Idle) {
+      ++snapshot.idle_connections;
     }
+    snapshot.connections.push_back(PooledConnectionMetrics{
+        .slot = i,
+        .queries = QueryStats{.queries = slot.queries.load(std::memory_order_relaxed),
+                              .errors = slot.query_errors.load(std::memory_order_relaxed),
+                              .timeouts = slot.query_timeouts.load(std::memory_order_relaxed)}});
   }
+  return snapshot;
+}
 
-  // Got an idle connection
-  auto pooled_connection = std::move(idle_connections_.front());
-  idle_connections_.pop();
+void PostgreSQLConnectionPool::count_queries(size_t slot, const PostgreSQLConnection& connection) {
+  auto& entry = slots_[slot];
+  const auto stats = connection.query_stats();
+  const QueryStats seen{.queries = entry.queries.load(std::memory_order_relaxed),
+                        .errors = entry.query_errors.load(std::memory_order_relaxed),
+                        .timeouts = entry.query_timeouts.load(std::memory_order_relaxed)};
+  metrics_.add_queries(stats - seen);
+  entry.queries.store(stats.queries, std::memory_order_relaxed);
+  entry.query_errors.store(stats.errors, std::memory_order_relaxed);
+  entry.query_timeouts.store(stats.timeouts, std::memory_order_relaxed);
+}
 
-  auto connection = std::move(pooled_connection.connection);
+void PostgreSQLConnectionPool::evaluate_autoscaling() {
+  using namespace std::chrono;
 
-  // Validate the connection if needed
-  if (config_.validate_connections && !validate_connection(connection)) {
-    // Connection is invalid, try to create a new one
-    lock.unlock();
-    auto conn_result = create_connection();
-    lock.lock();
+  const auto& autoscaling = config_.autoscaling;
+  if (!autoscaling.enabled) {
+    return;
+  }
 
-    if (!conn_result) {
-      --total_connections_;  // The invalid connection is effectively gone
-      return std::unexpected(ConnectionPoolError{
-          .message = "Failed to create replacement connection: " + conn_result.error().message,
-          .error_code = conn_result.error().error_code});
+  // Only one thread evaluates, and only once per interval
+  const auto now = now_ticks();
+  auto due = next_evaluation_.load(std::memory_order_relaxed);
+  const auto interval = duration_cast<steady_clock::duration>(autoscaling.evaluation_interval);
+  if (now < due || !next_evaluation_.compare_exchange_strong(due, now + interval.count())) {
+    return;
+  }
+  // Evaluations run in turn on different threads; skip one that overlaps a slow predecessor
+  const std::unique_lock<std::mutex> lock(evaluation_mutex_, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return;
+  }
+  if (due == 0) {
+    // The first call only starts the first interval
+    last_waits_ = metrics_.checkout_wait.snapshot();
+    return;
+  }
+
+  // The waits recorded since the last evaluation
+  auto waits = metrics_.checkout_wait.snapshot();
+  const auto interval_waits = waits.since(last_waits_);
+  last_waits_ = std::move(waits);
+  const uint64_t total = interval_waits.count;
+  const microseconds p99_wait = interval_waits.percentile(99.0);
+
+  const size_t target = target_size_.load();
+  const size_t peak = peak_active_.exchange(active_connections_.load(), std::memory_order_relaxed);
+  const double utilisation =
+      static_cast<double>(peak) / static_cast<double>(std::max<size_t>(target, 1));
+  const size_t min_size = std::min(autoscaling.min_size, config_.max_size);
+  const size_t step = std::max<size_t>(autoscaling.step, 1);
+
+  size_t next = target;
+  if (total > 0 && p99_wait > autoscaling.target_wait && target < config_.max_size) {
+    next = std::min(target + step, config_.max_size);
+    low_since_ = 0;
+  } else if (utilisation < autoscaling.utilisation_threshold && target > min_size) {
+    if (low_since_ == 0) {
+      low_since_ = now;
+    } else if (now - low_since_ >=
+               duration_cast<steady_clock::duration>(autoscaling.shrink_window).count()) {
+      next = std::max({target > step ? target - step : 0, min_size, peak});
+      low_since_ = now;  // The next step down needs another full window
     }
+  } else {
+    low_since_ = 0;
+  }
 
-    connection = *conn_result;
+  if (next == target) {
+    return;
   }
+  target_size_.store(next);
 
-  ++active_connections_;
-  return connection;
+  {
+    const std::lock_guard<std::mutex> pool_lock(pool_mutex_);
+    decisions_.push_back(ScalingDecision{.time = steady_clock::now(),
+                                         .from = target,
+                                         .to = next,
+                                         .p99_wait = p99_wait,
+                                         .utilisation = utilisation});
+    while (decisions_.size() > autoscaling.decision_history) {
+      decisions_.pop_front();
+    }
+    // Waiting threads may now open a connection
+    if (next > target) {
+      conn_available_.notify_all();
+    }
+  }
+  if (next > target) {
+    wake_maintenance();
+    return;
+  }
+
+  // Close idle connections above the new target
+  for (size_t i = 0; i < config_.max_size && total_connections_.load() > next; ++i) {
+    auto expected = SlotState::Idle;
+    if (slots_[i].state.compare_exchange_strong(expected, SlotState::InUse)) {
+      close_slot(i);
+    }
+  }
 }
 
-void PostgreSQLConnectionPool::return_connection(std::shared_ptr<PostgreSQLConnection> connection) {
+void PostgreSQLConnectionPool::return_connection(size_t slot,
+                                                 std::shared_ptr<PostgreSQLConnection> connection,
+                                                 const std::optional<Ticket>& ticket) {
   if (!connection) {
     return;
   }
 
+  if (ticket) {
+    if (config_.adaptive_concurrency.enabled) {
+      update_limit(now_ticks() - ticket->admitted);
+    }
+    release_ticket(*ticket);
+  }
+  count_queries(slot, *connection);
+
   // Check if the connection is still valid
   bool is_valid = connection->is_connected();
+  const bool needs_reset = connection->in_transaction() || !config_.reset_query.empty();
 
-  if (is_valid) {
-    // If there's an active transaction, roll it back
-    if (connection->in_transaction()) {
-      auto result = connection->rollback_transaction();
-      is_valid = result.has_value();
-    }
+  // Without a maintenance thread, roll back and reset on the returning thread
+  if (is_valid && needs_reset && !config_.maintenance_thread) {
+    is_valid = reset_connection(*connection);
   }
 
-  const std::lock_guard<std::mutex> lock(pool_mutex_);
-
   --active_connections_;
 
+  // Connections above a lowered autoscaling target are closed as they come back
+  if (is_valid && config_.autoscaling.enabled && total_connections_.load() > target_size_.load()) {
+    is_valid = false;
+  }
+
   if (!is_valid) {
     // Discard invalid connection
-    --total_connections_;
-  } else {
-    // Return to the pool
-    idle_connections_.push(
-        {.connection = std::move(connection), .last_used = std::chrono::steady_clock::now()});
+    close_slot(slot);
+    return;
+  }
+
+  // Return to the pool
+  auto& entry = slots_[slot];
+  entry.connection = std::move(connection);
+  const auto now = now_ticks();
+  entry.last_used.store(now, std::memory_order_relaxed);
+  entry.last_checked.store(now, std::memory_order_relaxed);
+  if (needs_reset && config_.maintenance_thread) {
+    entry.state.store(SlotState::Resetting);
+    wake_maintenance();
+    return;
+  }
+  entry.state.store(SlotState::Idle);
+  notify_waiter();
+}
+
+bool PostgreSQLConnectionPool::reset_connection(PostgreSQLConnection& connection) const {
+  // If there's an active transaction, roll it back
+  if (connection.in_transaction() && !connection.rollback_transaction()) {
+    return false;
+  }
+  if (!config_.reset_query.empty()) {
+    if (!connection.execute_raw(config_.reset_query)) {
+      return false;
+    }
+    // The reset query may have undone the configured settings; prepared statements survive it
+    connection.clear_session_settings();
+    if (!config_.session_setup.settings.empty() &&
+        !connection.apply_session_setup(SessionSetup{.settings = config_.session_setup.settings})) {
+      return false;
+    }
+  }
+  return connection.is_connected();
+}
+
+void PostgreSQLConnectionPool::release_slot(size_t slot) {
+  auto& entry = slots_[slot];
+  entry.connection.reset();
+  entry.queries.store(0, std::memory_order_relaxed);
+  entry.query_errors.store(0, std::memory_order_relaxed);
+  entry.query_timeouts.store(0, std::memory_order_relaxed);
+  entry.state.store(SlotState::Empty);
+  notify_waiter();
+}
+
+void PostgreSQLConnectionPool::close_slot(size_t slot) {
+  --total_connections_;
+  metrics_.connections_closed.add();
+  release_slot(slot);
+}
+
+void PostgreSQLConnectionPool::notify_waiter() {
+  if (waiters_.load() > 0) {
+    const std::lock_guard<std::mutex> lock(pool_mutex_);
     conn_available_.notify_one();
   }
 }
@@ -145,21 +879,37 @@ size_t PostgreSQLConnectionPool::active_connections() const {
 }
 
 size_t PostgreSQLConnectionPool::idle_connections() const {
-  const std::lock_guard<std::mutex> lock(pool_mutex_);
-  return idle_connections_.size();
+  size_t idle = 0;
+  for (size_t i = 0; i < config_.max_size; ++i) {
+    if (slots_[i].state.load(std::memory_order_relaxed) == SlotState::Idle) {
+      ++idle;
+    }
+  }
+  return idle;
 }
 
 ConnectionPoolResult<std::shared_ptr<PostgreSQLConnection>>
 PostgreSQLConnectionPool::create_connection() {
+  const auto started = std::chrono::steady_clock::now();
   auto connection = std::make_shared<PostgreSQLConnection>(config_.connection_params);
 
   auto result = connection->connect();
   if (!result) {
+    metrics_.connect_failures.add();
     return std::unexpected(
         ConnectionPoolError{.message = "Failed to connect to database: " + result.error().message,
                             .error_code = result.error().error_code});
   }
 
+  if (auto setup = connection->apply_session_setup(config_.session_setup); !setup) {
+    metrics_.connect_failures.add();
+    return std::unexpected(
+        ConnectionPoolError{.message = "Failed to set up session: " + setup.error().message,
+                            .error_code = setup.error().error_code});
+  }
+
+  metrics_.connect_latency.record(std::chrono::steady_clock::now() - started);
+  metrics_.connections_opened.add();
   return connection;
 }
 
@@ -174,54 +924,186 @@ bool PostgreSQLConnectionPool::validate_connection(
   return result.has_value();
 }
 
-void PostgreSQLConnectionPool::cleanup_idle_connections() {
+bool PostgreSQLConnectionPool::validate_checkout(const Checkout& checkout) const {
   using namespace std::chrono;
 
-  const std::lock_guard<std::mutex> lock(pool_mutex_);
+  // The maintenance thread does the round trips; a checkout only looks at the socket
+  if (config_.validation == ConnectionValidation::Always && !config_.maintenance_thread) {
+    return validate_connection(checkout.connection);
+  }
 
-  if (idle_connections_.empty()) {
-    return;
+  if (!connection_is_alive(checkout.connection->get_pg_conn())) {
+    return false;
   }
+  if (config_.validation == ConnectionValidation::Status || config_.maintenance_thread) {
+    return true;
+  }
+
+  const auto threshold =
+      duration_cast<steady_clock::duration>(config_.validation_idle_threshold).count();
+  const auto unchecked_for =
+      now_ticks() - slots_[checkout.slot].last_checked.load(std::memory_order_relaxed);
+  return unchecked_for <= threshold || validate_connection(checkout.connection);
+}
+
+size_t PostgreSQLConnectionPool::validate_idle_connections() {
+  using namespace std::chrono;
+
+  const auto threshold =
+      duration_cast<steady_clock::duration>(config_.validation_idle_threshold).count();
+  size_t closed = 0;
+  for (size_t i = 0; i < config_.max_size; ++i) {
+    auto& slot = slots_[i];
+    if (now_ticks() - slot.last_checked.load(std::memory_order_relaxed) <= threshold) {
+      continue;
+    }
+
+    auto expected = SlotState::Idle;
+    if (!slot.state.compare_exchange_strong(expected, SlotState::InUse)) {
+      continue;
+    }
+
+    if (validate_connection(slot.connection)) {
+      slot.last_checked.store(now_ticks(), std::memory_order_relaxed);
+      slot.state.store(SlotState::Idle);
+      notify_waiter();
+      continue;
+    }
+
+    metrics_.validation_failures.add();
+    close_slot(i);
+    ++closed;
+  }
+  return closed;
+}
+
+void PostgreSQLConnectionPool::cleanup_idle_connections() {
+  using namespace std::chrono;
 
   // Keep at least config_.initial_size connections
   if (total_connections_ <= config_.initial_size) {
     return;
   }
 
-  // Get the current time
-  auto now = steady_clock::now();
+  // Only one thread scans, and only once per interval
+  const auto now = now_ticks();
+  auto due = next_cleanup_.load(std::memory_order_relaxed);
+  const auto interval = duration_cast<steady_clock::duration>(
+      std::min<milliseconds>(config_.max_idle_time, seconds(1)));
+  if (now < due || !next_cleanup_.compare_exchange_strong(due, now + interval.count())) {
+    return;
+  }
 
-  // Create a temporary queue to hold connections we want to keep
-  std::queue<PoolEntry> keep_connections;
+  const auto max_idle = duration_cast<steady_clock::duration>(config_.max_idle_time).count();
+  size_t idle = idle_connections();
+  for (size_t i = 0; i < config_.max_size && total_connections_ > config_.initial_size &&
+                     idle > config_.min_idle;
+       ++i) {
+    auto& slot = slots_[i];
+    if (now - slot.last_used.load(std::memory_order_relaxed) <= max_idle) {
+      continue;
+    }
 
-  size_t closed = 0;
+    auto expected = SlotState::Idle;
+    if (!slot.state.compare_exchange_strong(expected, SlotState::InUse)) {
+      continue;
+    }
 
-  // Process all idle connections
-  while (!idle_connections_.empty()) {
-    auto& pooled_conn = idle_connections_.front();
+    // The connection may have been used and returned since last_used was read
+    if (now - slot.last_used.load(std::memory_order_relaxed) <= max_idle) {
+      slot.state.store(SlotState::Idle);
+      notify_waiter();
+      continue;
+    }
 
-    // Check if the connection has been idle for too long
-    auto idle_time = now - pooled_conn.last_used;
+    --idle;
+    close_slot(i);
+  }
+}
 
-    const bool should_close = idle_time > config_.max_idle_time &&
-                              (total_connections_ - closed) > config_.initial_size;
+void PostgreSQLConnectionPool::wake_maintenance() {
+  if (!config_.maintenance_thread) {
+    return;
+  }
+  {
+    const std::lock_guard<std::mutex> lock(maintenance_mutex_);
+    maintenance_pending_ = true;
+  }
+  maintenance_cv_.notify_one();
+}
 
-    if (should_close) {
-      // Close this connection
-      ++closed;
-    } else {
-      // Keep this connection
-      keep_connections.push(std::move(pooled_conn));
+void PostgreSQLConnectionPool::run_maintenance() {
+  std::unique_lock<std::mutex> lock(maintenance_mutex_);
+  while (true) {
+    maintenance_cv_.wait_for(lock, config_.maintenance_interval,
+                             [this] { return maintenance_pending_ || stopping_; });
+    if (stopping_) {
+      return;
     }
+    maintenance_pending_ = false;
+    lock.unlock();
 
-    idle_connections_.pop();
+    // Returned connections and waiting threads first; they hold up requests
+    reset_returned_connections();
+    open_connections();
+    cleanup_idle_connections();
+    evaluate_autoscaling();
+    if (config_.validate_connections) {
+      validate_idle_connections();
+    }
+    report_metrics();
+
+    lock.lock();
   }
+}
+
+void PostgreSQLConnectionPool::reset_returned_connections() {
+  for (size_t i = 0; i < config_.max_size; ++i) {
+    auto& slot = slots_[i];
+    auto expected = SlotState::Resetting;
+    if (!slot.state.compare_exchange_strong(expected, SlotState::InUse)) {
+      continue;
+    }
+
+    if (!reset_connection(*slot.connection)) {
+      close_slot(i);
+      continue;
+    }
 
-  // Update the idle connections queue
-  idle_connections_ = std::move(keep_connections);
+    slot.last_checked.store(now_ticks(), std::memory_order_relaxed);
+    slot.state.store(SlotState::Idle);
+    notify_waiter();
+  }
+}
 
-  // Update the total connection count
-  total_connections_ -= closed;
+void PostgreSQLConnectionPool::open_connections() {
+  while (!stopping_) {
+    const size_t idle = idle_connections();
+    if ((waiters_.load() <= idle && idle >= config_.min_idle) ||
+        total_connections_.load() >= target_size_.load()) {
+      return;
+    }
+
+    auto slot = claim_slot(SlotState::Empty);
+    if (!slot) {
+      return;
+    }
+
+    auto conn_result = create_connection();
+    if (!conn_result) {
+      // Tried again on the next run
+      release_slot(*slot);
+      return;
+    }
+
+    auto& entry = slots_[*slot];
+    entry.connection = std::move(*conn_result);
+    entry.last_used.store(now_ticks(), std::memory_order_relaxed);
+    entry.last_checked.store(now_ticks(), std::memory_order_relaxed);
+    ++total_connections_;
+    entry.state.store(SlotState::Idle);
+    notify_waiter();
+  }
 }
 
-}  // namespace relx::connection
\ No newline at end of file
+}  // namespace relx::connection
@@ -0,0 +1,388 @@
+#include "relx/connection/postgresql_pipeline.hpp"
+
+#include "relx/connection/sql_utils.hpp"
+
+#include <memory>
+#include <optional>
+
+#include <libpq-fe.h>
+#include <poll.h>
+
+namespace relx::connection {
+
+namespace {
+
+using PGResultPtr = std::unique_ptr<PGresult, decltype(&PQclear)>;
+
+ConnectionError make_conn_error(PGconn* conn, const std::string& context) {
+  return ConnectionError{.message = context + ": " + PQerrorMessage(conn),
+                         .error_code = static_cast<int>(PQstatus(conn))};
+}
+
+/// Flush the output buffer of a non-blocking connection. Incoming data is consumed while
+/// waiting so the server never blocks on a full socket buffer while we are still sending.
+ConnectionResult<void> flush_nonblocking(PGconn* conn) {
+  while (true) {
+    const int flush_result = PQflush(conn);
+    if (flush_result == 0) {
+      return {};
+    }
+    if (flush_result < 0) {
+      return std::unexpected(make_conn_error(conn, "Failed to flush pipeline"));
+    }
+
+    pollfd pfd{.fd = PQsocket(conn), .events = POLLIN | POLLOUT, .revents = 0};
+    if (poll(&pfd, 1, -1) < 0) {
+      return std::unexpected(
+          ConnectionError{.message = "Failed to wait for pipeline socket", .error_code = -1});
+    }
+
+    if ((pfd.revents & POLLIN) != 0 && PQconsumeInput(conn) == 0) {
+      return std::unexpected(make_conn_error(conn, "Failed to read pipeline results"));
+    }
+  }
+}
+
+/// Discard whatever is left of an interrupted pipeline and leave pipeline mode
+void abandon_pipeline(PGconn* conn) {
+  if (PQpipelineStatus(conn) == PQ_PIPELINE_OFF) {
+    return;
+  }
+
+  // Terminate anything queued so far with a sync point so the server flushes its results
+  if (PQpipelineSync(conn) == 1) {
+    [[maybe_unused]] auto _ = flush_nonblocking(conn);
+  }
+
+  int consecutive_nulls = 0;
+  while (PQstatus(conn) == CONNECTION_OK && PQexitPipelineMode(conn) != 1) {
+    PGresult* res = PQgetResult(conn);
+    if (res == nullptr) {
+      // Null results separate statements; two in a row means nothing is left to read
+      if (++consecutive_nulls > 1) {
+        break;
+      }
+      continue;
+    }
+    consecutive_nulls = 0;
+    PQclear(res);
+  }
+}
+
+}  // namespace
+
+PostgreSQLPipeline::PostgreSQLPipeline(PostgreSQLConnection& connection)
+    : connection_(connection) {}
+
+PostgreSQLPipeline& PostgreSQLPipeline::add_raw(std::string sql, std::vector<std::string> params,
+                                                query::ParamTypes types) {
+  if (!params.empty()) {
+    sql = sql_utils::convert_placeholders_to_postgresql(sql);
+  }
+  entries_.push_back({.sql = std::move(sql),
+                      .params = std::move(params),
+                      .types = std::move(types),
+                      .kind = EntryKind::Query});
+  return *this;
+}
+
+PostgreSQLPipeline& PostgreSQLPipeline::add_prepared(std::string statement_name,
+                                                     std::vector<std::string> params,
+                                                     query::ParamTypes types) {
+  entries_.push_back({.sql = std::move(statement_name),
+                      .params = std::move(params),
+                      .types = std::move(types),
+                      .kind = EntryKind::Execute});
+  return *this;
+}
+
+PostgreSQLPipeline& PostgreSQLPipeline::add_prepare(std::string statement_name, std::string sql,
+                                                    query::ParamTypes types) {
+  entries_.push_back({.sql = std::move(sql),
+                      .params = {},
+                      .types = std::move(types),
+                      .kind = EntryKind::Prepare,
+                      .statement_name = std::move(statement_name)});
+  return *this;
+}
+
+ConnectionResult<std::vector<result::ResultSet>> PostgreSQLPipeline::sync() {
+  if (entries_.empty() && connection_.stale_statements_.empty()) {
+    return std::vector<result::ResultSet>{};
+  }
+
+  PGconn* conn = connection_.get_pg_conn();
+  if (!connection_.is_connected() || !conn) {
+    entries_.clear();
+    return std::unexpected(
+        ConnectionError{.message = "Not connected to database", .error_code = -1});
+  }
+
+  // Limits of the call in progress, e.g. execute_raw() with options sending deferred statements
+  const bool limited = connection_.limits_.has_value();
+  if (limited && connection_.limits_expired()) {
+    entries_.clear();
+    return std::unexpected(
+        ConnectionError{.message = "Query timed out", .error_code = query_cancelled_error});
+  }
+
+  released_ = connection_.take_stale_statements();
+  if (entries_.empty() && released_.empty()) {
+    return std::vector<result::ResultSet>{};
+  }
+
+  // A deferred BEGIN and statements queued with defer() go out first, in the same batch
+  const size_t deferred_count = entries_.empty() ? 0 : prepend_deferred_statements();
+
+  const bool was_nonblocking = PQisnonblocking(conn) == 1;
+  if (!was_nonblocking && PQsetnonblocking(conn, 1) != 0) {
+    entries_.clear();
+    released_.clear();
+    return std::unexpected(make_conn_error(conn, "Failed to switch to non-blocking mode"));
+  }
+
+  if (limited) {
+    wait_ = connection_.begin_limited_wait();
+  }
+  gave_up_ = false;
+
+  ConnectionResult<std::vector<result::ResultSet>> results;
+  if (PQenterPipelineMode(conn) != 1) {
+    results = std::unexpected(make_conn_error(conn, "Failed to enter pipeline mode"));
+  } else if (auto send_result = send_entries(); !send_result) {
+    results = std::unexpected(send_result.error());
+    abandon_pipeline(conn);
+  } else if (auto released = discard_released_results(); !released) {
+    results = std::unexpected(released.error());
+    if (!gave_up_) {
+      abandon_pipeline(conn);
+    }
+  } else {
+    results = entries_.empty() ? std::vector<result::ResultSet>{} : read_results(deferred_count);
+    if (!gave_up_ && PQexitPipelineMode(conn) != 1) {
+      if (results) {
+        results = std::unexpected(make_conn_error(conn, "Failed to exit pipeline mode"));
+      }
+      abandon_pipeline(conn);
+    }
+  }
+
+  wait_.reset();
+  if (gave_up_) {
+    // The server did not answer the cancel request and the connection has been closed
+    entries_.clear();
+    released_.clear();
+    return results;
+  }
+  if (limited) {
+    connection_.end_limited_wait();
+  }
+
+  if (!was_nonblocking) {
+    PQsetnonblocking(conn, 0);
+  }
+
+  entries_.clear();
+  released_.clear();
+  return results;
+}
+
+size_t PostgreSQLPipeline::prepend_deferred_statements() {
+  auto deferred = connection_.take_deferred_statements();
+  if (deferred.empty()) {
+    return 0;
+  }
+
+  std::vector<PipelineEntry> entries;
+  entries.reserve(deferred.size() + entries_.size());
+  for (auto& statement : deferred) {
+    if (!statement.params.empty()) {
+      statement.sql = sql_utils::convert_placeholders_to_postgresql(statement.sql);
+    }
+    entries.push_back({.sql = std::move(statement.sql),
+                       .params = std::move(statement.params),
+                       .types = std::move(statement.types),
+                       .kind = EntryKind::Query});
+  }
+  for (auto& entry : entries_) {
+    entries.push_back(std::move(entry));
+  }
+  entries_ = std::move(entries);
+  return deferred.size();
+}
+
+ConnectionResult<void> PostgreSQLPipeline::send_entries() {
+  PGconn* conn = connection_.get_pg_conn();
+
+  for (const auto& name : released_) {
+    const std::string deallocate = "DEALLOCATE " + name;
+    const int sent =
+        PQsendQueryParams(conn, deallocate.c_str(), 0, nullptr, nullptr, nullptr, nullptr, 0);
+    if (sent != 1) {
+      return std::unexpected(make_conn_error(conn, "Failed to queue DEALLOCATE"));
+    }
+  }
+  if (!released_.empty() && PQpipelineSync(conn) != 1) {
+    return std::unexpected(make_conn_error(conn, "Failed to send pipeline sync"));
+  }
+
+  for (const auto& entry : entries_) {
+    const auto pg_params = sql_utils::make_pg_params(entry.params, entry.types);
+
+    int sent = 0;
+    if (entry.kind == EntryKind::Prepare) {
+      sent = PQsendPrepare(conn, entry.statement_name.c_str(), entry.sql.c_str(),
+                           static_cast<int>(entry.types.oids.size()),
+                           entry.types.oids.empty() ? nullptr : entry.types.oids.data());
+    } else if (entry.kind == EntryKind::Execute) {
+      sent = PQsendQueryPrepared(conn, entry.sql.c_str(), pg_params.count(),
+                                 pg_params.value_data(), pg_params.length_data(),
+                                 pg_params.formats,
+                                 0  // Use text format for results
+      );
+    } else {
+      sent = PQsendQueryParams(conn, entry.sql.c_str(), pg_params.count(), pg_params.types,
+                               pg_params.value_data(), pg_params.length_data(),
+                               pg_params.formats,
+                               0  // Use text format for results
+      );
+    }
+
+    if (sent != 1) {
+      return std::unexpected(make_conn_error(conn, "Failed to queue pipeline statement"));
+    }
+  }
+
+  if (!entries_.empty() && PQpipelineSync(conn) != 1) {
+    return std::unexpected(make_conn_error(conn, "Failed to send pipeline sync"));
+  }
+
+  return flush_nonblocking(conn);
+}
+
+ConnectionResult<void> PostgreSQLPipeline::discard_released_results() {
+  if (released_.empty()) {
+    return {};
+  }
+
+  PGconn* conn = connection_.get_pg_conn();
+  for (size_t i = 0; i < released_.size(); ++i) {
+    // A statement that no longer exists fails, which only skips the rest of this segment
+    while (PGresult* res = next_result()) {
+      PQclear(res);
+    }
+  }
+  if (gave_up_) {
+    return std::unexpected(limit_error());
+  }
+
+  const PGResultPtr sync_result{next_result(), PQclear};
+  if (gave_up_) {
+    return std::unexpected(limit_error());
+  }
+  if (!sync_result || PQresultStatus(sync_result.get()) != PGRES_PIPELINE_SYNC) {
+    return std::unexpected(make_conn_error(conn, "Pipeline did not end with a sync point"));
+  }
+  return {};
+}
+
+ConnectionResult<std::vector<result::ResultSet>> PostgreSQLPipeline::read_results(
+    size_t deferred_count) {
+  PGconn* conn = connection_.get_pg_conn();
+
+  std::vector<result::ResultSet> results;
+  results.reserve(entries_.size() - deferred_count);
+  std::optional<ConnectionError> first_error;
+
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    std::optional<result::ResultSet> result_set;
+
+    // Each statement yields one or more results terminated by a null result
+    while (PGResultPtr res{next_result(), PQclear}) {
+      const ExecStatusType status = PQresultStatus(res.get());
+      switch (status) {
+      case PGRES_COMMAND_OK:
+      case PGRES_TUPLES_OK:
+      case PGRES_SINGLE_TUPLE:
+        if (!result_set) {
+          sql_utils::count_query(connection_.query_stats_, res.get());
+          result_set = sql_utils::process_postgresql_result(res.get(), false);
+        }
+        break;
+
+      case PGRES_PIPELINE_ABORTED:
+        // Skipped by the server because an earlier statement failed
+        break;
+
+      default:
+        sql_utils::count_query(connection_.query_stats_, res.get());
+        if (!first_error) {
+          const std::string statement =
+              i < deferred_count ? "Deferred statement " + std::to_string(i)
+                                 : "Pipeline statement " + std::to_string(i - deferred_count);
+          first_error = ConnectionError{.message = statement + " failed: PostgreSQL error: " +
+                                                   PQresultErrorMessage(res.get()),
+                                        .error_code = static_cast<int>(status)};
+        }
+        break;
+      }
+    }
+
+    if (gave_up_) {
+      return std::unexpected(limit_error());
+    }
+    if (PQstatus(conn) != CONNECTION_OK) {
+      return std::unexpected(make_conn_error(conn, "Connection lost during pipeline"));
+    }
+
+    if (i < deferred_count) {
+      continue;  // Results of deferred statements are not reported
+    }
+
+    if (result_set) {
+      results.push_back(std::move(*result_set));
+    } else {
+      results.emplace_back();
+    }
+  }
+
+  // The batch ends with exactly one sync result
+  const PGResultPtr sync_result{next_result(), PQclear};
+  if (gave_up_) {
+    return std::unexpected(limit_error());
+  }
+  if (!sync_result || PQresultStatus(sync_result.get()) != PGRES_PIPELINE_SYNC) {
+    return std::unexpected(make_conn_error(conn, "Pipeline did not end with a sync point"));
+  }
+
+  if (first_error) {
+    return std::unexpected(*first_error);
+  }
+
+  return results;
+}
+
+PGresult* PostgreSQLPipeline::next_result() {
+  if (gave_up_) {
+    return nullptr;
+  }
+
+  // Without limits PQgetResult waits for the server itself
+  PGconn* conn = connection_.get_pg_conn();
+  while (wait_ && PQisBusy(conn) == 1) {
+    if (!connection_.wait_for_input(*wait_)) {
+      gave_up_ = true;
+      return nullptr;
+    }
+    if (PQconsumeInput(conn) != 1) {
+      break;
+    }
+  }
+  return PQgetResult(conn);
+}
+
+ConnectionError PostgreSQLPipeline::limit_error() {
+  return ConnectionError{.message = "Query timed out", .error_code = query_cancelled_error};
+}
+
+}  // namespace relx::connection
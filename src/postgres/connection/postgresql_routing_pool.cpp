@@ -0,0 +1,212 @@
+#include "relx/connection/postgresql_routing_pool.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace relx::connection {
+
+namespace {
+
+// Replication lag in milliseconds. Zero when the replica has replayed everything it received,
+// so an idle primary does not make its replicas look stale, and on servers not in recovery.
+constexpr auto replication_lag_sql =
+    "SELECT CASE WHEN pg_last_wal_receive_lsn() = pg_last_wal_replay_lsn() THEN 0 "
+    "ELSE COALESCE((EXTRACT(EPOCH FROM now() - pg_last_xact_replay_timestamp()) * 1000)::bigint, "
+    "0) END";
+
+}  // namespace
+
+void PostgreSQLRoutingPool::Replica::record_latency(std::chrono::nanoseconds sample) {
+  auto current = latency_ns.load(std::memory_order_relaxed);
+  int64_t next = 0;
+  do {
+    next = current == 0 ? sample.count()
+                        : current + static_cast<int64_t>(latency_weight *
+                                                         static_cast<double>(sample.count() -
+                                                                             current));
+    next = std::max<int64_t>(next, 1);
+  } while (!latency_ns.compare_exchange_weak(current, next, std::memory_order_relaxed));
+}
+
+void PostgreSQLRoutingPool::RoutedConnection::observe(std::chrono::nanoseconds elapsed,
+                                                      bool succeeded) {
+  if (!replica_) {
+    return;
+  }
+  if (succeeded) {
+    replica_->record_latency(elapsed);
+  } else if (!connection_->is_connected()) {
+    replica_->healthy.store(false, std::memory_order_relaxed);
+  }
+}
+
+PostgreSQLRoutingPool::PostgreSQLRoutingPool(PostgreSQLRoutingPoolConfig config)
+    : config_(std::move(config)), primary_(PostgreSQLConnectionPool::create(config_.primary)) {
+  replicas_.reserve(config_.replicas.size());
+  for (const auto& params : config_.replicas) {
+    auto replica_config = config_.primary;
+    replica_config.connection_params = params;
+    replica_config.session_setup.settings.emplace_back("default_transaction_read_only", "on");
+
+    auto replica = std::make_shared<Replica>();
+    replica->params = params;
+    replica->pool = PostgreSQLConnectionPool::create(std::move(replica_config));
+    replica->latency_weight = std::clamp(config_.latency_weight, 0.01, 1.0);
+    replicas_.push_back(std::move(replica));
+  }
+}
+
+PostgreSQLRoutingPool::~PostgreSQLRoutingPool() {
+  if (health_thread_.joinable()) {
+    {
+      const std::lock_guard<std::mutex> lock(health_mutex_);
+      stopping_ = true;
+    }
+    health_cv_.notify_one();
+    health_thread_.join();
+  }
+}
+
+ConnectionPoolResult<void> PostgreSQLRoutingPool::initialize() {
+  if (auto result = primary_->initialize(); !result) {
+    return result;
+  }
+
+  // Unreachable replicas are left unhealthy and retried by the health checks
+  for (auto& replica : replicas_) {
+    [[maybe_unused]] auto result = replica->pool->initialize();
+  }
+  check_replicas();
+  if (!replicas_.empty() && !health_thread_.joinable()) {
+    health_thread_ = std::thread([this] { run_health_checks(); });
+  }
+  return {};
+}
+
+ConnectionPoolResult<PostgreSQLConnectionPool::PooledConnection>
+PostgreSQLRoutingPool::get_primary() {
+  return primary_->get_connection();
+}
+
+ConnectionPoolResult<PostgreSQLRoutingPool::RoutedConnection> PostgreSQLRoutingPool::get_replica() {
+  // Try the healthy replicas from the best score to the worst
+  std::vector<bool> tried(replicas_.size(), false);
+  const size_t start = next_replica_.fetch_add(1, std::memory_order_relaxed);
+  for (size_t attempt = 0; attempt < replicas_.size(); ++attempt) {
+    std::shared_ptr<Replica> best;
+    size_t best_index = 0;
+    uint64_t best_score = std::numeric_limits<uint64_t>::max();
+    for (size_t i = 0; i < replicas_.size(); ++i) {
+      const size_t index = (start + i) % replicas_.size();
+      const auto& replica = replicas_[index];
+      if (tried[index] || !replica->healthy.load(std::memory_order_relaxed)) {
+        continue;
+      }
+      // Unmeasured replicas count as the fastest, so they are sampled soon
+      const auto latency =
+          static_cast<uint64_t>(replica->latency_ns.load(std::memory_order_relaxed)) + 1;
+      const uint64_t score = latency * (replica->in_flight.load(std::memory_order_relaxed) + 1);
+      if (score < best_score) {
+        best = replica;
+        best_index = index;
+        best_score = score;
+      }
+    }
+    if (!best) {
+      break;
+    }
+
+    // Count the connection before checking it out, so concurrent callers see the load
+    tried[best_index] = true;
+    best->in_flight.fetch_add(1, std::memory_order_relaxed);
+    auto conn = best->pool->get_connection();
+    if (conn) {
+      return RoutedConnection(std::move(*conn), std::move(best));
+    }
+    best->in_flight.fetch_sub(1, std::memory_order_relaxed);
+    // A pool that is only busy says nothing about the replica; a failed connect or validation
+    // takes it out of rotation until the next health check
+    if (conn.error().error_code != pool_timeout_error) {
+      best->healthy.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  if (!config_.fallback_to_primary) {
+    return std::unexpected(
+        ConnectionPoolError{.message = "No healthy replica available", .error_code = -1});
+  }
+  auto conn = primary_->get_connection();
+  if (!conn) {
+    return std::unexpected(conn.error());
+  }
+  return RoutedConnection(std::move(*conn), nullptr);
+}
+
+size_t PostgreSQLRoutingPool::check_replicas() {
+  size_t healthy = 0;
+  for (auto& replica : replicas_) {
+    check_replica(*replica);
+    if (replica->healthy.load(std::memory_order_relaxed)) {
+      ++healthy;
+    }
+  }
+  return healthy;
+}
+
+void PostgreSQLRoutingPool::run_health_checks() {
+  std::unique_lock<std::mutex> lock(health_mutex_);
+  while (!health_cv_.wait_for(lock, config_.health_check_interval, [this] { return stopping_; })) {
+    lock.unlock();
+    check_replicas();
+    lock.lock();
+  }
+}
+
+void PostgreSQLRoutingPool::check_replica(Replica& replica) const {
+  // Do not wait for a connection behind a healthy replica's own traffic. An unhealthy replica
+  // is always checked, so it is back in rotation one interval after it recovers.
+  if (replica.healthy.load(std::memory_order_relaxed) &&
+      replica.in_flight.load(std::memory_order_relaxed) >= config_.primary.max_size) {
+    return;
+  }
+
+  auto conn = replica.pool->get_connection();
+  if (!conn) {
+    if (conn.error().error_code != pool_timeout_error) {
+      replica.healthy.store(false, std::memory_order_relaxed);
+    }
+    return;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  auto result = (*conn)->execute_raw(replication_lag_sql);
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  if (!result || result->empty()) {
+    replica.healthy.store(false, std::memory_order_relaxed);
+    return;
+  }
+
+  const auto lag = result->at(0).get<long long>(0).value_or(0);
+  replica.record_latency(elapsed);
+  replica.lag_ms.store(lag, std::memory_order_relaxed);
+  replica.healthy.store(!config_.max_replication_lag || lag <= config_.max_replication_lag->count(),
+                        std::memory_order_relaxed);
+}
+
+std::vector<ReplicaStatus> PostgreSQLRoutingPool::replica_status() const {
+  std::vector<ReplicaStatus> status;
+  status.reserve(replicas_.size());
+  for (const auto& replica : replicas_) {
+    status.push_back(ReplicaStatus{
+        .params = replica->params,
+        .healthy = replica->healthy.load(std::memory_order_relaxed),
+        .latency = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::nanoseconds(replica->latency_ns.load(std::memory_order_relaxed))),
+        .in_flight = replica->in_flight.load(std::memory_order_relaxed),
+        .replication_lag =
+            std::chrono::milliseconds(replica->lag_ms.load(std::memory_order_relaxed))});
+  }
+  return status;
+}
+
+}  // namespace relx::connection
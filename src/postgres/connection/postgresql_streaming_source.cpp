@@ -146,6 +146,11 @@ ConnectionResult<void> PostgreSQLStreamingSource::start_query() {
     return std::unexpected(ConnectionError{.message = "Invalid connection", .error_code = -1});
   }
 
+  // Streaming bypasses execute_raw, so a deferred BEGIN has to be sent first
+  if (auto flush_result = connection_.flush_deferred(); !flush_result) {
+    return std::unexpected(flush_result.error());
+  }
+
   int result_code;
 
   if (params_.empty()) {
@@ -320,9 +325,15 @@ std::string PostgreSQLStreamingSource::convert_pg_bytea_to_binary(
 
 void PostgreSQLStreamingSource::cleanup() {
   if (query_active_) {
-    // Consume any remaining results to clean up the connection state
     PGconn* pg_conn = connection_.get_pg_conn();
     if (pg_conn) {
+      // A stream abandoned early would otherwise transfer and discard every remaining row, so
+      // the server is asked to cancel the query and only the rows already sent are drained.
+      // Inside a transaction the cancel would abort the transaction, so the rows are drained.
+      if (!finished_ && !connection_.in_transaction() &&
+          !sql_utils::discard_available_results(pg_conn)) {
+        connection_.request_cancel();
+      }
       PGresult* result;
       while ((result = PQgetResult(pg_conn)) != nullptr) {
         PQclear(result);
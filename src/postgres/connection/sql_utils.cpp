@@ -1,12 +1,21 @@
 #include "relx/connection/sql_utils.hpp"
 
+#include "relx/connection/metrics.hpp"
 #include "relx/results.hpp"
 
 #include <libpq-fe.h>
 
+#include <cstring>
+#include <type_traits>
+
 namespace relx::connection::sql_utils {
 
 std::string convert_placeholders_to_postgresql(const std::string& sql) {
+  // Rendered queries already use $n placeholders
+  if (sql.find('?') == std::string::npos) {
+    return sql;
+  }
+
   std::string result;
   result.reserve(sql.size() + 32);  // Reserve some extra space for parameter numbers
 
@@ -58,6 +67,71 @@ std::string convert_placeholders_to_postgresql(const std::string& sql) {
   return result;
 }
 
+static_assert(std::is_same_v<Oid, unsigned int>, "query::ParamTypes stores libpq Oids");
+
+PgParams make_pg_params(const std::vector<std::string>& params, const query::ParamTypes& types) {
+  PgParams result;
+  result.values.reserve(params.size());
+  for (const auto& param : params) {
+    result.values.push_back(param.c_str());
+  }
+
+  if (!types.empty()) {
+    // Binary values may contain NUL bytes, so every parameter gets an explicit length
+    result.lengths.reserve(params.size());
+    for (const auto& param : params) {
+      result.lengths.push_back(static_cast<int>(param.size()));
+    }
+    result.types = types.oids.data();
+    result.formats = types.formats.data();
+  }
+  return result;
+}
+
+std::string set_config_sql(size_t count) {
+  std::string sql = "SELECT ";
+  for (size_t i = 0; i < count; ++i) {
+    if (i > 0) {
+      sql += ", ";
+    }
+    sql += "set_config($" + std::to_string(2 * i + 1) + ", $" + std::to_string(2 * i + 2) +
+           ", false)";
+  }
+  return sql;
+}
+
+void count_query(QueryStats& stats, const PGresult* pg_result) {
+  ++stats.queries;
+  const ExecStatusType status =
+      pg_result != nullptr ? PQresultStatus(pg_result) : PGRES_FATAL_ERROR;
+  if (status == PGRES_COMMAND_OK || status == PGRES_TUPLES_OK || status == PGRES_SINGLE_TUPLE ||
+      status == PGRES_NONFATAL_ERROR) {
+    return;
+  }
+  ++stats.errors;
+
+  // query_canceled covers both statement_timeout and cancel requests
+  const char* sqlstate =
+      pg_result != nullptr ? PQresultErrorField(pg_result, PG_DIAG_SQLSTATE) : nullptr;
+  if (sqlstate != nullptr && std::strcmp(sqlstate, "57014") == 0) {
+    ++stats.timeouts;
+  }
+}
+
+bool discard_available_results(PGconn* pg_conn) {
+  if (PQconsumeInput(pg_conn) == 0) {
+    return true;  // The connection is broken, a cancel request would not help
+  }
+  while (PQisBusy(pg_conn) == 0) {
+    PGresult* result = PQgetResult(pg_conn);
+    if (result == nullptr) {
+      return true;
+    }
+    PQclear(result);
+  }
+  return false;
+}
+
 std::string isolation_level_to_postgresql_string(int isolation_level) {
   switch (isolation_level) {
   case 0:  // IsolationLevel::ReadUncommitted
@@ -0,0 +1,282 @@
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <gtest/gtest.h>
+#include <relx/connection/postgresql_async_connection_pool.hpp>
+#include <relx/query.hpp>
+
+namespace {
+
+namespace asio = boost::asio;
+using relx::connection::PostgreSQLAsyncConnectionPool;
+using relx::connection::PostgreSQLAsyncConnectionPoolConfig;
+
+class PostgreSQLAsyncConnectionPoolTest : public ::testing::Test {
+protected:
+  PostgreSQLAsyncConnectionPoolConfig make_config(size_t initial_size, size_t max_size) {
+    PostgreSQLAsyncConnectionPoolConfig config;
+    config.connection_params = {.host = "localhost",
+                                .port = 5434,
+                                .dbname = "relx_test",
+                                .user = "postgres",
+                                .password = "postgres"};
+    config.initial_size = initial_size;
+    config.max_size = max_size;
+    config.connection_timeout = std::chrono::milliseconds(1000);
+    return config;
+  }
+
+  asio::io_context io_context;
+};
+
+TEST_F(PostgreSQLAsyncConnectionPoolTest, AcquireAndReturn) {
+  auto pool = PostgreSQLAsyncConnectionPool::create(io_context, make_config(2, 4));
+
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto init = co_await pool->initialize();
+        EXPECT_TRUE(init) << init.error().message;
+        EXPECT_EQ(2, pool->idle_connections());
+
+        {
+          auto conn = co_await pool->acquire();
+          EXPECT_TRUE(conn) << conn.error().message;
+          if (!conn) {
+            co_return;
+          }
+          EXPECT_EQ(1, pool->active_connections());
+          EXPECT_EQ(1, pool->idle_connections());
+
+          auto result = co_await (*conn)->execute_raw("SELECT 1");
+          EXPECT_TRUE(result) << result.error().message;
+        }
+
+        EXPECT_EQ(0, pool->active_connections());
+        EXPECT_EQ(2, pool->idle_connections());
+      },
+      asio::detached);
+  io_context.run();
+}
+
+TEST_F(PostgreSQLAsyncConnectionPoolTest, OpensConnectionsOnDemand) {
+  auto pool = PostgreSQLAsyncConnectionPool::create(io_context, make_config(0, 2));
+
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto first = co_await pool->acquire();
+        EXPECT_TRUE(first) << first.error().message;
+        auto second = co_await pool->acquire();
+        EXPECT_TRUE(second) << second.error().message;
+        EXPECT_EQ(2, pool->active_connections());
+      },
+      asio::detached);
+  io_context.run();
+
+  EXPECT_EQ(0, pool->active_connections());
+  EXPECT_EQ(2, pool->idle_connections());
+}
+
+TEST_F(PostgreSQLAsyncConnectionPoolTest, TimesOutWhenExhausted) {
+  auto pool = PostgreSQLAsyncConnectionPool::create(io_context, make_config(1, 1));
+
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto init = co_await pool->initialize();
+        EXPECT_TRUE(init) << init.error().message;
+
+        auto held = co_await pool->acquire();
+        EXPECT_TRUE(held);
+
+        const auto start = std::chrono::steady_clock::now();
+        auto second = co_await pool->acquire(std::chrono::milliseconds(100));
+        EXPECT_FALSE(second);
+        EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+        EXPECT_EQ(0, pool->waiting());
+      },
+      asio::detached);
+  io_context.run();
+}
+
+TEST_F(PostgreSQLAsyncConnectionPoolTest, WaitersAreServedInOrder) {
+  auto pool = PostgreSQLAsyncConnectionPool::create(io_context, make_config(1, 1));
+  std::vector<int> order;
+
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto init = co_await pool->initialize();
+        EXPECT_TRUE(init) << init.error().message;
+
+        auto held = co_await pool->acquire();
+        EXPECT_TRUE(held);
+
+        for (int i = 0; i < 3; ++i) {
+          asio::co_spawn(
+              io_context,
+              [&, i]() -> asio::awaitable<void> {
+                auto conn = co_await pool->acquire();
+                EXPECT_TRUE(conn) << conn.error().message;
+                order.push_back(i);
+                // Hold the connection for a moment so the others have to wait
+                asio::steady_timer timer(io_context, std::chrono::milliseconds(10));
+                co_await timer.async_wait(asio::use_awaitable);
+              },
+              asio::detached);
+        }
+
+        // Let all three queue up before the held connection is returned
+        asio::steady_timer timer(io_context, std::chrono::milliseconds(50));
+        co_await timer.async_wait(asio::use_awaitable);
+        EXPECT_EQ(3, pool->waiting());
+      },
+      asio::detached);
+  io_context.run();
+
+  EXPECT_EQ((std::vector<int>{0, 1, 2}), order);
+}
+
+TEST_F(PostgreSQLAsyncConnectionPoolTest, RollsBackOpenTransactionOnReturn) {
+  auto pool = PostgreSQLAsyncConnectionPool::create(io_context, make_config(1, 1));
+
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto init = co_await pool->initialize();
+        EXPECT_TRUE(init) << init.error().message;
+
+        {
+          auto conn = co_await pool->acquire();
+          EXPECT_TRUE(conn);
+          if (!conn) {
+            co_return;
+          }
+          auto begin = co_await (*conn)->begin_transaction();
+          EXPECT_TRUE(begin) << begin.error().message;
+          EXPECT_TRUE((*conn)->in_transaction());
+        }
+
+        auto conn = co_await pool->acquire();
+        EXPECT_TRUE(conn) << conn.error().message;
+        if (conn) {
+          EXPECT_FALSE((*conn)->in_transaction());
+        }
+      },
+      asio::detached);
+  io_context.run();
+}
+
+TEST_F(PostgreSQLAsyncConnectionPoolTest, ReportsConnectionFailureToWaiter) {
+  auto config = make_config(0, 1);
+  config.connection_params.port = 1;
+  auto pool = PostgreSQLAsyncConnectionPool::create(io_context, config);
+
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto conn = co_await pool->acquire();
+        EXPECT_FALSE(conn);
+        if (!conn) {
+          EXPECT_NE(std::string::npos, conn.error().message.find("Failed to connect"));
+        }
+      },
+      asio::detached);
+  io_context.run();
+
+  EXPECT_EQ(0, pool->waiting());
+}
+
+TEST_F(PostgreSQLAsyncConnectionPoolTest, AppliesSessionSetup) {
+  auto config = make_config(1, 2);
+  config.session_setup.settings = {{"application_name", "async_pool_setup_test"}};
+  config.session_setup.statements.push_back(
+      relx::connection::warm_statement(relx::query::select_expr(relx::query::val(1))));
+  auto pool = PostgreSQLAsyncConnectionPool::create(io_context, config);
+
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto init = co_await pool->initialize();
+        EXPECT_TRUE(init) << init.error().message;
+
+        // The second connection is opened on demand
+        auto first = co_await pool->acquire();
+        auto second = co_await pool->acquire();
+        EXPECT_TRUE(first && second);
+        if (!first || !second) {
+          co_return;
+        }
+
+        for (auto* conn : {&*first, &*second}) {
+          auto name = co_await (*conn)->execute_raw("SHOW application_name");
+          EXPECT_TRUE(name) << name.error().message;
+          if (name) {
+            EXPECT_EQ("async_pool_setup_test", name->at(0).get<std::string>(0).value_or(""));
+          }
+          EXPECT_EQ(0, (*conn)->statement_cache_stats().hits);
+          EXPECT_EQ(1, (*conn)->statement_cache_stats().misses);
+
+          // Setting the same value again is skipped
+          auto unchanged = co_await (*conn)->set_session("application_name",
+                                                         "async_pool_setup_test");
+          EXPECT_TRUE(unchanged) << unchanged.error().message;
+        }
+      },
+      asio::detached);
+  io_context.run();
+}
+
+TEST_F(PostgreSQLAsyncConnectionPoolTest, RecordsMetrics) {
+  size_t reports = 0;
+  auto config = make_config(1, 1);
+  config.metrics_sink = {.callback = [&](const relx::connection::PoolMetrics&) { ++reports; },
+                         .interval = std::chrono::milliseconds(60000)};
+  auto pool = PostgreSQLAsyncConnectionPool::create(io_context, config);
+
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto init = co_await pool->initialize();
+        EXPECT_TRUE(init) << init.error().message;
+
+        {
+          auto conn = co_await pool->acquire();
+          EXPECT_TRUE(conn);
+          if (!conn) {
+            co_return;
+          }
+          EXPECT_TRUE(co_await (*conn)->execute_raw("SELECT 1"));
+          EXPECT_FALSE(co_await (*conn)->execute_raw("SELECT * FROM no_such_table"));
+
+          auto timed_out = co_await pool->acquire(std::chrono::milliseconds(50));
+          EXPECT_FALSE(timed_out);
+        }
+
+        auto metrics = pool->metrics();
+        EXPECT_EQ(1, metrics.checkouts);
+        EXPECT_EQ(1, metrics.checkout_timeouts);
+        EXPECT_EQ(1, metrics.connections_opened);
+        EXPECT_EQ(1, metrics.idle_connections);
+        EXPECT_EQ(2, metrics.queries.queries);
+        EXPECT_EQ(1, metrics.queries.errors);
+        EXPECT_EQ(2, metrics.checkout_wait.count);
+        EXPECT_GE(metrics.checkout_wait.max, std::chrono::milliseconds(50));
+        EXPECT_EQ(1, metrics.connect_latency.count);
+        EXPECT_TRUE(metrics.connections.empty());
+      },
+      asio::detached);
+  io_context.run();
+
+  // Once for the first acquire(); the interval has not passed for the second
+  EXPECT_EQ(1, reports);
+}
+
+}  // namespace
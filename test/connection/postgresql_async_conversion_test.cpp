@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <gtest/gtest.h>
+#include <relx/connection/postgresql_async_connection.hpp>
+#include <relx/connection/postgresql_connection.hpp>
+#include <relx/query.hpp>
+#include <relx/schema.hpp>
+
+namespace {
+
+namespace asio = boost::asio;
+using namespace std::chrono_literals;
+using relx::connection::PostgreSQLAsyncConnection;
+
+struct ConversionItems {
+  static constexpr auto table_name = "async_conversion_test";
+  relx::schema::column<ConversionItems, "id", int> id;
+  relx::schema::column<ConversionItems, "label", std::string> label;
+};
+
+struct ConversionItem {
+  int id;
+  std::string label;
+};
+
+struct ItemTotal {
+  int count;
+};
+
+constexpr auto large_query =
+    "SELECT i, md5(i::text), i * 2, md5((i * 2)::text) FROM generate_series(1, 500000) AS i";
+constexpr size_t large_row_count = 500'000;
+constexpr int item_count = 5'000;
+
+class PostgreSQLAsyncConversionTest : public ::testing::Test {
+protected:
+  std::string conn_string =
+      "host=localhost port=5434 dbname=relx_test user=postgres password=postgres";
+
+  asio::io_context io_context;
+  asio::thread_pool conversion_pool{2};
+
+  void SetUp() override {
+    relx::connection::PostgreSQLConnection setup_conn(conn_string);
+    ASSERT_TRUE(setup_conn.connect());
+    ASSERT_TRUE(setup_conn.execute_raw("DROP TABLE IF EXISTS async_conversion_test"));
+    ASSERT_TRUE(setup_conn.execute_raw(
+        "CREATE TABLE async_conversion_test (id INTEGER PRIMARY KEY, label TEXT)"));
+    ASSERT_TRUE(setup_conn.execute_raw(
+        "INSERT INTO async_conversion_test SELECT i, 'item ' || i FROM generate_series(1, " +
+        std::to_string(item_count) + ") AS i"));
+  }
+
+  void TearDown() override {
+    conversion_pool.join();
+    relx::connection::PostgreSQLConnection cleanup_conn(conn_string);
+    if (cleanup_conn.connect()) {
+      [[maybe_unused]] auto drop =
+          cleanup_conn.execute_raw("DROP TABLE IF EXISTS async_conversion_test");
+    }
+  }
+
+  void run_test(std::function<asio::awaitable<void>()> test_coro) {
+    asio::co_spawn(io_context, std::move(test_coro), asio::detached);
+    io_context.run();
+    io_context.restart();
+  }
+
+  /// Run large_query next to a coroutine ticking every millisecond on the same thread
+  /// @return The longest gap between two ticks, i.e. how long the query held the thread
+  std::chrono::steady_clock::duration longest_stall(PostgreSQLAsyncConnection& conn) {
+    bool done = false;
+    std::chrono::steady_clock::duration longest{};
+    const auto io_thread = std::this_thread::get_id();
+
+    asio::co_spawn(
+        io_context,
+        [&]() -> asio::awaitable<void> {
+          asio::steady_timer timer(io_context);
+          auto last = std::chrono::steady_clock::now();
+          while (!done) {
+            timer.expires_after(1ms);
+            co_await timer.async_wait(asio::use_awaitable);
+            const auto now = std::chrono::steady_clock::now();
+            longest = std::max(longest, now - last);
+            last = now;
+          }
+        },
+        asio::detached);
+    asio::co_spawn(
+        io_context,
+        [&]() -> asio::awaitable<void> {
+          auto result = co_await conn.execute_raw(large_query);
+          // Wherever the conversion ran, the coroutine is back on its own executor
+          EXPECT_EQ(io_thread, std::this_thread::get_id());
+          EXPECT_TRUE(result) << result.error().message;
+          if (result) {
+            EXPECT_EQ(large_row_count, result->size());
+          }
+          done = true;
+        },
+        asio::detached);
+    io_context.run();
+    io_context.restart();
+    return longest;
+  }
+};
+
+TEST_F(PostgreSQLAsyncConversionTest, LargeResultDoesNotStallOtherCoroutines) {
+  PostgreSQLAsyncConnection conn(io_context, conn_string);
+  run_test([&]() -> asio::awaitable<void> {
+    auto connect_result = co_await conn.connect();
+    EXPECT_TRUE(connect_result) << connect_result.error().message;
+  });
+  ASSERT_TRUE(conn.is_connected());
+
+  const auto inline_stall = longest_stall(conn);
+  conn.set_conversion_executor(conversion_pool.get_executor());
+  const auto offloaded_stall = longest_stall(conn);
+
+  // Reading the rows still happens on the io thread; converting them no longer does
+  EXPECT_LT(offloaded_stall * 2, inline_stall)
+      << "inline: " << std::chrono::duration<double, std::milli>(inline_stall).count()
+      << " ms, offloaded: " << std::chrono::duration<double, std::milli>(offloaded_stall).count()
+      << " ms";
+
+  run_test([&]() -> asio::awaitable<void> { co_await conn.disconnect(); });
+}
+
+TEST_F(PostgreSQLAsyncConversionTest, ExecuteManyMapsOnConversionExecutor) {
+  PostgreSQLAsyncConnection conn(io_context, conn_string);
+  conn.set_conversion_executor(conversion_pool.get_executor(), 1);
+  ConversionItems items;
+  const auto io_thread = std::this_thread::get_id();
+
+  run_test([&]() -> asio::awaitable<void> {
+    auto connect_result = co_await conn.connect();
+    EXPECT_TRUE(connect_result) << connect_result.error().message;
+    if (!connect_result) {
+      co_return;
+    }
+
+    auto mapped = co_await conn.execute_many<ConversionItem>(
+        relx::query::select(items.id, items.label).from(items).order_by(items.id));
+    EXPECT_EQ(io_thread, std::this_thread::get_id());
+    EXPECT_TRUE(mapped) << mapped.error().message;
+    if (mapped) {
+      EXPECT_EQ(static_cast<size_t>(item_count), mapped->size());
+      EXPECT_EQ(1, mapped->front().id);
+      EXPECT_EQ("item 1", mapped->front().label);
+      EXPECT_EQ(item_count, mapped->back().id);
+    }
+
+    // Results below the threshold are converted inline, with the same outcome
+    conn.set_conversion_executor(conversion_pool.get_executor(), item_count + 1);
+    auto small = co_await conn.execute_many<ConversionItem>(
+        relx::query::select(items.id, items.label).from(items).order_by(items.id));
+    EXPECT_TRUE(small) << small.error().message;
+    if (small) {
+      EXPECT_EQ(static_cast<size_t>(item_count), small->size());
+    }
+
+    co_await conn.disconnect();
+  });
+}
+
+TEST_F(PostgreSQLAsyncConversionTest, ExecuteMultiRunsEveryQueryInOneCall) {
+  PostgreSQLAsyncConnection conn(io_context, conn_string);
+  ConversionItems items;
+
+  run_test([&]() -> asio::awaitable<void> {
+    auto connect_result = co_await conn.connect();
+    EXPECT_TRUE(connect_result) << connect_result.error().message;
+    if (!connect_result) {
+      co_return;
+    }
+
+    const auto before = conn.query_stats();
+    auto results = co_await conn.execute_multi(
+        relx::query::select(relx::query::count_all()).from(items),
+        relx::query::select(relx::query::min(items.id)).from(items),
+        relx::query::select(relx::query::max(items.id)).from(items),
+        relx::query::select(relx::query::count_all()).from(items).where(items.id > 100),
+        relx::query::select(items.label).from(items).where(items.id == 42));
+    EXPECT_TRUE(results) << results.error().message;
+    if (results) {
+      EXPECT_EQ(5, results->size());
+      EXPECT_EQ(item_count, *(*results)[0].at(0).get<int>(0));
+      EXPECT_EQ(1, *(*results)[1].at(0).get<int>(0));
+      EXPECT_EQ(item_count, *(*results)[2].at(0).get<int>(0));
+      EXPECT_EQ(item_count - 100, *(*results)[3].at(0).get<int>(0));
+      EXPECT_EQ("item 42", *(*results)[4].at(0).get<std::string>(0));
+    }
+    EXPECT_EQ(5, (conn.query_stats() - before).queries);
+
+    // A failing query reports its index, and the server skips the rest of the batch
+    auto failed = co_await conn.execute_multi(
+        relx::query::select(relx::query::count_all()).from(items),
+        relx::query::insert_into(items).columns(items.id, items.label).values(1, "duplicate"),
+        relx::query::select(relx::query::count_all()).from(items));
+    EXPECT_FALSE(failed);
+    if (!failed) {
+      co_return;
+    }
+    EXPECT_NE(std::string::npos, failed.error().message.find("Pipeline statement 1 failed"))
+        << failed.error().message;
+
+    // The connection is still usable afterwards
+    auto after = co_await conn.execute_raw("SELECT 1");
+    EXPECT_TRUE(after) << after.error().message;
+
+    co_await conn.disconnect();
+  });
+}
+
+TEST_F(PostgreSQLAsyncConversionTest, ExecuteMultiAsMapsEachResult) {
+  PostgreSQLAsyncConnection conn(io_context, conn_string);
+  conn.set_conversion_executor(conversion_pool.get_executor(), 1);
+  ConversionItems items;
+  const auto io_thread = std::this_thread::get_id();
+
+  run_test([&]() -> asio::awaitable<void> {
+    auto connect_result = co_await conn.connect();
+    EXPECT_TRUE(connect_result) << connect_result.error().message;
+    if (!connect_result) {
+      co_return;
+    }
+
+    auto mapped = co_await conn.execute_multi_as<ConversionItem, ItemTotal>(
+        relx::query::select(items.id, items.label).from(items).order_by(items.id),
+        relx::query::select(relx::query::count_all()).from(items));
+    EXPECT_EQ(io_thread, std::this_thread::get_id());
+    EXPECT_TRUE(mapped) << mapped.error().message;
+    if (mapped) {
+      const auto& [rows, totals] = *mapped;
+      EXPECT_EQ(static_cast<size_t>(item_count), rows.size());
+      EXPECT_EQ("item 1", rows.front().label);
+      EXPECT_EQ(1, totals.size());
+      EXPECT_EQ(item_count, totals.front().count);
+    }
+
+    co_await conn.disconnect();
+  });
+}
+
+TEST_F(PostgreSQLAsyncConversionTest, ExecuteMultiTakesOptions) {
+  PostgreSQLAsyncConnection conn(io_context, conn_string);
+  ConversionItems items;
+
+  run_test([&]() -> asio::awaitable<void> {
+    auto connect_result = co_await conn.connect();
+    EXPECT_TRUE(connect_result) << connect_result.error().message;
+    if (!connect_result) {
+      co_return;
+    }
+
+    relx::connection::CancelToken token;
+    token.cancel();
+    auto cancelled = co_await conn.execute_multi(
+        relx::connection::QueryOptions{.cancel_token = &token},
+        relx::query::select(relx::query::count_all()).from(items),
+        relx::query::select(relx::query::max(items.id)).from(items));
+    EXPECT_FALSE(cancelled);
+    if (!cancelled) {
+      EXPECT_EQ(relx::connection::query_cancelled_error, cancelled.error().error_code);
+    }
+
+    auto mapped = co_await conn.execute_multi_as<ItemTotal, ItemTotal>(
+        relx::connection::QueryOptions{.timeout = 5s},
+        relx::query::select(relx::query::count_all()).from(items),
+        relx::query::select(relx::query::count_all()).from(items).where(items.id > 100));
+    EXPECT_TRUE(mapped) << mapped.error().message;
+    if (mapped) {
+      EXPECT_EQ(item_count, std::get<0>(*mapped).front().count);
+      EXPECT_EQ(item_count - 100, std::get<1>(*mapped).front().count);
+    }
+
+    co_await conn.disconnect();
+  });
+}
+
+}  // namespace
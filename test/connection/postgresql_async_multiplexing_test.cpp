@@ -0,0 +1,112 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <relx/connection/postgresql_async_connection.hpp>
+
+namespace {
+
+namespace asio = boost::asio;
+
+class PostgreSQLAsyncMultiplexingTest : public ::testing::Test {
+protected:
+  std::string conn_string =
+      "host=localhost port=5434 dbname=relx_test user=postgres password=postgres";
+
+  asio::io_context io_context;
+
+  void run_test(std::function<asio::awaitable<void>()> test_coro) {
+    asio::co_spawn(io_context, std::move(test_coro), asio::detached);
+    io_context.run();
+    io_context.restart();
+  }
+};
+
+TEST_F(PostgreSQLAsyncMultiplexingTest, ConcurrentQueriesGetTheirOwnResults) {
+  relx::connection::PostgreSQLAsyncConnection conn(io_context, conn_string);
+
+  run_test([&]() -> asio::awaitable<void> {
+    auto connect_result = co_await conn.connect();
+    EXPECT_TRUE(connect_result) << connect_result.error().message;
+  });
+  ASSERT_TRUE(conn.is_connected());
+
+  constexpr int query_count = 200;
+  std::vector<int> values(query_count, -1);
+  int completed = 0;
+
+  // Every coroutine shares the same connection; the queries are in flight together
+  for (int i = 0; i < query_count; ++i) {
+    asio::co_spawn(
+        io_context,
+        [&, i]() -> asio::awaitable<void> {
+          auto result = co_await conn.execute_raw("SELECT ?::int * 2", {std::to_string(i)});
+          if (result && !result->empty()) {
+            values[i] = result->at(0).get<int>(0).value_or(-1);
+          }
+          ++completed;
+        },
+        asio::detached);
+  }
+
+  io_context.run();
+  io_context.restart();
+
+  EXPECT_EQ(query_count, completed);
+  for (int i = 0; i < query_count; ++i) {
+    EXPECT_EQ(i * 2, values[i]) << "query " << i;
+  }
+  EXPECT_EQ(0, conn.get_async_conn().pending_queries());
+}
+
+TEST_F(PostgreSQLAsyncMultiplexingTest, FailingQueryDoesNotAffectOthers) {
+  relx::connection::PostgreSQLAsyncConnection conn(io_context, conn_string);
+
+  run_test([&]() -> asio::awaitable<void> {
+    auto connect_result = co_await conn.connect();
+    EXPECT_TRUE(connect_result) << connect_result.error().message;
+  });
+  ASSERT_TRUE(conn.is_connected());
+
+  bool first_ok = false;
+  bool bad_failed = false;
+  bool last_ok = false;
+
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto result = co_await conn.execute_raw("SELECT 1");
+        first_ok = result.has_value();
+      },
+      asio::detached);
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto result = co_await conn.execute_raw("SELECT * FROM table_that_does_not_exist");
+        bad_failed = !result.has_value();
+      },
+      asio::detached);
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto result = co_await conn.execute_raw("SELECT 3");
+        last_ok = result.has_value();
+      },
+      asio::detached);
+
+  io_context.run();
+  io_context.restart();
+
+  EXPECT_TRUE(first_ok);
+  EXPECT_TRUE(bad_failed);
+  EXPECT_TRUE(last_ok);
+
+  // After the pipeline drains the connection is usable for sequential work again
+  run_test([&]() -> asio::awaitable<void> {
+    auto result = co_await conn.execute_raw("SELECT 'still alive'");
+    EXPECT_TRUE(result);
+    co_await conn.disconnect();
+  });
+}
+
+}  // namespace
@@ -0,0 +1,268 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <gtest/gtest.h>
+#include <relx/connection/postgresql_async_connection.hpp>
+#include <relx/connection/postgresql_async_connection_pool.hpp>
+#include <relx/connection/postgresql_connection.hpp>
+#include <relx/query.hpp>
+#include <relx/schema.hpp>
+
+// These tests run one io_context on several threads and are meant to be run under
+// ThreadSanitizer as well (cmake -DRELX_ENABLE_TSAN=ON, or make test-tsan)
+
+namespace {
+
+namespace asio = boost::asio;
+using relx::connection::PostgreSQLAsyncConnection;
+
+struct MultithreadItems {
+  static constexpr auto table_name = "async_multithread_test";
+  relx::schema::column<MultithreadItems, "id", int> id;
+  relx::schema::column<MultithreadItems, "value", int> value;
+};
+
+constexpr size_t thread_count = 4;
+constexpr size_t connection_count = 8;
+constexpr int item_count = 64;
+
+class PostgreSQLAsyncMultithreadTest : public ::testing::Test {
+protected:
+  std::string conn_string =
+      "host=localhost port=5434 dbname=relx_test user=postgres password=postgres";
+
+  asio::io_context io_context;
+  std::vector<std::unique_ptr<PostgreSQLAsyncConnection>> connections;
+
+  void SetUp() override {
+    relx::connection::PostgreSQLConnection setup_conn(conn_string);
+    ASSERT_TRUE(setup_conn.connect());
+    ASSERT_TRUE(setup_conn.execute_raw("DROP TABLE IF EXISTS async_multithread_test"));
+    ASSERT_TRUE(setup_conn.execute_raw(
+        "CREATE TABLE async_multithread_test (id INTEGER PRIMARY KEY, value INTEGER)"));
+    ASSERT_TRUE(setup_conn.execute_raw(
+        "INSERT INTO async_multithread_test SELECT i, i * 10 FROM generate_series(1, " +
+        std::to_string(item_count) + ") AS i"));
+
+    for (size_t i = 0; i < connection_count; ++i) {
+      connections.push_back(std::make_unique<PostgreSQLAsyncConnection>(io_context, conn_string));
+      asio::co_spawn(
+          io_context,
+          [conn = connections.back().get()]() -> asio::awaitable<void> {
+            auto connect_result = co_await conn->connect();
+            EXPECT_TRUE(connect_result) << connect_result.error().message;
+          },
+          asio::detached);
+    }
+    run_on_threads();
+    for (const auto& conn : connections) {
+      ASSERT_TRUE(conn->is_connected());
+    }
+  }
+
+  void TearDown() override {
+    for (const auto& conn : connections) {
+      asio::co_spawn(
+          io_context,
+          [conn = conn.get()]() -> asio::awaitable<void> { co_await conn->disconnect(); },
+          asio::detached);
+    }
+    run_on_threads();
+
+    relx::connection::PostgreSQLConnection cleanup_conn(conn_string);
+    if (cleanup_conn.connect()) {
+      [[maybe_unused]] auto drop =
+          cleanup_conn.execute_raw("DROP TABLE IF EXISTS async_multithread_test");
+    }
+  }
+
+  /// Run the io_context on thread_count threads until it runs out of work
+  void run_on_threads() {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < thread_count; ++i) {
+      threads.emplace_back([this] { io_context.run(); });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    io_context.restart();
+  }
+};
+
+TEST_F(PostgreSQLAsyncMultithreadTest, ConcurrentQueriesFromManyThreads) {
+  constexpr int queries_per_connection = 64;
+  std::vector<int> values(connection_count * queries_per_connection, -1);
+  std::atomic<int> completed{0};
+
+  // The coroutines run on the io_context, not the strands, so every query hops onto its strand
+  for (size_t c = 0; c < connection_count; ++c) {
+    for (int q = 0; q < queries_per_connection; ++q) {
+      const size_t index = c * queries_per_connection + q;
+      asio::co_spawn(
+          io_context,
+          [&, conn = connections[c].get(), index]() -> asio::awaitable<void> {
+            auto result =
+                co_await conn->execute_raw("SELECT ?::int * 2", {std::to_string(index)});
+            if (result && !result->empty()) {
+              values[index] = result->at(0).get<int>(0).value_or(-1);
+            }
+            completed.fetch_add(1, std::memory_order_relaxed);
+          },
+          asio::detached);
+    }
+  }
+  run_on_threads();
+
+  EXPECT_EQ(static_cast<int>(values.size()), completed.load());
+  for (size_t i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(static_cast<int>(i) * 2, values[i]) << "query " << i;
+  }
+  for (const auto& conn : connections) {
+    EXPECT_EQ(0, conn->get_async_conn().pending_queries());
+    EXPECT_EQ(static_cast<uint64_t>(queries_per_connection), conn->query_stats().queries);
+  }
+}
+
+TEST_F(PostgreSQLAsyncMultithreadTest, CachedAndPreparedQueriesFromManyThreads) {
+  MultithreadItems items;
+  std::atomic<int> matched{0};
+
+  for (const auto& conn : connections) {
+    conn->enable_statement_cache(16);
+  }
+
+  for (const auto& conn_ptr : connections) {
+    auto* conn = conn_ptr.get();
+
+    // One coroutine on the strand prepares a statement, then shares it with coroutines that
+    // run on any thread, next to cached queries on the same connection
+    asio::co_spawn(
+        conn->strand(),
+        [&, conn]() -> asio::awaitable<void> {
+          auto prepared = co_await conn->prepare(
+              relx::query::select(items.value)
+                  .from(items)
+                  .where(items.id == relx::query::param<int>("id")));
+          EXPECT_TRUE(prepared) << prepared.error().message;
+          if (!prepared) {
+            co_return;
+          }
+
+          auto statement = std::make_shared<std::decay_t<decltype(*prepared)>>(
+              std::move(*prepared));
+          for (int id = 1; id <= item_count; ++id) {
+            asio::co_spawn(
+                io_context,
+                [&, conn, statement, id]() -> asio::awaitable<void> {
+                  auto by_statement = co_await (*statement)(id);
+                  auto by_cache = co_await conn->execute(
+                      relx::query::select(items.value).from(items).where(items.id == id));
+                  if (by_statement && by_cache && !by_statement->empty() && !by_cache->empty() &&
+                      by_statement->at(0).get<int>(0).value_or(-1) == id * 10 &&
+                      by_cache->at(0).get<int>(0).value_or(-1) == id * 10) {
+                    matched.fetch_add(1, std::memory_order_relaxed);
+                  }
+                },
+                asio::detached);
+          }
+        },
+        asio::detached);
+  }
+  run_on_threads();
+
+  EXPECT_EQ(static_cast<int>(connection_count) * item_count, matched.load());
+  for (const auto& conn : connections) {
+    const auto stats = conn->statement_cache_stats();
+    EXPECT_EQ(static_cast<uint64_t>(item_count), stats.hits + stats.misses);
+  }
+}
+
+TEST_F(PostgreSQLAsyncMultithreadTest, TransactionsOnEveryConnectionAtOnce) {
+  constexpr int transactions_per_connection = 16;
+
+  // A transaction needs the connection to itself, so each connection runs one coroutine; the
+  // connections themselves run in parallel on all threads
+  for (size_t c = 0; c < connection_count; ++c) {
+    asio::co_spawn(
+        connections[c]->strand(),
+        [conn = connections[c].get(), c]() -> asio::awaitable<void> {
+          for (int t = 0; t < transactions_per_connection; ++t) {
+            auto begin = co_await conn->begin_transaction();
+            EXPECT_TRUE(begin) << begin.error().message;
+            const int id = 1000 + static_cast<int>(c) * transactions_per_connection + t;
+            auto deferred = conn->defer_raw("INSERT INTO async_multithread_test VALUES (?, ?)",
+                                            {std::to_string(id), std::to_string(id)});
+            EXPECT_TRUE(deferred) << deferred.error().message;
+            auto commit = co_await conn->commit_transaction();
+            EXPECT_TRUE(commit) << commit.error().message;
+          }
+        },
+        asio::detached);
+  }
+  run_on_threads();
+
+  int inserted = -1;
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto count = co_await connections[0]->execute_raw(
+            "SELECT COUNT(*) FROM async_multithread_test WHERE id >= 1000");
+        EXPECT_TRUE(count) << count.error().message;
+        if (count) {
+          inserted = count->at(0).get<int>(0).value_or(-1);
+        }
+      },
+      asio::detached);
+  run_on_threads();
+
+  EXPECT_EQ(static_cast<int>(connection_count) * transactions_per_connection, inserted);
+}
+
+TEST_F(PostgreSQLAsyncMultithreadTest, PoolServesCoroutinesOnManyThreads) {
+  relx::connection::PostgreSQLAsyncConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 2;
+  config.max_size = 4;
+  config.connection_timeout = std::chrono::milliseconds(5000);
+  auto pool = relx::connection::PostgreSQLAsyncConnectionPool::create(io_context, config);
+
+  constexpr int request_count = 256;
+  std::atomic<int> succeeded{0};
+  for (int i = 0; i < request_count; ++i) {
+    asio::co_spawn(
+        io_context,
+        [&, i]() -> asio::awaitable<void> {
+          auto conn = co_await pool->acquire();
+          EXPECT_TRUE(conn) << conn.error().message;
+          if (!conn) {
+            co_return;
+          }
+          auto result = co_await (*conn)->execute_raw("SELECT ?::int + 1", {std::to_string(i)});
+          if (result && !result->empty() && result->at(0).get<int>(0).value_or(-1) == i + 1) {
+            succeeded.fetch_add(1, std::memory_order_relaxed);
+          }
+        },
+        asio::detached);
+  }
+  run_on_threads();
+
+  EXPECT_EQ(request_count, succeeded.load());
+  EXPECT_EQ(0, pool->active_connections());
+  EXPECT_LE(pool->metrics().total_connections, config.max_size);
+}
+
+}  // namespace
@@ -905,6 +905,42 @@ TEST_F(PostgreSQLAsyncStreamingTest, BoolReturnImmediateBreak) {
   });
 }
 
+// Breaking out of a huge stream cancels the rest of the query instead of draining it
+TEST_F(PostgreSQLAsyncStreamingTest, EarlyTerminationCancelsRemainingRows) {
+  connection::PostgreSQLAsyncConnection conn(io_context, conn_string);
+
+  run_test([&]() -> asio::awaitable<void> {
+    auto connect_result = co_await conn.connect();
+    EXPECT_TRUE(connect_result);
+    if (!connect_result) {
+      co_return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    {
+      auto streaming_result = connection::create_async_streaming_result(
+          conn, "SELECT i, md5(i::text) AS hash FROM generate_series(1, 10000000) AS i");
+
+      int count = 0;
+      co_await streaming_result.for_each([&count](const auto& lazy_row) -> bool {
+        (void)lazy_row;
+        return ++count >= 100;
+      });
+      EXPECT_EQ(count, 100);
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+
+    // The cancelled query left the connection ready for the next one
+    auto after = co_await conn.execute_raw("SELECT 1 AS one");
+    EXPECT_TRUE(after) << after.error().message;
+    if (after) {
+      EXPECT_EQ(1, after->at(0).template get<int>(0).value_or(-1));
+    }
+
+    co_await conn.disconnect();
+  });
+}
+
 // Test void functions (traditional behavior)
 TEST_F(PostgreSQLAsyncStreamingTest, VoidReturnTraditionalBehavior) {
   connection::PostgreSQLAsyncConnection conn(io_context, conn_string);
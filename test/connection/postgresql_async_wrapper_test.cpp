@@ -227,6 +227,67 @@ TEST_F(PostgresqlAsyncWrapperTest, ConnectionCloseAndReconnect) {
   });
 }
 
+// Unix-domain socket of the test server, shared from the container by docker-compose.yml
+constexpr auto socket_conn_string =
+    "host=/tmp/relx_postgres port=5432 dbname=relx_test user=postgres password=postgres";
+
+// The socket is watched as a plain descriptor, whatever its address family
+TEST_F(PostgresqlAsyncWrapperTest, QueryOverUnixDomainSocket) {
+  if (PQping(socket_conn_string) != PQPING_OK) {
+    GTEST_SKIP() << "No server socket in /tmp/relx_postgres";
+  }
+  Connection conn(io_);
+
+  run_test([&]() -> asio::awaitable<void> {
+    auto connect_result = co_await conn.connect(socket_conn_string);
+    EXPECT_TRUE(connect_result) << connect_result.error().message;
+
+    auto res_result = co_await conn.query("SELECT $1::int + 1 AS num", {"41"});
+    EXPECT_TRUE(res_result);
+    if (res_result) {
+      EXPECT_STREQ("42", res_result->get_value(0, 0));
+    }
+
+    conn.close();
+  });
+}
+
+TEST_F(PostgresqlAsyncWrapperTest, QueryOverIpv6Loopback) {
+  const std::string ipv6_conn_string =
+      "host=::1 port=5434 dbname=relx_test user=postgres password=postgres";
+  if (PQping(ipv6_conn_string.c_str()) != PQPING_OK) {
+    GTEST_SKIP() << "The test server is not reachable over IPv6";
+  }
+  Connection conn(io_);
+
+  run_test([&]() -> asio::awaitable<void> {
+    auto connect_result = co_await conn.connect(ipv6_conn_string);
+    EXPECT_TRUE(connect_result) << connect_result.error().message;
+
+    auto res_result = co_await conn.query("SELECT 1");
+    EXPECT_TRUE(res_result);
+
+    conn.close();
+  });
+}
+
+// libpq opens a new socket for each host it tries, so the wrapper has to follow it
+TEST_F(PostgresqlAsyncWrapperTest, ConnectFallsBackToNextHost) {
+  Connection conn(io_);
+
+  run_test([&]() -> asio::awaitable<void> {
+    auto connect_result = co_await conn.connect(
+        "host=localhost,localhost port=1,5434 dbname=relx_test user=postgres password=postgres");
+    EXPECT_TRUE(connect_result) << connect_result.error().message;
+    EXPECT_TRUE(conn.is_open());
+
+    auto res_result = co_await conn.query("SELECT 1");
+    EXPECT_TRUE(res_result);
+
+    conn.close();
+  });
+}
+
 // Test basic transaction
 TEST_F(PostgresqlAsyncWrapperTest, BasicTransaction) {
   Connection conn(io_);
@@ -1,15 +1,26 @@
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <expected>
 #include <future>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
 
 #include <gtest/gtest.h>
 #include <relx/connection/postgresql_connection_pool.hpp>
+#include <relx/query.hpp>
+#include <relx/schema.hpp>
 
 namespace {
 
+struct PgSettings {
+  static constexpr auto table_name = "pg_settings";
+  relx::schema::column<PgSettings, "name", std::string> name;
+  relx::schema::column<PgSettings, "setting", std::string> setting;
+};
+
 class PostgreSQLConnectionPoolTest : public ::testing::Test {
 protected:
   // Connection string for the Docker container
@@ -37,6 +48,23 @@ protected:
     }
   }
 
+  // Helper to terminate the backend behind a pooled connection from outside the pool
+  void terminate_backend(int pid) {
+    relx::connection::PostgreSQLConnection conn(conn_string);
+    ASSERT_TRUE(conn.connect());
+    auto result = conn.execute_raw("SELECT pg_terminate_backend(" + std::to_string(pid) + ")");
+    ASSERT_TRUE(result) << "Failed to terminate backend: " << result.error().message;
+    conn.disconnect();
+    // Give the server a moment to close the socket
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+
+  // Helper to read the backend pid of a pooled connection
+  int backend_pid(relx::connection::PostgreSQLConnectionPool::PooledConnection& conn) {
+    auto result = conn->execute_raw("SELECT pg_backend_pid()");
+    return result ? result->at(0).get<int>(0).value_or(-1) : -1;
+  }
+
   // Helper to create the test table using a connection from the pool
   void create_test_table(relx::connection::PostgreSQLConnectionPool::PooledConnection& conn) {
     std::string create_table_sql = R"(
@@ -522,4 +550,730 @@ TEST_F(PostgreSQLConnectionPoolTest, TestPoolConnectionFailureRecovery) {
   }
 }
 
-}  // namespace
\ No newline at end of file
+TEST_F(PostgreSQLConnectionPoolTest, TestStatusValidationDetectsClosedConnection) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 1;
+  config.max_size = 1;
+  config.validation = relx::connection::ConnectionValidation::Status;
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  int old_pid = -1;
+  {
+    auto conn = pool->get_connection();
+    ASSERT_TRUE(conn);
+    old_pid = backend_pid(*conn);
+  }
+  terminate_backend(old_pid);
+
+  // The closed socket is noticed without a round trip and the connection is replaced
+  auto conn = pool->get_connection();
+  ASSERT_TRUE(conn) << conn.error().message;
+  int new_pid = backend_pid(*conn);
+  EXPECT_NE(-1, new_pid);
+  EXPECT_NE(old_pid, new_pid);
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestIdempotentWorkIsRetriedOnBrokenConnection) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 1;
+  config.max_size = 1;
+  config.validate_connections = false;
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  {
+    auto conn = pool->get_connection();
+    ASSERT_TRUE(conn);
+    terminate_backend(backend_pid(*conn));
+  }
+
+  int calls = 0;
+  auto result = pool->with_idempotent_connection([&](auto& conn) {
+    ++calls;
+    return conn->execute_raw("SELECT 1");
+  });
+
+  ASSERT_TRUE(result) << result.error().message;
+  EXPECT_TRUE(*result);
+  EXPECT_EQ(2, calls);
+  EXPECT_EQ(1, pool->idle_connections());
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestValidateIdleConnections) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 2;
+  config.max_size = 2;
+  config.validation_idle_threshold = std::chrono::milliseconds(0);
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  {
+    auto conn = pool->get_connection();
+    ASSERT_TRUE(conn);
+    terminate_backend(backend_pid(*conn));
+  }
+
+  EXPECT_EQ(1, pool->validate_idle_connections());
+  EXPECT_EQ(1, pool->idle_connections());
+  EXPECT_EQ(0, pool->validate_idle_connections());
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestMaintenanceThreadKeepsMinIdle) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 1;
+  config.max_size = 4;
+  config.maintenance_thread = true;
+  config.maintenance_interval = std::chrono::milliseconds(20);
+  config.min_idle = 3;
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  EXPECT_EQ(3, pool->idle_connections());
+
+  {
+    auto conn = pool->get_connection();
+    ASSERT_TRUE(conn);
+    // The pool tops itself up again while the connection is checked out
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    EXPECT_EQ(3, pool->idle_connections());
+  }
+  EXPECT_EQ(4, pool->idle_connections());
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestMaintenanceThreadOpensConnectionsForWaiters) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 0;
+  config.max_size = 2;
+  config.maintenance_thread = true;
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  auto first = pool->get_connection();
+  ASSERT_TRUE(first) << first.error().message;
+  auto second = pool->get_connection();
+  ASSERT_TRUE(second) << second.error().message;
+  EXPECT_EQ(2, pool->active_connections());
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestMaintenanceThreadResetsReturnedConnections) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 1;
+  config.max_size = 1;
+  config.maintenance_thread = true;
+  config.reset_query = "RESET ALL";
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  {
+    auto conn = pool->get_connection();
+    ASSERT_TRUE(conn);
+    ASSERT_TRUE((*conn)->execute_raw("SET application_name = 'pool_reset_test'"));
+    ASSERT_TRUE((*conn)->begin_transaction());
+    ASSERT_TRUE((*conn)->execute_raw("SELECT 1"));
+  }
+
+  // The only connection comes back once the maintenance thread has reset it
+  auto conn = pool->get_connection();
+  ASSERT_TRUE(conn) << conn.error().message;
+  EXPECT_FALSE((*conn)->in_transaction());
+  auto name = (*conn)->execute_raw("SHOW application_name");
+  ASSERT_TRUE(name) << name.error().message;
+  EXPECT_NE("pool_reset_test", name->at(0).get<std::string>(0).value_or(""));
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestMaintenanceThreadReplacesBrokenConnections) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 1;
+  config.max_size = 1;
+  config.maintenance_thread = true;
+  config.validation = relx::connection::ConnectionValidation::Always;
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  int pid = 0;
+  {
+    auto conn = pool->get_connection();
+    ASSERT_TRUE(conn);
+    pid = backend_pid(*conn);
+  }
+  terminate_backend(pid);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  // The checkout sees the closed socket, drops the connection and waits for the maintenance
+  // thread to open a new one
+  auto conn = pool->get_connection();
+  ASSERT_TRUE(conn) << conn.error().message;
+  EXPECT_NE(pid, backend_pid(*conn));
+
+  auto metrics = pool->metrics();
+  EXPECT_EQ(1, metrics.validation_failures);
+  EXPECT_EQ(1, metrics.connections_closed);
+  EXPECT_EQ(2, metrics.connections_opened);
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestLifoIdleOrder) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 2;
+  config.max_size = 2;
+  config.shard_count = 1;
+  config.idle_order = relx::connection::IdleOrder::Lifo;
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  int second_pid = -1;
+  {
+    auto first = pool->get_connection();
+    auto second = pool->get_connection();
+    ASSERT_TRUE(first && second);
+    second_pid = backend_pid(*second);
+
+    // Return the first connection before the second
+    auto returned = std::move(*first);
+  }
+
+  // The most recently returned connection is handed out again
+  auto conn = pool->get_connection();
+  ASSERT_TRUE(conn);
+  EXPECT_EQ(second_pid, backend_pid(*conn));
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestThreadAffinity) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 2;
+  config.max_size = 2;
+  config.shard_count = 1;
+  config.thread_affinity = true;
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  int last_pid = -1;
+  {
+    auto first = pool->get_connection();
+    auto last = pool->get_connection();
+    ASSERT_TRUE(first && last);
+    last_pid = backend_pid(*last);
+
+    // Return the connection checked out last before the other one
+    auto returned = std::move(*last);
+  }
+
+  // This thread gets its last connection back, even though it is not the first idle one
+  auto conn = pool->get_connection();
+  ASSERT_TRUE(conn);
+  EXPECT_EQ(last_pid, backend_pid(*conn));
+
+  // Another thread has no affinity and takes whatever is idle
+  std::thread other([&] {
+    auto other_conn = pool->get_connection();
+    ASSERT_TRUE(other_conn);
+    EXPECT_NE(last_pid, backend_pid(*other_conn));
+  });
+  other.join();
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestParallelInitialization) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 8;
+  config.max_size = 8;
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  auto init_result = pool->initialize();
+  ASSERT_TRUE(init_result) << init_result.error().message;
+
+  EXPECT_EQ(8, pool->idle_connections());
+  auto latencies = pool->connect_latencies();
+  ASSERT_EQ(8, latencies.size());
+  for (auto latency : latencies) {
+    EXPECT_GT(latency.count(), 0);
+  }
+
+  // Every connection is usable
+  std::vector<relx::connection::PostgreSQLConnectionPool::PooledConnection> held;
+  for (int i = 0; i < 8; ++i) {
+    auto conn = pool->get_connection();
+    ASSERT_TRUE(conn) << conn.error().message;
+    EXPECT_TRUE((*conn)->execute_raw("SELECT 1"));
+    held.push_back(std::move(*conn));
+  }
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestParallelInitializationTimesOut) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  // A non-routable address, so connecting neither succeeds nor fails quickly
+  config.connection_params = {.host = "10.255.255.1",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 4;
+  config.max_size = 4;
+  config.connection_timeout = std::chrono::milliseconds(200);
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  const auto start = std::chrono::steady_clock::now();
+  auto init_result = pool->initialize();
+  EXPECT_FALSE(init_result);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+  EXPECT_EQ(0, pool->idle_connections());
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestSessionSetupOnNewConnections) {
+  PgSettings s;
+  auto setting_query = [&](const char* name) {
+    return relx::query::select(s.setting).from(s).where(s.name == std::string(name));
+  };
+
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 1;
+  config.max_size = 2;
+  config.session_setup.settings = {{"application_name", "pool_setup_test"},
+                                   {"statement_timeout", "5s"}};
+  config.session_setup.statements.push_back(
+      relx::connection::warm_statement(setting_query("anything")));
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  // Both the initial connection and one opened on demand are set up
+  auto first = pool->get_connection();
+  auto second = pool->get_connection();
+  ASSERT_TRUE(first && second);
+  for (auto* conn : {&*first, &*second}) {
+    EXPECT_EQ("pool_setup_test", (*conn)->session_setting("application_name"));
+
+    // The warmed statement is already prepared, whatever the parameter value
+    auto result = (*conn)->execute(setting_query("application_name"));
+    ASSERT_TRUE(result) << result.error().message;
+    ASSERT_EQ(1, result->size());
+    EXPECT_EQ("pool_setup_test", result->at(0).get<std::string>(0).value_or(""));
+    EXPECT_EQ(1, (*conn)->statement_cache_stats().hits);
+    EXPECT_EQ(1, (*conn)->statement_cache_stats().misses);
+  }
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestSessionSetupAppliedToEveryInitialConnection) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 8;
+  config.max_size = 8;
+  config.session_setup.settings = {{"application_name", "pool_setup_test"}};
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+  EXPECT_EQ(8, pool->idle_connections());
+  EXPECT_EQ(8, pool->connect_latencies().size());
+
+  // The setups ran side by side, and every connection got its own
+  std::vector<relx::connection::PostgreSQLConnectionPool::PooledConnection> conns;
+  for (int i = 0; i < 8; ++i) {
+    auto conn = pool->get_connection();
+    ASSERT_TRUE(conn) << conn.error().message;
+    conns.push_back(std::move(*conn));
+  }
+  for (auto& conn : conns) {
+    auto name = conn->execute_raw("SHOW application_name");
+    ASSERT_TRUE(name) << name.error().message;
+    EXPECT_EQ("pool_setup_test", name->at(0).get<std::string>(0).value_or(""));
+  }
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestSessionSettingsReappliedAfterReset) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 1;
+  config.max_size = 1;
+  config.reset_query = "RESET ALL";
+  config.session_setup.settings = {{"application_name", "pool_setup_test"}};
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  {
+    auto conn = pool->get_connection();
+    ASSERT_TRUE(conn);
+    ASSERT_TRUE((*conn)->execute_raw("SET application_name = 'changed'"));
+  }
+
+  auto conn = pool->get_connection();
+  ASSERT_TRUE(conn);
+  auto name = (*conn)->execute_raw("SHOW application_name");
+  ASSERT_TRUE(name) << name.error().message;
+  EXPECT_EQ("pool_setup_test", name->at(0).get<std::string>(0).value_or(""));
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestPriorityClassReservation) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 2;
+  config.max_size = 2;
+  config.connection_timeout = std::chrono::milliseconds(100);
+  config.priority_classes = {{.name = "api", .reserved = 1}, {.name = "batch"}};
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  // Batch work cannot take the connection reserved for the API
+  auto batch = pool->get_connection("batch");
+  ASSERT_TRUE(batch);
+  EXPECT_FALSE(pool->get_connection("batch"));
+
+  auto api = pool->get_connection("api");
+  ASSERT_TRUE(api) << api.error().message;
+
+  auto unknown = pool->get_connection("unknown");
+  ASSERT_FALSE(unknown);
+  EXPECT_NE(std::string::npos, unknown.error().message.find("Unknown priority class"));
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestPriorityClassWeights) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 1;
+  config.max_size = 1;
+  config.priority_classes = {{.name = "api", .weight = 3}, {.name = "batch", .weight = 1}};
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  std::mutex order_mutex;
+  std::vector<std::string> order;
+  std::vector<std::thread> threads;
+  {
+    auto held = pool->get_connection();
+    ASSERT_TRUE(held);
+    for (int i = 0; i < 4; ++i) {
+      for (const char* name : {"api", "batch"}) {
+        threads.emplace_back([&, name] {
+          auto conn = pool->get_connection(name);
+          ASSERT_TRUE(conn);
+          const std::lock_guard<std::mutex> lock(order_mutex);
+          order.emplace_back(name);
+        });
+      }
+    }
+    // Let every thread start waiting
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // While both classes wait, the API gets three of every four connections
+  ASSERT_EQ(8, order.size());
+  EXPECT_EQ(3, std::count(order.begin(), order.begin() + 4, "api"));
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestAdaptiveConcurrencyLimit) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 4;
+  config.max_size = 4;
+  config.connection_timeout = std::chrono::milliseconds(100);
+  config.adaptive_concurrency = {.enabled = true, .initial_limit = 1};
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+  EXPECT_EQ(1, pool->concurrency_limit());
+
+  {
+    auto first = pool->get_connection();
+    ASSERT_TRUE(first);
+    EXPECT_FALSE(pool->get_connection());
+  }
+
+  // Fast checkouts that use the whole limit let it grow
+  for (int i = 0; i < 20; ++i) {
+    auto conn = pool->get_connection();
+    ASSERT_TRUE(conn);
+    ASSERT_TRUE((*conn)->execute_raw("SELECT 1"));
+  }
+  EXPECT_GT(pool->concurrency_limit(), 1);
+  EXPECT_LE(pool->concurrency_limit(), 4);
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestAutoscalingFollowsLoad) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 1;
+  config.max_size = 8;
+  config.autoscaling = {.enabled = true,
+                        .min_size = 1,
+                        .target_wait = std::chrono::milliseconds(1),
+                        .evaluation_interval = std::chrono::milliseconds(50),
+                        .shrink_window = std::chrono::milliseconds(200)};
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+  EXPECT_EQ(1, pool->target_size());
+
+  // Threads queueing for the only connection make the pool grow
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 6; ++i) {
+    threads.emplace_back([&] {
+      while (!stop) {
+        auto conn = pool->get_connection();
+        ASSERT_TRUE(conn) << conn.error().message;
+        ASSERT_TRUE((*conn)->execute_raw("SELECT pg_sleep(0.005)"));
+      }
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+  stop = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const size_t grown = pool->target_size();
+  EXPECT_GT(grown, 1);
+  EXPECT_LE(grown, 8);
+
+  // A single user leaves most of the pool unused, so it shrinks again
+  for (int i = 0; i < 100; ++i) {
+    auto conn = pool->get_connection();
+    ASSERT_TRUE(conn);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_LT(pool->target_size(), grown);
+
+  auto decisions = pool->scaling_decisions();
+  ASSERT_FALSE(decisions.empty());
+  EXPECT_EQ(1, decisions.front().from);
+  EXPECT_GT(decisions.front().to, decisions.front().from);
+  EXPECT_GE(decisions.front().p99_wait, std::chrono::milliseconds(1));
+  EXPECT_LT(decisions.back().to, decisions.back().from);
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestPoolMetrics) {
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 1;
+  config.max_size = 2;
+  config.connection_timeout = std::chrono::milliseconds(100);
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  {
+    auto first = pool->get_connection();
+    ASSERT_TRUE(first);
+    ASSERT_TRUE((*first)->execute_raw("SELECT 1"));
+    EXPECT_FALSE((*first)->execute_raw("SELECT * FROM no_such_table"));
+    ASSERT_TRUE((*first)->execute_raw("SET statement_timeout = 10"));
+    EXPECT_FALSE((*first)->execute_raw("SELECT pg_sleep(1)"));
+    ASSERT_TRUE((*first)->execute_raw("RESET statement_timeout"));
+
+    auto second = pool->get_connection();
+    ASSERT_TRUE(second);
+    // Both connections are in use
+    EXPECT_FALSE(pool->get_connection());
+  }
+
+  auto metrics = pool->metrics();
+  EXPECT_EQ(0, metrics.active_connections);
+  EXPECT_EQ(2, metrics.idle_connections);
+  EXPECT_EQ(2, metrics.total_connections);
+  EXPECT_EQ(2, metrics.checkouts);
+  EXPECT_EQ(1, metrics.checkout_timeouts);
+  EXPECT_EQ(2, metrics.connections_opened);
+  EXPECT_EQ(0, metrics.connections_closed);
+  EXPECT_EQ(0, metrics.connect_failures);
+
+  EXPECT_EQ(5, metrics.queries.queries);
+  EXPECT_EQ(2, metrics.queries.errors);
+  EXPECT_EQ(1, metrics.queries.timeouts);
+  ASSERT_EQ(2, metrics.connections.size());
+  uint64_t per_connection = 0;
+  for (const auto& connection : metrics.connections) {
+    per_connection += connection.queries.queries;
+  }
+  EXPECT_EQ(5, per_connection);
+
+  // Three checkouts, the timed out one waiting for the whole connection_timeout
+  EXPECT_EQ(3, metrics.checkout_wait.count);
+  EXPECT_GE(metrics.checkout_wait.max, std::chrono::milliseconds(100));
+  EXPECT_GE(metrics.checkout_wait.percentile(100), std::chrono::milliseconds(100));
+  EXPECT_LT(metrics.checkout_wait.percentile(50), std::chrono::milliseconds(100));
+  EXPECT_EQ(2, metrics.connect_latency.count);
+  EXPECT_GT(metrics.connect_latency.mean().count(), 0);
+}
+
+TEST_F(PostgreSQLConnectionPoolTest, TestPoolMetricsCountChurnAndSink) {
+  std::mutex reports_mutex;
+  std::vector<relx::connection::PoolMetrics> reports;
+
+  relx::connection::PostgreSQLConnectionPoolConfig config;
+  config.connection_params = {.host = "localhost",
+                              .port = 5434,
+                              .dbname = "relx_test",
+                              .user = "postgres",
+                              .password = "postgres"};
+  config.initial_size = 1;
+  config.max_size = 1;
+  config.validation = relx::connection::ConnectionValidation::Status;
+  config.metrics_sink = {.callback =
+                             [&](const relx::connection::PoolMetrics& metrics) {
+                               const std::lock_guard<std::mutex> lock(reports_mutex);
+                               reports.push_back(metrics);
+                             },
+                         .interval = std::chrono::milliseconds(50)};
+
+  auto pool = relx::connection::PostgreSQLConnectionPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  int pid = 0;
+  {
+    auto conn = pool->get_connection();
+    ASSERT_TRUE(conn);
+    pid = backend_pid(*conn);
+  }
+  terminate_backend(pid);
+
+  // The broken connection fails validation and is replaced
+  {
+    auto conn = pool->get_connection();
+    ASSERT_TRUE(conn);
+    EXPECT_TRUE((*conn)->execute_raw("SELECT 1"));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  ASSERT_TRUE(pool->get_connection());
+
+  auto metrics = pool->metrics();
+  EXPECT_EQ(1, metrics.validation_failures);
+  EXPECT_EQ(1, metrics.connections_closed);
+  EXPECT_EQ(2, metrics.connections_opened);
+  EXPECT_EQ(1, metrics.total_connections);
+
+  // The sink is called on the first checkout and then once the interval has passed
+  const std::lock_guard<std::mutex> lock(reports_mutex);
+  ASSERT_GE(reports.size(), 2);
+  EXPECT_EQ(0, reports.front().checkouts);
+  EXPECT_EQ(2, reports.back().checkouts);
+  // backend_pid() on the first connection and SELECT 1 on its replacement
+  EXPECT_EQ(2, reports.back().queries.queries);
+}
+
+TEST(LatencyHistogramTest, PercentilesStayWithinBucketPrecision) {
+  using relx::connection::LatencyHistogram;
+  using std::chrono::microseconds;
+
+  for (uint64_t value : {0ULL, 7ULL, 8ULL, 1000ULL, 123456ULL, 1ULL << 39}) {
+    const size_t index = LatencyHistogram::bucket_index(value);
+    ASSERT_LT(index, LatencyHistogram::bucket_count);
+    EXPECT_GE(LatencyHistogram::bucket_upper_bound(index), value);
+    EXPECT_LE(LatencyHistogram::bucket_upper_bound(index), value + value / 8);
+  }
+
+  LatencyHistogram histogram;
+  for (int i = 1; i <= 1000; ++i) {
+    histogram.record(microseconds(i));
+  }
+  const auto before = histogram.snapshot();
+  EXPECT_EQ(1000, before.count);
+  EXPECT_EQ(microseconds(1000), before.max);
+  EXPECT_EQ(microseconds(500), before.mean());
+  EXPECT_GE(before.percentile(50), microseconds(500));
+  EXPECT_LE(before.percentile(50), microseconds(500 + 500 / 8));
+  EXPECT_GE(before.percentile(99), microseconds(990));
+  EXPECT_EQ(microseconds(1000), before.percentile(100));
+
+  histogram.record(std::chrono::milliseconds(50));
+  const auto interval = histogram.snapshot().since(before);
+  EXPECT_EQ(1, interval.count);
+  EXPECT_GE(interval.percentile(50), std::chrono::milliseconds(50));
+}
+
+}  // namespace
@@ -0,0 +1,158 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <relx/connection/postgresql_async_connection.hpp>
+#include <relx/connection/postgresql_connection.hpp>
+#include <relx/connection/transaction_guard.hpp>
+#include <relx/query.hpp>
+#include <relx/schema.hpp>
+
+namespace {
+
+namespace asio = boost::asio;
+
+struct Accounts {
+  static constexpr auto table_name = "deferred_tx_test";
+  relx::schema::column<Accounts, "id", int> id;
+  relx::schema::column<Accounts, "balance", int> balance;
+};
+
+class PostgreSQLDeferredTransactionTest : public ::testing::Test {
+protected:
+  std::string conn_string =
+      "host=localhost port=5434 dbname=relx_test user=postgres password=postgres";
+
+  void SetUp() override {
+    auto connect_result = conn.connect();
+    ASSERT_TRUE(connect_result) << "Failed to connect: " << connect_result.error().message;
+
+    ASSERT_TRUE(conn.execute_raw("DROP TABLE IF EXISTS deferred_tx_test"));
+    ASSERT_TRUE(conn.execute_raw(
+        "CREATE TABLE deferred_tx_test (id INTEGER PRIMARY KEY, balance INTEGER)"));
+  }
+
+  void TearDown() override {
+    if (conn.is_connected()) {
+      [[maybe_unused]] auto drop = conn.execute_raw("DROP TABLE IF EXISTS deferred_tx_test");
+      [[maybe_unused]] auto disconnect = conn.disconnect();
+    }
+  }
+
+  int row_count() {
+    auto count = conn.execute_raw("SELECT COUNT(*) FROM deferred_tx_test");
+    return count ? count->at(0).get<int>(0).value_or(-1) : -1;
+  }
+
+  relx::connection::PostgreSQLConnection conn{conn_string};
+};
+
+TEST_F(PostgreSQLDeferredTransactionTest, BeginIsSentWithFirstStatement) {
+  ASSERT_TRUE(conn.begin_transaction(relx::IsolationLevel::Serializable));
+  EXPECT_TRUE(conn.in_transaction());
+  EXPECT_EQ(1, conn.deferred_count());
+
+  auto level = conn.execute_raw("SHOW transaction_isolation");
+  ASSERT_TRUE(level) << level.error().message;
+  EXPECT_EQ("serializable", *level->at(0).get<std::string>(0));
+  EXPECT_EQ(0, conn.deferred_count());
+
+  ASSERT_TRUE(conn.commit_transaction());
+}
+
+TEST_F(PostgreSQLDeferredTransactionTest, EmptyTransactionNeverReachesServer) {
+  ASSERT_TRUE(conn.begin_transaction());
+  ASSERT_TRUE(conn.commit_transaction());
+  EXPECT_FALSE(conn.in_transaction());
+
+  ASSERT_TRUE(conn.begin_transaction());
+  ASSERT_TRUE(conn.rollback_transaction());
+  EXPECT_FALSE(conn.in_transaction());
+}
+
+TEST_F(PostgreSQLDeferredTransactionTest, DeferredStatementsCommitInOneBatch) {
+  Accounts accounts;
+
+  {
+    relx::connection::TransactionGuard guard(conn);
+    ASSERT_TRUE(conn.defer(
+        relx::query::insert_into(accounts).columns(accounts.id, accounts.balance).values(1, 100)));
+    ASSERT_TRUE(conn.defer(
+        relx::query::insert_into(accounts).columns(accounts.id, accounts.balance).values(2, 50)));
+    ASSERT_TRUE(conn.defer_raw("UPDATE deferred_tx_test SET balance = balance - ? WHERE id = ?",
+                               {"10", "1"}));
+    EXPECT_EQ(4, conn.deferred_count());
+
+    guard.commit();
+    EXPECT_TRUE(guard.is_committed());
+  }
+
+  EXPECT_EQ(0, conn.deferred_count());
+  auto balance = conn.execute_raw("SELECT balance FROM deferred_tx_test WHERE id = 1");
+  ASSERT_TRUE(balance) << balance.error().message;
+  EXPECT_EQ(90, *balance->at(0).get<int>(0));
+}
+
+TEST_F(PostgreSQLDeferredTransactionTest, FailedDeferredStatementRollsBackGuard) {
+  {
+    relx::connection::TransactionGuard guard(conn);
+    ASSERT_TRUE(conn.defer_raw("INSERT INTO deferred_tx_test (id, balance) VALUES (?, ?)",
+                               {"1", "10"}));
+    ASSERT_TRUE(conn.defer_raw("INSERT INTO deferred_tx_test (id, balance) VALUES (?, ?)",
+                               {"1", "20"}));
+    EXPECT_THROW(guard.commit(), relx::connection::TransactionException);
+    EXPECT_TRUE(conn.in_transaction());
+  }
+
+  // The guard rolled the aborted transaction back
+  EXPECT_FALSE(conn.in_transaction());
+  EXPECT_EQ(0, row_count());
+}
+
+TEST_F(PostgreSQLDeferredTransactionTest, RollbackDiscardsUnsentStatements) {
+  ASSERT_TRUE(conn.begin_transaction());
+  ASSERT_TRUE(conn.defer_raw("INSERT INTO deferred_tx_test (id, balance) VALUES (?, ?)",
+                             {"1", "10"}));
+  ASSERT_TRUE(conn.rollback_transaction());
+  EXPECT_EQ(0, conn.deferred_count());
+  EXPECT_EQ(0, row_count());
+}
+
+TEST_F(PostgreSQLDeferredTransactionTest, DeferRequiresTransaction) {
+  auto result = conn.defer_raw("SELECT 1");
+  EXPECT_FALSE(result);
+}
+
+TEST_F(PostgreSQLDeferredTransactionTest, AsyncDeferredStatementsCommitTogether) {
+  asio::io_context io_context;
+  relx::connection::PostgreSQLAsyncConnection async_conn(io_context, conn_string);
+
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto connect_result = co_await async_conn.connect();
+        EXPECT_TRUE(connect_result) << connect_result.error().message;
+
+        auto begin_result = co_await async_conn.begin_transaction();
+        EXPECT_TRUE(begin_result);
+        EXPECT_EQ(1, async_conn.get_async_conn().deferred_count());
+
+        EXPECT_TRUE(async_conn.defer_raw(
+            "INSERT INTO deferred_tx_test (id, balance) VALUES (?, ?)", {"1", "10"}));
+        EXPECT_TRUE(async_conn.defer_raw(
+            "INSERT INTO deferred_tx_test (id, balance) VALUES (?, ?)", {"2", "20"}));
+
+        auto commit_result = co_await async_conn.commit_transaction();
+        EXPECT_TRUE(commit_result) << commit_result.error().message;
+        EXPECT_FALSE(async_conn.in_transaction());
+        EXPECT_EQ(0, async_conn.get_async_conn().deferred_count());
+
+        co_await async_conn.disconnect();
+      },
+      asio::detached);
+  io_context.run();
+
+  EXPECT_EQ(2, row_count());
+}
+
+}  // namespace
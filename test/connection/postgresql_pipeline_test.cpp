@@ -0,0 +1,190 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <relx/connection/postgresql_connection.hpp>
+#include <relx/connection/postgresql_pipeline.hpp>
+#include <relx/connection/postgresql_statement.hpp>
+#include <relx/query.hpp>
+#include <relx/schema.hpp>
+
+namespace {
+
+struct PipelineItems {
+  static constexpr auto table_name = "pipeline_test";
+  relx::schema::column<PipelineItems, "id", int> id;
+  relx::schema::column<PipelineItems, "name", std::string> name;
+};
+
+struct PipelineItem {
+  int id;
+  std::string name;
+};
+
+struct ItemTotal {
+  int count;
+};
+
+class PostgreSQLPipelineTest : public ::testing::Test {
+protected:
+  // Connection string for the Docker container
+  std::string conn_string =
+      "host=localhost port=5434 dbname=relx_test user=postgres password=postgres";
+
+  void SetUp() override {
+    auto connect_result = conn.connect();
+    ASSERT_TRUE(connect_result) << "Failed to connect: " << connect_result.error().message;
+
+    ASSERT_TRUE(conn.execute_raw("DROP TABLE IF EXISTS pipeline_test"));
+    ASSERT_TRUE(conn.execute_raw("CREATE TABLE pipeline_test (id INTEGER PRIMARY KEY, name TEXT)"));
+  }
+
+  void TearDown() override {
+    if (conn.is_connected()) {
+      [[maybe_unused]] auto drop = conn.execute_raw("DROP TABLE IF EXISTS pipeline_test");
+      [[maybe_unused]] auto disconnect = conn.disconnect();
+    }
+  }
+
+  relx::connection::PostgreSQLConnection conn{conn_string};
+};
+
+TEST_F(PostgreSQLPipelineTest, ReturnsOneResultSetPerStatement) {
+  PipelineItems items;
+
+  auto p = conn.pipeline();
+  p.add(relx::query::insert_into(items).columns(items.id, items.name).values(1, "one"));
+  p.add(relx::query::insert_into(items).columns(items.id, items.name).values(2, "two"));
+  p.add_raw("SELECT name FROM pipeline_test WHERE id = ?", {"2"});
+  p.add(relx::query::select(items.id).from(items));
+  EXPECT_EQ(4, p.size());
+
+  auto results = p.sync();
+  ASSERT_TRUE(results) << results.error().message;
+  ASSERT_EQ(4, results->size());
+  EXPECT_TRUE(p.empty());
+
+  EXPECT_EQ(0, (*results)[0].size());
+  ASSERT_EQ(1, (*results)[2].size());
+  EXPECT_EQ("two", *(*results)[2].at(0).get<std::string>(0));
+  EXPECT_EQ(2, (*results)[3].size());
+
+  // The connection is usable outside pipeline mode again
+  auto count = conn.execute_raw("SELECT COUNT(*) FROM pipeline_test");
+  ASSERT_TRUE(count) << count.error().message;
+  EXPECT_EQ(2, *count->at(0).get<int>(0));
+}
+
+TEST_F(PostgreSQLPipelineTest, EmptyPipelineIsNoOp) {
+  auto p = conn.pipeline();
+  auto results = p.sync();
+  ASSERT_TRUE(results);
+  EXPECT_TRUE(results->empty());
+}
+
+TEST_F(PostgreSQLPipelineTest, FailureAbortsWholeBatch) {
+  auto p = conn.pipeline();
+  p.add_raw("INSERT INTO pipeline_test (id, name) VALUES (?, ?)", {"1", "first"});
+  p.add_raw("INSERT INTO pipeline_test (id, name) VALUES (?, ?)", {"1", "duplicate"});
+  p.add_raw("INSERT INTO pipeline_test (id, name) VALUES (?, ?)", {"3", "skipped"});
+
+  auto results = p.sync();
+  ASSERT_FALSE(results);
+  EXPECT_NE(std::string::npos, results.error().message.find("Pipeline statement 1 failed"));
+
+  // The implicit transaction was rolled back, so nothing was inserted
+  auto count = conn.execute_raw("SELECT COUNT(*) FROM pipeline_test");
+  ASSERT_TRUE(count) << count.error().message;
+  EXPECT_EQ(0, *count->at(0).get<int>(0));
+
+  // The same pipeline object can be reused after a failure
+  p.add_raw("INSERT INTO pipeline_test (id, name) VALUES (?, ?)", {"4", "after"});
+  auto retry = p.sync();
+  ASSERT_TRUE(retry) << retry.error().message;
+}
+
+TEST_F(PostgreSQLPipelineTest, ExecuteBatchWithPreparedStatement) {
+  auto stmt = conn.prepare_statement("pipeline_insert",
+                                     "INSERT INTO pipeline_test (id, name) VALUES (?, ?)", 2);
+  ASSERT_TRUE(stmt);
+
+  std::vector<std::vector<std::string>> rows;
+  for (int i = 0; i < 100; ++i) {
+    rows.push_back({std::to_string(i), "row " + std::to_string(i)});
+  }
+
+  auto results = conn.execute_batch(*stmt, rows);
+  ASSERT_TRUE(results) << results.error().message;
+  EXPECT_EQ(100, results->size());
+
+  auto count = conn.execute_raw("SELECT COUNT(*) FROM pipeline_test");
+  ASSERT_TRUE(count) << count.error().message;
+  EXPECT_EQ(100, *count->at(0).get<int>(0));
+
+  auto mismatch = conn.execute_batch(*stmt, {{"1"}});
+  EXPECT_FALSE(mismatch);
+}
+
+TEST_F(PostgreSQLPipelineTest, FailsWhenDisconnected) {
+  relx::connection::PostgreSQLConnection disconnected(conn_string);
+  auto p = disconnected.pipeline();
+  p.add_raw("SELECT 1");
+  auto results = p.sync();
+  EXPECT_FALSE(results);
+}
+
+TEST_F(PostgreSQLPipelineTest, ExecuteMultiRunsEveryQueryInOneCall) {
+  PipelineItems items;
+  ASSERT_TRUE(conn.execute_raw(
+      "INSERT INTO pipeline_test SELECT i, 'item ' || i FROM generate_series(1, 10) AS i"));
+
+  const auto before = conn.query_stats();
+  auto results = conn.execute_multi(
+      relx::query::select(relx::query::count_all()).from(items),
+      relx::query::select(relx::query::min(items.id)).from(items),
+      relx::query::select(relx::query::max(items.id)).from(items),
+      relx::query::select(relx::query::count_all()).from(items).where(items.id > 5),
+      relx::query::select(items.name).from(items).where(items.id == 3));
+  ASSERT_TRUE(results) << results.error().message;
+  ASSERT_EQ(5, results->size());
+  EXPECT_EQ(10, *(*results)[0].at(0).get<int>(0));
+  EXPECT_EQ(1, *(*results)[1].at(0).get<int>(0));
+  EXPECT_EQ(10, *(*results)[2].at(0).get<int>(0));
+  EXPECT_EQ(5, *(*results)[3].at(0).get<int>(0));
+  EXPECT_EQ("item 3", *(*results)[4].at(0).get<std::string>(0));
+  EXPECT_EQ(5, (conn.query_stats() - before).queries);
+}
+
+TEST_F(PostgreSQLPipelineTest, ExecuteMultiAsMapsEachResult) {
+  PipelineItems items;
+  ASSERT_TRUE(conn.execute_raw("INSERT INTO pipeline_test VALUES (1, 'one'), (2, 'two')"));
+
+  auto mapped = conn.execute_multi_as<PipelineItem, ItemTotal>(
+      relx::query::select(items.id, items.name).from(items).order_by(items.id),
+      relx::query::select(relx::query::count_all()).from(items));
+  ASSERT_TRUE(mapped) << mapped.error().message;
+
+  const auto& [rows, totals] = *mapped;
+  ASSERT_EQ(2, rows.size());
+  EXPECT_EQ(1, rows[0].id);
+  EXPECT_EQ("two", rows[1].name);
+  ASSERT_EQ(1, totals.size());
+  EXPECT_EQ(2, totals[0].count);
+}
+
+TEST_F(PostgreSQLPipelineTest, ExecuteMultiReportsFailingQuery) {
+  PipelineItems items;
+  auto results = conn.execute_multi(
+      relx::query::insert_into(items).columns(items.id, items.name).values(1, "first"),
+      relx::query::insert_into(items).columns(items.id, items.name).values(1, "duplicate"),
+      relx::query::select(relx::query::count_all()).from(items));
+  ASSERT_FALSE(results);
+  EXPECT_NE(std::string::npos, results.error().message.find("Pipeline statement 1 failed"));
+
+  // The queries shared an implicit transaction, which was rolled back
+  auto count = conn.execute_raw("SELECT COUNT(*) FROM pipeline_test");
+  ASSERT_TRUE(count) << count.error().message;
+  EXPECT_EQ(0, *count->at(0).get<int>(0));
+}
+
+}  // namespace
@@ -0,0 +1,188 @@
+#include <chrono>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <relx/connection/postgresql_async_connection.hpp>
+#include <relx/connection/postgresql_connection.hpp>
+#include <relx/query.hpp>
+#include <relx/schema.hpp>
+
+namespace {
+
+namespace asio = boost::asio;
+
+struct Accounts {
+  static constexpr auto table_name = "prepared_query_test";
+  relx::schema::column<Accounts, "id", int> id;
+  relx::schema::column<Accounts, "owner", std::string> owner;
+  relx::schema::column<Accounts, "balance", double> balance;
+  relx::schema::column<Accounts, "active", bool> active;
+};
+
+class PostgreSQLPreparedQueryTest : public ::testing::Test {
+protected:
+  std::string conn_string =
+      "host=localhost port=5434 dbname=relx_test user=postgres password=postgres";
+
+  void SetUp() override {
+    auto connect_result = conn.connect();
+    ASSERT_TRUE(connect_result) << "Failed to connect: " << connect_result.error().message;
+
+    ASSERT_TRUE(conn.execute_raw("DROP TABLE IF EXISTS prepared_query_test"));
+    ASSERT_TRUE(conn.execute_raw("CREATE TABLE prepared_query_test (id INTEGER PRIMARY KEY, "
+                                 "owner TEXT, balance DOUBLE PRECISION, active BOOLEAN)"));
+    ASSERT_TRUE(conn.execute_raw("INSERT INTO prepared_query_test VALUES (1, 'ann', 10.5, true), "
+                                 "(2, 'bob', 20.25, false), (3, 'cat', 30.0, true)"));
+  }
+
+  void TearDown() override {
+    if (conn.is_connected()) {
+      [[maybe_unused]] auto drop = conn.execute_raw("DROP TABLE IF EXISTS prepared_query_test");
+      [[maybe_unused]] auto disconnect = conn.disconnect();
+    }
+  }
+
+  int prepared_query_count() {
+    auto count = conn.execute_raw(
+        "SELECT COUNT(*) FROM pg_prepared_statements WHERE name LIKE 'relx_query_%'");
+    return count ? count->at(0).get<int>(0).value_or(-1) : -1;
+  }
+
+  relx::connection::PostgreSQLConnection conn{conn_string};
+};
+
+TEST_F(PostgreSQLPreparedQueryTest, ExecutesWithNewArguments) {
+  Accounts a;
+
+  auto prepared = conn.prepare(relx::query::select(a.owner)
+                                   .from(a)
+                                   .where(a.balance > relx::query::param<double>("min_balance") &&
+                                          a.active == relx::query::param<bool>("active"))
+                                   .order_by(a.id));
+  ASSERT_TRUE(prepared) << prepared.error().message;
+  static_assert(std::remove_reference_t<decltype(*prepared)>::param_count == 2);
+
+  auto result = (*prepared)(5.0, true);
+  ASSERT_TRUE(result) << result.error().message;
+  ASSERT_EQ(2, result->size());
+  EXPECT_EQ("ann", result->at(0).get<std::string>(0).value_or(""));
+  EXPECT_EQ("cat", result->at(1).get<std::string>(0).value_or(""));
+
+  result = (*prepared)(15.0, false);
+  ASSERT_TRUE(result) << result.error().message;
+  ASSERT_EQ(1, result->size());
+  EXPECT_EQ("bob", result->at(0).get<std::string>(0).value_or(""));
+}
+
+TEST_F(PostgreSQLPreparedQueryTest, FixedValuesAndTextParameters) {
+  Accounts a;
+
+  auto prepared =
+      conn.prepare(relx::query::update(a)
+                       .set(a.owner, relx::query::param<std::string>("owner"))
+                       .where(a.id == relx::query::param<int>("id") && a.active == true));
+  ASSERT_TRUE(prepared) << prepared.error().message;
+
+  ASSERT_TRUE((*prepared)("dan", 1));
+  ASSERT_TRUE((*prepared)("eve", 2));  // Inactive, so unchanged
+
+  auto owners = conn.execute_raw("SELECT owner FROM prepared_query_test ORDER BY id");
+  ASSERT_TRUE(owners) << owners.error().message;
+  EXPECT_EQ("dan", owners->at(0).get<std::string>(0).value_or(""));
+  EXPECT_EQ("bob", owners->at(1).get<std::string>(0).value_or(""));
+}
+
+TEST_F(PostgreSQLPreparedQueryTest, StatementIsDeallocatedAfterDestruction) {
+  Accounts a;
+
+  {
+    auto prepared = conn.prepare(
+        relx::query::select(a.id).from(a).where(a.id == relx::query::param<int>("id")));
+    ASSERT_TRUE(prepared) << prepared.error().message;
+    EXPECT_EQ(1, prepared_query_count());
+  }
+
+  // Released statements are deallocated when the next one is prepared
+  auto next = conn.prepare(
+      relx::query::select(a.owner).from(a).where(a.id == relx::query::param<int>("id")));
+  ASSERT_TRUE(next) << next.error().message;
+  EXPECT_EQ(1, prepared_query_count());
+}
+
+TEST_F(PostgreSQLPreparedQueryTest, AsyncPreparedQueryExecutesRepeatedly) {
+  Accounts a;
+  asio::io_context io_context;
+  relx::connection::PostgreSQLAsyncConnection async_conn(io_context, conn_string);
+
+  std::vector<std::string> owners;
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto connect_result = co_await async_conn.connect();
+        EXPECT_TRUE(connect_result) << connect_result.error().message;
+
+        auto prepared = co_await async_conn.prepare(
+            relx::query::select(a.owner).from(a).where(a.id == relx::query::param<int>("id")));
+        EXPECT_TRUE(prepared) << prepared.error().message;
+        if (!prepared) {
+          co_return;
+        }
+
+        for (int id = 1; id <= 3; ++id) {
+          auto result = co_await (*prepared)(id);
+          EXPECT_TRUE(result) << result.error().message;
+          if (result && result->size() == 1) {
+            owners.push_back(result->at(0).get<std::string>(0).value_or(""));
+          }
+        }
+
+        co_await async_conn.disconnect();
+      },
+      asio::detached);
+  io_context.run();
+
+  EXPECT_EQ((std::vector<std::string>{"ann", "bob", "cat"}), owners);
+}
+
+TEST_F(PostgreSQLPreparedQueryTest, AsyncPreparedQueryTakesOptions) {
+  using namespace std::chrono_literals;
+  Accounts a;
+  asio::io_context io_context;
+  relx::connection::PostgreSQLAsyncConnection async_conn(io_context, conn_string);
+
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto connect_result = co_await async_conn.connect();
+        EXPECT_TRUE(connect_result) << connect_result.error().message;
+
+        auto prepared = co_await async_conn.prepare(
+            relx::query::select(a.owner).from(a).where(a.id == relx::query::param<int>("id")));
+        EXPECT_TRUE(prepared) << prepared.error().message;
+        if (!prepared) {
+          co_return;
+        }
+
+        relx::connection::CancelToken token;
+        token.cancel();
+        auto cancelled = co_await (*prepared)({.cancel_token = &token}, 1);
+        EXPECT_FALSE(cancelled);
+        if (!cancelled) {
+          EXPECT_EQ(relx::connection::query_cancelled_error, cancelled.error().error_code);
+        }
+
+        auto result = co_await (*prepared)({.timeout = 5s}, 2);
+        EXPECT_TRUE(result) << result.error().message;
+        if (result && result->size() == 1) {
+          EXPECT_EQ("bob", result->at(0).get<std::string>(0).value_or(""));
+        }
+
+        co_await async_conn.disconnect();
+      },
+      asio::detached);
+  io_context.run();
+}
+
+}  // namespace
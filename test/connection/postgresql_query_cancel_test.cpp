@@ -0,0 +1,277 @@
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <variant>
+
+#include <boost/asio/experimental/awaitable_operators.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <gtest/gtest.h>
+#include <relx/connection/postgresql_async_connection.hpp>
+#include <relx/connection/postgresql_connection.hpp>
+
+namespace {
+
+namespace asio = boost::asio;
+using namespace std::chrono_literals;
+using relx::connection::CancelToken;
+using relx::connection::query_cancelled_error;
+using relx::connection::QueryOptions;
+
+constexpr auto slow_query = "SELECT pg_sleep(10)";
+
+/// The calls below must return long before the ten seconds of slow_query
+constexpr auto cancel_bound = std::chrono::seconds(3);
+
+class PostgreSQLQueryCancelTest : public ::testing::Test {
+protected:
+  std::string conn_string =
+      "host=localhost port=5434 dbname=relx_test user=postgres password=postgres";
+
+  asio::io_context io_context;
+
+  void run_test(std::function<asio::awaitable<void>()> test_coro) {
+    asio::co_spawn(io_context, std::move(test_coro), asio::detached);
+    io_context.run();
+    io_context.restart();
+  }
+};
+
+TEST_F(PostgreSQLQueryCancelTest, SyncTimeoutCancelsOnServer) {
+  relx::connection::PostgreSQLConnection conn(conn_string);
+  ASSERT_TRUE(conn.connect());
+
+  const auto start = std::chrono::steady_clock::now();
+  auto result = conn.execute_raw(slow_query, {}, QueryOptions{.timeout = 100ms});
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  ASSERT_FALSE(result);
+  EXPECT_EQ(query_cancelled_error, result.error().error_code);
+  EXPECT_EQ("Query timed out", result.error().message);
+  EXPECT_LT(elapsed, cancel_bound);
+  EXPECT_EQ(1u, conn.query_stats().timeouts);
+
+  // The server answered the cancel request, so the connection is clean
+  ASSERT_TRUE(conn.is_connected());
+  auto after = conn.execute_raw("SELECT 1");
+  ASSERT_TRUE(after) << after.error().message;
+  EXPECT_EQ(1, after->at(0).get<int>(0).value_or(-1));
+}
+
+TEST_F(PostgreSQLQueryCancelTest, SyncQueryWithinLimitsSucceeds) {
+  relx::connection::PostgreSQLConnection conn(conn_string);
+  ASSERT_TRUE(conn.connect());
+
+  CancelToken token;
+  auto result = conn.execute_raw("SELECT ?::int + 1", {"41"},
+                                 QueryOptions{.timeout = 5s, .cancel_token = &token});
+  ASSERT_TRUE(result) << result.error().message;
+  EXPECT_EQ(42, result->at(0).get<int>(0).value_or(-1));
+  EXPECT_EQ(0u, conn.query_stats().timeouts);
+}
+
+TEST_F(PostgreSQLQueryCancelTest, SyncCancelTokenFromAnotherThread) {
+  relx::connection::PostgreSQLConnection conn(conn_string);
+  ASSERT_TRUE(conn.connect());
+
+  CancelToken token;
+  std::thread canceller([&token] {
+    std::this_thread::sleep_for(100ms);
+    token.cancel();
+  });
+
+  const auto start = std::chrono::steady_clock::now();
+  auto result = conn.execute_raw(slow_query, {}, QueryOptions{.cancel_token = &token});
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  canceller.join();
+
+  ASSERT_FALSE(result);
+  EXPECT_EQ(query_cancelled_error, result.error().error_code);
+  EXPECT_EQ("Query cancelled", result.error().message);
+  EXPECT_LT(elapsed, cancel_bound);
+
+  // A cancelled token fails calls without sending them until it is reset
+  auto refused = conn.execute_raw("SELECT 1", {}, QueryOptions{.cancel_token = &token});
+  ASSERT_FALSE(refused);
+  EXPECT_EQ(query_cancelled_error, refused.error().error_code);
+
+  token.reset();
+  auto after = conn.execute_raw("SELECT 1", {}, QueryOptions{.cancel_token = &token});
+  ASSERT_TRUE(after) << after.error().message;
+}
+
+TEST_F(PostgreSQLQueryCancelTest, SyncDeadlineInsideTransaction) {
+  relx::connection::PostgreSQLConnection conn(conn_string);
+  ASSERT_TRUE(conn.connect());
+  ASSERT_TRUE(conn.begin_transaction());
+
+  const auto deadline = std::chrono::steady_clock::now() + 100ms;
+  auto result = conn.execute_raw(slow_query, {}, QueryOptions{.deadline = deadline});
+  ASSERT_FALSE(result);
+  EXPECT_EQ(query_cancelled_error, result.error().error_code);
+
+  // The cancelled statement aborted the transaction, which rolls back as usual
+  ASSERT_TRUE(conn.rollback_transaction());
+  EXPECT_TRUE(conn.execute_raw("SELECT 1"));
+}
+
+TEST_F(PostgreSQLQueryCancelTest, SyncTimeoutCoversDeferredStatements) {
+  relx::connection::PostgreSQLConnection conn(conn_string);
+  ASSERT_TRUE(conn.connect());
+  ASSERT_TRUE(conn.begin_transaction());
+  ASSERT_TRUE(conn.defer_raw("SELECT 1"));
+
+  // The slow query goes out in one pipeline with the deferred statement
+  const auto start = std::chrono::steady_clock::now();
+  auto result = conn.execute_raw(slow_query, {}, QueryOptions{.timeout = 100ms});
+  ASSERT_FALSE(result);
+  EXPECT_EQ(query_cancelled_error, result.error().error_code);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, cancel_bound);
+
+  ASSERT_TRUE(conn.is_connected());
+  ASSERT_TRUE(conn.rollback_transaction());
+  EXPECT_TRUE(conn.execute_raw("SELECT 1"));
+}
+
+TEST_F(PostgreSQLQueryCancelTest, SyncCommitTimeoutCoversDeferredStatements) {
+  relx::connection::PostgreSQLConnection conn(conn_string);
+  ASSERT_TRUE(conn.connect());
+  ASSERT_TRUE(conn.begin_transaction());
+  ASSERT_TRUE(conn.defer_raw(slow_query));
+
+  const auto start = std::chrono::steady_clock::now();
+  auto result = conn.commit_transaction(QueryOptions{.timeout = 100ms});
+  ASSERT_FALSE(result);
+  EXPECT_EQ(query_cancelled_error, result.error().error_code);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, cancel_bound);
+
+  ASSERT_TRUE(conn.rollback_transaction());
+  EXPECT_TRUE(conn.execute_raw("SELECT 1"));
+}
+
+TEST_F(PostgreSQLQueryCancelTest, AsyncTimeoutCancelsOnServer) {
+  relx::connection::PostgreSQLAsyncConnection conn(io_context, conn_string);
+
+  run_test([&]() -> asio::awaitable<void> {
+    auto connect_result = co_await conn.connect();
+    EXPECT_TRUE(connect_result) << connect_result.error().message;
+    if (!connect_result) {
+      co_return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    auto result = co_await conn.execute_raw(slow_query, {}, QueryOptions{.timeout = 100ms});
+    EXPECT_FALSE(result);
+    if (!result) {
+      EXPECT_EQ(query_cancelled_error, result.error().error_code);
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, cancel_bound);
+
+    // The abandoned query is drained ahead of the next one
+    auto after = co_await conn.execute_raw("SELECT 1");
+    EXPECT_TRUE(after) << after.error().message;
+    EXPECT_EQ(0, conn.get_async_conn().pending_queries());
+    EXPECT_EQ(1u, conn.query_stats().timeouts);
+    co_await conn.disconnect();
+  });
+}
+
+TEST_F(PostgreSQLQueryCancelTest, AsyncCancellationSlotStopsQuery) {
+  using namespace asio::experimental::awaitable_operators;
+  relx::connection::PostgreSQLAsyncConnection conn(io_context, conn_string);
+
+  run_test([&]() -> asio::awaitable<void> {
+    auto connect_result = co_await conn.connect();
+    EXPECT_TRUE(connect_result) << connect_result.error().message;
+    if (!connect_result) {
+      co_return;
+    }
+
+    // Whichever finishes first cancels the other through its cancellation slot
+    const auto start = std::chrono::steady_clock::now();
+    asio::steady_timer timer(co_await asio::this_coro::executor, 100ms);
+    auto winner = co_await (conn.execute_raw(slow_query) || timer.async_wait(asio::use_awaitable));
+    EXPECT_EQ(1u, winner.index());
+    EXPECT_LT(std::chrono::steady_clock::now() - start, cancel_bound);
+
+    auto after = co_await conn.execute_raw("SELECT 2");
+    EXPECT_TRUE(after) << after.error().message;
+    if (after) {
+      EXPECT_EQ(2, after->at(0).get<int>(0).value_or(-1));
+    }
+    co_await conn.disconnect();
+  });
+}
+
+TEST_F(PostgreSQLQueryCancelTest, AsyncCancelTokenFromAnotherThread) {
+  relx::connection::PostgreSQLAsyncConnection conn(io_context, conn_string);
+  CancelToken token;
+  std::thread canceller;
+
+  run_test([&]() -> asio::awaitable<void> {
+    auto connect_result = co_await conn.connect();
+    EXPECT_TRUE(connect_result) << connect_result.error().message;
+    if (!connect_result) {
+      co_return;
+    }
+
+    canceller = std::thread([&token] {
+      std::this_thread::sleep_for(100ms);
+      token.cancel();
+    });
+    auto result = co_await conn.execute_raw(slow_query, {}, QueryOptions{.cancel_token = &token});
+    EXPECT_FALSE(result);
+    if (!result) {
+      EXPECT_EQ(query_cancelled_error, result.error().error_code);
+      EXPECT_NE(std::string::npos, result.error().message.find("Query cancelled"));
+    }
+
+    auto after = co_await conn.execute_raw("SELECT 1");
+    EXPECT_TRUE(after) << after.error().message;
+    co_await conn.disconnect();
+  });
+  canceller.join();
+}
+
+TEST_F(PostgreSQLQueryCancelTest, AsyncTimeoutLeavesPipelinedQueriesAlone) {
+  relx::connection::PostgreSQLAsyncConnection conn(io_context, conn_string);
+
+  run_test([&]() -> asio::awaitable<void> {
+    auto connect_result = co_await conn.connect();
+    EXPECT_TRUE(connect_result) << connect_result.error().message;
+  });
+  ASSERT_TRUE(conn.is_connected());
+
+  // The slow query runs ahead of a fast one in the same pipeline. Its caller gives up at the
+  // timeout, but no cancel request is sent while the fast query shares the pipeline, so the
+  // fast query still gets its result
+  bool slow_timed_out = false;
+  int fast_value = -1;
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto result = co_await conn.execute_raw("SELECT pg_sleep(1)", {},
+                                                QueryOptions{.timeout = 100ms});
+        slow_timed_out = !result && result.error().error_code == query_cancelled_error;
+      },
+      asio::detached);
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto result = co_await conn.execute_raw("SELECT 7");
+        if (result && !result->empty()) {
+          fast_value = result->at(0).get<int>(0).value_or(-1);
+        }
+      },
+      asio::detached);
+  io_context.run();
+  io_context.restart();
+
+  EXPECT_TRUE(slow_timed_out);
+  EXPECT_EQ(7, fast_value);
+  EXPECT_EQ(0, conn.get_async_conn().pending_queries());
+
+  run_test([&]() -> asio::awaitable<void> { co_await conn.disconnect(); });
+}
+
+}  // namespace
@@ -0,0 +1,223 @@
+#include <chrono>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <relx/connection/postgresql_routing_pool.hpp>
+#include <relx/query.hpp>
+#include <relx/schema.hpp>
+
+namespace {
+
+using relx::connection::PostgreSQLConnectionParams;
+using relx::connection::PostgreSQLRoutingPool;
+using relx::connection::PostgreSQLRoutingPoolConfig;
+
+struct Servers {
+  static constexpr auto table_name = "routing_pool_test";
+  relx::schema::column<Servers, "id", int> id;
+  relx::schema::column<Servers, "name", std::string> name;
+};
+
+// The replica is an independent server from docker-compose that stands in for a real one
+class PostgreSQLRoutingPoolTest : public ::testing::Test {
+protected:
+  PostgreSQLConnectionParams primary_params{.host = "localhost",
+                                            .port = 5434,
+                                            .dbname = "relx_test",
+                                            .user = "postgres",
+                                            .password = "postgres"};
+  PostgreSQLConnectionParams replica_params{.host = "localhost",
+                                            .port = 5435,
+                                            .dbname = "relx_test",
+                                            .user = "postgres",
+                                            .password = "postgres"};
+
+  void SetUp() override {
+    // Each server holds a row naming it, so results show where a query ran
+    create_table(primary_params, "primary");
+    create_table(replica_params, "replica");
+  }
+
+  void TearDown() override {
+    drop_table(primary_params);
+    drop_table(replica_params);
+  }
+
+  void create_table(const PostgreSQLConnectionParams& params, const std::string& name) {
+    relx::connection::PostgreSQLConnection conn(params);
+    ASSERT_TRUE(conn.connect()) << "Cannot reach " << params.host << ":" << params.port;
+    ASSERT_TRUE(conn.execute_raw("DROP TABLE IF EXISTS routing_pool_test"));
+    ASSERT_TRUE(conn.execute_raw("CREATE TABLE routing_pool_test (id INTEGER, name TEXT)"));
+    ASSERT_TRUE(conn.execute_raw("INSERT INTO routing_pool_test VALUES (1, '" + name + "')"));
+    conn.disconnect();
+  }
+
+  void drop_table(const PostgreSQLConnectionParams& params) {
+    relx::connection::PostgreSQLConnection conn(params);
+    if (conn.connect()) {
+      conn.execute_raw("DROP TABLE IF EXISTS routing_pool_test");
+      conn.disconnect();
+    }
+  }
+
+  PostgreSQLRoutingPoolConfig make_config(std::vector<PostgreSQLConnectionParams> replicas) {
+    PostgreSQLRoutingPoolConfig config;
+    config.primary.connection_params = primary_params;
+    config.primary.initial_size = 1;
+    config.primary.max_size = 4;
+    config.primary.connection_timeout = std::chrono::milliseconds(1000);
+    config.replicas = std::move(replicas);
+    return config;
+  }
+
+  std::string server_name(PostgreSQLRoutingPool& pool) {
+    Servers s;
+    auto result = pool.execute(relx::query::select(s.name).from(s).where(s.id == 1));
+    if (!result || result->empty()) {
+      return "";
+    }
+    return result->at(0).get<std::string>(0).value_or("");
+  }
+};
+
+TEST_F(PostgreSQLRoutingPoolTest, RoutesReadsToReplicaAndWritesToPrimary) {
+  auto pool = PostgreSQLRoutingPool::create(make_config({replica_params}));
+  auto init = pool->initialize();
+  ASSERT_TRUE(init) << init.error().message;
+
+  EXPECT_EQ("replica", server_name(*pool));
+
+  Servers s;
+  auto insert = pool->execute(relx::query::insert_into(s).columns(s.id, s.name).values(2, "new"));
+  ASSERT_TRUE(insert) << insert.error().message;
+
+  auto primary = pool->get_primary();
+  ASSERT_TRUE(primary);
+  auto count = (*primary)->execute_raw("SELECT COUNT(*) FROM routing_pool_test");
+  ASSERT_TRUE(count);
+  EXPECT_EQ(2, count->at(0).get<int>(0).value_or(0));
+
+  auto status = pool->replica_status();
+  ASSERT_EQ(1, status.size());
+  EXPECT_TRUE(status[0].healthy);
+  EXPECT_GT(status[0].latency.count(), 0);
+  EXPECT_EQ(0, status[0].replication_lag.count());
+  EXPECT_EQ(0, status[0].in_flight);
+}
+
+TEST_F(PostgreSQLRoutingPoolTest, ReplicaConnectionsAreReadOnly) {
+  auto pool = PostgreSQLRoutingPool::create(make_config({replica_params}));
+  ASSERT_TRUE(pool->initialize());
+
+  auto conn = pool->get_replica();
+  ASSERT_TRUE(conn);
+  EXPECT_TRUE(conn->is_replica());
+  EXPECT_FALSE((*conn)->execute_raw("INSERT INTO routing_pool_test VALUES (3, 'write')"));
+}
+
+TEST_F(PostgreSQLRoutingPoolTest, FallsBackToPrimaryWithoutHealthyReplica) {
+  auto unreachable = replica_params;
+  unreachable.port = 1;
+  auto config = make_config({unreachable});
+  auto pool = PostgreSQLRoutingPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  EXPECT_FALSE(pool->replica_status()[0].healthy);
+  EXPECT_EQ("primary", server_name(*pool));
+
+  config.fallback_to_primary = false;
+  auto strict_pool = PostgreSQLRoutingPool::create(config);
+  ASSERT_TRUE(strict_pool->initialize());
+  EXPECT_FALSE(strict_pool->get_replica());
+}
+
+TEST_F(PostgreSQLRoutingPoolTest, TracksConnectionsInFlight) {
+  // The same server, configured as two replicas
+  auto pool = PostgreSQLRoutingPool::create(make_config({replica_params, replica_params}));
+  ASSERT_TRUE(pool->initialize());
+
+  auto in_flight = [&] {
+    size_t total = 0;
+    for (const auto& status : pool->replica_status()) {
+      total += status.in_flight;
+    }
+    return total;
+  };
+
+  {
+    auto first = pool->get_replica();
+    auto second = pool->get_replica();
+    ASSERT_TRUE(first && second);
+    EXPECT_TRUE(first->is_replica() && second->is_replica());
+    EXPECT_EQ(2, in_flight());
+
+    auto moved = std::move(*first);
+    EXPECT_EQ(2, in_flight());
+  }
+  EXPECT_EQ(0, in_flight());
+}
+
+TEST_F(PostgreSQLRoutingPoolTest, MaxLagKeepsCaughtUpReplicas) {
+  auto config = make_config({replica_params});
+  config.max_replication_lag = std::chrono::milliseconds(0);
+  auto pool = PostgreSQLRoutingPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  // A server that is not replaying WAL has no lag
+  EXPECT_EQ(1, pool->check_replicas());
+  EXPECT_EQ("replica", server_name(*pool));
+}
+
+TEST_F(PostgreSQLRoutingPoolTest, BusyReplicaStaysHealthy) {
+  auto config = make_config({replica_params});
+  config.primary.max_size = 1;
+  config.primary.connection_timeout = std::chrono::milliseconds(100);
+  auto pool = PostgreSQLRoutingPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  auto held = pool->get_replica();
+  ASSERT_TRUE(held && held->is_replica());
+
+  // The replica's only connection is taken, so this read times out there and goes to the
+  // primary, but a busy pool is no reason to stop routing reads to the replica
+  auto overflow = pool->get_replica();
+  ASSERT_TRUE(overflow);
+  EXPECT_FALSE(overflow->is_replica());
+  EXPECT_TRUE(pool->replica_status()[0].healthy);
+}
+
+TEST_F(PostgreSQLRoutingPoolTest, HealthChecksRunInTheBackground) {
+  auto config = make_config({replica_params});
+  config.primary.max_size = 1;
+  config.primary.validate_connections = false;
+  config.health_check_interval = std::chrono::milliseconds(100);
+  auto pool = PostgreSQLRoutingPool::create(config);
+  ASSERT_TRUE(pool->initialize());
+
+  int pid = 0;
+  {
+    auto conn = pool->get_replica();
+    ASSERT_TRUE(conn && conn->is_replica());
+    auto result = (*conn)->execute_raw("SELECT pg_backend_pid()");
+    ASSERT_TRUE(result);
+    pid = result->at(0).get<int>(0).value_or(0);
+  }
+
+  relx::connection::PostgreSQLConnection admin(replica_params);
+  ASSERT_TRUE(admin.connect());
+  ASSERT_TRUE(admin.execute_raw("SELECT pg_terminate_backend(" + std::to_string(pid) + ")"));
+
+  // A read on the killed connection fails and takes the replica out of rotation, unless a
+  // health check finds the broken connection first
+  server_name(*pool);
+
+  // No request is needed for the replica to come back
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  EXPECT_TRUE(pool->replica_status()[0].healthy);
+  EXPECT_EQ("replica", server_name(*pool));
+}
+
+}  // namespace
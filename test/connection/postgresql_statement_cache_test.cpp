@@ -0,0 +1,201 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <relx/connection/postgresql_async_connection.hpp>
+#include <relx/connection/postgresql_connection.hpp>
+#include <relx/query.hpp>
+#include <relx/schema.hpp>
+
+namespace {
+
+namespace asio = boost::asio;
+
+struct CacheItems {
+  static constexpr auto table_name = "statement_cache_test";
+  relx::schema::column<CacheItems, "id", int> id;
+  relx::schema::column<CacheItems, "name", std::string> name;
+};
+
+class PostgreSQLStatementCacheTest : public ::testing::Test {
+protected:
+  std::string conn_string =
+      "host=localhost port=5434 dbname=relx_test user=postgres password=postgres";
+
+  void SetUp() override {
+    auto connect_result = conn.connect();
+    ASSERT_TRUE(connect_result) << "Failed to connect: " << connect_result.error().message;
+
+    ASSERT_TRUE(conn.execute_raw("DROP TABLE IF EXISTS statement_cache_test"));
+    ASSERT_TRUE(
+        conn.execute_raw("CREATE TABLE statement_cache_test (id INTEGER PRIMARY KEY, name TEXT)"));
+    ASSERT_TRUE(conn.execute_raw(
+        "INSERT INTO statement_cache_test (id, name) VALUES (1, 'one'), (2, 'two'), (3, 'three')"));
+  }
+
+  void TearDown() override {
+    if (conn.is_connected()) {
+      [[maybe_unused]] auto drop = conn.execute_raw("DROP TABLE IF EXISTS statement_cache_test");
+      [[maybe_unused]] auto disconnect = conn.disconnect();
+    }
+  }
+
+  int prepared_statement_count() {
+    auto count = conn.execute_raw(
+        "SELECT COUNT(*) FROM pg_prepared_statements WHERE name LIKE 'relx_cached_%'");
+    return count ? count->at(0).get<int>(0).value_or(-1) : -1;
+  }
+
+  relx::connection::PostgreSQLConnection conn{conn_string};
+};
+
+TEST_F(PostgreSQLStatementCacheTest, RepeatedQueriesHitTheCache) {
+  CacheItems items;
+  conn.enable_statement_cache(16);
+  ASSERT_TRUE(conn.statement_cache_enabled());
+
+  for (int id = 1; id <= 3; ++id) {
+    auto result = conn.execute(
+        relx::query::select(items.name).from(items).where(items.id == id));
+    ASSERT_TRUE(result) << result.error().message;
+    ASSERT_EQ(1, result->size());
+  }
+
+  // Same shape, different parameters: one prepare, two hits
+  const auto stats = conn.statement_cache_stats();
+  EXPECT_EQ(1, stats.misses);
+  EXPECT_EQ(2, stats.hits);
+  EXPECT_NEAR(2.0 / 3.0, stats.hit_rate(), 1e-9);
+  EXPECT_EQ(1, prepared_statement_count());
+}
+
+TEST_F(PostgreSQLStatementCacheTest, LeastRecentlyUsedStatementIsDeallocated) {
+  CacheItems items;
+  conn.enable_statement_cache(2);
+
+  ASSERT_TRUE(conn.execute(relx::query::select(items.id).from(items)));
+  ASSERT_TRUE(conn.execute(relx::query::select(items.name).from(items)));
+  ASSERT_TRUE(conn.execute(relx::query::select(items.id, items.name).from(items)));
+
+  EXPECT_EQ(1, conn.statement_cache_stats().evictions);
+  EXPECT_EQ(2, prepared_statement_count());
+
+  conn.disable_statement_cache();
+  EXPECT_FALSE(conn.statement_cache_enabled());
+  EXPECT_EQ(0, prepared_statement_count());
+}
+
+TEST_F(PostgreSQLStatementCacheTest, EvictingMissingStatementDoesNotFailQuery) {
+  CacheItems items;
+  conn.enable_statement_cache(1);
+
+  ASSERT_TRUE(conn.execute(relx::query::select(items.id).from(items)));
+  ASSERT_TRUE(conn.execute_raw("DEALLOCATE ALL"));
+
+  // The DEALLOCATE of the evicted statement fails in its own pipeline segment, sent in the
+  // round trip of the new statement's prepare
+  auto result = conn.execute(relx::query::select(items.name).from(items));
+  ASSERT_TRUE(result) << result.error().message;
+  EXPECT_EQ(3, result->size());
+  EXPECT_EQ(1, conn.statement_cache_stats().evictions);
+  EXPECT_EQ(1, prepared_statement_count());
+}
+
+TEST_F(PostgreSQLStatementCacheTest, ReprepareWhenResultTypeChanges) {
+  CacheItems items;
+  conn.enable_statement_cache();
+
+  auto query = relx::query::select_all(items).where(items.id == 1);
+  ASSERT_TRUE(conn.execute(query));
+
+  // SELECT * now returns an extra column, invalidating the cached plan
+  ASSERT_TRUE(conn.execute_raw("ALTER TABLE statement_cache_test ADD COLUMN extra INTEGER"));
+
+  auto result = conn.execute(query);
+  ASSERT_TRUE(result) << result.error().message;
+  EXPECT_EQ(3, result->column_count());
+  EXPECT_EQ(1, conn.statement_cache_stats().reprepares);
+}
+
+TEST_F(PostgreSQLStatementCacheTest, RawSqlAndDisabledCacheBypassPreparation) {
+  CacheItems items;
+  ASSERT_TRUE(conn.execute(relx::query::select(items.id).from(items)));
+  EXPECT_EQ(0, conn.statement_cache_stats().misses);
+
+  conn.enable_statement_cache();
+  ASSERT_TRUE(conn.execute_raw("SELECT id FROM statement_cache_test"));
+  EXPECT_EQ(0, conn.statement_cache_stats().misses);
+  EXPECT_EQ(0, prepared_statement_count());
+}
+
+TEST_F(PostgreSQLStatementCacheTest, AsyncConnectionUsesTheCache) {
+  CacheItems items;
+  asio::io_context io_context;
+  relx::connection::PostgreSQLAsyncConnection async_conn(io_context, conn_string);
+  async_conn.enable_statement_cache(8);
+
+  int found = 0;
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto connect_result = co_await async_conn.connect();
+        EXPECT_TRUE(connect_result) << connect_result.error().message;
+
+        for (int id = 1; id <= 3; ++id) {
+          auto result = co_await async_conn.execute(
+              relx::query::select(items.name).from(items).where(items.id == id));
+          EXPECT_TRUE(result) << result.error().message;
+          if (result) {
+            found += static_cast<int>(result->size());
+          }
+        }
+
+        co_await async_conn.disconnect();
+      },
+      asio::detached);
+  io_context.run();
+
+  EXPECT_EQ(3, found);
+  EXPECT_EQ(1, async_conn.statement_cache_stats().misses);
+  EXPECT_EQ(2, async_conn.statement_cache_stats().hits);
+}
+
+TEST_F(PostgreSQLStatementCacheTest, AsyncEvictionDeallocatesWithoutWaiting) {
+  CacheItems items;
+  asio::io_context io_context;
+  relx::connection::PostgreSQLAsyncConnection async_conn(io_context, conn_string);
+  async_conn.enable_statement_cache(1);
+
+  int cached = -1;
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        auto connect_result = co_await async_conn.connect();
+        EXPECT_TRUE(connect_result) << connect_result.error().message;
+
+        for (int round = 0; round < 2; ++round) {
+          auto ids = co_await async_conn.execute(relx::query::select(items.id).from(items));
+          EXPECT_TRUE(ids) << ids.error().message;
+          auto names = co_await async_conn.execute(relx::query::select(items.name).from(items));
+          EXPECT_TRUE(names) << names.error().message;
+        }
+
+        // Every eviction's DEALLOCATE went out with the next prepare
+        auto count = co_await async_conn.execute_raw(
+            "SELECT COUNT(*) FROM pg_prepared_statements WHERE name LIKE 'relx_cached_%'");
+        EXPECT_TRUE(count) << count.error().message;
+        if (count) {
+          cached = count->at(0).get<int>(0).value_or(-1);
+        }
+        EXPECT_EQ(0, async_conn.get_async_conn().pending_queries());
+
+        co_await async_conn.disconnect();
+      },
+      asio::detached);
+  io_context.run();
+
+  EXPECT_EQ(1, cached);
+  EXPECT_EQ(3, async_conn.statement_cache_stats().evictions);
+}
+
+}  // namespace
@@ -223,6 +223,60 @@ TEST_F(PostgreSQLStreamingTest, LargeResultSetStreaming) {
   EXPECT_EQ(count, 100);
 }
 
+TEST_F(PostgreSQLStreamingTest, EarlyTerminationCancelsRemainingRows) {
+  if (!connection) GTEST_SKIP();
+
+  // Draining ten million rows would take seconds; cancelling them takes a round trip
+  const auto start = std::chrono::steady_clock::now();
+  {
+    connection::PostgreSQLStreamingSource source(
+        *connection, "SELECT i, md5(i::text) FROM generate_series(1, 10000000) AS i");
+    auto init_result = source.initialize();
+    ASSERT_TRUE(init_result) << "Failed to initialize streaming: " << init_result.error().message;
+
+    auto streaming_result = result::StreamingResultSet(std::move(source));
+    int count = 0;
+    for (const auto& lazy_row : streaming_result) {
+      (void)lazy_row;
+      if (++count >= 100) {
+        break;
+      }
+    }
+    EXPECT_EQ(count, 100);
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  EXPECT_LT(elapsed, std::chrono::seconds(2));
+
+  // The cancelled query left the connection ready for the next one
+  auto after = connection->execute_raw("SELECT 1");
+  ASSERT_TRUE(after) << after.error().message;
+  EXPECT_EQ(1, after->at(0).get<int>(0).value_or(-1));
+}
+
+TEST_F(PostgreSQLStreamingTest, EarlyTerminationInsideTransactionKeepsTransaction) {
+  if (!connection) GTEST_SKIP();
+
+  ASSERT_TRUE(connection->begin_transaction());
+  {
+    connection::PostgreSQLStreamingSource source(*connection,
+                                                 "SELECT id, name FROM users ORDER BY id");
+    auto init_result = source.initialize();
+    ASSERT_TRUE(init_result) << "Failed to initialize streaming: " << init_result.error().message;
+
+    auto streaming_result = result::StreamingResultSet(std::move(source));
+    for (const auto& lazy_row : streaming_result) {
+      (void)lazy_row;
+      break;
+    }
+  }
+
+  // A cancel would have aborted the transaction, so the remaining rows were drained instead
+  auto count = connection->execute_raw("SELECT COUNT(*) FROM users");
+  ASSERT_TRUE(count) << count.error().message;
+  EXPECT_EQ(1000, count->at(0).get<int>(0).value_or(-1));
+  EXPECT_TRUE(connection->commit_transaction());
+}
+
 TEST_F(PostgreSQLStreamingTest, StreamingEmptyResult) {
   if (!connection) GTEST_SKIP();
 
@@ -1,11 +1,24 @@
+#include <chrono>
 #include <optional>
 #include <string>
 
 #include <gtest/gtest.h>
 #include <relx/connection/postgresql_connection.hpp>
+#include <relx/query.hpp>
+#include <relx/schema.hpp>
 
 namespace {
 
+struct TypedRow {
+  static constexpr auto table_name = "typed_binary_test";
+  relx::schema::column<TypedRow, "int_val", int> int_val;
+  relx::schema::column<TypedRow, "big_val", long long> big_val;
+  relx::schema::column<TypedRow, "float_val", double> float_val;
+  relx::schema::column<TypedRow, "bool_val", bool> bool_val;
+  relx::schema::column<TypedRow, "created_at", std::chrono::system_clock::time_point> created_at;
+  relx::schema::column<TypedRow, "text_val", std::string> text_val;
+};
+
 class PostgreSQLTypedParamsTest : public ::testing::Test {
 protected:
   // Connection string for the Docker container
@@ -29,6 +42,7 @@ protected:
     if (connect_result) {
       // Drop table if it exists
       conn.execute_raw("DROP TABLE IF EXISTS typed_params_test");
+      conn.execute_raw("DROP TABLE IF EXISTS typed_binary_test");
       conn.disconnect();
     }
   }
@@ -186,4 +200,90 @@ TEST_F(PostgreSQLTypedParamsTest, TestCustomTypeConversion) {
   conn.disconnect();
 }
 
-}  // namespace
\ No newline at end of file
+TEST_F(PostgreSQLTypedParamsTest, QueryExpressionsSendBinaryParameters) {
+  relx::connection::PostgreSQLConnection conn(conn_string);
+  ASSERT_TRUE(conn.connect());
+
+  auto create_result = conn.execute_raw(R"(
+      CREATE TABLE typed_binary_test (
+          int_val INTEGER,
+          big_val BIGINT,
+          float_val DOUBLE PRECISION,
+          bool_val BOOLEAN,
+          created_at TIMESTAMPTZ,
+          text_val TEXT
+      )
+  )");
+  ASSERT_TRUE(create_result) << create_result.error().message;
+
+  TypedRow t;
+  const std::chrono::system_clock::time_point created_at =
+      std::chrono::sys_days{std::chrono::year{2024} / 2 / 29} + std::chrono::hours{13} +
+      std::chrono::microseconds{250};
+
+  auto insert = relx::query::insert_into(t)
+                    .columns(t.int_val, t.big_val, t.float_val, t.bool_val, t.created_at,
+                             t.text_val)
+                    .values(-7, 9'000'000'000LL, 0.1, true, relx::query::value(created_at),
+                            "it's binary");
+  auto insert_result = conn.execute(insert);
+  ASSERT_TRUE(insert_result) << insert_result.error().message;
+
+  // The same query with and without the statement cache, which prepares it with the types
+  for (bool cached : {false, true}) {
+    if (cached) {
+      conn.enable_statement_cache();
+    }
+
+    auto select =
+        relx::query::select(t.text_val, t.created_at)
+            .from(t)
+            .where(relx::query::column_ref(t.big_val) == relx::query::val(9'000'000'000LL) &&
+                   relx::query::column_ref(t.int_val) == relx::query::val(-7) &&
+                   relx::query::column_ref(t.float_val) == relx::query::val(0.1) &&
+                   relx::query::column_ref(t.created_at) == relx::query::value(created_at));
+    auto result = conn.execute(select);
+    ASSERT_TRUE(result) << result.error().message;
+    ASSERT_EQ(1, result->size()) << "cached: " << cached;
+
+    auto text_val = (*result)[0].get<std::string>("text_val");
+    ASSERT_TRUE(text_val);
+    EXPECT_EQ("it's binary", *text_val);
+  }
+
+  conn.disconnect();
+}
+
+TEST_F(PostgreSQLTypedParamsTest, TimePointsKeepUtcInTimestampColumns) {
+  relx::connection::PostgreSQLConnection conn(conn_string);
+  ASSERT_TRUE(conn.connect());
+  ASSERT_TRUE(conn.execute_raw("SET TimeZone = 'America/New_York'"));
+
+  auto create_result = conn.execute_raw(R"(
+      CREATE TABLE typed_binary_test (
+          int_val INTEGER,
+          created_at TIMESTAMP
+      )
+  )");
+  ASSERT_TRUE(create_result) << create_result.error().message;
+
+  TypedRow t;
+  const std::chrono::system_clock::time_point created_at =
+      std::chrono::sys_days{std::chrono::year{2024} / 2 / 29} + std::chrono::hours{13};
+  auto insert_result = conn.execute(relx::query::insert_into(t)
+                                        .columns(t.int_val, t.created_at)
+                                        .values(1, relx::query::value(created_at)));
+  ASSERT_TRUE(insert_result) << insert_result.error().message;
+
+  // A TIMESTAMP column stores the UTC wall time, not the session's local time
+  auto result = conn.execute_raw("SELECT created_at::text AS created_at FROM typed_binary_test");
+  ASSERT_TRUE(result) << result.error().message;
+  ASSERT_EQ(1, result->size());
+  auto stored = (*result)[0].get<std::string>("created_at");
+  ASSERT_TRUE(stored);
+  EXPECT_EQ("2024-02-29 13:00:00", *stored);
+
+  conn.disconnect();
+}
+
+}  // namespace
@@ -0,0 +1,85 @@
+#include "test_common.hpp"
+
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace relx;
+using namespace test_tables;
+
+TEST(ParamTest, RendersPlaceholdersAndSlots) {
+  users u;
+
+  auto query = query::select(u.id, u.name)
+                   .from(u)
+                   .where(u.age > query::param<int>("min_age") && u.login_count > 3 &&
+                          u.name == query::param<std::string>("name"));
+
+  static_assert(query::ParameterizedQuery<decltype(query)>);
+  static_assert(
+      std::is_same_v<std::tuple<int, std::string>, query::param_types_t<decltype(query)>>);
+
+  EXPECT_EQ("SELECT users.id, users.name FROM users WHERE (((users.age > ?) AND "
+            "(users.login_count > ?)) AND (users.name = ?))",
+            query.to_sql());
+
+  query::SqlWriter writer(query::PlaceholderStyle::Numbered);
+  writer.set_typed_params(true);
+  query::render_to(writer, query);
+
+  EXPECT_EQ("SELECT users.id, users.name FROM users WHERE (((users.age > $1) AND "
+            "(users.login_count > $2)) AND (users.name = $3))",
+            writer.sql());
+
+  // The fixed value is bound, the slots wait for their values
+  ASSERT_EQ(3, writer.params().size());
+  ASSERT_EQ(2, writer.param_slots().size());
+  EXPECT_EQ("min_age", writer.param_slots()[0].name);
+  EXPECT_EQ(0, writer.param_slots()[0].index);
+  EXPECT_EQ(typeid(int), *writer.param_slots()[0].type);
+  EXPECT_EQ("name", writer.param_slots()[1].name);
+  EXPECT_EQ(2, writer.param_slots()[1].index);
+  EXPECT_EQ(typeid(std::string), *writer.param_slots()[1].type);
+
+  // Integers are sent in binary, strings as untyped text
+  EXPECT_EQ((std::vector<unsigned int>{23, 23, 0}), writer.param_types().oids);
+  EXPECT_EQ((std::vector<int>{1, 1, 0}), writer.param_types().formats);
+}
+
+TEST(ParamTest, ParamTypesFollowRenderingOrder) {
+  users u;
+
+  // HAVING is rendered before ORDER BY even though it is added later
+  auto query = query::select(u.age, query::count(u.id))
+                   .from(u)
+                   .where(u.is_active == query::param<bool>("active"))
+                   .group_by(u.age)
+                   .having(query::count(u.id) > query::param<int>("min_count"));
+  static_assert(
+      std::is_same_v<std::tuple<bool, int>, query::param_types_t<decltype(query)>>);
+
+  query::SqlWriter writer(query::PlaceholderStyle::Numbered);
+  query::render_to(writer, query);
+  ASSERT_EQ(2, writer.param_slots().size());
+  EXPECT_EQ("active", writer.param_slots()[0].name);
+  EXPECT_EQ("min_count", writer.param_slots()[1].name);
+
+  auto update = query::update(u)
+                    .set(u.name, query::param<std::string>("name"))
+                    .where(u.id == query::param<int>("id"));
+  static_assert(
+      std::is_same_v<std::tuple<std::string, int>, query::param_types_t<decltype(update)>>);
+  EXPECT_EQ("UPDATE users SET name = ? WHERE (users.id = ?)", update.to_sql());
+}
+
+TEST(ParamTest, QueriesWithoutParamsAreNotParameterized) {
+  users u;
+
+  auto query = query::select(u.id).from(u).where(u.age > 18);
+  static_assert(!query::ParameterizedQuery<decltype(query)>);
+  static_assert(std::is_same_v<std::tuple<>, query::param_types_t<decltype(query)>>);
+}
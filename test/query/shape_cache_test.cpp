@@ -0,0 +1,149 @@
+#include "test_common.hpp"
+
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace relx;
+using namespace test_tables;
+
+namespace {
+
+// Build two queries of the same C++ type whose SQL differs only by a runtime operator
+auto select_by_id(const users& u, bool negate) {
+  auto id = query::column_ref(u.id);
+  auto cond = negate ? (id != query::val(1)) : (id == query::val(1));
+  return query::select(u.id, u.name).from(u).where(cond);
+}
+
+}  // namespace
+
+TEST(ShapeCacheTest, StaticQueriesAreMemoised) {
+  users u;
+
+  auto query = query::select(u.id, u.name).from(u).where(query::column_ref(u.id) == query::val(7));
+  using Query = decltype(query);
+  static_assert(Query::has_static_shape);
+
+  EXPECT_EQ("SELECT users.id, users.name FROM users WHERE (users.id = ?)", query.to_sql());
+  EXPECT_EQ(1, query::ShapeCache<Query>::size());
+
+  // Rendering again hits the cache and still collects the instance's own parameters
+  auto other = query::select(u.id, u.name).from(u).where(query::column_ref(u.id) == query::val(9));
+  EXPECT_EQ(query.to_sql(), other.to_sql());
+  EXPECT_EQ(1, query::ShapeCache<Query>::size());
+  EXPECT_EQ(std::vector<std::string>{"9"}, other.bind_params());
+}
+
+TEST(ShapeCacheTest, RuntimeOperatorIsPartOfTheShape) {
+  users u;
+
+  auto equal = select_by_id(u, false);
+  auto not_equal = select_by_id(u, true);
+  static_assert(std::is_same_v<decltype(equal), decltype(not_equal)>);
+
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ("SELECT users.id, users.name FROM users WHERE (users.id = ?)", equal.to_sql());
+    EXPECT_EQ("SELECT users.id, users.name FROM users WHERE (users.id != ?)", not_equal.to_sql());
+  }
+}
+
+TEST(ShapeCacheTest, RuntimeJoinTypeIsPartOfTheShape) {
+  users u;
+  posts p;
+
+  auto cond = query::column_ref(u.id) == query::column_ref(p.user_id);
+  auto inner = query::select(u.name, p.title).from(u).join(p, cond, query::JoinType::Inner);
+  auto left = query::select(u.name, p.title).from(u).join(p, cond, query::JoinType::Left);
+  static_assert(std::is_same_v<decltype(inner), decltype(left)>);
+
+  EXPECT_EQ("SELECT users.name, posts.title FROM users JOIN posts ON (users.id = posts.user_id)",
+            inner.to_sql());
+  EXPECT_EQ(
+      "SELECT users.name, posts.title FROM users LEFT JOIN posts ON (users.id = posts.user_id)",
+      left.to_sql());
+}
+
+TEST(ShapeCacheTest, NullOptionalValueIsPartOfTheShape) {
+  users u;
+
+  auto with_bio = query::insert_into(u)
+                      .columns(u.name, u.bio)
+                      .values(query::val("alice"), query::val(std::optional<std::string>("hi")));
+  auto without_bio =
+      query::insert_into(u)
+          .columns(u.name, u.bio)
+          .values(query::val("bob"), query::val(std::optional<std::string>(std::nullopt)));
+  static_assert(std::is_same_v<decltype(with_bio), decltype(without_bio)>);
+
+  EXPECT_EQ("INSERT INTO users (name, bio) VALUES (?, ?)", with_bio.to_sql());
+  EXPECT_EQ("INSERT INTO users (name, bio) VALUES (?, NULL)", without_bio.to_sql());
+  EXPECT_EQ(1, without_bio.bind_params().size());
+}
+
+TEST(ShapeCacheTest, UpdateAndDeleteAreMemoised) {
+  users u;
+
+  auto update = query::update(u)
+                    .set(u.name, query::val("carol"))
+                    .where(query::column_ref(u.id) == query::val(3));
+  static_assert(decltype(update)::has_static_shape);
+  EXPECT_EQ("UPDATE users SET name = ? WHERE (users.id = ?)", update.to_sql());
+  EXPECT_EQ("UPDATE users SET name = ? WHERE (users.id = ?)", update.to_sql());
+
+  auto remove = query::delete_from(u).where(query::column_ref(u.id) > query::val(3));
+  static_assert(decltype(remove)::has_static_shape);
+  EXPECT_EQ("DELETE FROM users WHERE (users.id > ?)", remove.to_sql());
+  EXPECT_EQ(std::vector<std::string>{"3"}, remove.bind_params());
+}
+
+TEST(ShapeCacheTest, RuntimeVariableQueriesAreNotMemoised) {
+  users u;
+
+  auto ids = std::vector<std::string>{"1", "2", "3"};
+  auto in_list = query::select(u.id).from(u).where(query::in(query::column_ref(u.id), ids));
+  static_assert(!decltype(in_list)::has_static_shape);
+  EXPECT_EQ("SELECT users.id FROM users WHERE users.id IN (?, ?, ?)", in_list.to_sql());
+
+  auto aliased = query::select(query::as(u.name, "n")).from(u);
+  static_assert(!decltype(aliased)::has_static_shape);
+  EXPECT_EQ("SELECT users.name AS n FROM users", aliased.to_sql());
+}
+
+TEST(ShapeCacheTest, LongShapeTextDoesNotCollide) {
+  // A 257-byte string whose length would wrap to 1 in a one-byte prefix, laid out so that it
+  // reads like "c" followed by a 255-byte string
+  const std::string long_text = "c\xff" + std::string(255, 'u');
+  std::string one_long;
+  query::append_shape_text(one_long, long_text);
+
+  std::string two_short;
+  query::append_shape_text(two_short, "c");
+  query::append_shape_text(two_short, std::string(255, 'u'));
+  EXPECT_NE(one_long, two_short);
+
+  users u;
+  const std::string op(300, '~');
+  auto query = query::select(u.id).from(u).where(
+      query::BinaryCondition(query::column_ref(u.id), op, query::val(1)));
+  EXPECT_EQ("SELECT users.id FROM users WHERE (users.id " + op + " ?)", query.to_sql());
+}
+
+TEST(ShapeCacheTest, LongTableNameDoesNotCollide) {
+  users u;
+  using Adapter = query::SchemaColumnAdapter<decltype(u.id)>;
+
+  // With a one-byte length prefix, 255 + 1 wraps to the byte that marks the column's own
+  // table, so these two column pairs would build the same key
+  const std::string first_name = std::string(1, '\0') + std::string(254, 't');
+  const std::string second_name = std::string(254, 't') + std::string(1, '\0');
+  auto renamed_first = query::select(Adapter(u.id, first_name), Adapter(u.id)).from(u);
+  auto renamed_second = query::select(Adapter(u.id), Adapter(u.id, second_name)).from(u);
+  static_assert(std::is_same_v<decltype(renamed_first), decltype(renamed_second)>);
+
+  EXPECT_EQ("SELECT " + first_name + ".id, users.id FROM users", renamed_first.to_sql());
+  EXPECT_EQ("SELECT users.id, " + second_name + ".id FROM users", renamed_second.to_sql());
+}
@@ -0,0 +1,175 @@
+#include "test_common.hpp"
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace relx;
+using namespace test_tables;
+
+TEST(SqlWriterTest, NumbersPlaceholdersInOnePass) {
+  users u;
+
+  auto query = query::select(u.id, u.name)
+                   .from(u)
+                   .where(query::column_ref(u.age) > query::val(18) &&
+                          query::like(query::column_ref(u.name), "a%"))
+                   .limit(10);
+
+  query::SqlWriter writer(query::PlaceholderStyle::Numbered);
+  query::render_to(writer, query);
+
+  EXPECT_EQ(
+      "SELECT users.id, users.name FROM users WHERE ((users.age > $1) AND users.name LIKE $2) "
+      "LIMIT $3",
+      writer.sql());
+  EXPECT_EQ((std::vector<std::string>{"18", "a%", "10"}), writer.params());
+  EXPECT_EQ(3, writer.placeholder_count());
+
+  // to_sql() and bind_params() are thin wrappers over the same walk
+  EXPECT_EQ("SELECT users.id, users.name FROM users WHERE ((users.age > ?) AND users.name LIKE ?) "
+            "LIMIT ?",
+            query.to_sql());
+  EXPECT_EQ(writer.params(), query.bind_params());
+}
+
+TEST(SqlWriterTest, ExpressionsWithoutRenderAreAdapted) {
+  users u;
+
+  // Aggregate functions only implement to_sql(); their placeholders are renumbered in place
+  auto query = query::select(u.name, query::count(u.id))
+                   .from(u)
+                   .where(query::column_ref(u.age) > query::val(21))
+                   .group_by(u.name)
+                   .having(query::count(u.id) > query::val(2));
+
+  query::SqlWriter writer(query::PlaceholderStyle::Numbered);
+  query::render_to(writer, query);
+
+  EXPECT_NE(std::string::npos, writer.sql().find("(users.age > $1)"));
+  EXPECT_NE(std::string::npos, writer.sql().find("HAVING (COUNT(users.id) > $2)"));
+  EXPECT_EQ(std::string::npos, writer.sql().find('?'));
+  EXPECT_EQ((std::vector<std::string>{"21", "2"}), writer.params());
+}
+
+TEST(SqlWriterTest, MemoisedTextContinuesNumbering) {
+  users u;
+
+  auto by_id = [&](int id) {
+    return query::delete_from(u).where(query::column_ref(u.id) == query::val(id));
+  };
+
+  // The first render fills the shape cache, the second one uses it
+  for (int id : {1, 2}) {
+    query::SqlWriter writer(query::PlaceholderStyle::Numbered);
+    query::render_to(writer, by_id(id));
+    EXPECT_EQ("DELETE FROM users WHERE (users.id = $1)", writer.sql());
+    EXPECT_EQ(std::vector<std::string>{std::to_string(id)}, writer.params());
+  }
+
+  // Memoised $n text is only reused at the start of a statement
+  query::SqlWriter writer(query::PlaceholderStyle::Numbered);
+  writer.append("WITH x AS (SELECT ").param("7").append(") ");
+  query::render_to(writer, by_id(3));
+  EXPECT_EQ("WITH x AS (SELECT $1) DELETE FROM users WHERE (users.id = $2)", writer.sql());
+  EXPECT_EQ((std::vector<std::string>{"7", "3"}), writer.params());
+}
+
+TEST(SqlWriterTest, InListAndNullValues) {
+  users u;
+
+  auto query =
+      query::insert_into(u)
+          .columns(u.name, u.bio)
+          .values(query::val("a"), query::val(std::optional<std::string>(std::nullopt)))
+          .values(query::val("b"), query::val(std::optional<std::string>("bio")));
+
+  query::SqlWriter writer(query::PlaceholderStyle::Numbered);
+  query::render_to(writer, query);
+  EXPECT_EQ("INSERT INTO users (name, bio) VALUES ($1, NULL), ($2, $3)", writer.sql());
+  ASSERT_EQ(3, writer.params().size());
+  EXPECT_EQ("a", writer.params()[0]);
+  EXPECT_EQ("b", writer.params()[1]);
+
+  auto in_list = query::select(u.id).from(u).where(
+      query::in(query::column_ref(u.id), std::vector<std::string>{"4", "5"}));
+  writer.reset(query::PlaceholderStyle::Numbered);
+  query::render_to(writer, in_list);
+  EXPECT_EQ("SELECT users.id FROM users WHERE users.id IN ($1, $2)", writer.sql());
+}
+
+TEST(SqlWriterTest, LeasesReuseBuffersAndNest) {
+  const std::string* first_buffer = nullptr;
+  {
+    query::SqlWriterLease outer(query::PlaceholderStyle::Numbered);
+    outer->append("SELECT ").param("1");
+    first_buffer = &outer->sql();
+
+    query::SqlWriterLease inner;
+    EXPECT_NE(first_buffer, &inner->sql());
+    EXPECT_TRUE(inner->sql().empty());
+    EXPECT_EQ("SELECT $1", outer->sql());
+  }
+
+  query::SqlWriterLease again;
+  EXPECT_EQ(first_buffer, &again->sql());
+  EXPECT_TRUE(again->sql().empty());
+  EXPECT_TRUE(again->params().empty());
+}
+
+TEST(SqlWriterTest, TypedParamsUseBinaryEncodings) {
+  users u;
+
+  auto query =
+      query::select(u.id).from(u).where(u.id == 258 && u.name == "ann" && u.is_active == true);
+
+  query::SqlWriter writer(query::PlaceholderStyle::Numbered);
+  writer.set_typed_params(true);
+  query::render_to(writer, query);
+
+  const auto& types = writer.param_types();
+  ASSERT_EQ(3, writer.params().size());
+  EXPECT_EQ((std::vector<unsigned int>{23, 0, 16}), types.oids);
+  EXPECT_EQ((std::vector<int>{1, 0, 1}), types.formats);
+
+  // int4 in network byte order, text as is, bool as one byte
+  EXPECT_EQ(std::string("\x00\x00\x01\x02", 4), writer.params()[0]);
+  EXPECT_EQ("ann", writer.params()[1]);
+  EXPECT_EQ(std::string("\x01", 1), writer.params()[2]);
+
+  // Untyped rendering, as used by bind_params(), is unchanged
+  EXPECT_EQ((std::vector<std::string>{"258", "ann", "1"}), query.bind_params());
+}
+
+TEST(SqlWriterTest, BinaryEncodingsMatchPostgres) {
+  namespace chrono = std::chrono;
+
+  std::string float8;
+  schema::column_traits<double>::to_pg_binary(1.5, float8);
+  EXPECT_EQ(std::string("\x3F\xF8\x00\x00\x00\x00\x00\x00", 8), float8);
+
+  std::string int8;
+  schema::column_traits<long long>::to_pg_binary(-2, int8);
+  EXPECT_EQ(std::string("\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFE", 8), int8);
+
+  // Dates count from 2000-01-01
+  std::string date;
+  schema::column_traits<chrono::year_month_day>::to_pg_binary(chrono::year{1999} / 12 / 31, date);
+  EXPECT_EQ(std::string("\xFF\xFF\xFF\xFF", 4), date);
+}
+
+TEST(SqlWriterTest, TimePointsAreSentAsUntypedText) {
+  namespace chrono = std::chrono;
+  static_assert(!schema::BinaryParamType<chrono::system_clock::time_point>);
+
+  query::SqlWriter writer(query::PlaceholderStyle::Numbered);
+  writer.set_typed_params(true);
+  writer.bind_value(chrono::system_clock::time_point{chrono::sys_days{chrono::year{2000} / 1 / 2}});
+  ASSERT_EQ(1, writer.params().size());
+  EXPECT_EQ("'2000-01-02T00:00:00Z'", writer.params()[0]);
+  EXPECT_EQ(std::vector<unsigned int>{0}, writer.param_types().oids);
+  EXPECT_EQ(std::vector<int>{0}, writer.param_types().formats);
+}